@@ -0,0 +1,274 @@
+// Implementation of the interface described in crc.h.
+
+#ifdef __AVR__
+#  include <avr/pgmspace.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc.h"
+#include "util.h"
+
+// The polynomials, in the bit-reversed form used by these LSB-first
+// algorithms.
+#define DALLAS8_POLYNOMIAL 0x8C
+#define IBM16_POLYNOMIAL   0xA001
+#define CCITT_POLYNOMIAL   0x8408
+
+// Each table entry is the result of shifting its index through the CRC
+// register (with the polynomial feedback) four or eight times.  The tables
+// were generated by doing exactly that with the bitwise update functions.
+
+static uint8_t const dallas8_nibble_table[16] PROGMEM = {
+  0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8,
+  0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+static uint16_t const ibm16_nibble_table[16] PROGMEM = {
+  0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+  0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+static uint16_t const ccitt_nibble_table[16] PROGMEM = {
+  0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+  0x8408, 0x9489, 0xA50A, 0xB58B, 0xC60C, 0xD68D, 0xE70E, 0xF78F
+};
+
+#ifdef CRC_BUILD_BYTE_TABLE_FUNCTIONS
+
+static uint8_t const dallas8_byte_table[256] PROGMEM = {
+  0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83,
+  0xC2, 0x9C, 0x7E, 0x20, 0xA3, 0xFD, 0x1F, 0x41,
+  0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E,
+  0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC,
+  0x23, 0x7D, 0x9F, 0xC1, 0x42, 0x1C, 0xFE, 0xA0,
+  0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+  0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D,
+  0x7C, 0x22, 0xC0, 0x9E, 0x1D, 0x43, 0xA1, 0xFF,
+  0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5,
+  0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07,
+  0xDB, 0x85, 0x67, 0x39, 0xBA, 0xE4, 0x06, 0x58,
+  0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+  0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6,
+  0xA7, 0xF9, 0x1B, 0x45, 0xC6, 0x98, 0x7A, 0x24,
+  0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B,
+  0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9,
+  0x8C, 0xD2, 0x30, 0x6E, 0xED, 0xB3, 0x51, 0x0F,
+  0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+  0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92,
+  0xD3, 0x8D, 0x6F, 0x31, 0xB2, 0xEC, 0x0E, 0x50,
+  0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C,
+  0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE,
+  0x32, 0x6C, 0x8E, 0xD0, 0x53, 0x0D, 0xEF, 0xB1,
+  0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+  0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49,
+  0x08, 0x56, 0xB4, 0xEA, 0x69, 0x37, 0xD5, 0x8B,
+  0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4,
+  0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16,
+  0xE9, 0xB7, 0x55, 0x0B, 0x88, 0xD6, 0x34, 0x6A,
+  0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+  0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7,
+  0xB6, 0xE8, 0x0A, 0x54, 0xD7, 0x89, 0x6B, 0x35
+};
+
+static uint16_t const ibm16_byte_table[256] PROGMEM = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+  0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+  0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+  0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+  0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+  0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+  0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+  0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+  0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+  0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+  0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+  0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+  0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+  0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+  0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+  0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+  0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+static uint16_t const ccitt_byte_table[256] PROGMEM = {
+  0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+  0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+  0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+  0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+  0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+  0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+  0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+  0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+  0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+  0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+  0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+  0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+  0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+  0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+  0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+  0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+  0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+  0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+  0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+  0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+  0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+  0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+  0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+  0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+  0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+  0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+  0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+  0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+  0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+  0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+  0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+  0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+};
+
+#endif
+
+// The update steps themselves are inline so the buffer functions don't pay
+// for a call per byte.
+
+static inline uint8_t
+dallas8_bitwise_step (uint8_t crc, uint8_t data)
+{
+  crc ^= data;
+  for ( uint8_t ii = 0 ; ii < BITS_PER_BYTE ; ii++ ) {
+    if ( crc & B00000001 ) {
+      crc = (crc >> 1) ^ DALLAS8_POLYNOMIAL;
+    }
+    else {
+      crc >>= 1;
+    }
+  }
+
+  return crc;
+}
+
+static inline uint16_t
+crc16_bitwise_step (uint16_t crc, uint8_t data, uint16_t polynomial)
+{
+  crc ^= data;
+  for ( uint8_t ii = 0 ; ii < BITS_PER_BYTE ; ii++ ) {
+    if ( crc & B00000001 ) {
+      crc = (crc >> 1) ^ polynomial;
+    }
+    else {
+      crc >>= 1;
+    }
+  }
+
+  return crc;
+}
+
+static inline uint8_t
+dallas8_nibble_step (uint8_t crc, uint8_t data)
+{
+  crc ^= data;
+  crc = (crc >> 4) ^ pgm_read_byte (&(dallas8_nibble_table[crc & 0x0F]));
+  crc = (crc >> 4) ^ pgm_read_byte (&(dallas8_nibble_table[crc & 0x0F]));
+
+  return crc;
+}
+
+static inline uint16_t
+crc16_nibble_step (uint16_t crc, uint8_t data, uint16_t const *table)
+{
+  crc ^= data;
+  crc = (crc >> 4) ^ pgm_read_word (&(table[crc & 0x0F]));
+  crc = (crc >> 4) ^ pgm_read_word (&(table[crc & 0x0F]));
+
+  return crc;
+}
+
+#ifdef CRC_BUILD_BYTE_TABLE_FUNCTIONS
+
+static inline uint8_t
+dallas8_table_step (uint8_t crc, uint8_t data)
+{
+  return pgm_read_byte (&(dallas8_byte_table[crc ^ data]));
+}
+
+static inline uint16_t
+crc16_table_step (uint16_t crc, uint8_t data, uint16_t const *table)
+{
+  uint8_t index = LOW_BYTE (crc) ^ data;
+
+  return (crc >> BITS_PER_BYTE) ^ pgm_read_word (&(table[index]));
+}
+
+#endif
+
+// Define a public update function name that performs step, and a public
+// buffer function buffer_name that performs it for each byte of a buffer.
+// The step argument can be any expression in crc and data.
+#define DEFINE_FUNCTIONS(name, buffer_name, crc_type, step)         \
+  crc_type                                                          \
+  name (crc_type crc, uint8_t data)                                 \
+  {                                                                 \
+    return step;                                                    \
+  }                                                                 \
+                                                                    \
+  crc_type                                                          \
+  buffer_name (crc_type crc, void const *buf, size_t count)         \
+  {                                                                 \
+    uint8_t const *bp = buf;                                        \
+    for ( size_t ii = 0 ; ii < count ; ii++ ) {                     \
+      uint8_t data = bp[ii];                                        \
+      crc = step;                                                   \
+    }                                                               \
+                                                                    \
+    return crc;                                                     \
+  }
+
+DEFINE_FUNCTIONS (
+    crc_dallas8_update_bitwise, crc_dallas8_bitwise, uint8_t,
+    dallas8_bitwise_step (crc, data) )
+DEFINE_FUNCTIONS (
+    crc_dallas8_update_nibble, crc_dallas8_nibble, uint8_t,
+    dallas8_nibble_step (crc, data) )
+
+DEFINE_FUNCTIONS (
+    crc_ibm16_update_bitwise, crc_ibm16_bitwise, uint16_t,
+    crc16_bitwise_step (crc, data, IBM16_POLYNOMIAL) )
+DEFINE_FUNCTIONS (
+    crc_ibm16_update_nibble, crc_ibm16_nibble, uint16_t,
+    crc16_nibble_step (crc, data, ibm16_nibble_table) )
+
+DEFINE_FUNCTIONS (
+    crc_ccitt_update_bitwise, crc_ccitt_bitwise, uint16_t,
+    crc16_bitwise_step (crc, data, CCITT_POLYNOMIAL) )
+DEFINE_FUNCTIONS (
+    crc_ccitt_update_nibble, crc_ccitt_nibble, uint16_t,
+    crc16_nibble_step (crc, data, ccitt_nibble_table) )
+
+#ifdef CRC_BUILD_BYTE_TABLE_FUNCTIONS
+
+DEFINE_FUNCTIONS (
+    crc_dallas8_update_table, crc_dallas8_table, uint8_t,
+    dallas8_table_step (crc, data) )
+DEFINE_FUNCTIONS (
+    crc_ibm16_update_table, crc_ibm16_table, uint16_t,
+    crc16_table_step (crc, data, ibm16_byte_table) )
+DEFINE_FUNCTIONS (
+    crc_ccitt_update_table, crc_ccitt_table, uint16_t,
+    crc16_table_step (crc, data, ccitt_byte_table) )
+
+#endif
@@ -0,0 +1,98 @@
+// Dallas CRC8, CRC16 (IBM) and CRC-CCITT with different size/speed tradeoffs
+//
+// Test driver: crc_test.c    Implementation: crc.c
+// Host test driver: crc_host_test.c
+//
+// The AVR libc <util/crc16.h> functions _crc_ibutton_update(),
+// _crc16_update() and _crc_ccitt_update() are used throughout the 1-wire
+// and XBee code.  They're small, but they work a bit at a time, and they're
+// called once per byte.  This interface computes exactly the same CRCs
+// (so the functions here can replace those from AVR libc one-for-one), in
+// three variants that trade program memory for speed:
+//
+//   * *_bitwise: no table, a bit at a time like the AVR libc functions
+//
+//   * *_nibble: four bits at a time using a 16 entry table in program
+//     memory (16 bytes for CRC8, 32 bytes for the CRC16s)
+//
+//   * *_table: a whole byte at a time using a 256 entry table in program
+//     memory (256 bytes for CRC8, 512 bytes for the CRC16s)
+//
+// Each variant comes as a byte update function and a buffer function.
+// The buffer functions avoid the per-byte function call overhead, so
+// they're the ones to use when the data is all available at once.  The
+// crc_test.c program verifies all the variants against the AVR libc
+// functions and prints the number of cycles each one takes per byte, so
+// each hot path can pick the tradeoff that suits it.
+//
+// Since our build system doesn't discard unused functions, the 256
+// entry tables would cost 1280 bytes of program memory in every program
+// using this interface.  So the *_table functions are only built if
+// CRC_BUILD_BYTE_TABLE_FUNCTIONS is defined (see the Makefile for this
+// module).
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Conventional initial values.  The CRC8 is the one used for 1-wire ROM
+// IDs and DS18B20 scratchpads.  The CRC16 one is what the 1-wire logger
+// modules use, and the CRC-CCITT one is what wireless_xbee.h uses.
+#define CRC_DALLAS8_INITIAL_VALUE 0x00
+#define CRC_IBM16_INITIAL_VALUE   0xFFFF
+#define CRC_CCITT_INITIAL_VALUE   0xFFFF
+
+// Dallas (Maxim) 1-wire CRC8 (polynomial x^8 + x^5 + x^4 + 1).  These give
+// the same results as _crc_ibutton_update() from AVR libc.
+uint8_t
+crc_dallas8_update_bitwise (uint8_t crc, uint8_t data);
+uint8_t
+crc_dallas8_update_nibble (uint8_t crc, uint8_t data);
+uint8_t
+crc_dallas8_bitwise (uint8_t crc, void const *buf, size_t count);
+uint8_t
+crc_dallas8_nibble (uint8_t crc, void const *buf, size_t count);
+
+// IBM CRC16 (polynomial x^16 + x^15 + x^2 + 1).  These give the same
+// results as _crc16_update() from AVR libc.
+uint16_t
+crc_ibm16_update_bitwise (uint16_t crc, uint8_t data);
+uint16_t
+crc_ibm16_update_nibble (uint16_t crc, uint8_t data);
+uint16_t
+crc_ibm16_bitwise (uint16_t crc, void const *buf, size_t count);
+uint16_t
+crc_ibm16_nibble (uint16_t crc, void const *buf, size_t count);
+
+// CRC-CCITT (polynomial x^16 + x^12 + x^5 + 1, processed LSB first).  These
+// give the same results as _crc_ccitt_update() from AVR libc.
+uint16_t
+crc_ccitt_update_bitwise (uint16_t crc, uint8_t data);
+uint16_t
+crc_ccitt_update_nibble (uint16_t crc, uint8_t data);
+uint16_t
+crc_ccitt_bitwise (uint16_t crc, void const *buf, size_t count);
+uint16_t
+crc_ccitt_nibble (uint16_t crc, void const *buf, size_t count);
+
+#ifdef CRC_BUILD_BYTE_TABLE_FUNCTIONS
+
+// Byte table variants of all the above.
+uint8_t
+crc_dallas8_update_table (uint8_t crc, uint8_t data);
+uint8_t
+crc_dallas8_table (uint8_t crc, void const *buf, size_t count);
+uint16_t
+crc_ibm16_update_table (uint16_t crc, uint8_t data);
+uint16_t
+crc_ibm16_table (uint16_t crc, void const *buf, size_t count);
+uint16_t
+crc_ccitt_update_table (uint16_t crc, uint8_t data);
+uint16_t
+crc_ccitt_table (uint16_t crc, void const *buf, size_t count);
+
+#endif
+
+#endif // CRC_H
@@ -0,0 +1,186 @@
+// Host test driver for crc.c (see the host_test target in generic.mk).
+//
+// crc_test.c checks each variant on one small buffer on the AVR itself.
+// On the development machine we can afford to be exhaustive: every update
+// function is checked against the reference for every possible CRC value
+// and data byte, and the buffer functions are checked on many random
+// buffers (including empty ones, and ones split across several calls).
+// The references are the C equivalents of the AVR libc <util/crc16.h>
+// functions given in the AVR libc documentation, so this also shows the
+// table contents in crc.c are right.
+//
+// This program exits with a non-zero status after printing a description
+// of the first failure, or prints a summary line per variant and exits
+// with status zero if everything passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc_host_test.h"
+#include "crc.h"
+#include "host_test_util.h"
+
+// Standard check string, and the CRCs it's supposed to give (using the
+// CRC_*_INITIAL_VALUE initial values).
+static char const check_string[] = "123456789";
+#define DALLAS8_CHECK_VALUE 0xA1
+#define IBM16_CHECK_VALUE   0x4B37
+#define CCITT_CHECK_VALUE   0x6F91
+
+#define RANDOM_BUFFER_COUNT    1000
+#define MAX_RANDOM_BUFFER_SIZE 300
+
+// C equivalents of the AVR libc functions (from the AVR libc
+// documentation for <util/crc16.h>).
+
+static uint8_t
+libc_crc_ibutton_update (uint8_t crc, uint8_t data)
+{
+  crc = crc ^ data;
+  for ( uint8_t ii = 0 ; ii < 8 ; ii++ ) {
+    if ( crc & 0x01 ) {
+      crc = (crc >> 1) ^ 0x8C;
+    }
+    else {
+      crc >>= 1;
+    }
+  }
+
+  return crc;
+}
+
+static uint16_t
+libc_crc16_update (uint16_t crc, uint8_t data)
+{
+  crc ^= data;
+  for ( uint8_t ii = 0 ; ii < 8 ; ii++ ) {
+    if ( crc & 1 ) {
+      crc = (crc >> 1) ^ 0xA001;
+    }
+    else {
+      crc = (crc >> 1);
+    }
+  }
+
+  return crc;
+}
+
+static uint16_t
+libc_crc_ccitt_update (uint16_t crc, uint8_t data)
+{
+  data ^= LOW_BYTE (crc);
+  data ^= data << 4;
+
+  return ((((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t) (data >> 4)
+          ^ ((uint16_t) data << 3));
+}
+
+// Check update function update_function and buffer function buffer_function
+// (for CRCs of crc_type) against reference update function libc_function,
+// and check that they give check_value for check_string starting from
+// initial.
+#define CHECK_VARIANT(                                                    \
+    buffer_function, update_function, libc_function, crc_type, initial,   \
+    check_value )                                                         \
+  do {                                                                    \
+    if ( buffer_function (initial, check_string, strlen (check_string))   \
+         != check_value ) {                                               \
+      fprintf (stderr, #buffer_function "() gave wrong check value\n");   \
+      exit (EXIT_FAILURE);                                                \
+    }                                                                     \
+                                                                          \
+    /* Every CRC value and data byte */                                   \
+    for ( uint32_t XxX_crc = 0 ;                                          \
+          XxX_crc <= (crc_type) ~((crc_type) 0) ;                         \
+          XxX_crc++ ) {                                                   \
+      for ( uint16_t XxX_data = 0 ; XxX_data <= UINT8_MAX ; XxX_data++ ) { \
+        if ( update_function (XxX_crc, XxX_data)                          \
+             != libc_function (XxX_crc, XxX_data) ) {                     \
+          fprintf (                                                       \
+              stderr,                                                     \
+              #update_function "() wrong for CRC 0x%lx, data 0x%x\n",     \
+              (unsigned long) XxX_crc,                                    \
+              XxX_data );                                                 \
+          exit (EXIT_FAILURE);                                            \
+        }                                                                 \
+      }                                                                   \
+    }                                                                     \
+                                                                          \
+    /* Random buffers, starting from random CRC values, with the buffer   \
+       function called on the whole buffer and on two pieces of it */     \
+    for ( uint16_t XxX_ii = 0 ; XxX_ii < RANDOM_BUFFER_COUNT ; XxX_ii++ ) { \
+      uint8_t XxX_buffer[MAX_RANDOM_BUFFER_SIZE];                         \
+      size_t XxX_size = random_uint32 () % (MAX_RANDOM_BUFFER_SIZE + 1);  \
+      for ( size_t XxX_jj = 0 ; XxX_jj < XxX_size ; XxX_jj++ ) {          \
+        XxX_buffer[XxX_jj] = random_uint32 ();                            \
+      }                                                                   \
+      crc_type XxX_start = random_uint32 ();                              \
+      crc_type XxX_expected = XxX_start;                                  \
+      for ( size_t XxX_jj = 0 ; XxX_jj < XxX_size ; XxX_jj++ ) {          \
+        XxX_expected = libc_function (XxX_expected, XxX_buffer[XxX_jj]);  \
+      }                                                                   \
+      size_t XxX_split = random_uint32 () % (XxX_size + 1);               \
+      crc_type XxX_whole                                                  \
+        = buffer_function (XxX_start, XxX_buffer, XxX_size);              \
+      crc_type XxX_pieces                                                 \
+        = buffer_function (                                               \
+            buffer_function (XxX_start, XxX_buffer, XxX_split),           \
+            XxX_buffer + XxX_split,                                       \
+            XxX_size - XxX_split );                                       \
+      if ( XxX_whole != XxX_expected || XxX_pieces != XxX_expected ) {    \
+        fprintf (                                                         \
+            stderr,                                                       \
+            #buffer_function "() wrong for %zu byte buffer\n",            \
+            XxX_size );                                                   \
+        exit (EXIT_FAILURE);                                              \
+      }                                                                   \
+    }                                                                     \
+                                                                          \
+    printf (#buffer_function ": ok\n");                                   \
+  } while ( 0 )
+
+int
+main (void)
+{
+  CHECK_VARIANT (
+      crc_dallas8_bitwise, crc_dallas8_update_bitwise,
+      libc_crc_ibutton_update, uint8_t,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_dallas8_nibble, crc_dallas8_update_nibble,
+      libc_crc_ibutton_update, uint8_t,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_dallas8_table, crc_dallas8_update_table,
+      libc_crc_ibutton_update, uint8_t,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+
+  CHECK_VARIANT (
+      crc_ibm16_bitwise, crc_ibm16_update_bitwise,
+      libc_crc16_update, uint16_t,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ibm16_nibble, crc_ibm16_update_nibble,
+      libc_crc16_update, uint16_t,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ibm16_table, crc_ibm16_update_table,
+      libc_crc16_update, uint16_t,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+
+  CHECK_VARIANT (
+      crc_ccitt_bitwise, crc_ccitt_update_bitwise,
+      libc_crc_ccitt_update, uint16_t,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ccitt_nibble, crc_ccitt_update_nibble,
+      libc_crc_ccitt_update, uint16_t,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ccitt_table, crc_ccitt_update_table,
+      libc_crc_ccitt_update, uint16_t,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,29 @@
+// Stand-Ins Letting crc.c Compile on the Development Machine
+//
+// Host test driver: crc_host_test.c
+//
+// This header is force-included (with the compiler's -include option) when
+// crc.c is compiled for the host (see the Makefile).  It claims the include
+// guard of util.h, which is AVR-only, and supplies the few things crc.c
+// needs from it and from <avr/pgmspace.h> (which crc.c doesn't include on
+// the host) instead.  On the host the tables just live in ordinary memory.
+
+#ifndef CRC_HOST_TEST_H
+#define CRC_HOST_TEST_H
+
+#include <stdint.h>
+
+#define UTIL_H
+
+#define BITS_PER_BYTE 8
+
+#define B00000001 UINT8_C (1)
+
+#define LOW_BYTE(two_byte_value)                                        \
+  ((uint8_t) (((uint16_t) two_byte_value) & 0x00ff))
+
+#define PROGMEM
+#define pgm_read_byte(address) (*((uint8_t const *) (address)))
+#define pgm_read_word(address) (*((uint16_t const *) (address)))
+
+#endif // CRC_HOST_TEST_H
@@ -0,0 +1,182 @@
+// Test/demo for the crc.h interface.
+//
+// This program checks all the CRC variants against the standard check
+// values and against the AVR libc <util/crc16.h> functions, then measures
+// the number of CPU cycles each variant takes per byte (using timer1 as a
+// cycle counter).
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "crc.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "timer1_stopwatch.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+#if TIMER1_STOPWATCH_PRESCALER_DIVIDER != 1
+#  error This test counts cycles, so it needs a prescaler divider of 1
+#endif
+
+// Standard check string, and the CRCs it's supposed to give (using the
+// CRC_*_INITIAL_VALUE initial values).
+static char const check_string[] = "123456789";
+#define DALLAS8_CHECK_VALUE 0xA1
+#define IBM16_CHECK_VALUE   0x4B37
+#define CCITT_CHECK_VALUE   0x6F91
+
+#define TEST_BUFFER_SIZE 64
+static uint8_t test_buffer[TEST_BUFFER_SIZE];
+
+// AVR libc equivalents of our buffer functions (for comparison).
+
+static uint8_t
+libc_dallas8 (uint8_t crc, void const *buf, size_t count)
+{
+  for ( size_t ii = 0 ; ii < count ; ii++ ) {
+    crc = _crc_ibutton_update (crc, ((uint8_t const *) buf)[ii]);
+  }
+  return crc;
+}
+
+static uint16_t
+libc_ibm16 (uint16_t crc, void const *buf, size_t count)
+{
+  for ( size_t ii = 0 ; ii < count ; ii++ ) {
+    crc = _crc16_update (crc, ((uint8_t const *) buf)[ii]);
+  }
+  return crc;
+}
+
+static uint16_t
+libc_ccitt (uint16_t crc, void const *buf, size_t count)
+{
+  for ( size_t ii = 0 ; ii < count ; ii++ ) {
+    crc = _crc_ccitt_update (crc, ((uint8_t const *) buf)[ii]);
+  }
+  return crc;
+}
+
+// Check that buffer function buffer_function and update function
+// update_function both agree with reference function libc_function (on
+// test_buffer), and give check_value for check_string.
+#define CHECK_VARIANT(                                                    \
+    buffer_function, update_function, libc_function, initial, check_value ) \
+  do {                                                                    \
+    PFP ("Checking " #buffer_function "()... ");                          \
+    PFP_ASSERT (                                                          \
+        buffer_function (initial, check_string, strlen (check_string))    \
+        == check_value );                                                 \
+    uint16_t XxX_crc = initial;                                           \
+    for ( uint8_t XxX_ii = 0 ; XxX_ii < TEST_BUFFER_SIZE ; XxX_ii++ ) {   \
+      XxX_crc = update_function (XxX_crc, test_buffer[XxX_ii]);           \
+    }                                                                     \
+    uint16_t XxX_expected                                                 \
+      = libc_function (initial, test_buffer, TEST_BUFFER_SIZE);           \
+    PFP_ASSERT (XxX_crc == XxX_expected);                                 \
+    PFP_ASSERT (                                                          \
+        buffer_function (initial, test_buffer, TEST_BUFFER_SIZE)          \
+        == XxX_expected );                                                \
+    PFP ("ok.\n");                                                        \
+  } while ( 0 )
+
+// Somewhere to put benchmark results so the compiler can't optimize the
+// benchmarked calls away.
+static volatile uint16_t sink;
+
+// Time buffer_function on test_buffer, and print the cycles per byte (in
+// tenths of a cycle, to avoid needing floating point printf() support).
+#define BENCHMARK(buffer_function, initial)                             \
+  do {                                                                  \
+    TIMER1_STOPWATCH_RESET ();                                          \
+    sink = buffer_function (initial, test_buffer, TEST_BUFFER_SIZE);    \
+    uint16_t XxX_ticks = TIMER1_STOPWATCH_TICKS ();                     \
+    PFP_ASSERT (! TIMER1_STOPWATCH_OVERFLOWED ());                      \
+    uint32_t XxX_tenths = (XxX_ticks * 10UL) / TEST_BUFFER_SIZE;        \
+    PFP (                                                               \
+        "  %-22s %4lu.%lu cycles/byte\n",                               \
+        #buffer_function,                                               \
+        XxX_tenths / 10,                                                \
+        XxX_tenths % 10 );                                              \
+  } while ( 0 )
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  srandom (42);
+  for ( uint8_t ii = 0 ; ii < TEST_BUFFER_SIZE ; ii++ ) {
+    test_buffer[ii] = random ();
+  }
+
+  CHECK_VARIANT (
+      crc_dallas8_bitwise, crc_dallas8_update_bitwise, libc_dallas8,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_dallas8_nibble, crc_dallas8_update_nibble, libc_dallas8,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_dallas8_table, crc_dallas8_update_table, libc_dallas8,
+      CRC_DALLAS8_INITIAL_VALUE, DALLAS8_CHECK_VALUE );
+
+  CHECK_VARIANT (
+      crc_ibm16_bitwise, crc_ibm16_update_bitwise, libc_ibm16,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ibm16_nibble, crc_ibm16_update_nibble, libc_ibm16,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ibm16_table, crc_ibm16_update_table, libc_ibm16,
+      CRC_IBM16_INITIAL_VALUE, IBM16_CHECK_VALUE );
+
+  CHECK_VARIANT (
+      crc_ccitt_bitwise, crc_ccitt_update_bitwise, libc_ccitt,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ccitt_nibble, crc_ccitt_update_nibble, libc_ccitt,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+  CHECK_VARIANT (
+      crc_ccitt_table, crc_ccitt_update_table, libc_ccitt,
+      CRC_CCITT_INITIAL_VALUE, CCITT_CHECK_VALUE );
+
+  PFP ("\n");
+
+  timer1_stopwatch_init ();
+
+  PFP ("Benchmarks (%u byte buffer):\n", TEST_BUFFER_SIZE);
+  BENCHMARK (libc_dallas8, CRC_DALLAS8_INITIAL_VALUE);
+  BENCHMARK (crc_dallas8_bitwise, CRC_DALLAS8_INITIAL_VALUE);
+  BENCHMARK (crc_dallas8_nibble, CRC_DALLAS8_INITIAL_VALUE);
+  BENCHMARK (crc_dallas8_table, CRC_DALLAS8_INITIAL_VALUE);
+  BENCHMARK (libc_ibm16, CRC_IBM16_INITIAL_VALUE);
+  BENCHMARK (crc_ibm16_bitwise, CRC_IBM16_INITIAL_VALUE);
+  BENCHMARK (crc_ibm16_nibble, CRC_IBM16_INITIAL_VALUE);
+  BENCHMARK (crc_ibm16_table, CRC_IBM16_INITIAL_VALUE);
+  BENCHMARK (libc_ccitt, CRC_CCITT_INITIAL_VALUE);
+  BENCHMARK (crc_ccitt_bitwise, CRC_CCITT_INITIAL_VALUE);
+  BENCHMARK (crc_ccitt_nibble, CRC_CCITT_INITIAL_VALUE);
+  BENCHMARK (crc_ccitt_table, CRC_CCITT_INITIAL_VALUE);
+
+  PFP ("\n");
+  PFP ("All tests passed.\n");
+
+  for ( ; ; ) {
+    ;
+  }
+}
@@ -0,0 +1 @@
+../term_io/run_screen.mk
\ No newline at end of file
@@ -1,12 +1,15 @@
 // Implementation of the interface described in dc_motor.h.
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
 #include <assert.h>
 // FIXME: remove this if all it's needed for is assert once assert.h is fixed
 #include <stdlib.h>
+#include <util/atomic.h>
 
 #include "adc.h"
 #include "dc_motor.h"
+#include "dc_motor_pid_private.h"
 #include "dio.h"
 
 #define DC_MOTOR_DIRECTION_FORWARD HIGH
@@ -20,6 +23,57 @@
 #define DC_MOTOR_BREAK_OFF LOW
 #define DC_MOTOR_BREAK_ON  HIGH
 
+#define DC_MOTOR_CHANNEL_A_SET_BREAK(state) \
+  DIO_SET (DC_MOTOR_CHANNEL_A_BRAKE_DIO_PIN, state)
+#define DC_MOTOR_CHANNEL_B_SET_BREAK(state) \
+  DIO_SET (DC_MOTOR_CHANNEL_B_BRAKE_DIO_PIN, state)
+
+#define CHANNEL_COUNT 2
+
+// What's currently deciding the duty cycle of a channel.
+typedef enum {
+  MODE_DIRECT,    // dc_motor_set_speed() (or a finished ramp)
+  MODE_RAMP,      // dc_motor_ramp_to_speed() ramp in progress
+  MODE_CONTROL,   // Closed-loop control
+  MODE_BRAKE      // dc_motor_brake()
+} channel_mode_t;
+
+// State of a channel.  While the control loop is running, only the ISR
+// touches the fields other than mode, the PID target, and the parameters
+// (and the client only touches those from ATOMIC_BLOCKs).
+typedef struct {
+  channel_mode_t mode;
+  int16_t duty;                  // Duty cycle currently applied
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+  dc_motor_pid_state_t pid;      // Setpoint, gains, and PID terms
+  dc_motor_feedback_function_t feedback;
+  uint16_t current_sum;          // Sum of current samples since last step
+  uint8_t current_samples;       // Number of samples in current_sum
+  uint16_t current_ma;           // Average load current at the last step
+#endif
+} channel_state_t;
+
+static channel_state_t channels[CHANNEL_COUNT];
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+// TRUE iff the control loop is running.
+static volatile uint8_t loop_running = FALSE;
+
+// Channel whose current sense pin is being sampled, and number of
+// conversions remaining until the next control step.
+static dc_motor_channel_t sampling_channel;
+static uint8_t conversions_until_step;
+
+// Milliamps per raw ADC reading step, as Q6.10 fixed point.
+#define CURRENT_MA_PER_STEP_Q10                                   \
+  ((uint16_t) (                                                   \
+      DC_MOTOR_ADC_REFERENCE_VOLTAGE *                            \
+      DC_MOTOR_CURRENT_SENSE_AMPS_PER_VOLT * 1000.0 * 1024.0 /    \
+      (ADC_RAW_READING_STEPS - 1) + 0.5 ))
+
+#endif
+
 void
 dc_motor_init (void)
 {
@@ -122,42 +176,312 @@ dc_motor_init (void)
 // Map an argument in the range [0, 100] onto the range [0, 255].
 #define DC_MOTOR_SPEED_MAP(arg) (((uint16_t) arg * 255) / 100)
 
-void
-dc_motor_set_speed (dc_motor_channel_t channel, int8_t speed)
+static void
+set_duty (dc_motor_channel_t channel, int16_t duty)
 {
-  assert (-100 <= speed);
-  assert (speed <= 100);
+  // Release the brake and apply duty (which must be in [-DC_MOTOR_MAX_DUTY,
+  // DC_MOTOR_MAX_DUTY]) to channel.
+
+  uint8_t direction
+    = (duty >= 0 ? DC_MOTOR_DIRECTION_FORWARD : DC_MOTOR_DIRECTION_REVERSE);
+  uint8_t magnitude = (duty >= 0 ? duty : -duty);
 
   switch ( channel ) {
     case DC_MOTOR_CHANNEL_A:
-      if ( speed >= 0 ) {
-        DC_MOTOR_CHANNEL_A_SET_DIRECTION (DC_MOTOR_DIRECTION_FORWARD);
-        DC_MOTOR_CHANNEL_A_OCR_REGISTER = DC_MOTOR_SPEED_MAP (speed);
-      }
-      else { // ( speed < 0 )
-        DC_MOTOR_CHANNEL_A_SET_DIRECTION (DC_MOTOR_DIRECTION_REVERSE);
-        DC_MOTOR_CHANNEL_A_OCR_REGISTER = DC_MOTOR_SPEED_MAP (-speed);
-      }
+      DC_MOTOR_CHANNEL_A_SET_BREAK (DC_MOTOR_BREAK_OFF);
+      DC_MOTOR_CHANNEL_A_SET_DIRECTION (direction);
+      DC_MOTOR_CHANNEL_A_OCR_REGISTER = magnitude;
       break;
     case DC_MOTOR_CHANNEL_B:
-      if ( speed >= 0 ) {
-        DC_MOTOR_CHANNEL_B_SET_DIRECTION (DC_MOTOR_DIRECTION_FORWARD);
-        DC_MOTOR_CHANNEL_B_OCR_REGISTER = DC_MOTOR_SPEED_MAP (speed);
-      }
-      else { // ( speed < 0 )
-        DC_MOTOR_CHANNEL_B_SET_DIRECTION (DC_MOTOR_DIRECTION_REVERSE);
-        DC_MOTOR_CHANNEL_B_OCR_REGISTER = DC_MOTOR_SPEED_MAP (-speed);
-      }
+      DC_MOTOR_CHANNEL_B_SET_BREAK (DC_MOTOR_BREAK_OFF);
+      DC_MOTOR_CHANNEL_B_SET_DIRECTION (direction);
+      DC_MOTOR_CHANNEL_B_OCR_REGISTER = magnitude;
       break;
     default:
       assert (0);   // Shouldn't be here
       break;
   }
+
+  channels[channel].duty = duty;
+}
+
+void
+dc_motor_set_speed (dc_motor_channel_t channel, int8_t speed)
+{
+  assert (-100 <= speed);
+  assert (speed <= 100);
+
+  int16_t duty
+    = (speed >= 0 ? DC_MOTOR_SPEED_MAP (speed) : -DC_MOTOR_SPEED_MAP (-speed));
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    channels[channel].mode = MODE_DIRECT;
+    set_duty (channel, duty);
+  }
+}
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+static void
+select_adc_pin (dc_motor_channel_t channel)
+{
+  // Select the current sense pin for channel as the ADC input (see
+  // adc_read_raw()).
+
+  uint8_t pin = (channel == DC_MOTOR_CHANNEL_A ?
+                 DC_MOTOR_CHANNEL_A_CURRENT_SENSE_ADC_PIN :
+                 DC_MOTOR_CHANNEL_B_CURRENT_SENSE_ADC_PIN );
+  ADMUX = (ADMUX & 0xf0) | (pin & 0x0f);
+}
+
+static void
+start_loop (void)
+{
+  // Start the control loop if it isn't already running.  Must be called
+  // with interrupts disabled.
+
+  if ( loop_running ) {
+    return;
+  }
+
+  for ( uint8_t ii = 0 ; ii < CHANNEL_COUNT ; ii++ ) {
+    channels[ii].current_sum = 0;
+    channels[ii].current_samples = 0;
+  }
+  sampling_channel = DC_MOTOR_CHANNEL_A;
+  select_adc_pin (sampling_channel);
+  conversions_until_step = DC_MOTOR_CONTROL_CONVERSIONS;
+  loop_running = TRUE;
+
+  // Each conversion is started by the ISR for the previous one (rather
+  // than using free running mode), so we always know which pin a result
+  // came from.
+  ADCSRA |= _BV (ADIE) | _BV (ADSC);
+}
+
+static void
+control_step (void)
+{
+  // Perform a control step for each channel that needs one, and stop the
+  // loop if none do.
+
+  uint8_t active = FALSE;
+
+  for ( uint8_t ii = 0 ; ii < CHANNEL_COUNT ; ii++ ) {
+    channel_state_t *cs = &(channels[ii]);
+
+    if ( cs->current_samples > 0 ) {
+      uint16_t average = cs->current_sum / cs->current_samples;
+      cs->current_ma
+        = ((uint32_t) average * CURRENT_MA_PER_STEP_Q10) >> 10;
+      cs->current_sum = 0;
+      cs->current_samples = 0;
+    }
+
+    switch ( cs->mode ) {
+      case MODE_RAMP:
+        dc_motor_pid_advance_setpoint (&(cs->pid));
+        set_duty (ii, cs->pid.setpoint_q16 / 65536);
+        if ( cs->duty == cs->pid.target ) {
+          cs->mode = MODE_DIRECT;
+        }
+        else {
+          active = TRUE;
+        }
+        break;
+      case MODE_CONTROL:
+        {
+          int16_t measurement;
+          if ( cs->feedback == NULL ) {
+            measurement
+              = (cs->duty >= 0 ? cs->current_ma : -(cs->current_ma));
+          }
+          else {
+            measurement = cs->feedback (ii);
+          }
+          dc_motor_pid_advance_setpoint (&(cs->pid));
+          set_duty (ii, dc_motor_pid_step (&(cs->pid), measurement));
+          active = TRUE;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if ( ! active ) {
+    ADCSRA &= ~(_BV (ADIE));
+    loop_running = FALSE;
+  }
+}
+
+ISR (ADC_vect)
+{
+  channel_state_t *cs = &(channels[sampling_channel]);
+  cs->current_sum += ADC;
+  cs->current_samples++;
+
+  sampling_channel
+    = (sampling_channel == DC_MOTOR_CHANNEL_A ?
+       DC_MOTOR_CHANNEL_B :
+       DC_MOTOR_CHANNEL_A );
+  select_adc_pin (sampling_channel);
+
+  if ( --conversions_until_step == 0 ) {
+    conversions_until_step = DC_MOTOR_CONTROL_CONVERSIONS;
+    control_step ();
+  }
+
+  if ( loop_running ) {
+    ADCSRA |= _BV (ADSC);
+  }
+}
+
+void
+dc_motor_ramp_to_speed (
+    dc_motor_channel_t channel, int8_t target_speed, uint8_t rate )
+{
+  assert (-100 <= target_speed);
+  assert (target_speed <= 100);
+  assert (rate > 0);
+
+  channel_state_t *cs = &(channels[channel]);
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    cs->pid.target
+      = (target_speed >= 0 ?
+         DC_MOTOR_SPEED_MAP (target_speed) :
+         -DC_MOTOR_SPEED_MAP (-target_speed) );
+    cs->pid.setpoint_q16 = (int32_t) cs->duty * 65536;
+    cs->pid.slew_q16
+      = ((uint32_t) rate * DC_MOTOR_MAX_DUTY * 65536 / 100)
+        / DC_MOTOR_CONTROL_HZ;
+    cs->mode = MODE_RAMP;
+    start_loop ();
+  }
+
+  sei ();
+}
+
+#endif
+
+void
+dc_motor_brake (dc_motor_channel_t channel)
+{
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    channels[channel].mode = MODE_BRAKE;
+    channels[channel].duty = 0;
+
+    // Full duty cycle, so the motor terminals are shorted all the time.
+    switch ( channel ) {
+      case DC_MOTOR_CHANNEL_A:
+        DC_MOTOR_CHANNEL_A_SET_BREAK (DC_MOTOR_BREAK_ON);
+        DC_MOTOR_CHANNEL_A_OCR_REGISTER = DC_MOTOR_MAX_DUTY;
+        break;
+      case DC_MOTOR_CHANNEL_B:
+        DC_MOTOR_CHANNEL_B_SET_BREAK (DC_MOTOR_BREAK_ON);
+        DC_MOTOR_CHANNEL_B_OCR_REGISTER = DC_MOTOR_MAX_DUTY;
+        break;
+      default:
+        assert (0);   // Shouldn't be here
+        break;
+    }
+  }
+}
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+void
+dc_motor_control_start (
+    dc_motor_channel_t channel,
+    dc_motor_pid_parameters_t const *params,
+    dc_motor_feedback_function_t feedback )
+{
+  channel_state_t *cs = &(channels[channel]);
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    cs->pid.kp = params->kp;
+    cs->pid.ki = params->ki;
+    cs->pid.kd = params->kd;
+    cs->pid.slew_q16
+      = ((uint32_t) params->slew_rate * 65536) / DC_MOTOR_CONTROL_HZ;
+    cs->feedback = feedback;
+    cs->pid.target = 0;
+    cs->pid.setpoint_q16 = 0;
+    cs->pid.integral = 0;
+    cs->pid.have_measurement = FALSE;
+    cs->pid.measurement = 0;
+    set_duty (channel, 0);
+    cs->mode = MODE_CONTROL;
+    start_loop ();
+  }
+
+  sei ();
+}
+
+void
+dc_motor_control_set_target (dc_motor_channel_t channel, int16_t target)
+{
+  assert (channels[channel].mode == MODE_CONTROL);
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    channels[channel].pid.target = target;
+  }
+}
+
+int16_t
+dc_motor_control_feedback (dc_motor_channel_t channel)
+{
+  assert (channels[channel].mode == MODE_CONTROL);
+
+  int16_t result;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    result = channels[channel].pid.measurement;
+  }
+
+  return result;
+}
+
+#endif
+
+int16_t
+dc_motor_duty (dc_motor_channel_t channel)
+{
+  int16_t result;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    result = channels[channel].duty;
+  }
+
+  return result;
 }
 
 float
 dc_motor_load_current (dc_motor_channel_t channel)
 {
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+  uint8_t running;
+  uint16_t current_ma;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    running = loop_running;
+    current_ma = channels[channel].current_ma;
+  }
+
+  if ( running ) {
+    return current_ma / 1000.0;
+  }
+#endif
+
   uint8_t adc_pin;
 
   switch ( channel ) {
@@ -2,6 +2,7 @@
 // Motor Shield Model R3 (http://arduino.cc/en/Main/ArduinoMotorShieldR3).
 //
 // Test driver: dc_motor_test.c    Implementation: dc_motor.c
+// Host test driver: dc_motor_host_test.c
 //
 // The Arduino motor shield is a fairly thin wrapper around the underlying
 // L298P H-Bridge controller chip.
@@ -9,6 +10,8 @@
 #ifndef DC_MOTOR_H
 #define DC_MOTOR_H
 
+#include <inttypes.h>
+
 //  These pins are used by the shield for direction and brake controls
 #define DC_MOTOR_CHANNEL_A_DIRECTION_DIO_PIN DIO_PIN_DIGITAL_12
 #define DC_MOTOR_CHANNEL_B_DIRECTION_DIO_PIN DIO_PIN_DIGITAL_13
@@ -59,24 +62,36 @@ dc_motor_init (void);
 // 0 => off, 100 => full speed ahead).  WARNING: it's possible for sudden
 // changes to the motor speed or direction to place significant inertial
 // loads on the motor.  You might want to call this routine multiple times
-// over time, or perhaps implement dc_motor_ramp_to_speed() (see below).
+// over time, or use dc_motor_ramp_to_speed() (see below, this requires
+// DC_MOTOR_USE_CONTROL_LOOP to be defined).  This cancels any
+// ramp or closed-loop control in progress on channel, and releases the
+// brake.
 void
 dc_motor_set_speed (dc_motor_channel_t channel, int8_t speed);
 
-// FIXXME: something like this might be useful in some applications to slowly
-// ramp the speed to a given setting and thereby avoid high acceleration
-// loading.  It could be implemented easily in terms of dc_motor_set_speed().
-// It's unimplemented because I've only used heavily geared gear motors,
-// and so haven't needed this.
-//void
-//dc_motor_ramp_to_speed (
-//    dc_motor_channel_t channel, uint8_t target_speed, uint8_t rate );
-
-// FIXXME: For reaons similar to those discussed above for the prospective
-// dc_motor_ramp_to_speed() function, this is currently unimplemented
-// (though the break lines are initialized by dc_motor_init()).
-//void
-//dc_motor_brake (dc_motor_channel_t channel);
+// Ramp the speed of channel from its current setting to target_speed (which
+// is interpreted as for dc_motor_set_speed()) at rate percent of full speed
+// per second (so a rate of 50 takes two seconds to go from stopped to full
+// speed), to avoid high acceleration loading.  The rate must be greater
+// than zero.  This function returns right away, and the ramp is done in
+// the background by the control loop (see below), so this function only
+// exists if DC_MOTOR_USE_CONTROL_LOOP is defined.  This cancels any ramp
+// or closed-loop control in progress on channel, and releases the brake.
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+void
+dc_motor_ramp_to_speed (
+    dc_motor_channel_t channel, int8_t target_speed, uint8_t rate );
+#endif
+
+// Apply the brake on channel.  This makes the L298P short the motor
+// terminals together, which stops the motor much faster than setting the
+// speed to 0 (which lets it coast).  Braking a fast-moving motor causes
+// high loads, so it might be best to use dc_motor_ramp_to_speed() first.
+// This cancels any ramp or closed-loop control in progress on channel.
+// The brake stays on until dc_motor_set_speed(), dc_motor_ramp_to_speed(),
+// or dc_motor_control_start() is called.
+void
+dc_motor_brake (dc_motor_channel_t channel);
 
 // For the ADC-based load current calculations, we assume that the ADC
 // reference voltage has this value.  Note that even if a high-voltage
@@ -97,10 +112,119 @@ dc_motor_set_speed (dc_motor_channel_t channel, int8_t speed);
 // Return the load current in amps for motor on channel
 // channel.  Note that this is the current value as computed using
 // DC_MOTOR_CURRENT_SENSE_AMPS_PER_VOLT, not the voltage reading at the
-// sensor output.
+// sensor output.  While the control loop is running (see below) this
+// returns the average measured over the last control loop period (rather
+// than reading the ADC itself).
 float
 dc_motor_load_current (dc_motor_channel_t channel);
 
+// Closed-Loop Control
+//
+// The dc_motor_set_speed() function only sets the PWM duty cycle, so the
+// torque and speed that result depend on the load.  The control loop
+// adjusts the duty cycle automatically to hold a measured quantity (the
+// feedback) at a target value.  The feedback is either the load current
+// (which is roughly proportional to the motor torque), or a value supplied
+// by a client function (the speed measured with a shaft encoder, for
+// example).  The loop:
+//
+//   * Runs from the ADC conversion complete interrupt, with the ADC
+//     sampling the current sense pins of the two channels in alternation,
+//     and performs a control step about DC_MOTOR_CONTROL_HZ times per
+//     second, using the average of the current samples taken since the
+//     previous step.  This doesn't cost the main program anything except
+//     the interrupt time (a few percent of the CPU).
+//
+//   * Uses a fixed-point PID (Proportional-Integral-Derivative) controller
+//     with Q8.8 gains, so no floating point arithmetic is done in the
+//     interrupt handler.  The integral term is limited to the full output
+//     range, so it can't wind up while the output is saturated, and the
+//     derivative term acts on the feedback rather than the error, so target
+//     changes don't cause output spikes.
+//
+//   * Limits the rate at which the setpoint used by the PID moves towards
+//     the target, if desired, so the motor accelerates smoothly.
+//
+// The loop only runs while at least one channel is ramping (see
+// dc_motor_ramp_to_speed()) or under closed-loop control.  It stops itself
+// when neither is.
+//
+// The loop (and so everything below, and dc_motor_ramp_to_speed()) is only
+// built if DC_MOTOR_USE_CONTROL_LOOP is defined, since it defines an ADC
+// conversion complete interrupt handler (ADC_vect), and only one module in
+// a program can do that.
+//
+// WARNING: with DC_MOTOR_USE_CONTROL_LOOP defined this module can't be
+// linked with anything else that defines an ADC_vect handler (for example
+// the lcd_keypad.h interface with LCD_KEYPAD_USE_SCANNER defined), whether
+// or not the loop is ever started.  While the loop is running it also owns
+// the ADC, so adc.h functions must not be used.  The motor shield PWM
+// outputs already tie up timer2.
+
+// Number of ADC conversions per control step, and the resulting
+// (approximate) control step frequency, given the fixed 125 kHz ADC
+// clock from adc.h and 13 ADC clock cycles per conversion.
+#define DC_MOTOR_CONTROL_CONVERSIONS 10
+#define DC_MOTOR_CONTROL_HZ \
+  (F_CPU / 128 / 13 / DC_MOTOR_CONTROL_CONVERSIONS)
+
+// The PID output is the PWM duty cycle, in [-DC_MOTOR_MAX_DUTY,
+// DC_MOTOR_MAX_DUTY] (negative values mean reverse).  This is finer than
+// the [-100, 100] speed of dc_motor_set_speed().
+#define DC_MOTOR_MAX_DUTY 255
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+// Type of client-supplied feedback functions.  The function is called
+// from the control loop interrupt handler once per control step, and
+// should quickly return the current feedback value for channel (in any
+// units the client likes, as long as the target and the PID gains are
+// consistent with them).  Note that interrupts are disabled while it runs.
+typedef int16_t (*dc_motor_feedback_function_t) (dc_motor_channel_t channel);
+
+// Control loop parameters.  The gains are Q8.8 fixed point values (so 256
+// means 1.0), and give the change in the duty cycle per unit of error (kp),
+// per unit of error per control step (ki), and per unit of feedback change
+// per control step (kd).  The slew rate is the maximum rate at which the
+// setpoint may change on its way to the target, in feedback units per
+// second, or 0 for no limit.
+typedef struct {
+  int16_t kp;
+  int16_t ki;
+  int16_t kd;
+  uint16_t slew_rate;
+} dc_motor_pid_parameters_t;
+
+// Start closed-loop control of channel, using the parameters in *params
+// (which are copied) and the feedback function feedback.  If feedback is
+// NULL, the load current in milliamps is used as feedback, signed
+// according to the direction the motor is being driven in (so positive
+// targets mean forward torque).  The target starts out at 0 (see
+// dc_motor_control_set_target()).  This releases the brake.  Interrupts are
+// enabled globally (with sei()) by this function.
+void
+dc_motor_control_start (
+    dc_motor_channel_t channel,
+    dc_motor_pid_parameters_t const *params,
+    dc_motor_feedback_function_t feedback );
+
+// Set the target value for the feedback of channel, which must be under
+// closed-loop control.  The setpoint moves towards it at the slew rate.
+void
+dc_motor_control_set_target (dc_motor_channel_t channel, int16_t target);
+
+// Return the feedback value measured in the most recent control step for
+// channel, which must be under closed-loop control.
+int16_t
+dc_motor_control_feedback (dc_motor_channel_t channel);
+
+#endif // DC_MOTOR_USE_CONTROL_LOOP
+
+// Return the duty cycle currently applied to channel (whether it was set
+// by the control loop or not), in [-DC_MOTOR_MAX_DUTY, DC_MOTOR_MAX_DUTY].
+int16_t
+dc_motor_duty (dc_motor_channel_t channel);
+
 // FIXXME: if we wanted to entirely shut down the timer/counter2 hardware to
 // save power or something (and perhaps deconfigure direction/brake/current
 // sense lines?, make sure OCR2A/B end up low by strobing FOC2X from
@@ -0,0 +1,500 @@
+// Host test driver for dc_motor_pid_private.c (see the host_test target in
+// generic.mk).
+//
+// dc_motor_test.c can only show the control loop running one real motor.
+// On the development machine the integer arithmetic of the control step
+// can be checked exhaustively, and the loop can be closed around a
+// simulated motor:
+//
+//   * Setpoint slewing and PID steps from many random states are compared
+//     with a 64 bit reference calculation (so any int32_t overflow shows),
+//     and the properties dc_motor.h promises (no derivative kick, no
+//     integral windup, derivative on the feedback, clamped output) are
+//     checked directly.
+//
+//   * dc_motor_ramp_to_speed() ramps are stepped through, and must reach
+//     the target exactly, in the expected time, without ever moving faster
+//     than the rate.
+//
+//   * The load current of a simulated motor (with back EMF, inertia, and a
+//     frictional load, sampled and scaled the way dc_motor.c does it) is
+//     controlled with the gains dc_motor_test.c uses.  It must settle at
+//     the target, recover after the load steps up, and follow the target
+//     into reverse.
+//
+// This program exits with a non-zero status after printing a description
+// of the first failure, or prints a summary line per test and exits with
+// status zero if everything passes.
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dc_motor_pid_private.h"
+#include "host_test_util.h"
+
+#define RANDOM_CASE_COUNT 10000000
+
+static int64_t
+clamp64 (int64_t value, int64_t limit)
+{
+  return (value > limit ? limit : (value < -limit ? -limit : value));
+}
+
+static void
+check_random_states (void)
+{
+  test_name = "random_states";
+
+  for ( uint32_t ii = 0 ; ii < RANDOM_CASE_COUNT ; ii++ ) {
+    dc_motor_pid_state_t ps = {
+      .target = random_uint32 (),
+      .setpoint_q16 = random_uint32 (),
+      // Mostly small slew limits, but sometimes huge or none
+      .slew_q16 = (random_uint32 () % 4 == 0 ?
+                   random_uint32 () :
+                   random_uint32 () % 0x100000 ),
+      .kp = random_uint32 (),
+      .ki = random_uint32 (),
+      .kd = random_uint32 (),
+      .integral
+        = (int32_t) (random_uint32 () % (2 * DC_MOTOR_MAX_DUTY * 256 + 1))
+          - DC_MOTOR_MAX_DUTY * 256,
+      .measurement = random_uint32 (),
+      .have_measurement = random_uint32 () % 2 };
+    if ( random_uint32 () % 8 == 0 ) {
+      ps.slew_q16 = 0;
+    }
+    int16_t measurement = random_uint32 ();
+    dc_motor_pid_state_t original = ps;
+
+    // Setpoint slewing
+    int64_t target_q16 = (int64_t) ps.target * 65536;
+    int64_t distance = target_q16 - ps.setpoint_q16;
+    int64_t expected_setpoint
+      = (ps.slew_q16 == 0 || llabs (distance) <= ps.slew_q16 ?
+         target_q16 :
+         ps.setpoint_q16 + (distance > 0 ? 1 : -1) * (int64_t) ps.slew_q16 );
+    dc_motor_pid_advance_setpoint (&ps);
+    if ( ps.setpoint_q16 != expected_setpoint ) {
+      fail (
+          "setpoint 0x%" PRIx32 " slewed by %" PRIu32 " towards %" PRIi16
+          " gave 0x%" PRIx32 ", not 0x%" PRIx32,
+          (uint32_t) original.setpoint_q16, original.slew_q16,
+          original.target, (uint32_t) ps.setpoint_q16,
+          (uint32_t) expected_setpoint );
+    }
+
+    // PID step
+    int64_t previous
+      = (original.have_measurement ? original.measurement : measurement);
+    int64_t error
+      = clamp64 (
+          ps.setpoint_q16 / 65536 - measurement, DC_MOTOR_PID_INPUT_LIMIT );
+    int64_t change
+      = clamp64 (measurement - previous, DC_MOTOR_PID_INPUT_LIMIT);
+    int64_t expected_integral
+      = clamp64 (
+          ps.integral + (int64_t) ps.ki * error,
+          (int64_t) DC_MOTOR_MAX_DUTY * 256 );
+    int64_t expected_output
+      = clamp64 (
+          ((int64_t) ps.kp * error + expected_integral
+           - (int64_t) ps.kd * change) / 256,
+          DC_MOTOR_MAX_DUTY );
+    int16_t output = dc_motor_pid_step (&ps, measurement);
+    if ( output != expected_output || ps.integral != expected_integral ) {
+      fail (
+          "step from setpoint %" PRIi32 ", measurement %" PRIi16
+          ", gains %" PRIi16 "/%" PRIi16 "/%" PRIi16 " gave output %" PRIi16
+          " (integral %" PRIi32 "), not %" PRIi64 " (integral %" PRIi64 ")",
+          ps.setpoint_q16 / 65536, measurement, ps.kp, ps.ki, ps.kd, output,
+          ps.integral, expected_output, expected_integral );
+    }
+    if ( ps.measurement != measurement || ! ps.have_measurement ) {
+      fail ("step didn't record measurement %" PRIi16, measurement);
+    }
+  }
+
+  printf ("%s: ok: %" PRIu32 " cases\n", test_name, RANDOM_CASE_COUNT);
+}
+
+static void
+check_slew_extremes (void)
+{
+  test_name = "slew_extremes";
+
+  // Distances too large for an int32_t, slewed by the smallest, an
+  // ordinary, and the largest slew limit.
+  int32_t const far_setpoints[] = { INT32_MAX, INT32_MIN };
+  int16_t const far_targets[] = { INT16_MIN, INT16_MAX };
+  for ( uint8_t ii = 0 ; ii < 2 ; ii++ ) {
+    int64_t target_q16 = (int64_t) far_targets[ii] * 65536;
+    int64_t direction = (target_q16 > far_setpoints[ii] ? 1 : -1);
+    uint32_t const slews[] = { 1, 8695, UINT32_MAX };
+    for ( uint8_t jj = 0 ; jj < 3 ; jj++ ) {
+      dc_motor_pid_state_t ps = {
+        .target = far_targets[ii],
+        .setpoint_q16 = far_setpoints[ii],
+        .slew_q16 = slews[jj] };
+      dc_motor_pid_advance_setpoint (&ps);
+      int64_t expected
+        = (llabs (target_q16 - far_setpoints[ii]) <= slews[jj] ?
+           target_q16 :
+           far_setpoints[ii] + direction * slews[jj] );
+      if ( ps.setpoint_q16 != expected ) {
+        fail (
+            "setpoint 0x%" PRIx32 " slewed by %" PRIu32 " towards %" PRIi16
+            " gave 0x%" PRIx32 ", not 0x%" PRIx32,
+            (uint32_t) far_setpoints[ii], slews[jj], far_targets[ii],
+            (uint32_t) ps.setpoint_q16, (uint32_t) expected );
+      }
+    }
+  }
+
+  printf ("%s: ok\n", test_name);
+}
+
+static void
+check_pid_properties (void)
+{
+  // No derivative kick: the first step after a start has no derivative
+  // term, however far the feedback is from the 0 it starts out at.
+  test_name = "no_derivative_kick";
+  {
+    dc_motor_pid_state_t ps = { .kd = 1000 };
+    int16_t output = dc_motor_pid_step (&ps, 500);
+    if ( output != 0 ) {
+      fail ("first step gave output %" PRIi16, output);
+    }
+    output = dc_motor_pid_step (&ps, 501);
+    if ( output != -1000 / 256 ) {
+      fail ("second step gave output %" PRIi16, output);
+    }
+  }
+  printf ("%s: ok\n", test_name);
+
+  // Derivative on the feedback: a target change doesn't move the
+  // derivative term at all.
+  test_name = "derivative_on_feedback";
+  {
+    dc_motor_pid_state_t ps = { .kd = INT16_MAX };
+    dc_motor_pid_step (&ps, 100);
+    ps.target = 10000;
+    dc_motor_pid_advance_setpoint (&ps);
+    int16_t output = dc_motor_pid_step (&ps, 100);
+    if ( output != 0 ) {
+      fail ("target change gave output %" PRIi16, output);
+    }
+  }
+  printf ("%s: ok\n", test_name);
+
+  // No windup: after a long time saturated, the integral is no more than
+  // the full output, so the output reverses soon after the error does.
+  // With ki = 1 and an error of 1000, unwinding the full output takes 66
+  // steps, where unwinding the unlimited integral would take 10000.
+  test_name = "anti_windup";
+  {
+    dc_motor_pid_state_t ps = { .ki = 1, .target = 1000 };
+    dc_motor_pid_advance_setpoint (&ps);
+    for ( uint16_t ii = 0 ; ii < 10000 ; ii++ ) {
+      int16_t output = dc_motor_pid_step (&ps, 0);
+      if ( ii >= 66 && output != DC_MOTOR_MAX_DUTY ) {
+        fail ("saturated output was %" PRIi16, output);
+      }
+    }
+    if ( ps.integral != DC_MOTOR_MAX_DUTY * 256 ) {
+      fail ("integral wound up to %" PRIi32, ps.integral);
+    }
+    ps.target = -1000;
+    dc_motor_pid_advance_setpoint (&ps);
+    uint16_t steps = 0;
+    while ( dc_motor_pid_step (&ps, 0) >= 0 ) {
+      if ( ++steps > 70 ) {
+        fail ("output still not reversed after %" PRIu16 " steps", steps);
+      }
+    }
+  }
+  printf ("%s: ok\n", test_name);
+
+  // Clamped output: the largest errors and gains give exactly the full
+  // output, in both directions, and don't overflow.
+  test_name = "output_clamp";
+  {
+    int16_t const gains[] = { INT16_MAX, INT16_MIN };
+    int16_t const targets[] = { INT16_MAX, INT16_MIN };
+    for ( uint8_t ii = 0 ; ii < 2 ; ii++ ) {
+      for ( uint8_t jj = 0 ; jj < 2 ; jj++ ) {
+        dc_motor_pid_state_t ps = {
+          .kp = gains[ii], .ki = gains[ii], .kd = gains[ii],
+          .target = targets[jj] };
+        dc_motor_pid_advance_setpoint (&ps);
+        dc_motor_pid_step (&ps, 0);
+        int16_t output = dc_motor_pid_step (&ps, -targets[jj] / 2);
+        int16_t expected
+          = ((gains[ii] > 0) == (targets[jj] > 0) ?
+             DC_MOTOR_MAX_DUTY :
+             -DC_MOTOR_MAX_DUTY );
+        if ( output != expected ) {
+          fail (
+              "gain %" PRIi16 " and target %" PRIi16 " gave output %" PRIi16,
+              gains[ii], targets[jj], output );
+        }
+      }
+    }
+  }
+  printf ("%s: ok\n", test_name);
+}
+
+// Map an argument in the range [0, 100] onto the range [0, 255] (this is
+// the same as the map dc_motor.c uses).
+#define SPEED_MAP(arg) (((uint16_t) arg * 255) / 100)
+
+// Do a ramp from duty cycle start_duty to speed target_speed (in [-100,
+// 100]) at rate percent per second, setting up and stepping the PID state
+// the way dc_motor_ramp_to_speed() and the control loop do, and return
+// the number of control steps the ramp took.
+static uint32_t
+check_ramp (int16_t start_duty, int8_t target_speed, uint8_t rate)
+{
+  dc_motor_pid_state_t ps = {
+    .target
+      = (target_speed >= 0 ?
+         SPEED_MAP (target_speed) :
+         -SPEED_MAP (-target_speed) ),
+    .setpoint_q16 = (int32_t) start_duty * 65536,
+    .slew_q16
+      = ((uint32_t) rate * DC_MOTOR_MAX_DUTY * 65536 / 100)
+        / DC_MOTOR_CONTROL_HZ };
+
+  if ( ps.slew_q16 == 0 ) {
+    fail ("rate %" PRIu8 " gives a slew limit of 0 (no limit)", rate);
+  }
+
+  int16_t duty = start_duty;
+  uint32_t steps = 0;
+  while ( duty != ps.target ) {
+    int32_t previous = ps.setpoint_q16;
+    dc_motor_pid_advance_setpoint (&ps);
+    if ( llabs ((int64_t) ps.setpoint_q16 - previous) > ps.slew_q16 ) {
+      fail ("ramp moved faster than rate %" PRIu8, rate);
+    }
+    if ( (ps.setpoint_q16 - previous > 0) != (ps.target > start_duty) ) {
+      fail ("ramp towards %" PRIi16 " moved the wrong way", ps.target);
+    }
+    duty = ps.setpoint_q16 / 65536;
+    steps++;
+  }
+
+  // The ramp should take the time the rate implies, give or take one step
+  // and the truncation of the slew limit (which is less than one part in
+  // slew_q16).  Since the duty cycle is the setpoint truncated towards
+  // zero, ramps that end nearer zero than they start may also finish up to
+  // one duty cycle unit early.
+  double expected_steps
+    = (double) abs (ps.target - start_duty) * 100.0 / DC_MOTOR_MAX_DUTY
+      / rate * DC_MOTOR_CONTROL_HZ;
+  double slack = 1.0 + expected_steps / (ps.slew_q16 - 1);
+  uint8_t towards_zero
+    = (start_duty > 0 ?
+       0 <= ps.target && ps.target < start_duty :
+       start_duty < ps.target && ps.target <= 0 );
+  double early_slack = (towards_zero ? 65536.0 / ps.slew_q16 : 0.0);
+  if ( steps > expected_steps + slack
+       || steps < expected_steps - slack - early_slack ) {
+    fail (
+        "ramp from %" PRIi16 " to %" PRIi16 " at rate %" PRIu8 " took %"
+        PRIu32 " steps, not about %.1f",
+        start_duty, ps.target, rate, steps, expected_steps );
+  }
+
+  return steps;
+}
+
+static void
+check_ramps (void)
+{
+  test_name = "ramps";
+
+  // The ramp dc_motor_test.c does (stopped to full speed in two seconds).
+  uint32_t steps = check_ramp (0, 100, 50);
+  if ( fabs ((double) steps / DC_MOTOR_CONTROL_HZ - 2.0) > 0.01 ) {
+    fail ("ramp to full speed at 50 %%/s took %" PRIu32 " steps", steps);
+  }
+
+  check_ramp (DC_MOTOR_MAX_DUTY, -100, 100);
+  check_ramp (-DC_MOTOR_MAX_DUTY, 100, UINT8_MAX);
+  check_ramp (0, 1, 1);
+  check_ramp (-7, -1, 1);
+  check_ramp (100, 30, 13);
+
+  printf ("%s: ok\n", test_name);
+}
+
+// Simulated motor.  This is roughly a small 6V motor: the load current is
+// the applied voltage less the back EMF over the winding resistance
+// (inductance is ignored, since the PWM period is tiny compared to all the
+// other time constants), and the torque it produces works against the
+// rotor inertia, bearing friction, and a load proportional to speed (like
+// a thumb and finger pinching the shaft).
+#define SUPPLY_VOLTS       6.0
+#define WINDING_OHMS       2.0
+#define MOTOR_CONSTANT     0.01     // V s / rad, and N m / A
+#define ROTOR_INERTIA      1e-5     // kg m^2
+#define BEARING_FRICTION   1e-4     // N m s / rad
+#define LIGHT_LOAD         1e-4     // N m s / rad
+#define HEAVY_LOAD         3e-4     // N m s / rad
+
+// Raw ADC reading steps (as in adc.h), and the milliamps per step as
+// computed by dc_motor.c.
+#define ADC_RAW_READING_STEPS 1024
+#define CURRENT_MA_PER_STEP_Q10                                   \
+  ((uint16_t) (                                                   \
+      DC_MOTOR_ADC_REFERENCE_VOLTAGE *                            \
+      DC_MOTOR_CURRENT_SENSE_AMPS_PER_VOLT * 1000.0 * 1024.0 /    \
+      (ADC_RAW_READING_STEPS - 1) + 0.5 ))
+
+// Time per ADC conversion (at the 125 kHz ADC clock, 13 clocks each).
+#define CONVERSION_SECONDS (128.0 * 13.0 / F_CPU)
+
+typedef struct {
+  double speed;                  // rad / s
+  double load;                   // N m s / rad
+  int16_t duty;
+} motor_t;
+
+static double
+motor_amps (motor_t const *motor)
+{
+  return
+    (SUPPLY_VOLTS * motor->duty / DC_MOTOR_MAX_DUTY
+     - MOTOR_CONSTANT * motor->speed)
+    / WINDING_OHMS;
+}
+
+// Do one control step of closed-loop current control with *ps for
+// *motor, sampling the current the way the ADC interrupt handler in
+// dc_motor.c does, and return the measurement used.
+static int16_t
+motor_control_step (motor_t *motor, dc_motor_pid_state_t *ps)
+{
+  uint32_t sum = 0;
+  uint8_t samples = 0;
+
+  for ( uint8_t ii = 0 ; ii < DC_MOTOR_CONTROL_CONVERSIONS ; ii++ ) {
+    double amps = motor_amps (motor);
+    double torque
+      = MOTOR_CONSTANT * amps
+        - (BEARING_FRICTION + motor->load) * motor->speed;
+    motor->speed += torque / ROTOR_INERTIA * CONVERSION_SECONDS;
+
+    // The channels are sampled alternately, so this one gets every other
+    // conversion.  The current sense amplifier gives the magnitude.
+    if ( ii % 2 == 0 ) {
+      double reading
+        = fabs (amps) / DC_MOTOR_CURRENT_SENSE_AMPS_PER_VOLT
+          / DC_MOTOR_ADC_REFERENCE_VOLTAGE * (ADC_RAW_READING_STEPS - 1);
+      sum += (reading > ADC_RAW_READING_STEPS - 1 ?
+              ADC_RAW_READING_STEPS - 1 :
+              (uint16_t) (reading + 0.5) );
+      samples++;
+    }
+  }
+
+  uint16_t average = sum / samples;
+  int16_t current_ma = ((uint32_t) average * CURRENT_MA_PER_STEP_Q10) >> 10;
+  int16_t measurement = (motor->duty >= 0 ? current_ma : -current_ma);
+
+  dc_motor_pid_advance_setpoint (ps);
+  motor->duty = dc_motor_pid_step (ps, measurement);
+
+  return measurement;
+}
+
+// Largest distance from the target allowed once settled, in milliamps
+// (about three ADC reading steps, plus a margin).
+#define SETTLED_TOLERANCE_MA 15
+
+// Time allowed to settle after a change, in seconds.
+#define SETTLING_SECONDS 0.5
+
+// Run *motor under control with *ps for seconds seconds, starting with a
+// change (description) that needs the feedback to settle at the target
+// again, and fail if it doesn't settle at the target in time and stay
+// there.
+static void
+run_and_check_settling (
+    motor_t *motor, dc_motor_pid_state_t *ps, double seconds,
+    char const *description )
+{
+  uint32_t const steps = seconds * DC_MOTOR_CONTROL_HZ;
+  uint32_t const settling_steps = SETTLING_SECONDS * DC_MOTOR_CONTROL_HZ;
+
+  for ( uint32_t ii = 0 ; ii < steps ; ii++ ) {
+    int16_t measurement = motor_control_step (motor, ps);
+    if ( ii >= settling_steps
+         && abs (measurement - ps->target) > SETTLED_TOLERANCE_MA ) {
+      fail (
+          "%.3f s after %s, current was %" PRIi16 " mA (target %" PRIi16
+          " mA, duty %" PRIi16 ")",
+          (double) ii / DC_MOTOR_CONTROL_HZ, description, measurement,
+          ps->target, motor->duty );
+    }
+  }
+}
+
+static void
+check_simulated_motor (void)
+{
+  test_name = "simulated_motor";
+
+  // The closed-loop parameters and target from dc_motor_test.c, set up the
+  // way dc_motor_control_start() does.
+  dc_motor_pid_state_t ps = {
+    .kp = 5, .ki = 2, .kd = 0,
+    .slew_q16 = ((uint32_t) 1000 * 65536) / DC_MOTOR_CONTROL_HZ };
+  motor_t motor = { .load = LIGHT_LOAD };
+
+  ps.target = 300;
+  run_and_check_settling (&motor, &ps, 2.0, "start");
+  int16_t light_duty = motor.duty;
+
+  // Pinching the shaft slows it, so there's less back EMF, and less duty
+  // cycle is needed for the same current.
+  motor.load = HEAVY_LOAD;
+  run_and_check_settling (&motor, &ps, 2.0, "load increase");
+  if ( motor.duty >= light_duty ) {
+    fail (
+        "duty didn't fall (from %" PRIi16 ") when the load rose, it's %"
+        PRIi16, light_duty, motor.duty );
+  }
+
+  motor.load = LIGHT_LOAD;
+  run_and_check_settling (&motor, &ps, 2.0, "load decrease");
+
+  ps.target = 150;
+  run_and_check_settling (&motor, &ps, 2.0, "target decrease");
+
+  // Through zero into reverse (at 1000 mA/s the setpoint takes 0.35 s to
+  // get there, so there's less time left to settle).
+  ps.target = -200;
+  run_and_check_settling (&motor, &ps, 3.0, "target reversal");
+  if ( motor.duty >= 0 || motor.speed >= 0.0 ) {
+    fail ("motor isn't running in reverse");
+  }
+
+  printf ("%s: ok\n", test_name);
+}
+
+int
+main (void)
+{
+  check_random_states ();
+  check_slew_extremes ();
+  check_pid_properties ();
+  check_ramps ();
+  check_simulated_motor ();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+// Stand-Ins Letting dc_motor_pid_private.c Compile on the Development Machine
+//
+// Host test driver: dc_motor_host_test.c
+//
+// This header is force-included (with the compiler's -include option) when
+// dc_motor_pid_private.c and the test driver are compiled for the host (see
+// the Makefile).  It claims the include guard of util.h, which is
+// AVR-only, and supplies the few things needed from it instead.
+
+#ifndef DC_MOTOR_HOST_TEST_H
+#define DC_MOTOR_HOST_TEST_H
+
+#define UTIL_H
+
+#define TRUE  0x01
+#define FALSE 0x00
+
+// dc_motor.h needs this for DC_MOTOR_CONTROL_HZ.
+#ifndef F_CPU
+#  define F_CPU 16000000UL
+#endif
+
+#endif // DC_MOTOR_HOST_TEST_H
@@ -0,0 +1,71 @@
+// Implementation of the interface described in dc_motor_pid_private.h.
+
+#include "dc_motor_pid_private.h"
+#include "util.h"
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+void
+dc_motor_pid_advance_setpoint (dc_motor_pid_state_t *ps)
+{
+  // The distances are computed as unsigned values, since they can be too
+  // large for an int32_t.
+
+  int32_t target_q16 = (int32_t) ps->target * 65536;
+
+  if ( ps->slew_q16 == 0 ) {
+    ps->setpoint_q16 = target_q16;
+  }
+  else if ( ps->setpoint_q16 < target_q16 ) {
+    if ( (uint32_t) target_q16 - (uint32_t) ps->setpoint_q16 > ps->slew_q16 ) {
+      ps->setpoint_q16 += ps->slew_q16;
+    }
+    else {
+      ps->setpoint_q16 = target_q16;
+    }
+  }
+  else if ( ps->setpoint_q16 > target_q16 ) {
+    if ( (uint32_t) ps->setpoint_q16 - (uint32_t) target_q16 > ps->slew_q16 ) {
+      ps->setpoint_q16 -= ps->slew_q16;
+    }
+    else {
+      ps->setpoint_q16 = target_q16;
+    }
+  }
+}
+
+static int32_t
+clamp (int32_t value, int32_t limit)
+{
+  return (value > limit ? limit : (value < -limit ? -limit : value));
+}
+
+int16_t
+dc_motor_pid_step (dc_motor_pid_state_t *ps, int16_t measurement)
+{
+  if ( ! ps->have_measurement ) {
+    ps->measurement = measurement;   // So there's no derivative kick
+    ps->have_measurement = TRUE;
+  }
+
+  int16_t setpoint = ps->setpoint_q16 / 65536;
+  int32_t error
+    = clamp ((int32_t) setpoint - measurement, DC_MOTOR_PID_INPUT_LIMIT);
+  int32_t change
+    = clamp (
+        (int32_t) measurement - ps->measurement, DC_MOTOR_PID_INPUT_LIMIT );
+  ps->measurement = measurement;
+
+  // Anti-windup: the integral alone is never allowed to call for more
+  // than the full output.
+  ps->integral = clamp (
+      ps->integral + (int32_t) ps->ki * error,
+      (int32_t) DC_MOTOR_MAX_DUTY * 256 );
+
+  int32_t output_q8
+    = (int32_t) ps->kp * error + ps->integral - (int32_t) ps->kd * change;
+
+  return clamp (output_q8 / 256, DC_MOTOR_MAX_DUTY);
+}
+
+#endif // DC_MOTOR_USE_CONTROL_LOOP
@@ -0,0 +1,52 @@
+// Setpoint Slewing and PID Arithmetic for the dc_motor.h Control Loop
+//
+// Implementation: dc_motor_pid_private.c
+// Host test driver: dc_motor_host_test.c
+//
+// This is an internal part of the dc_motor.h interface, which clients
+// shouldn't use directly.  It holds the part of a control step that is
+// plain integer arithmetic, so it can be tested on the development machine
+// as well as the AVR (see dc_motor_host_test.c).  See the description of
+// the control loop in dc_motor.h for the representation of the gains.
+
+#ifndef DC_MOTOR_PID_PRIVATE_H
+#define DC_MOTOR_PID_PRIVATE_H
+
+#include <inttypes.h>
+
+#include "dc_motor.h"
+
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+// Limit on the error and feedback change magnitudes used in the PID
+// calculation, which ensures the Q8.8 arithmetic can't overflow an int32_t.
+#define DC_MOTOR_PID_INPUT_LIMIT 16383
+
+// State of the PID controller (or ramp) for one channel.  Setpoints are
+// stored with 16 fractional bits, so slow slew rates still make progress
+// every control step.
+typedef struct {
+  int16_t target;                // Duty cycle (ramps) or feedback target
+  int32_t setpoint_q16;          // Slew-rate limited setpoint
+  uint32_t slew_q16;             // Max setpoint change per step, 0 for none
+  int16_t kp, ki, kd;
+  int32_t integral;              // Integral term (Q8.8 duty units)
+  int16_t measurement;           // Feedback from the latest step
+  uint8_t have_measurement;      // FALSE until the first step has been done
+} dc_motor_pid_state_t;
+
+// Move the setpoint of *ps towards its target, by no more than its slew
+// limit.
+void
+dc_motor_pid_advance_setpoint (dc_motor_pid_state_t *ps);
+
+// Perform one PID step for *ps with feedback measurement (using the
+// current setpoint, so dc_motor_pid_advance_setpoint() should normally be
+// called first), and return the new duty cycle, which is in
+// [-DC_MOTOR_MAX_DUTY, DC_MOTOR_MAX_DUTY].
+int16_t
+dc_motor_pid_step (dc_motor_pid_state_t *ps, int16_t measurement);
+
+#endif // DC_MOTOR_USE_CONTROL_LOOP
+
+#endif // DC_MOTOR_PID_PRIVATE_H
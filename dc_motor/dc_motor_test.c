@@ -20,6 +20,14 @@
 // should cause the load current to rise.  Note that at lower speed setting
 // and voltages, many motors won't get going, so there may be several steps
 // where the motors don't move.
+//
+// Before that (if DC_MOTOR_USE_CONTROL_LOOP is defined in the Makefile),
+// dc_motor_ramp_to_speed(), dc_motor_brake(), and closed-loop load current
+// control of motor A are tried.  During the closed-loop test, loading the
+// shaft should make the motor slow down and the duty cycle fall (since
+// there's less back EMF) while the load current stays near the target.
+// The test fails (with a PFP_ASSERT()) if the average load current at the
+// end isn't near the target.
 
 #include <util/delay.h>
 
@@ -44,6 +52,67 @@ main (void)
 
   PFP ("\n");
 
+#ifdef DC_MOTOR_USE_CONTROL_LOOP
+
+  // Test dc_motor_ramp_to_speed() and dc_motor_brake().
+  {
+    uint8_t const rate = 50;   // Percent of full speed per second
+    dc_motor_ramp_to_speed (DC_MOTOR_CHANNEL_A, 100, rate);
+    PFP ("Ramping motor A to full speed at %hhu %%/s...\n", rate);
+    for ( uint8_t ii = 0 ; ii < 6 ; ii++ ) {
+      PFP ("  Duty: %i\n", dc_motor_duty (DC_MOTOR_CHANNEL_A));
+      _delay_ms (500.0);
+    }
+    dc_motor_brake (DC_MOTOR_CHANNEL_A);
+    PFP ("Braked motor A.\n");
+    _delay_ms (2000.0);
+    PFP ("\n");
+  }
+
+  // Test closed-loop load current control.  These gains are conservative
+  // starting points that work with a small 5V motor (and with the
+  // simulated one in dc_motor_host_test.c), but they're almost certainly
+  // not optimal for any particular one.
+  {
+    dc_motor_pid_parameters_t const params = {
+      .kp = 5,             // About 0.02 duty cycle steps per mA of error
+      .ki = 2,             // About 0.008 per mA per control step
+      .kd = 0,
+      .slew_rate = 1000 }; // mA per second
+    int16_t const target_ma = 300;
+    dc_motor_control_start (DC_MOTOR_CHANNEL_A, &params, NULL);
+    dc_motor_control_set_target (DC_MOTOR_CHANNEL_A, target_ma);
+    PFP ("Holding motor A load current at %i mA...\n", target_ma);
+    for ( uint8_t ii = 0 ; ii < 20 ; ii++ ) {
+      PFP (
+          "  Current: %i mA, duty: %i\n",
+          dc_motor_control_feedback (DC_MOTOR_CHANNEL_A),
+          dc_motor_duty (DC_MOTOR_CHANNEL_A) );
+      _delay_ms (500.0);
+    }
+
+    // Check the average over a second or so, since the individual readings
+    // are noisy (the tolerance is generous for the same reason).
+    int16_t const tolerance_ma = 45;
+    int32_t sum = 0;
+    uint8_t const samples = 100;
+    for ( uint8_t ii = 0 ; ii < samples ; ii++ ) {
+      sum += dc_motor_control_feedback (DC_MOTOR_CHANNEL_A);
+      _delay_ms (10.0);
+    }
+    int16_t average_ma = sum / samples;
+    PFP ("Average current: %i mA\n", average_ma);
+    PFP_ASSERT (target_ma - tolerance_ma <= average_ma);
+    PFP_ASSERT (average_ma <= target_ma + tolerance_ma);
+    PFP ("Average current is within %i mA of target, ok.\n", tolerance_ma);
+    dc_motor_set_speed (DC_MOTOR_CHANNEL_A, 0);   // Also ends control
+    PFP ("Stopped motor A.\n");
+    _delay_ms (1000.0);
+    PFP ("\n");
+  }
+
+#endif
+
   // Ramp motor speeds up and down continually, measuring load at each step.
   // To be cute, motors A and B will be run in opposite directions :)
   {
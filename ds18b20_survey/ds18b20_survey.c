@@ -0,0 +1,163 @@
+// Implementation of the interface described in ds18b20_survey.h.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <util/crc16.h>
+
+#include "ds18b20_commands.h"
+#include "ds18b20_survey.h"
+#include "one_wire_master.h"
+#include "util.h"
+
+// These are properties of the DS18B20 that have nothing to do with the
+// 1-wire bus in general.
+#define SCRATCHPAD_SIZE   9
+#define SCRATCHPAD_T_LSB  0
+#define SCRATCHPAD_T_MSB  1
+#define SCRATCHPAD_TH     2
+#define SCRATCHPAD_TL     3
+#define SCRATCHPAD_CONFIG 4
+#define SCRATCHPAD_CRC    8
+
+// Resolution bits of the configuration register.
+#define CONFIG_RESOLUTION_SHIFT 5
+#define CONFIG_RESOLUTION_MASK  B00000011
+
+// Each read time slot takes at least this long, so polling this many of
+// them takes at least DS18B20_SURVEY_CONVERSION_TIMEOUT_MS.
+#define MIN_READ_SLOT_US \
+  (OWC_TICK_DELAY_A + OWC_TICK_DELAY_E + OWC_TICK_DELAY_F)
+#define CONVERSION_TIMEOUT_SLOTS \
+  (DS18B20_SURVEY_CONVERSION_TIMEOUT_MS * 1000UL / MIN_READ_SLOT_US)
+
+static uint8_t
+read_scratchpad (uint8_t *rom_id, uint8_t *spb)
+{
+  // Read the scratchpad of the slave with ID rom_id into spb.  Return TRUE
+  // on success, or FALSE on failure (including a bad CRC).
+
+  owm_result_t result
+    = owm_start_transaction (
+        OWC_MATCH_ROM_COMMAND,
+        rom_id,
+        DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND );
+  if ( result != OWM_RESULT_SUCCESS ) {
+    return FALSE;
+  }
+
+  uint8_t crc = 0;
+  for ( uint8_t ii = 0 ; ii < SCRATCHPAD_SIZE ; ii++ ) {
+    spb[ii] = owm_read_byte ();
+    if ( LIKELY (ii < SCRATCHPAD_CRC) ) {
+      crc = _crc_ibutton_update (crc, spb[ii]);
+    }
+  }
+
+  // Note that an absent slave gives us all ones, which fails this check.
+  return crc == spb[SCRATCHPAD_CRC];
+}
+
+uint8_t
+ds18b20_survey_set_resolution (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, uint8_t resolution )
+{
+  assert (
+      resolution == DS18B20_SURVEY_RESOLUTION_9_BIT  ||
+      resolution == DS18B20_SURVEY_RESOLUTION_10_BIT ||
+      resolution == DS18B20_SURVEY_RESOLUTION_11_BIT ||
+      resolution == DS18B20_SURVEY_RESOLUTION_12_BIT    );
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    // The TH and TL registers get written along with the configuration
+    // register, so we have to read them first to avoid clobbering them.
+    uint8_t spb[SCRATCHPAD_SIZE];
+    if ( ! read_scratchpad (rom_ids[ii], spb) ) {
+      return FALSE;
+    }
+
+    owm_result_t result
+      = owm_start_transaction (
+          OWC_MATCH_ROM_COMMAND,
+          rom_ids[ii],
+          DS18B20_COMMANDS_WRITE_SCRATCHPAD_COMMAND );
+    if ( result != OWM_RESULT_SUCCESS ) {
+      return FALSE;
+    }
+    owm_write_byte (spb[SCRATCHPAD_TH]);
+    owm_write_byte (spb[SCRATCHPAD_TL]);
+    owm_write_byte (resolution);
+
+    // Read back to make sure the write took.
+    if ( ! read_scratchpad (rom_ids[ii], spb) ) {
+      return FALSE;
+    }
+    if ( spb[SCRATCHPAD_CONFIG] != resolution ) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+uint8_t
+ds18b20_survey_convert_all (void)
+{
+  owm_result_t result
+    = owm_start_transaction (
+        OWC_SKIP_ROM_COMMAND, NULL, DS18B20_COMMANDS_CONVERT_T_COMMAND );
+  if ( result != OWM_RESULT_SUCCESS ) {
+    return FALSE;
+  }
+
+  // Every slave that's still converting holds read slots low, so we see
+  // a one only once they've all finished.
+  for ( uint32_t ii = 0 ; ii < CONVERSION_TIMEOUT_SLOTS ; ii++ ) {
+    if ( owm_read_bit () ) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+uint8_t
+ds18b20_survey_read_all (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, int16_t *temps )
+{
+  uint8_t good_count = 0;
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    uint8_t spb[SCRATCHPAD_SIZE];
+    if ( ! read_scratchpad (rom_ids[ii], spb) ) {
+      temps[ii] = DS18B20_SURVEY_INVALID_TEMPERATURE;
+      continue;
+    }
+
+    // The low bits of the temperature are undefined at lower resolutions.
+    uint8_t resolution_bits
+      = ( (spb[SCRATCHPAD_CONFIG] >> CONFIG_RESOLUTION_SHIFT) &
+          CONFIG_RESOLUTION_MASK );
+    uint8_t undefined_bits_mask = (1 << (3 - resolution_bits)) - 1;
+
+    temps[ii]
+      = (int16_t) ( ((uint16_t) spb[SCRATCHPAD_T_MSB] << BITS_PER_BYTE) |
+                    (spb[SCRATCHPAD_T_LSB] & ~undefined_bits_mask) );
+    good_count++;
+  }
+
+  return good_count;
+}
+
+uint8_t
+ds18b20_survey_run (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, int16_t *temps )
+{
+  if ( ! ds18b20_survey_convert_all () ) {
+    for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+      temps[ii] = DS18B20_SURVEY_INVALID_TEMPERATURE;
+    }
+    return 0;
+  }
+
+  return ds18b20_survey_read_all (rom_ids, count, temps);
+}
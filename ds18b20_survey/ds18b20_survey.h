@@ -0,0 +1,105 @@
+// Interface for reading many DS18B20 temperature sensors at once
+//
+// Test driver: ds18b20_survey_test.c    Implementation: ds18b20_survey.c
+//
+// Each DS18B20 takes up to 750 ms to do a temperature conversion (at full
+// resolution).  If each sensor on a bus is addressed, told to convert, and
+// then read in turn, a survey of N sensors takes N times that long.  But
+// the CONVERT T command can be broadcast to all the sensors at once using
+// SKIP ROM, so they all convert in parallel.  This interface does that,
+// then polls read time slots (the DS18B20 answers them with zeros until
+// its conversion completes) rather than waiting for the worst-case
+// conversion time, and finally uses MATCH ROM to read each sensor's
+// scratchpad (with CRC checks).  A whole bus of sensors then takes only
+// about one conversion time.
+//
+// This interface is built on one_wire_master.h, which must be initialized
+// with owm_init() first.  The ROM IDs of the sensors are supplied by the
+// caller, typically from owm_scan_bus_into().  For example:
+//
+//   uint8_t rom_ids[MAX_SENSORS][OWC_ID_SIZE_BYTES];
+//   uint8_t sensor_count;
+//   int16_t temps[MAX_SENSORS];
+//
+//   owm_init ();
+//   owm_result_t result
+//     = owm_scan_bus_into (rom_ids, MAX_SENSORS, &sensor_count);
+//   assert (result == OWM_RESULT_SUCCESS);
+//   uint8_t sentinel = ds18b20_survey_set_resolution (
+//       rom_ids, sensor_count, DS18B20_SURVEY_RESOLUTION_10_BIT );
+//   assert (sentinel);
+//
+//   for ( ; ; ) {
+//     uint8_t good_count = ds18b20_survey_run (rom_ids, sensor_count, temps);
+//     // Now temps[ii] is the temperature from the sensor with ROM ID
+//     // rom_ids[ii] in units of 1/16 degree C, or
+//     // DS18B20_SURVEY_INVALID_TEMPERATURE if that sensor couldn't be read.
+//   }
+//
+// WARNING: all the sensors must be externally powered (not parasite
+// powered), since parasite powered sensors can't answer read time slots
+// during conversion (and need a strong pull-up that this interface doesn't
+// provide).
+
+#ifndef DS18B20_SURVEY_H
+#define DS18B20_SURVEY_H
+
+#include <stdint.h>
+
+#include "one_wire_master.h"
+
+// Maximum time to wait for a conversion to complete, in milliseconds.
+// The DS18B20 datasheet gives a maximum of 750 ms at 12 bit resolution.
+#ifndef DS18B20_SURVEY_CONVERSION_TIMEOUT_MS
+#  define DS18B20_SURVEY_CONVERSION_TIMEOUT_MS 1000
+#endif
+
+// Temperature value used for sensors that couldn't be read.  No real
+// DS18B20 reading ever has this value.
+#define DS18B20_SURVEY_INVALID_TEMPERATURE INT16_MIN
+
+// Possible conversion resolutions.  Lower resolutions convert faster (in
+// about 94, 188, 375, and 750 ms respectively).  These values are the
+// DS18B20 configuration register values for the resolutions.
+#define DS18B20_SURVEY_RESOLUTION_9_BIT  0x1F
+#define DS18B20_SURVEY_RESOLUTION_10_BIT 0x3F
+#define DS18B20_SURVEY_RESOLUTION_11_BIT 0x5F
+#define DS18B20_SURVEY_RESOLUTION_12_BIT 0x7F
+
+// Set the conversion resolution of each of the count sensors with ROM IDs
+// in rom_ids to resolution (one of the DS18B20_SURVEY_RESOLUTION_* values).
+// The alarm trigger registers of each sensor are preserved.  Note that the
+// new resolution is only stored in each sensor's scratchpad (not its
+// EEPROM), so it's lost if the sensor loses power.  Returns TRUE on success,
+// or FALSE if any sensor couldn't be reached or returned a scratchpad with
+// a bad CRC (some sensors may have been changed in this case).
+uint8_t
+ds18b20_survey_set_resolution (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, uint8_t resolution );
+
+// Start a temperature conversion on every sensor on the bus at once (using
+// SKIP ROM CONVERT T), then wait for them all to finish by polling read
+// time slots.  Returns TRUE on success, or FALSE if there was no presence
+// pulse or the conversion didn't complete within
+// DS18B20_SURVEY_CONVERSION_TIMEOUT_MS.
+uint8_t
+ds18b20_survey_convert_all (void);
+
+// Read the last converted temperature from each of the count sensors with
+// ROM IDs in rom_ids, and store them in temps (in units of 1/16 degree C,
+// with any bits that are undefined at the sensor's resolution cleared).
+// Sensors that can't be reached, or that return a scratchpad with a bad
+// CRC, get DS18B20_SURVEY_INVALID_TEMPERATURE.  Returns the number of
+// sensors read successfully.
+uint8_t
+ds18b20_survey_read_all (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, int16_t *temps );
+
+// Do ds18b20_survey_convert_all() followed by ds18b20_survey_read_all().
+// If the conversion fails all the temps are set to
+// DS18B20_SURVEY_INVALID_TEMPERATURE and 0 is returned.
+uint8_t
+ds18b20_survey_run (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t count, int16_t *temps );
+
+#endif // DS18B20_SURVEY_H
@@ -0,0 +1,104 @@
+// Test/demo for the ds18b20_survey.h interface.
+//
+// This test program requires one or more externally powered DS18B20
+// sensors (and no other slaves) on the bus connected to DIO_PIN_DIGITAL_2,
+// with a 4.7 kohm pull-up resistor.  See one_wire_master_test.c for more
+// details about the hardware setup.  The more sensors there are the more
+// interesting the timing results get.
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+//
+// The survey part of the test sequence repeats perpetually.
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "ds18b20_survey.h"
+#include "one_wire_master.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "timer0_stopwatch.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+char result_buf[OWM_RESULT_DESCRIPTION_MAX_LENGTH + 1];
+
+#define OWM_CHECK(result)                                        \
+  PFP_ASSERT_SUCCESS (result, owm_result_as_string, result_buf);
+
+#define MAX_SENSORS 16
+
+static uint8_t rom_ids[MAX_SENSORS][OWC_ID_SIZE_BYTES];
+static int16_t temps[MAX_SENSORS];
+
+static void
+print_rom_id (uint8_t const *rom_id)
+{
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
+    PFP ("%02x", rom_id[ii]);
+  }
+}
+
+static void
+survey_at_resolution (uint8_t sensor_count, uint8_t resolution)
+{
+  // Set resolution, then time a survey.
+
+  PFP ("Setting resolution to 0x%02x... ", resolution);
+  uint8_t sentinel
+    = ds18b20_survey_set_resolution (rom_ids, sensor_count, resolution);
+  PFP_ASSERT (sentinel);
+  PFP ("ok.\n");
+
+  PFP ("Surveying %u sensor(s)... ", sensor_count);
+  timer0_stopwatch_reset ();
+  uint8_t good_count = ds18b20_survey_run (rom_ids, sensor_count, temps);
+  uint32_t elapsed_us = timer0_stopwatch_microseconds ();
+  PFP_ASSERT (good_count == sensor_count);
+  PFP ("ok, took %lu ms.\n", elapsed_us / 1000);
+
+  for ( uint8_t ii = 0 ; ii < sensor_count ; ii++ ) {
+    PFP_ASSERT (temps[ii] != DS18B20_SURVEY_INVALID_TEMPERATURE);
+    PFP ("  ");
+    print_rom_id (rom_ids[ii]);
+    // Units are 1/16 degree C, so this gives degrees C to 4 decimal places.
+    int32_t ten_thousandths = (int32_t) temps[ii] * 625;
+    PFP (
+        ": %s%ld.%04ld degrees C\n",
+        (ten_thousandths < 0 ? "-" : ""),
+        labs (ten_thousandths) / 10000,
+        labs (ten_thousandths) % 10000 );
+  }
+}
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  timer0_stopwatch_init ();
+  owm_init ();
+  PFP ("Did timer0_stopwatch_init() and owm_init().\n");
+
+  PFP ("Scanning bus... ");
+  uint8_t sensor_count;
+  OWM_CHECK (owm_scan_bus_into (rom_ids, MAX_SENSORS, &sensor_count));
+  PFP ("ok, found %u sensor(s).\n", sensor_count);
+
+  for ( ; ; ) {
+    PFP ("\n");
+    survey_at_resolution (sensor_count, DS18B20_SURVEY_RESOLUTION_9_BIT);
+    survey_at_resolution (sensor_count, DS18B20_SURVEY_RESOLUTION_12_BIT);
+    PFP ("All tests passed (assuming temperatures look sane :).\n");
+  }
+}
@@ -40,6 +40,7 @@ PRINT_DEFAULT_GOAL_TRAP_ERROR_MESSAGE := \
   echo ; \
   echo '  *' some_file.o  --  Compile some_file.c ; \
   echo '  *' writeflash   --  Compile, link, and upload current module test ; \
+  echo '  *' host_test    --  Build and run module host test \(if any\) ; \
   echo
 
 .DEFAULT_GOAL = default_goal_trap
@@ -89,14 +90,15 @@ ARDUINO_BOOTLOADER ?= autoguess
 # won't work (even if it's an append), because setting make variables that
 # way stomps settings that come from the Makefile or its included fragments.
 # See comments near where the variable is referenced.
-VALID_ARDUINOLESS_TARGET_PATTERNS += %.c %.o %.ee.hex %.hex %.out %.out.map
+VALID_ARDUINOLESS_TARGET_PATTERNS += %.c %.o %.ee.hex %.hex %.out %.out.map \
+                                    host_test
 
 
 ##### Program Name, Constituent Object Files (Overridable) {{{1
 
 # This is the paragraph that determines which files are being built into what.
 PROGNAME ?= program_to_upload
-OBJS ?= $(patsubst %.c,%.o,$(wildcard *.c)) \
+OBJS ?= $(patsubst %.c,%.o,$(filter-out %_host_test.c,$(wildcard *.c))) \
         $(patsubst %.cpp,%.o,$(wildcard *.cpp))
 HEADERS ?= $(wildcard *.h)
 
@@ -196,6 +198,30 @@ AVARICE ?=
 AVRGDB ?=
 
 
+##### Host Test Program (Overridable) {{{1
+
+# Some modules are partly plain C that doesn't depend on the AVR hardware,
+# and that part can also be tested on the development machine, where it's
+# easy to simulate the outside world and run many cases quickly.  Such
+# modules have a test program in a file ending in _host_test.c, which the
+# host_test target builds with the native compiler using HOST_TEST_BUILD
+# and then runs.  The program should exit with a non-zero status if any
+# test fails.  Modules list the other sources the program needs in
+# HOST_TEST_SOURCES (and any flags it needs in HOST_TEST_CPPFLAGS), or
+# override HOST_TEST_BUILD entirely if one compiler command won't do.
+# Files ending in _host_test.c are never part of OBJS, and objects built
+# for the host should be named *.host.o so the clean target finds them.
+HOST_CC ?= cc
+HOST_CFLAGS ?= -std=gnu11 -O2 -g -Werror -Wall -Wextra
+HOST_TEST_PROGRAM_SOURCE ?= $(wildcard *_host_test.c)
+HOST_TEST_PROGRAM ?= $(patsubst %.c,%,$(HOST_TEST_PROGRAM_SOURCE))
+HOST_TEST_SOURCES ?=
+HOST_TEST_CPPFLAGS ?=
+HOST_TEST_BUILD ?=                                                          \
+  $(HOST_CC) $(HOST_CFLAGS) $(HOST_TEST_CPPFLAGS) -o $(HOST_TEST_PROGRAM)   \
+             $(HOST_TEST_PROGRAM_SOURCE) $(HOST_TEST_SOURCES)
+
+
 ##### Fuse Settings (Overridable) {{{1
 
 # Fuse settings to be programmed, in the form of a list of setting for
@@ -697,6 +723,14 @@ COMPILE_CXX = $(CXX) $(DIAGNOSTICS_FLAGS) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@
 %.o: %.cpp
 	$(COMPILE_CXX)
 
+# Build and run the host test program (see HOST_TEST_BUILD).
+.PHONY: host_test
+host_test:
+	@[ -n '$(HOST_TEST_PROGRAM_SOURCE)' ] || \
+	  (echo 'This module has no *_host_test.c program' 1>&2 && false)
+	$(HOST_TEST_BUILD)
+	./$(HOST_TEST_PROGRAM)
+
 # Clean everything imaginable.
 .PHONY: clean
 clean:
@@ -707,6 +741,7 @@ clean:
 	rm -rf $(HEXTRG)
 	rm -rf *.deps
 	rm -rf binaries_suid_root_stamp
+	rm -rf $(HOST_TEST_PROGRAM) *.host.o
 
 ########## Supporting Targets (Implementation) {{{2
 
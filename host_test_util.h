@@ -0,0 +1,62 @@
+// Generally useful stuff for the host test drivers (see the host_test
+// target in generic.mk).
+//
+// The *_host_test.c programs run on the development machine, not the AVR,
+// so this header must not include anything AVR-specific.  Everything here
+// is static, so each test driver gets its own copy.
+
+#ifndef HOST_TEST_UTIL_H
+#define HOST_TEST_UTIL_H
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Name of the current test, for failure messages.  Test drivers should set
+// this before each test.
+static char const *test_name __attribute__ ((unused));
+
+// Print a failure message (prefixed with test_name, if it's been set)
+// formatted like printf() to stderr, and exit with a non-zero status.
+static void
+fail (char const *format, ...)
+  __attribute__ ((format (printf, 1, 2), noreturn, unused));
+
+static void
+fail (char const *format, ...)
+{
+  va_list ap;
+
+  if ( test_name != NULL ) {
+    fprintf (stderr, "%s: ", test_name);
+  }
+  fprintf (stderr, "FAILED: ");
+  va_start (ap, format);
+  vfprintf (stderr, format, ap);
+  va_end (ap);
+  fprintf (stderr, "\n");
+
+  exit (EXIT_FAILURE);
+}
+
+// State of the pseudo-random number generator (a 32 bit xorshift generator,
+// used so runs are the same everywhere).  Test drivers may assign a new
+// (non-zero) seed.
+static uint32_t random_state __attribute__ ((unused)) = 42;
+
+static uint32_t
+random_uint32 (void)
+  __attribute__ ((unused));
+
+static uint32_t
+random_uint32 (void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+
+  return random_state;
+}
+
+#endif // HOST_TEST_UTIL_H
@@ -1,6 +1,11 @@
 // Implementation of the interface described in lcd.h.
 
 #include <assert.h>
+#ifdef LCD_USE_BACKGROUND_QUEUE
+#  include <avr/interrupt.h>
+#  include <avr/power.h>
+#  include <util/atomic.h>
+#endif
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,13 +64,52 @@ static uint8_t entrymodeset_flags;
 
 #define LCD_DISPLAY_LINES 2
 
+#if LCD_FB_ROWS > LCD_DISPLAY_LINES
+#  error LCD_FB_ROWS is greater than LCD_DISPLAY_LINES
+#endif
+
+// The framebuffer, the framebuffer cursor position, and what the display is
+// showing (if shown_valid is TRUE).
+static char fb[LCD_FB_ROWS][LCD_FB_COLUMNS];
+static uint8_t fb_column, fb_row;
+static char shown[LCD_FB_ROWS][LCD_FB_COLUMNS];
+static uint8_t shown_valid;
+
+// The glyphs loaded in the CGRAM slots (if glyph_loaded is TRUE for the
+// slot), and the slot numbers in order from most to least recently used.
+static uint8_t glyphs[LCD_GLYPH_SLOTS][LCD_GLYPH_ROWS];
+static uint8_t glyph_loaded[LCD_GLYPH_SLOTS];
+static uint8_t glyph_lru[LCD_GLYPH_SLOTS];
+
+// Character codes 8 through 15 display the same glyphs as 0 through 7.
+#define GLYPH_CODE_OFFSET 8
+
+// The CGRAM slot that code '\n' would display, if lcd_fb_write() didn't
+// treat it as a line break.
+#define NEWLINE_GLYPH_SLOT ('\n' - GLYPH_CODE_OFFSET)
+
+// Character code of the full block character in the LCD character ROM.
+#define FULL_BLOCK_CHARACTER 0xFF
+
+// Bits of the pixels in a glyph pattern row.
+#define GLYPH_COLUMNS  5
+#define GLYPH_ROW_FULL 0x1F
+
 // NOTE: resetting the Arduino doesn't necessarily reset the LCD.  So its
 // possible to trick yourself about whether a test is working or not while
 // developing.  The Makefile for this module contains a silly little target
 // the increments a number in the display setting string as one way to test
 // the most basic functionality of the LCD.
 
-// This is used to signal the LCD that data is ready on the data pins.
+// Worst-case execution times for most operations, and for the clear and
+// home operations.  The datasheet says 37 us and 1.52 ms, but that's for
+// a 270 kHz LCD clock, and some LCDs are slower, so we leave some margin.
+#define EXECUTION_TIME_US      100
+#define LONG_EXECUTION_TIME_US 2000
+
+// This is used to signal the LCD that data is ready on the data pins.  The
+// caller is responsible for waiting for the LCD to finish with complete
+// bytes (the second nibble of a byte can follow the first right away).
 static void
 pulse_enable (void)
 {
@@ -73,10 +117,10 @@ pulse_enable (void)
   _delay_us (1);
 
   LCD_ENABLE_SET_HIGH ();
-  _delay_us (1);
+  _delay_us (1);   // Enable pulse width must be > 450 ns
 
   LCD_ENABLE_SET_LOW ();
-  _delay_us (100);   // Commands need > 37us to settle
+  _delay_us (1);   // Enable cycle time must be > 1 us
 }
 
 // Write four bits of data to the LCD.  This could be part of a command or
@@ -96,9 +140,67 @@ write_4_bits (uint8_t value)
   pulse_enable ();
 }
 
-// Send eight bits of data to the LCD.  This could be a command or text data.
+#ifdef LCD_USE_BUSY_FLAG
+
+// Lower bound on the time read_busy_flag() takes, in microseconds.
+#  define BUSY_FLAG_READ_TIME_US 4
+
+// Return TRUE iff the LCD busy flag is set.  Note that this changes the RS
+// pin, so it must not be called between the nibbles of a byte.
+static uint8_t
+read_busy_flag (void)
+{
+  LCD_DB4_INIT (DIO_INPUT, DIO_DISABLE_PULLUP, DIO_DONT_CARE);
+  LCD_DB5_INIT (DIO_INPUT, DIO_DISABLE_PULLUP, DIO_DONT_CARE);
+  LCD_DB6_INIT (DIO_INPUT, DIO_DISABLE_PULLUP, DIO_DONT_CARE);
+  LCD_DB7_INIT (DIO_INPUT, DIO_DISABLE_PULLUP, DIO_DONT_CARE);
+
+  LCD_RS_SET_LOW ();
+  LCD_RW_SET_HIGH ();
+
+  // The busy flag shows up on DB7 during the first nibble.  The second
+  // nibble (the low bits of the address counter) has to be clocked out as
+  // well, though we don't care about it.
+  LCD_ENABLE_SET_HIGH ();
+  _delay_us (1);   // Data delay time is < 360 ns
+  uint8_t busy = LCD_DB7_READ ();
+  LCD_ENABLE_SET_LOW ();
+  _delay_us (1);
+  LCD_ENABLE_SET_HIGH ();
+  _delay_us (1);
+  LCD_ENABLE_SET_LOW ();
+
+  // Back to writing.  The data pins get turned back into outputs by
+  // write_4_bits().
+  LCD_RW_SET_LOW ();
+
+  return busy;
+}
+
+// Wait until the LCD busy flag clears, or for about max_us microseconds,
+// whichever comes first.
 static void
-send (uint8_t value, uint8_t mode)
+wait_while_busy (uint16_t max_us)
+{
+  for ( uint16_t ii = 0 ; ii < max_us / BUSY_FLAG_READ_TIME_US ; ii++ ) {
+    if ( ! read_busy_flag () ) {
+      return;
+    }
+  }
+}
+
+#  define WAIT_FOR_LCD(max_us) wait_while_busy (max_us)
+
+#else
+
+#  define WAIT_FOR_LCD(max_us) _delay_us (max_us)
+
+#endif
+
+// Write eight bits of data to the LCD.  This could be a command or text
+// data.  The caller must wait for the LCD to finish with it.
+static void
+write_8_bits (uint8_t value, uint8_t mode)
 {
   LCD_RS_SET (mode);
 
@@ -107,6 +209,191 @@ send (uint8_t value, uint8_t mode)
   write_4_bits (value);
 }
 
+#ifdef LCD_USE_BACKGROUND_QUEUE
+
+// Flags stored with each queued byte.
+#  define ENTRY_RS_HIGH      0x01   // Byte is text data rather than a command
+#  define ENTRY_LONG_COMMAND 0x02   // Byte is a clear or home command
+
+// The queue itself.  It's a ring buffer, and only the ISR changes
+// queue_head (while queue_count is nonzero).
+static uint8_t queue_values[LCD_QUEUE_SIZE];
+static uint8_t queue_flags[LCD_QUEUE_SIZE];
+static uint8_t queue_head;
+static volatile uint8_t queue_count;
+
+// Number of ISR ticks to do nothing for (while the LCD finishes a byte), and
+// whether the low nibble of the byte at the queue head is next.
+static uint8_t hold_ticks;
+static uint8_t low_nibble_next;
+
+#  define TIMER2_PRESCALER_DIVIDER 32
+#  define TIMER2_PRESCALER_CS_BITS (_BV (CS21) | _BV (CS20))
+
+// Number of timer2 ticks in us microseconds (rounded up).
+#  define TIMER2_TICKS(us)                                          \
+  ( ((us) * (F_CPU / 1000000UL) + TIMER2_PRESCALER_DIVIDER - 1) / \
+    TIMER2_PRESCALER_DIVIDER )
+
+#  if TIMER2_TICKS (LCD_QUEUE_TICK_US) > UINT8_MAX + 1
+#    error LCD_QUEUE_TICK_US is too long for timer2 with this prescaler
+#  endif
+
+// Number of ISR ticks in us microseconds (rounded up).
+#  define QUEUE_TICKS(us) (((us) + LCD_QUEUE_TICK_US - 1) / LCD_QUEUE_TICK_US)
+
+static void
+start_timer (void)
+{
+  TCNT2 = 0;
+  OCR2A = TIMER2_TICKS (LCD_QUEUE_TICK_US) - 1;
+  // Writing a logic one clears the flag (so no "|=" is required).
+  TIFR2 = _BV (OCF2A);
+  TCCR2B = TIMER2_PRESCALER_CS_BITS;
+  TIMSK2 |= _BV (OCIE2A);
+}
+
+static void
+stop_timer (void)
+{
+  TIMSK2 &= ~(_BV (OCIE2A));
+  TCCR2B = 0;   // Disconnect the clock source (saves a little power)
+}
+
+static uint8_t
+timer_running (void)
+{
+  return TIMSK2 & _BV (OCIE2A);
+}
+
+#  ifdef LCD_USE_BUSY_FLAG
+
+// Return TRUE iff the LCD is still busy with the last byte sent.  Like
+// wait_while_busy(), this gives up after about the time the fixed delay
+// would have taken.
+static uint8_t
+still_busy (void)
+{
+  static uint8_t busy_ticks = 0;
+
+  if ( busy_ticks < QUEUE_TICKS (LONG_EXECUTION_TIME_US) &&
+       read_busy_flag () ) {
+    busy_ticks++;
+    return TRUE;
+  }
+
+  busy_ticks = 0;
+  return FALSE;
+}
+
+#  endif
+
+ISR (TIMER2_COMPA_vect)
+{
+  if ( hold_ticks > 0 ) {
+    hold_ticks--;
+    return;
+  }
+
+#  ifdef LCD_USE_BUSY_FLAG
+  if ( ! low_nibble_next && still_busy () ) {
+    return;   // Try again next tick
+  }
+#  endif
+
+  // The timer only stops after a tick with nothing to do (and the LCD not
+  // busy), so the LCD always gets at least that long to finish the last
+  // byte, and lcd_wait_until_idle() doesn't return too soon.
+  if ( queue_count == 0 ) {
+    stop_timer ();
+    return;
+  }
+
+  uint8_t value = queue_values[queue_head];
+  uint8_t flags = queue_flags[queue_head];
+
+  if ( ! low_nibble_next ) {
+    LCD_RS_SET (flags & ENTRY_RS_HIGH ? HIGH : LOW);
+    write_4_bits (value >> 4);
+    low_nibble_next = TRUE;
+    return;
+  }
+
+  write_4_bits (value);
+  low_nibble_next = FALSE;
+
+#  ifndef LCD_USE_BUSY_FLAG
+  // The tick that notices an empty queue or sends the next high nibble
+  // provides one tick of the wait.
+  if ( flags & ENTRY_LONG_COMMAND ) {
+    hold_ticks = QUEUE_TICKS (LONG_EXECUTION_TIME_US) - 1;
+  }
+  else {
+    hold_ticks = QUEUE_TICKS (EXECUTION_TIME_US) - 1;
+  }
+#  endif
+
+  queue_head = (queue_head + 1) % LCD_QUEUE_SIZE;
+  queue_count--;
+}
+
+static void
+enqueue (uint8_t value, uint8_t flags)
+{
+  while ( queue_count == LCD_QUEUE_SIZE ) {
+    ;
+  }
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    uint8_t tail = (queue_head + queue_count) % LCD_QUEUE_SIZE;
+    queue_values[tail] = value;
+    queue_flags[tail] = flags;
+    queue_count++;
+    if ( ! timer_running () ) {
+      start_timer ();
+    }
+  }
+}
+
+// Default value of the timer/counter2 control register A (for the ATmega328P
+// at least), according to the datasheet.
+#  define TCCR2A_DEFAULT_VALUE 0x00
+
+static void
+queue_init (void)
+{
+  power_timer2_enable ();   // Ensure timer2 not shut down to save power
+
+  // Clear Timer on Compare match (CTC) mode, with the clock source not yet
+  // connected (start_timer() connects it).
+  TCCR2A = TCCR2A_DEFAULT_VALUE;
+  TCCR2A |= _BV (WGM21);
+  stop_timer ();
+
+  // Anything left over from a previous lcd_init() is discarded.
+  queue_head = 0;
+  queue_count = 0;
+  hold_ticks = 0;
+  low_nibble_next = FALSE;
+
+  sei ();   // Ensure that interrupts are enabled.
+}
+
+#endif
+
+// Send eight bits of data to the LCD.  This could be a command or text data.
+static void
+send (uint8_t value, uint8_t mode)
+{
+#ifdef LCD_USE_BACKGROUND_QUEUE
+  enqueue (value, mode == HIGH ? ENTRY_RS_HIGH : 0);
+#else
+  write_8_bits (value, mode);
+  WAIT_FOR_LCD (EXECUTION_TIME_US);
+#endif
+}
+
 // Send an eight bit command to the LCD.
 static void
 command (uint8_t value)
@@ -114,11 +401,31 @@ command (uint8_t value)
   send (value, LOW);
 }
 
+// Send an eight bit command that takes a long time to execute (clear or
+// home) to the LCD.
+static void
+long_command (uint8_t value)
+{
+#ifdef LCD_USE_BACKGROUND_QUEUE
+  enqueue (value, ENTRY_LONG_COMMAND);
+#else
+  write_8_bits (value, LOW);
+  WAIT_FOR_LCD (LONG_EXECUTION_TIME_US);
+#endif
+}
+
 void
 lcd_init (void)
 {
+#ifdef LCD_USE_BACKGROUND_QUEUE
+  queue_init ();
+#endif
+
   LCD_RS_INIT (DIO_OUTPUT, DIO_DONT_CARE, LOW);
   LCD_ENABLE_INIT (DIO_OUTPUT, DIO_DONT_CARE, LOW);
+#ifdef LCD_USE_BUSY_FLAG
+  LCD_RW_INIT (DIO_OUTPUT, DIO_DONT_CARE, LOW);
+#endif
 
   functionset_flags = LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS;
 
@@ -146,8 +453,10 @@ lcd_init (void)
   // Third go!
   write_4_bits (0x03);
   _delay_us (150);
-  // Finally, set to 4-bit interface.
+  // Finally, set to 4-bit interface.  The busy flag can't be trusted until
+  // this has taken effect, so we use fixed delays up to here.
   write_4_bits (0x02);
+  _delay_us (EXECUTION_TIME_US);
 
   // NOTE: By my reading of the above datasheet, the initialization timing
   // should look like the below code.  But the Arduino library way has
@@ -183,21 +492,41 @@ lcd_init (void)
 
   // A little harmless paranoia in case some devices initialize weirdly.
   lcd_home ();
+
+  lcd_fb_clear ();
+
+  // Whatever is in CGRAM now is of unknown origin.
+  for ( uint8_t ii = 0 ; ii < LCD_GLYPH_SLOTS ; ii++ ) {
+    glyph_loaded[ii] = FALSE;
+    glyph_lru[ii] = ii;
+  }
+}
+
+void
+lcd_wait_until_idle (void)
+{
+#ifdef LCD_USE_BACKGROUND_QUEUE
+  while ( timer_running () ) {
+    ;
+  }
+#endif
 }
 
 void
 lcd_clear (void)
 {
-  command (LCD_CLEARDISPLAY);  // Clear display, set cursor position to zero.
-  _delay_us (2000);   // This command takes a long time.
+  // Clear display, set cursor position to zero.
+  long_command (LCD_CLEARDISPLAY);
+
+  memset (shown, ' ', sizeof (shown));
+  shown_valid = TRUE;
 }
 
 void
 lcd_home (void)
 {
   // Set cursor position to zero and undo any scrolling that is in effect.
-  command (LCD_RETURNHOME);
-  _delay_us (2000);  // This command takes a long time.
+  long_command (LCD_RETURNHOME);
 }
 
 void
@@ -318,3 +647,276 @@ lcd_write_string (const char *buffer)
   return n;
 }
 
+void
+lcd_fb_clear (void)
+{
+  memset (fb, ' ', sizeof (fb));
+  fb_column = 0;
+  fb_row = 0;
+}
+
+void
+lcd_fb_set_cursor_position (uint8_t column, uint8_t row)
+{
+  fb_column = column;
+  fb_row = row;
+}
+
+void
+lcd_fb_write (char character)
+{
+  if ( character == '\n' ) {
+    fb_column = 0;
+    if ( fb_row < UINT8_MAX ) {
+      fb_row++;
+    }
+    return;
+  }
+
+  if ( fb_row < LCD_FB_ROWS && fb_column < LCD_FB_COLUMNS ) {
+    fb[fb_row][fb_column] = character;
+  }
+  if ( fb_column < UINT8_MAX ) {
+    fb_column++;
+  }
+}
+
+size_t
+lcd_fb_write_string (const char *buffer)
+{
+  size_t n = 0;
+  while ( *buffer != '\0' ) {
+    lcd_fb_write (*buffer++);
+    n++;
+  }
+
+  return n;
+}
+
+int
+lcd_fb_printf (const char *format, ...)
+{
+  char message_buffer[LCD_MAX_MESSAGE_LENGTH + 1];
+
+  va_list ap;
+  va_start (ap, format);
+  int chars_written
+    = vsnprintf (message_buffer, LCD_MAX_MESSAGE_LENGTH, format, ap);
+  va_end (ap);
+
+  lcd_fb_write_string (message_buffer);
+
+  return chars_written;
+}
+
+int
+lcd_fb_printf_P (const char *format, ...)
+{
+  char message_buffer[LCD_MAX_MESSAGE_LENGTH + 1];
+
+  va_list ap;
+  va_start (ap, format);
+  int chars_written
+    = vsnprintf_P (message_buffer, LCD_MAX_MESSAGE_LENGTH, format, ap);
+  va_end (ap);
+
+  lcd_fb_write_string (message_buffer);
+
+  return chars_written;
+}
+
+void
+lcd_fb_invalidate (void)
+{
+  shown_valid = FALSE;
+}
+
+uint8_t
+lcd_refresh (void)
+{
+  uint8_t sent = 0;   // Bytes sent to the LCD
+
+  for ( uint8_t row = 0 ; row < LCD_FB_ROWS ; row++ ) {
+    // Column where the LCD cursor is in this row, or LCD_FB_COLUMNS if it
+    // isn't in this row as far as we know.  Rewriting an unchanged
+    // character between two changed ones would cost a byte, just like
+    // moving the cursor past it does, so we always do the latter.
+    uint8_t lcd_column = LCD_FB_COLUMNS;
+    for ( uint8_t column = 0 ; column < LCD_FB_COLUMNS ; column++ ) {
+      char character = fb[row][column];
+      if ( shown_valid && character == shown[row][column] ) {
+        continue;
+      }
+      if ( column != lcd_column ) {
+        lcd_set_cursor_position (column, row);
+        sent++;
+      }
+      lcd_write (character);
+      sent++;
+      shown[row][column] = character;
+      lcd_column = column + 1;
+    }
+  }
+
+  shown_valid = TRUE;
+
+  return sent;
+}
+
+void
+lcd_define_character (uint8_t slot, uint8_t const *pattern)
+{
+  assert (slot < LCD_GLYPH_SLOTS);
+
+  // After this the LCD address counter points into CGRAM, so the data
+  // written next goes there.
+  command (LCD_SETCGRAMADDR | (slot * LCD_GLYPH_ROWS));
+  for ( uint8_t ii = 0 ; ii < LCD_GLYPH_ROWS ; ii++ ) {
+    send (pattern[ii], HIGH);
+  }
+}
+
+static void
+mark_glyph_used (uint8_t lru_index)
+{
+  // Move the slot at lru_index in glyph_lru to the front.
+
+  uint8_t slot = glyph_lru[lru_index];
+  for ( uint8_t ii = lru_index ; ii > 0 ; ii-- ) {
+    glyph_lru[ii] = glyph_lru[ii - 1];
+  }
+  glyph_lru[0] = slot;
+}
+
+static uint8_t
+glyph_in_framebuffer (uint8_t slot)
+{
+  // Return TRUE iff either of the character codes for slot appear in the
+  // framebuffer.
+
+  char const *fbp = (char const *) fb;
+  for ( uint8_t ii = 0 ; ii < sizeof (fb) ; ii++ ) {
+    if ( (uint8_t) fbp[ii] == slot ||
+         (uint8_t) fbp[ii] == slot + GLYPH_CODE_OFFSET ) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static uint8_t
+glyph_code (uint8_t slot)
+{
+  // Return the character code lcd_glyph() uses for slot.  This is the code
+  // from the 8-15 range, except for the slot whose code there is '\n'.
+
+  if ( slot == NEWLINE_GLYPH_SLOT ) {
+    return slot;
+  }
+
+  return slot + GLYPH_CODE_OFFSET;
+}
+
+uint8_t
+lcd_glyph (uint8_t const *pattern)
+{
+  for ( uint8_t ii = 0 ; ii < LCD_GLYPH_SLOTS ; ii++ ) {
+    uint8_t slot = glyph_lru[ii];
+    if ( glyph_loaded[slot] &&
+         memcmp (glyphs[slot], pattern, LCD_GLYPH_ROWS) == 0 ) {
+      mark_glyph_used (ii);
+      return glyph_code (slot);
+    }
+  }
+
+  // Not loaded, so find a victim, starting from the least recently used.
+  uint8_t victim_index = LCD_GLYPH_SLOTS - 1;
+  for ( int8_t ii = LCD_GLYPH_SLOTS - 1 ; ii >= 0 ; ii-- ) {
+    uint8_t slot = glyph_lru[ii];
+    if ( ! glyph_loaded[slot] || ! glyph_in_framebuffer (slot) ) {
+      victim_index = ii;
+      break;
+    }
+  }
+
+  uint8_t slot = glyph_lru[victim_index];
+  memcpy (glyphs[slot], pattern, LCD_GLYPH_ROWS);
+  glyph_loaded[slot] = TRUE;
+  lcd_define_character (slot, pattern);
+  mark_glyph_used (victim_index);
+
+  return glyph_code (slot);
+}
+
+void
+lcd_fb_bar_graph (
+    uint8_t column,
+    uint8_t row,
+    uint8_t width,
+    uint16_t value,
+    uint16_t max )
+{
+  assert (max > 0);
+
+  if ( value > max ) {
+    value = max;
+  }
+
+  uint16_t filled = ((uint32_t) value * width * GLYPH_COLUMNS + max / 2) / max;
+  uint8_t full_characters = filled / GLYPH_COLUMNS;
+  uint8_t partial_columns = filled % GLYPH_COLUMNS;
+
+  lcd_fb_set_cursor_position (column, row);
+
+  for ( uint8_t ii = 0 ; ii < full_characters ; ii++ ) {
+    lcd_fb_write (FULL_BLOCK_CHARACTER);
+  }
+
+  uint8_t remaining = width - full_characters;
+  if ( partial_columns > 0 ) {
+    uint8_t pattern[LCD_GLYPH_ROWS];
+    memset (
+        pattern,
+        (GLYPH_ROW_FULL << (GLYPH_COLUMNS - partial_columns)) & GLYPH_ROW_FULL,
+        sizeof (pattern) );
+    lcd_fb_write (lcd_glyph (pattern));
+    remaining--;
+  }
+
+  for ( uint8_t ii = 0 ; ii < remaining ; ii++ ) {
+    lcd_fb_write (' ');
+  }
+}
+
+void
+lcd_fb_sparkline (
+    uint8_t column,
+    uint8_t row,
+    uint8_t count,
+    uint16_t const *values,
+    uint16_t max )
+{
+  assert (max > 0);
+
+  lcd_fb_set_cursor_position (column, row);
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    uint16_t value = (values[ii] > max ? max : values[ii]);
+    uint8_t height
+      = ((uint32_t) value * LCD_GLYPH_ROWS + max / 2) / max;
+
+    if ( height == 0 ) {
+      lcd_fb_write (' ');
+    }
+    else if ( height == LCD_GLYPH_ROWS ) {
+      lcd_fb_write (FULL_BLOCK_CHARACTER);
+    }
+    else {
+      uint8_t pattern[LCD_GLYPH_ROWS];
+      memset (pattern, 0x00, LCD_GLYPH_ROWS - height);
+      memset (pattern + LCD_GLYPH_ROWS - height, GLYPH_ROW_FULL, height);
+      lcd_fb_write (lcd_glyph (pattern));
+    }
+  }
+}
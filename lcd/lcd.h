@@ -35,6 +35,60 @@
          See the example in the Makefile in the dio module directory.
 #endif
 
+// By default we assume that the LCD R/W pin is tied to ground (as it is on
+// the DFRobot DFR0009 shield), so nothing can ever be read from the LCD.
+// Every operation is then followed by a fixed delay long enough for a slow
+// LCD to finish it: 100 us for most things, and 2 ms for lcd_clear() and
+// lcd_home().  Most LCDs are considerably faster than that.  If the R/W pin
+// is connected to an IO pin instead and LCD_USE_BUSY_FLAG is defined, the
+// LCD busy flag is polled, so we only wait as long as the LCD actually needs
+// (about 40 us per character for a typical LCD).  In that case macros for
+// the R/W pin and for reading the DB7 pin must be defined as well (see the
+// commented-out example in the Makefile for this module).  If the busy flag
+// never clears (because the LCD isn't connected, for example) we give up
+// after about the time the fixed delay would have taken.
+#ifdef LCD_USE_BUSY_FLAG
+#  if ! (defined (LCD_RW_INIT) && \
+         defined (LCD_RW_SET_HIGH) && \
+         defined (LCD_RW_SET_LOW) && \
+         \
+         defined (LCD_DB7_READ))
+#    error LCD_USE_BUSY_FLAG is defined, but the macros which specify the \
+           R/W pin and how to read DB7 are not set.  See the example in the \
+           Makefile in the lcd module directory.
+#  endif
+#endif
+
+// Even in busy flag mode, writing a full screen takes a millisecond or two,
+// which is a long time to stall something like a control loop.  If
+// LCD_USE_BACKGROUND_QUEUE is defined, the functions below that send
+// things to the LCD just put the bytes in a queue with room for
+// LCD_QUEUE_SIZE bytes and return right away (unless the queue is full, in
+// which case they wait for room).  The timer2 compare match interrupt then
+// sends one nibble from the queue every LCD_QUEUE_TICK_US microseconds,
+// holding off as long as required after each byte (or until the busy flag
+// clears, if LCD_USE_BUSY_FLAG is also defined).  Each interrupt takes only
+// a few microseconds.  The timer is stopped whenever the queue is empty.
+//
+// WARNING: in background queue mode, interrupts must remain enabled while
+// the functions below are called (lcd_init() enables them), since a full
+// queue never empties otherwise.
+//
+// WARNING: background queue mode uses timer2, so it can't be used together
+// with any other interface that uses it (the dc_motor.h or
+// one_wire_master_async.h interfaces for example).
+#ifdef LCD_USE_BACKGROUND_QUEUE
+#  ifndef LCD_QUEUE_SIZE
+#    define LCD_QUEUE_SIZE 48
+#  endif
+#  if LCD_QUEUE_SIZE > 255
+#    error LCD_QUEUE_SIZE must not be greater than 255
+#  endif
+#  ifndef LCD_QUEUE_TICK_US
+#    define LCD_QUEUE_TICK_US 50
+#  endif
+#endif
+
 // Initialize display.  This routine takes about 50 milliseconds (to ensure
 // that the input voltage has risen sufficiently for corret display operation,
 // in case we are called near power-on).  Note also that some macros must
@@ -44,6 +98,12 @@
 void
 lcd_init (void);
 
+// Wait until everything that has been sent to the LCD has actually been
+// written to it.  This returns immediately unless LCD_USE_BACKGROUND_QUEUE
+// is defined (see above).
+void
+lcd_wait_until_idle (void);
+
 // Clear the display (the underlying content of the LCD is removed).
 void
 lcd_clear (void);
@@ -130,5 +190,136 @@ int
 lcd_printf_P (const char *format, ...)
   __attribute__ ((format (printf, 1, 2)));
 
+// Framebuffer Interface
+//
+// Redrawing a whole screen with lcd_clear() and lcd_printf() every time
+// a value changes is slow: lcd_clear() alone takes 2 ms, and every
+// character costs a byte sent to the LCD.  The functions below write into
+// a framebuffer in RAM instead.  When the framebuffer is ready,
+// lcd_refresh() compares it with what the display is known to be showing,
+// and sends only the characters that have changed (moving the LCD cursor
+// only where the changed characters aren't already consecutive).  It never
+// clears the display.  A screen where one short value changes now and then
+// typically costs just a few bytes per refresh.
+//
+// The framebuffer and the functions above don't know about each other,
+// except that lcd_init() and lcd_clear() keep track of the fact that the
+// display is blank.  Clients that write to the display using the other
+// functions (or scroll it) should call lcd_fb_invalidate() before the next
+// lcd_refresh().  lcd_refresh() leaves the LCD cursor position undefined.
+
+// Dimensions of the framebuffer.
+#define LCD_FB_COLUMNS 16
+#define LCD_FB_ROWS 2
+
+// Fill the framebuffer with spaces and set the framebuffer cursor position
+// to column 0, row 0.  This doesn't send anything to the LCD.
+void
+lcd_fb_clear (void);
+
+// Set the framebuffer cursor position (where the lcd_fb_write*() and
+// lcd_fb_printf*() functions put characters).  Positions off the screen
+// are allowed, but characters written there are discarded.
+void
+lcd_fb_set_cursor_position (uint8_t column, uint8_t row);
+
+// Write a single character into the framebuffer at the framebuffer cursor
+// position, and advance the cursor.  Characters that don't fit on the
+// current row are discarded (there is no wrapping), except that a newline
+// character ('\n') moves the cursor to the start of the next row.
+void
+lcd_fb_write (char character);
+
+// Write a string into the framebuffer as per lcd_fb_write(), and return
+// the number of characters written.
+size_t
+lcd_fb_write_string (const char *buffer);
+
+// Framebuffer analogues of lcd_printf() and lcd_printf_P().
+int
+lcd_fb_printf (const char *format, ...)
+  __attribute__ ((format (printf, 1, 2)));
+int
+lcd_fb_printf_P (const char *format, ...)
+  __attribute__ ((format (printf, 1, 2)));
+
+// Forget what the display is showing, so the next lcd_refresh() sends the
+// entire framebuffer.
+void
+lcd_fb_invalidate (void);
+
+// Send the parts of the framebuffer that differ from what the display is
+// showing to the LCD.  Returns the number of bytes (characters and cursor
+// movement commands) that were sent.
+uint8_t
+lcd_refresh (void);
+
+// Custom Characters
+//
+// The HD44780 has room for eight custom characters (glyphs) in its
+// character generator RAM (CGRAM).  Each glyph is described by eight bytes,
+// one per row of pixels from top to bottom, of which the low five bits are
+// the pixels from left to right (so 0x10 is the leftmost pixel).  Glyphs
+// are displayed by writing character codes 0 through 7 (or equivalently 8
+// through 15, which are easier to use in strings since they aren't the null
+// byte).
+
+// Number of custom character slots.
+#define LCD_GLYPH_SLOTS 8
+
+// Number of bytes in a glyph pattern.
+#define LCD_GLYPH_ROWS 8
+
+// Load the glyph described by pattern into CGRAM slot (0 through
+// LCD_GLYPH_SLOTS - 1).  Characters with this code that are already on
+// the display change right away.  This leaves the LCD cursor position
+// undefined (lcd_set_cursor_position() must be used before lcd_write()).
+// Clients that use this function shouldn't use lcd_glyph() as well.
+void
+lcd_define_character (uint8_t slot, uint8_t const *pattern);
+
+// Return a character code that displays the glyph described by pattern.
+// If the glyph is already loaded in one of the CGRAM slots it isn't sent to
+// the LCD again.  Otherwise it's loaded into the least recently used slot
+// whose code doesn't currently appear in the framebuffer (or into the least
+// recently used slot, if they all do, in which case the characters already
+// in the framebuffer end up showing the wrong glyph).  So up to
+// LCD_GLYPH_SLOTS different glyphs can be on the screen at once.  The
+// returned code is between 8 and 15 (see above), except that slot 2 is
+// returned as code 2, since code 10 is '\n' (see lcd_fb_write()).  So the
+// code is never the null byte or a newline.  This leaves the LCD cursor
+// position undefined (lcd_set_cursor_position() must be used before
+// lcd_write(), though lcd_refresh() doesn't care).
+uint8_t
+lcd_glyph (uint8_t const *pattern);
+
+// Draw a horizontal bar width characters wide into the framebuffer,
+// starting at the given column and row.  The bar is filled in proportion
+// to value / max (with a resolution of one pixel column, so five steps per
+// character), and value is clamped to max.  Full characters use the
+// block character 0xFF from the LCD character ROM, and the partly filled
+// character uses a custom glyph (see lcd_glyph()), so this consumes at
+// most one glyph slot.  The framebuffer cursor is left after the bar.
+void
+lcd_fb_bar_graph (
+    uint8_t column,
+    uint8_t row,
+    uint8_t width,
+    uint16_t value,
+    uint16_t max );
+
+// Draw a sparkline of count values into the framebuffer, starting at the
+// given column and row.  Each value gets one character, which is filled
+// from the bottom in proportion to value / max (with a resolution of one
+// pixel row, so eight steps per character), and values are clamped to max.
+// This consumes at most seven glyph slots (see lcd_glyph()).  The
+// framebuffer cursor is left after the sparkline.
+void
+lcd_fb_sparkline (
+    uint8_t column,
+    uint8_t row,
+    uint8_t count,
+    uint16_t const *values,
+    uint16_t max );
 
 #endif // LCD_H
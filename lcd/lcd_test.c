@@ -17,7 +17,8 @@
 //   * LCD D5 pin to digital pin 12
 //   * LCD D6 pin to digital pin 13
 //   * LCD D7 pin to digital pin 14
-//   * LCD R/W pin to ground
+//   * LCD R/W pin to ground (or to digital pin 2 if LCD_USE_BUSY_FLAG is
+//     enabled in the Makefile)
 //   * 10K potentiometer:
 //     * Ends to +5V and ground
 //     * Wiper to LCD VO pin (pin 3).
@@ -118,4 +119,50 @@ main (void)
   lcd_home ();
   lcd_write (LCD_CHARACTER_RIGHT_ARROW);
   lcd_write (LCD_CHARACTER_LEFT_ARROW);
+  _delay_ms (time_per_test_ms);
+
+  // Test the framebuffer interface.  The first row shows a counter, the
+  // second the number of bytes the previous lcd_refresh() sent to the LCD,
+  // which should be a lot less than the whole screen (usually two bytes:
+  // one cursor move and one digit).
+  lcd_clear ();
+  lcd_fb_clear ();
+  uint8_t bytes_sent = 0;
+  for ( uint16_t ii = 0 ; ii <= 200 ; ii++ ) {
+    lcd_fb_set_cursor_position (0, 0);
+    lcd_fb_printf ("count: %3u", ii);
+    lcd_fb_set_cursor_position (0, 1);
+    lcd_fb_printf ("sent: %2u", bytes_sent);
+    bytes_sent = lcd_refresh ();
+    _delay_ms (20);
+  }
+  _delay_ms (time_per_test_ms);
+
+  // Test the custom character interface.  The first row shows a bar graph
+  // that fills up smoothly, and the second a sparkline of a sawtooth wave
+  // that moves to the left.
+  lcd_clear ();
+  lcd_fb_clear ();
+  uint16_t const bar_max = 200;
+  uint8_t const sparkline_length = LCD_FB_COLUMNS;
+  uint16_t samples[LCD_FB_COLUMNS];
+  for ( uint16_t ii = 0 ; ii <= bar_max ; ii++ ) {
+    lcd_fb_bar_graph (0, 0, LCD_FB_COLUMNS, ii, bar_max);
+    for ( uint8_t jj = 0 ; jj < sparkline_length ; jj++ ) {
+      samples[jj] = (ii + jj) % LCD_GLYPH_ROWS;
+    }
+    lcd_fb_sparkline (
+        0, 1, sparkline_length, samples, LCD_GLYPH_ROWS - 1 );
+    lcd_refresh ();
+    _delay_ms (20);
+  }
+  _delay_ms (time_per_test_ms);
+
+  // Test lcd_wait_until_idle().  This only has anything to wait for if
+  // LCD_USE_BACKGROUND_QUEUE is defined (see lcd.h), in which case the
+  // functions above return before their output has actually reached the
+  // LCD.  Either way the display should end up reading "idle".
+  lcd_clear ();
+  lcd_write_string ("idle");
+  lcd_wait_until_idle ();
 }
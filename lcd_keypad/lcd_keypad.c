@@ -1,11 +1,13 @@
 // Implementation of the interface described in lcd_keypad.h.
 
 #include <assert.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 // FIXME: here only cause assert.h wrongly needs, remove when that bug is
 // fixed (which it is in most recent upstream AVR libc
 #include <stdlib.h>
 #include <string.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
 #include "adc.h"
@@ -94,9 +96,24 @@ button_band (uint16_t raw_adc_reading)
   return nearest_button;
 }
 
+#ifdef LCD_KEYPAD_USE_SCANNER
+
+// TRUE iff the background scanner is running, and the debounced button
+// state it has arrived at.
+static volatile uint8_t scanner_running = FALSE;
+static volatile lcd_keypad_button_t scanned_button;
+
+#endif
+
 lcd_keypad_button_t
 lcd_keypad_check_buttons (void)
 {
+#ifdef LCD_KEYPAD_USE_SCANNER
+  if ( scanner_running ) {
+    return scanned_button;
+  }
+#endif
+
   // We require two ADC readings in the same band before we consider that we
   // have a definite button press at that value.
   uint16_t reading1, reading2;
@@ -296,3 +313,230 @@ lcd_keypad_set_value (const char *name, double *value, double step)
 
   return button;
 }
+
+#ifdef LCD_KEYPAD_USE_SCANNER
+
+// Scanner timing parameters in units of scans.
+#define DEBOUNCE_SCANS \
+  (LCD_KEYPAD_DEBOUNCE_MS / LCD_KEYPAD_SCAN_PERIOD_MS)
+#define REPEAT_DELAY_SCANS \
+  (LCD_KEYPAD_REPEAT_DELAY_MS / LCD_KEYPAD_SCAN_PERIOD_MS)
+#define REPEAT_INTERVAL_SCANS \
+  (LCD_KEYPAD_REPEAT_INTERVAL_MS / LCD_KEYPAD_SCAN_PERIOD_MS)
+#define LONG_PRESS_SCANS \
+  (LCD_KEYPAD_LONG_PRESS_MS / LCD_KEYPAD_SCAN_PERIOD_MS)
+
+#if DEBOUNCE_SCANS < 1 || DEBOUNCE_SCANS > UINT8_MAX
+#  error LCD_KEYPAD_DEBOUNCE_MS is out of range
+#endif
+
+// The event queue.  It's a ring buffer, and only the ISR changes
+// event_count upwards.
+static lcd_keypad_event_t event_queue[LCD_KEYPAD_EVENT_QUEUE_SIZE];
+static uint8_t event_head;
+static volatile uint8_t event_count;
+
+// Scanner state.  Only the ISR touches these while the scanner is running.
+static uint8_t conversions_until_scan;
+static lcd_keypad_button_t candidate_button;   // Seen in the latest scans
+static uint8_t candidate_scans;                // Scans candidate seen in
+static uint16_t held_scans;                    // Scans scanned_button held
+static uint16_t scans_until_repeat;
+
+static void
+post_event (lcd_keypad_event_type_t type, lcd_keypad_button_t button)
+{
+  if ( event_count == LCD_KEYPAD_EVENT_QUEUE_SIZE ) {
+    return;
+  }
+
+  uint8_t tail = (event_head + event_count) % LCD_KEYPAD_EVENT_QUEUE_SIZE;
+  event_queue[tail].type = type;
+  event_queue[tail].button = button;
+  event_count++;
+}
+
+ISR (ADC_vect)
+{
+  if ( --conversions_until_scan != 0 ) {
+    return;
+  }
+  conversions_until_scan = LCD_KEYPAD_SCAN_CONVERSIONS;
+
+  lcd_keypad_button_t band = button_band (ADC);
+
+  if ( band == candidate_button ) {
+    if ( candidate_scans < DEBOUNCE_SCANS ) {
+      candidate_scans++;
+    }
+  }
+  else {
+    candidate_button = band;
+    candidate_scans = 1;
+  }
+
+  if ( candidate_scans == DEBOUNCE_SCANS &&
+       candidate_button != scanned_button ) {
+    // Since the resistor ladder can only report one button at a time, a
+    // change from one button directly to another is a release and a press.
+    if ( scanned_button != LCD_KEYPAD_BUTTON_NONE ) {
+      post_event (LCD_KEYPAD_EVENT_RELEASE, scanned_button);
+    }
+    scanned_button = candidate_button;
+    if ( scanned_button != LCD_KEYPAD_BUTTON_NONE ) {
+      post_event (LCD_KEYPAD_EVENT_PRESS, scanned_button);
+    }
+    held_scans = 0;
+    scans_until_repeat = REPEAT_DELAY_SCANS;
+    return;
+  }
+
+  if ( scanned_button != LCD_KEYPAD_BUTTON_NONE ) {
+    if ( held_scans < UINT16_MAX ) {
+      held_scans++;
+      if ( held_scans == LONG_PRESS_SCANS ) {
+        post_event (LCD_KEYPAD_EVENT_LONG_PRESS, scanned_button);
+      }
+    }
+    if ( --scans_until_repeat == 0 ) {
+      post_event (LCD_KEYPAD_EVENT_REPEAT, scanned_button);
+      scans_until_repeat = REPEAT_INTERVAL_SCANS;
+    }
+  }
+}
+
+void
+lcd_keypad_scanner_start (void)
+{
+  assert (! scanner_running);
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    event_head = 0;
+    event_count = 0;
+  }
+  conversions_until_scan = LCD_KEYPAD_SCAN_CONVERSIONS;
+  candidate_button = LCD_KEYPAD_BUTTON_NONE;
+  candidate_scans = 0;
+  scanned_button = LCD_KEYPAD_BUTTON_NONE;
+  held_scans = 0;
+  scans_until_repeat = REPEAT_DELAY_SCANS;
+
+  // Select the keypad channel (see adc_read_raw()), put the ADC in free
+  // running mode with the conversion complete interrupt enabled, and start
+  // the first conversion.
+  ADMUX = (ADMUX & 0xf0) | (LCD_KEYPAD_ADC_PIN & 0x0f);
+  ADCSRB &= ~(_BV (ADTS2) | _BV (ADTS1) | _BV (ADTS0));
+  ADCSRA |= _BV (ADATE) | _BV (ADIE);
+  scanner_running = TRUE;
+  sei ();   // Ensure that interrupts are enabled.
+  ADCSRA |= _BV (ADSC);
+}
+
+void
+lcd_keypad_scanner_stop (void)
+{
+  assert (scanner_running);
+
+  ADCSRA &= ~(_BV (ADATE) | _BV (ADIE));
+  // Let any conversion in progress finish, so adc_read_raw() starts clean.
+  loop_until_bit_is_clear (ADCSRA, ADSC);
+  scanner_running = FALSE;
+}
+
+uint8_t
+lcd_keypad_get_event (lcd_keypad_event_t *event)
+{
+  uint8_t result = FALSE;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    if ( event_count > 0 ) {
+      *event = event_queue[event_head];
+      event_head = (event_head + 1) % LCD_KEYPAD_EVENT_QUEUE_SIZE;
+      event_count--;
+      result = TRUE;
+    }
+  }
+
+  return result;
+}
+
+// Update the value display in the framebuffer and send it to the LCD.
+static void
+refresh_edited_value (double value)
+{
+  lcd_fb_set_cursor_position (0, 1);
+  lcd_fb_printf_P (PSTR (LCD_KEYPAD_VALUE_DISPLAY_FORMAT), value);
+  lcd_refresh ();
+}
+
+void
+lcd_keypad_edit_value_start (
+    lcd_keypad_value_editor_t *editor,
+    const char *name,
+    double *value,
+    double step )
+{
+  assert (scanner_running);
+
+  editor->value = value;
+  editor->step = step;
+
+  // The client may have written to the display directly, so we can't trust
+  // the framebuffer's idea of what's shown.
+  lcd_fb_invalidate ();
+  lcd_fb_clear ();
+  // Note that we truncate really long variable names as per the
+  // LCD_KEYPAD_VALUE_NAME_MAX_LENGTH interface macro.
+  lcd_fb_printf_P (PSTR ("%.15s:"), name);
+  refresh_edited_value (*value);
+}
+
+lcd_keypad_button_t
+lcd_keypad_edit_value_poll (lcd_keypad_value_editor_t *editor)
+{
+  lcd_keypad_button_t result = LCD_KEYPAD_BUTTON_NONE;
+  uint8_t changed = FALSE;
+  lcd_keypad_event_t event;
+
+  while ( result == LCD_KEYPAD_BUTTON_NONE &&
+          lcd_keypad_get_event (&event) ) {
+    uint8_t steps = (event.type == LCD_KEYPAD_EVENT_PRESS ||
+                     event.type == LCD_KEYPAD_EVENT_REPEAT);
+    switch ( event.button ) {
+      case LCD_KEYPAD_BUTTON_UP:
+        if ( steps ) {
+          *(editor->value) += editor->step;
+          changed = TRUE;
+        }
+        break;
+      case LCD_KEYPAD_BUTTON_DOWN:
+        if ( steps ) {
+          *(editor->value) -= editor->step;
+          changed = TRUE;
+        }
+        break;
+      case LCD_KEYPAD_BUTTON_RIGHT:
+      case LCD_KEYPAD_BUTTON_LEFT:
+      case LCD_KEYPAD_BUTTON_SELECT:
+        if ( event.type == LCD_KEYPAD_EVENT_RELEASE ) {
+          result = event.button;
+        }
+        break;
+      default:
+        assert (0);   // Shouldn't be here.
+        break;
+    }
+  }
+
+  // Thanks to lcd_refresh() only the digits that actually change get sent,
+  // so unlike lcd_keypad_set_value() we can afford to show every step.
+  if ( changed ) {
+    refresh_edited_value (*(editor->value));
+  }
+
+  return result;
+}
+
+#endif // LCD_KEYPAD_USE_SCANNER
@@ -96,6 +96,138 @@ lcd_keypad_show_value (const char *name, double *value);
 lcd_keypad_button_t
 lcd_keypad_set_value (const char *name, double *value, double step);
 
+// Background Scanner
+//
+// The functions above poll the ADC (and busy-wait) whenever they want to
+// know about the buttons, so nothing else can happen while they wait.  The
+// background scanner instead runs the ADC in free running mode and takes a
+// look at the keypad channel from the ADC conversion complete interrupt
+// about every LCD_KEYPAD_SCAN_PERIOD_MS milliseconds.  A button state only
+// counts once it has been seen in LCD_KEYPAD_DEBOUNCE_MS milliseconds of
+// consecutive scans, which filters out both contact bounce and the
+// intermediate ADC values seen while the resistor ladder voltage changes.
+// Changes in the debounced state are posted as events to a queue with room
+// for LCD_KEYPAD_EVENT_QUEUE_SIZE events, which can be read at leisure with
+// lcd_keypad_get_event():
+//
+//   * LCD_KEYPAD_EVENT_PRESS when a button goes down,
+//
+//   * LCD_KEYPAD_EVENT_REPEAT every LCD_KEYPAD_REPEAT_INTERVAL_MS
+//     milliseconds while a button is held down, starting after
+//     LCD_KEYPAD_REPEAT_DELAY_MS milliseconds,
+//
+//   * LCD_KEYPAD_EVENT_LONG_PRESS once, when a button has been held down
+//     for LCD_KEYPAD_LONG_PRESS_MS milliseconds, and
+//
+//   * LCD_KEYPAD_EVENT_RELEASE when the button comes back up.
+//
+// While the scanner is running lcd_keypad_check_buttons() just returns the
+// debounced state, so lcd_keypad_wait_for_button() and
+// lcd_keypad_show_value() keep working.  lcd_keypad_set_value() shouldn't
+// be used (its button repeat timing assumes polled ADC reads), but
+// lcd_keypad_edit_value_start() and lcd_keypad_edit_value_poll() provide a
+// version of it that doesn't block.
+//
+// The interrupt fires after every ADC conversion (about every 104 us), but
+// does nothing but count most of the time, so the scanner uses a percent or
+// two of the CPU time.
+//
+// The scanner is only built if LCD_KEYPAD_USE_SCANNER is defined, since
+// it defines an ADC conversion complete interrupt handler (ADC_vect), and
+// only one module in a program can do that.
+//
+// WARNING: with LCD_KEYPAD_USE_SCANNER defined this module can't be linked
+// with anything else that defines an ADC_vect handler (for example the
+// dc_motor.h interface with DC_MOTOR_USE_CONTROL_LOOP defined), whether
+// or not the scanner is ever started.  While the scanner is running it
+// also owns the ADC, so adc_read_raw() and friends must not be used
+// (lcd_keypad_scanner_stop() gives the ADC back).
+
+#ifdef LCD_KEYPAD_USE_SCANNER
+
+// Approximate interval between scans, in milliseconds.  This is fixed by the
+// ADC clock rate that adc.h uses: a conversion takes 13 ADC clock cycles, and
+// only every LCD_KEYPAD_SCAN_CONVERSIONS conversion gets looked at.
+#define LCD_KEYPAD_SCAN_CONVERSIONS 10
+#define LCD_KEYPAD_SCAN_PERIOD_MS 1
+
+// Timing parameters for the scanner (in milliseconds).
+#ifndef LCD_KEYPAD_DEBOUNCE_MS
+#  define LCD_KEYPAD_DEBOUNCE_MS 20
+#endif
+#ifndef LCD_KEYPAD_REPEAT_DELAY_MS
+#  define LCD_KEYPAD_REPEAT_DELAY_MS 600
+#endif
+#ifndef LCD_KEYPAD_REPEAT_INTERVAL_MS
+#  define LCD_KEYPAD_REPEAT_INTERVAL_MS 100
+#endif
+#ifndef LCD_KEYPAD_LONG_PRESS_MS
+#  define LCD_KEYPAD_LONG_PRESS_MS 1500
+#endif
+
+// Number of events the scanner queue can hold.  If the queue is full, new
+// events are discarded.
+#ifndef LCD_KEYPAD_EVENT_QUEUE_SIZE
+#  define LCD_KEYPAD_EVENT_QUEUE_SIZE 8
+#endif
+
+typedef enum {
+  LCD_KEYPAD_EVENT_PRESS,
+  LCD_KEYPAD_EVENT_REPEAT,
+  LCD_KEYPAD_EVENT_LONG_PRESS,
+  LCD_KEYPAD_EVENT_RELEASE
+} lcd_keypad_event_type_t;
+
+typedef struct {
+  lcd_keypad_event_type_t type;
+  lcd_keypad_button_t button;
+} lcd_keypad_event_t;
+
+// Start the background scanner.  The event queue starts out empty.
+// lcd_keypad_init() must have been called first.  Interrupts are enabled
+// globally (with sei()) by this function.
+void
+lcd_keypad_scanner_start (void);
+
+// Stop the background scanner and return the ADC to normal polled
+// operation.  Any events still in the queue remain available.
+void
+lcd_keypad_scanner_stop (void);
+
+// If there's an event in the scanner queue, remove it, copy it to *event,
+// and return TRUE, otherwise return FALSE.
+uint8_t
+lcd_keypad_get_event (lcd_keypad_event_t *event);
+
+// State of a value being edited with lcd_keypad_edit_value_start() and
+// lcd_keypad_edit_value_poll().  Clients shouldn't touch the fields.
+typedef struct {
+  double *value;
+  double step;
+} lcd_keypad_value_editor_t;
+
+// Begin editing the named value, as lcd_keypad_set_value() does, but
+// return right away.  The display is drawn using the framebuffer interface
+// from lcd.h (without clearing the display), and the scanner must be
+// running.
+void
+lcd_keypad_edit_value_start (
+    lcd_keypad_value_editor_t *editor,
+    const char *name,
+    double *value,
+    double step );
+
+// Process any events waiting in the scanner queue: up and down button
+// presses and repeats change *value by step, and the display is updated.
+// Returns LCD_KEYPAD_BUTTON_NONE if editing should continue, or the button
+// that ended it (right, left, or select, once it's been released).  Events
+// after the one that ended editing are left in the queue.  This never
+// blocks, so it can be called from a main loop that has other things to do.
+lcd_keypad_button_t
+lcd_keypad_edit_value_poll (lcd_keypad_value_editor_t *editor);
+
+#endif // LCD_KEYPAD_USE_SCANNER
+
 // FIXXME: should have method to get strings and maybe some specialized
 // methods to get things like email addresses, IP addresses, etc.
 
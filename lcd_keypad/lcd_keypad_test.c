@@ -105,5 +105,69 @@ main (void)
   
   // }}}1
 
+#ifdef LCD_KEYPAD_USE_SCANNER
+
+  // Test the background scanner.
+  // {{{1
+
+  lcd_clear ();
+  lcd_home ();
+  lcd_write_string ("Will now test");
+  lcd_set_cursor_position (0, 1);
+  lcd_write_string ("scanner events");
+  _delay_ms (transition_message_time_ms);
+
+  lcd_keypad_scanner_start ();
+
+  // Show events as they arrive, together with a count of main loop
+  // iterations to show that the main loop isn't stalled.  Holding a button
+  // down should produce a press, some repeats, a long press, more repeats,
+  // and finally a release.
+  const uint8_t events_required = 30;
+  uint8_t events_seen = 0;
+  uint16_t iterations = 0;
+  lcd_clear ();
+  lcd_fb_clear ();
+  while ( events_seen < events_required ) {
+    lcd_keypad_event_t event;
+    if ( lcd_keypad_get_event (&event) ) {
+      events_seen++;
+      const char *event_names[] = { "PRESS", "REPEAT", "LONG", "RELEASE" };
+      lcd_keypad_button_name (event.button, button_name);
+      lcd_fb_set_cursor_position (0, 0);
+      lcd_fb_printf ("%-7s %-8s", event_names[event.type], button_name);
+    }
+    lcd_fb_set_cursor_position (0, 1);
+    lcd_fb_printf ("%2hhu left %5u", events_required - events_seen, iterations);
+    lcd_refresh ();
+    iterations++;
+  }
+
+  // Test the non-blocking value editor.  The iteration count in the top
+  // right corner should keep going while the value is being edited.
+  the_answer = 42.0;
+  lcd_keypad_value_editor_t editor;
+  lcd_keypad_edit_value_start (&editor, "answer", &the_answer, 1.0);
+  iterations = 0;
+  do {
+    lcd_fb_set_cursor_position (11, 0);
+    lcd_fb_printf ("%5u", iterations++);
+    button = lcd_keypad_edit_value_poll (&editor);
+    lcd_refresh ();
+  } while ( button == LCD_KEYPAD_BUTTON_NONE );
+
+  lcd_keypad_scanner_stop ();
+
+  lcd_clear ();
+  lcd_home ();
+  lcd_write_string ("Edited answer:");
+  lcd_set_cursor_position (0, 1);
+  lcd_printf_P (PSTR (LCD_KEYPAD_VALUE_DISPLAY_FORMAT), the_answer);
+  _delay_ms (transition_message_time_ms);
+
+  // }}}1
+
+#endif
+
   return 0;
 }
@@ -2,7 +2,12 @@
 // the 1-wire protocol.  These values are (necessarily) identical in the
 // one_wire_master and one_wire_slave modules, so they get their own header.
 
-#include <util/delay.h>
+// The constants in this header are also useful in programs for the
+// development machine (see one_wire_master_host_test.c), where only the
+// macros that actually touch the line are unusable.
+#ifdef __AVR__
+#  include <util/delay.h>
+#endif
 
 #ifndef ONE_WIRE_COMMON_H
 #define ONE_WIRE_COMMON_H
@@ -20,6 +25,19 @@
 #define OWC_TICK_DELAY_I  70
 #define OWC_TICK_DELAY_J 410
 
+// Overdrive speed versions of the above, from the same table.  These are
+// in the same (1 us) ticks, so some of them are fractional.
+#define OWC_OVERDRIVE_TICK_DELAY_A  1.0
+#define OWC_OVERDRIVE_TICK_DELAY_B  7.5
+#define OWC_OVERDRIVE_TICK_DELAY_C  7.5
+#define OWC_OVERDRIVE_TICK_DELAY_D  2.5
+#define OWC_OVERDRIVE_TICK_DELAY_E  1.0
+#define OWC_OVERDRIVE_TICK_DELAY_F  7.0
+#define OWC_OVERDRIVE_TICK_DELAY_G  2.5
+#define OWC_OVERDRIVE_TICK_DELAY_H 70.0
+#define OWC_OVERDRIVE_TICK_DELAY_I  8.5
+#define OWC_OVERDRIVE_TICK_DELAY_J 40.0
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -44,8 +62,8 @@
 
 #define OWC_SAMPLE_LINE(pin) DIO_READ (pin)
 
-// We support only standard speed, not overdrive speed, so we make our tick
-// 1 us.
+// Our tick is 1 us.  This is convenient for standard speed.  The overdrive
+// speed delays are then fractional numbers of ticks.
 #define OWC_TICK_TIME_IN_US 1.0
 
 // WARNING: the argument to this macro must be a valid constant double
@@ -69,21 +87,35 @@
 #define OWC_SKIP_ROM_COMMAND     0xCC
 #define OWC_ALARM_SEARCH_COMMAND 0xEC
 
+// These ROM commands work like OWC_SKIP_ROM_COMMAND and
+// OWC_MATCH_ROM_COMMAND, except that they switch the addressed slaves which
+// support overdrive speed into overdrive speed (starting immediately after
+// the command byte).  Slaves stay at overdrive speed until they get a
+// standard speed reset pulse.  Slaves that don't support overdrive speed
+// ignore everything after these commands until the next reset pulse.  See
+// for example the DS2431 datasheet "ROM FUNCTION COMMANDS" section.
+#define OWC_OVERDRIVE_SKIP_ROM_COMMAND  0x3C
+#define OWC_OVERDRIVE_MATCH_ROM_COMMAND 0x69
+
 // ROM commands perform 1-wire search and addressing operations and are
 // effectively part of the 1-wire protocol, as opposed to other commands
 // which particular slave types may define to do particular things.
 #define OWC_IS_ROM_COMMAND(command) \
-  ( command ==   OWC_SEARCH_ROM_COMMAND || \
-    command ==     OWC_READ_ROM_COMMAND || \
-    command ==    OWC_MATCH_ROM_COMMAND || \
-    command ==     OWC_SKIP_ROM_COMMAND || \
-    command == OWC_ALARM_SEARCH_COMMAND    )
+  ( command ==          OWC_SEARCH_ROM_COMMAND || \
+    command ==            OWC_READ_ROM_COMMAND || \
+    command ==           OWC_MATCH_ROM_COMMAND || \
+    command ==            OWC_SKIP_ROM_COMMAND || \
+    command ==        OWC_ALARM_SEARCH_COMMAND || \
+    command ==  OWC_OVERDRIVE_SKIP_ROM_COMMAND || \
+    command == OWC_OVERDRIVE_MATCH_ROM_COMMAND    )
 
 // These ROM commands are valid ways to start a transaction (see
 // DS18B20_datasheed.pdf "TRANSACTION SEQUENCE" section).
 #define OWC_IS_TRANSACTION_INITIATING_ROM_COMMAND(command) \
-  ( command ==  OWC_READ_ROM_COMMAND || \
-    command == OWC_MATCH_ROM_COMMAND || \
-    command ==  OWC_SKIP_ROM_COMMAND    )
+  ( command ==            OWC_READ_ROM_COMMAND || \
+    command ==           OWC_MATCH_ROM_COMMAND || \
+    command ==            OWC_SKIP_ROM_COMMAND || \
+    command ==  OWC_OVERDRIVE_SKIP_ROM_COMMAND || \
+    command == OWC_OVERDRIVE_MATCH_ROM_COMMAND    )
 
 #endif  // ONE_WIRE_COMMON_H
@@ -1,10 +1,14 @@
 // Implementation of the interface described in one_wire_master.h.
 
 #include <assert.h>
-#include <avr/pgmspace.h>
+#ifdef __AVR__
+#  include <avr/io.h>
+#  include <avr/pgmspace.h>
+#  include <avr/power.h>
+#  include <util/crc16.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
-#include <util/crc16.h>
 
 #include "dio.h"
 #include "one_wire_common.h"
@@ -36,6 +40,35 @@ owm_result_as_string (owm_result_t result, char *buf)
 
 #endif
 
+// TRUE iff we're currently using overdrive speed.
+static uint8_t overdrive = FALSE;
+
+void
+owm_set_speed (owm_speed_t speed)
+{
+#ifdef OWM_USE_UART_BACKEND
+  // The UART backend can't generate overdrive speed slots.
+  assert (speed == OWM_SPEED_STANDARD);
+#endif
+
+  overdrive = (speed == OWM_SPEED_OVERDRIVE);
+}
+
+owm_speed_t
+owm_speed (void)
+{
+  return overdrive ? OWM_SPEED_OVERDRIVE : OWM_SPEED_STANDARD;
+}
+
+#if ! defined (__AVR__)
+
+// When this file is compiled for the development machine (by the host_test
+// target, see one_wire_master_host_test.c), owm_init(), owm_touch_reset(),
+// owm_write_bit(), and owm_read_bit() are supplied by the simulated bus in
+// the test driver, so everything above the bit level gets tested.
+
+#elif ! defined (OWM_USE_UART_BACKEND)
+
 // Here we support use of the internal pull-up on the IO pin, if requested.
 // This may be convenient for some cases where the wires are short.  However,
 // the internal pull-up is much weaker than the 4.7 kohm pull-up 1-wire
@@ -59,6 +92,71 @@ owm_init (void)
   RELEASE_LINE ();
 }
 
+#else
+
+// UART backend (see Maxim Application Note 214, "Using a UART to Implement
+// a 1-Wire Bus Master").  The USART0 TX and RX lines are both connected to
+// the bus (TX through an open-drain buffer), so everything we send is also
+// received, except where slaves pull the bus low.  At 9600 baud, the start
+// bit and the low bits of 0xF0 make a reset pulse of about 520 us, and a
+// presence pulse corrupts the high bits that we receive back.  At 115200
+// baud, the start bit alone (about 8.7 us) makes a write one or read slot
+// and the start bit plus a 0x00 byte makes a write zero slot.  During a read
+// slot, a slave that is sending a zero holds the bus low long enough to
+// corrupt the low bits that come back.  The USART does all the timing, so
+// interrupts don't disturb slots.  Note that we always use double-speed
+// mode, since that gives the best baud rate accuracy for these particular
+// rates at the usual clock frequencies.
+
+#  define RESET_BAUD 9600
+#  define SLOT_BAUD  115200
+
+// UBRR value giving (approximately) the given baud rate in double-speed mode.
+#  define DOUBLE_SPEED_UBRR(baud) \
+  ((F_CPU + 4UL * (baud)) / (8UL * (baud)) - 1)
+
+#  define RESET_BYTE           0xF0
+#  define WRITE_ONE_READ_BYTE  0xFF
+#  define WRITE_ZERO_BYTE      0x00
+
+static void
+set_ubrr (uint16_t ubrr)
+{
+  UBRR0H = ubrr >> BITS_PER_BYTE;
+  UBRR0L = ubrr;
+}
+
+static uint8_t
+uart_touch (uint8_t data)
+{
+  // Send data, and return whatever comes back over the loopback.
+
+  // Discard anything left in the receiver.
+  while ( UCSR0A & _BV (RXC0) ) {
+    (void) UDR0;
+  }
+
+  loop_until_bit_is_set (UCSR0A, UDRE0);
+  UDR0 = data;
+  loop_until_bit_is_set (UCSR0A, RXC0);
+
+  return UDR0;
+}
+
+void
+owm_init (void)
+{
+  power_usart0_enable ();   // Ensure USART0 not shut down to save power
+
+  UCSR0A = _BV (U2X0);
+  UCSR0B = _BV (TXEN0) | _BV (RXEN0);   // Enable TX/RX
+  UCSR0C = _BV (UCSZ01) | _BV (UCSZ00);   // 8N1 frames
+  set_ubrr (DOUBLE_SPEED_UBRR (SLOT_BAUD));
+}
+
+#endif
+
+
 owm_result_t
 owm_scan_bus (uint8_t ***rom_ids_ptr)
 {
@@ -125,6 +223,31 @@ owm_free_rom_ids_list (uint8_t **rom_ids)
   free (rom_ids);
 }
 
+owm_result_t
+owm_scan_bus_into (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t max_count, uint8_t *count )
+{
+  uint8_t crid[OWC_ID_SIZE_BYTES];   // Current ROM ID
+
+  *count = 0;
+
+  owm_result_t sfr = owm_first (crid);   // Search Function Result
+  while ( sfr == OWM_RESULT_SUCCESS ) {
+    if ( *count == max_count ) {
+      return OWM_RESULT_TOO_MANY_SLAVES;
+    }
+    memcpy (rom_ids[(*count)++], crid, OWC_ID_SIZE_BYTES);
+    sfr = owm_next (crid);
+  }
+
+  if ( *count > 0 && sfr == OWM_RESULT_NO_SUCH_SLAVE ) {
+    // We expect to eventually hit the end of the list, so this is success
+    return OWM_RESULT_SUCCESS;
+  }
+
+  return sfr;
+}
+
 owm_result_t
 owm_start_transaction (uint8_t rom_cmd, uint8_t *rom_id, uint8_t function_cmd)
 {
@@ -135,12 +258,28 @@ owm_start_transaction (uint8_t rom_cmd, uint8_t *rom_id, uint8_t function_cmd)
     return OWM_RESULT_ERROR_GOT_ROM_COMMAND_INSTEAD_OF_FUNCTION_COMMAND;
   }
 
+  uint8_t const odc   // OverDrive Command
+    = ( rom_cmd == OWC_OVERDRIVE_SKIP_ROM_COMMAND ||
+        rom_cmd == OWC_OVERDRIVE_MATCH_ROM_COMMAND );
+
+  // The overdrive commands must be sent at standard speed.  The standard
+  // speed reset pulse returns any slaves already at overdrive speed to
+  // standard speed, so they can hear them.
+  if ( odc ) {
+    owm_set_speed (OWM_SPEED_STANDARD);
+  }
+
   if ( ! owm_touch_reset () ) {
     return OWM_RESULT_DID_NOT_GET_PRESENCE_PULSE;
   }
 
   owm_write_byte (rom_cmd);
 
+  // Slaves switch to overdrive speed right after the command byte.
+  if ( odc ) {
+    owm_set_speed (OWM_SPEED_OVERDRIVE);
+  }
+
   switch ( rom_cmd ) {
 
     case OWC_READ_ROM_COMMAND:
@@ -162,12 +301,14 @@ owm_start_transaction (uint8_t rom_cmd, uint8_t *rom_id, uint8_t function_cmd)
       }
 
     case OWC_MATCH_ROM_COMMAND:
+    case OWC_OVERDRIVE_MATCH_ROM_COMMAND:
       for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
         owm_write_byte (rom_id[ii]);
       }
       break;
 
     case OWC_SKIP_ROM_COMMAND:
+    case OWC_OVERDRIVE_SKIP_ROM_COMMAND:
       break;
 
     default:
@@ -180,17 +321,36 @@ owm_start_transaction (uint8_t rom_cmd, uint8_t *rom_id, uint8_t function_cmd)
   return OWM_RESULT_SUCCESS;
 }
 
+#if ! defined (__AVR__)
+
+// Supplied by the test driver (see the comments near owm_init() above).
+
+#elif ! defined (OWM_USE_UART_BACKEND)
+
 uint8_t
 owm_touch_reset (void)
 {
-  TICK_DELAY (OWC_TICK_DELAY_G);
-  DRIVE_LINE_LOW ();
-  TICK_DELAY (OWC_TICK_DELAY_H);
-  RELEASE_LINE ();
-  TICK_DELAY (OWC_TICK_DELAY_I);
-  // Look for presence pulse from slave
-  uint8_t result = ! SAMPLE_LINE ();
-  TICK_DELAY (OWC_TICK_DELAY_J); // Complete the reset sequence recovery
+  uint8_t result;
+
+  if ( LIKELY (! overdrive) ) {
+    TICK_DELAY (OWC_TICK_DELAY_G);
+    DRIVE_LINE_LOW ();
+    TICK_DELAY (OWC_TICK_DELAY_H);
+    RELEASE_LINE ();
+    TICK_DELAY (OWC_TICK_DELAY_I);
+    // Look for presence pulse from slave
+    result = ! SAMPLE_LINE ();
+    TICK_DELAY (OWC_TICK_DELAY_J); // Complete the reset sequence recovery
+  }
+  else {
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_G);
+    DRIVE_LINE_LOW ();
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_H);
+    RELEASE_LINE ();
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_I);
+    result = ! SAMPLE_LINE ();
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_J);
+  }
 
   return result; // Return sample presence pulse result
 }
@@ -200,37 +360,94 @@ owm_write_bit (uint8_t value)
 {
   // Send a 1-Wire write bit. Provide recovery time.
 
-  if ( value ) {
-    // Write '1' bit
+  if ( LIKELY (! overdrive) ) {
+    if ( value ) {
+      // Write '1' bit
+      DRIVE_LINE_LOW ();
+      TICK_DELAY (OWC_TICK_DELAY_A);
+      RELEASE_LINE ();
+      TICK_DELAY (OWC_TICK_DELAY_B); // Complete the time slot and recovery
+    }
+    else {
+      // Write '0' bit
+      DRIVE_LINE_LOW ();
+      TICK_DELAY (OWC_TICK_DELAY_C);
+      RELEASE_LINE ();
+      TICK_DELAY (OWC_TICK_DELAY_D);
+    }
+  }
+  else {
+    if ( value ) {
+      DRIVE_LINE_LOW ();
+      TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_A);
+      RELEASE_LINE ();
+      TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_B);
+    }
+    else {
+      DRIVE_LINE_LOW ();
+      TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_C);
+      RELEASE_LINE ();
+      TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_D);
+    }
+  }
+}
+
+uint8_t
+owm_read_bit (void)
+{
+  // Read a bit from the 1-Wire bus and return it. Provide recovery time.
+
+  uint8_t result;
+
+  if ( LIKELY (! overdrive) ) {
     DRIVE_LINE_LOW ();
     TICK_DELAY (OWC_TICK_DELAY_A);
     RELEASE_LINE ();
-    TICK_DELAY (OWC_TICK_DELAY_B); // Complete the time slot and recovery
+    TICK_DELAY (OWC_TICK_DELAY_E);
+    result = SAMPLE_LINE ();   // Sample bit value from slave
+    TICK_DELAY (OWC_TICK_DELAY_F); // Complete the time slot and recovery
   }
   else {
-    // Write '0' bit
     DRIVE_LINE_LOW ();
-    TICK_DELAY (OWC_TICK_DELAY_C);
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_A);
     RELEASE_LINE ();
-    TICK_DELAY (OWC_TICK_DELAY_D);
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_E);
+    result = SAMPLE_LINE ();
+    TICK_DELAY (OWC_OVERDRIVE_TICK_DELAY_F);
   }
+
+  return result;
 }
 
+#else
+
 uint8_t
-owm_read_bit (void)
+owm_touch_reset (void)
 {
-  // Read a bit from the 1-Wire bus and return it. Provide recovery time.
+  // Note that the receive complete wait in uart_touch() ensures the frame
+  // is finished before we change the baud rate.
+  set_ubrr (DOUBLE_SPEED_UBRR (RESET_BAUD));
+  uint8_t echo = uart_touch (RESET_BYTE);
+  set_ubrr (DOUBLE_SPEED_UBRR (SLOT_BAUD));
 
-  DRIVE_LINE_LOW ();
-  TICK_DELAY (OWC_TICK_DELAY_A);
-  RELEASE_LINE ();
-  TICK_DELAY (OWC_TICK_DELAY_E);
-  uint8_t result = SAMPLE_LINE ();   // Sample bit value from slave
-  TICK_DELAY (OWC_TICK_DELAY_F); // Complete the time slot and recovery
+  return echo != RESET_BYTE;   // Presence pulse corrupts the echo
+}
 
-  return result;
+void
+owm_write_bit (uint8_t value)
+{
+  uart_touch (value ? WRITE_ONE_READ_BYTE : WRITE_ZERO_BYTE);
 }
 
+uint8_t
+owm_read_bit (void)
+{
+  // A slave sending a zero holds the line low past the first data bit.
+  return uart_touch (WRITE_ONE_READ_BYTE) == WRITE_ONE_READ_BYTE;
+}
+
+#endif
+
 void
 owm_write_byte (uint8_t data)
 {
@@ -1,6 +1,7 @@
 // One-wire master interface (software interface -- requires only one IO pin)
 //
 // Test driver: one_wire_master_test.c    Implementation: one_wire_master.c
+// Host test driver: one_wire_master_host_test.c
 //
 // If you're new to 1-wire you should first read the entire
 // Maxim_DS18B20_datasheet.pdf.  Its hard to use 1-wire without at least a
@@ -20,7 +21,7 @@
 #include "dio.h"
 #include "one_wire_common.h"
 
-#ifndef OWM_PIN
+#if ! defined (OWM_PIN) && ! defined (OWM_USE_UART_BACKEND)
 #  error OWM_PIN not defined (it must be explicitly set to one of \
          the DIO_PIN_* tuple macros before this header is included)
 #endif
@@ -54,6 +55,10 @@
   /* this.                                                                 */ \
   X (OWM_RESULT_NO_SUCH_SLAVE)                                                \
                                                                               \
+  /* owm_scan_bus_into() found more slaves than would fit in the table     */ \
+  /* provided by the caller.                                               */ \
+  X (OWM_RESULT_TOO_MANY_SLAVES)                                              \
+                                                                              \
   /* Got one values for both a bit and its compliment, in a situation      */ \
   /* where this shouldn't happen (i.e. not during the first bit of an      */ \
   /* owm_first_alarmed() call).  Note that when no slaves are present,     */ \
@@ -111,6 +116,20 @@ owm_result_as_string (owm_result_t result, char *buf);
 // is defined at compile-time, the internal pull-up will be enabled
 // on the pin when it's configured as an input.  See the comments near
 // OWM_USE_INTERNAL_PULLUP in one_wire_master.c for details.
+//
+// If OWM_USE_UART_BACKEND is defined at compile-time, OWM_PIN isn't used.
+// Instead, time slots are generated in hardware by USART0, using the
+// technique described in Maxim Application Note 214 ("Using a UART to
+// Implement a 1-Wire Bus Master"), and this function sets up USART0.  This
+// requires an external interface circuit: the TX pin (DIO_PIN_DIGITAL_1)
+// must drive the bus through an open-drain buffer (e.g. a small N-channel
+// MOSFET, which inverts, so the TX line must be inverted first, or a
+// non-inverting open-drain buffer used), and the RX pin (DIO_PIN_DIGITAL_0)
+// must be connected directly to the bus.  Since slot timing then doesn't
+// depend on software, interrupts can't corrupt slots.  Note that USART0 is
+// the only USART on the ATmega328P, so this is incompatible with term_io.h
+// and uart.h (and with the serial bootloader, unless the interface circuit
+// is disconnected while programming).
 void
 owm_init (void);
 
@@ -127,6 +146,26 @@ owm_scan_bus (uint8_t ***rom_ids_ptr);
 void
 owm_free_rom_ids_list (uint8_t **rom_ids);
 
+// Like owm_scan_bus(), but the ROM IDs are stored in the caller-provided
+// table rom_ids, which must have room for max_count IDs, and no heap memory
+// is used.  The number of IDs stored is put in *count.  If at least one
+// slave is found and no errors occur, then OWM_RESULT_SUCCESS is returned.
+// If more than max_count slaves are present, OWM_RESULT_TOO_MANY_SLAVES is
+// returned (and the first max_count IDs found are in the table).  Otherwise,
+// a non-zero result code is returned, and the contents of the table are
+// undefined.  Usage looks like this:
+//
+//   uint8_t rom_ids[MAX_SLAVES][OWC_ID_SIZE_BYTES];
+//   uint8_t slave_count;
+//   owm_result_t result
+//     = owm_scan_bus_into (rom_ids, MAX_SLAVES, &slave_count);
+//
+// This avoids the heap fragmentation and allocation overhead of
+// owm_scan_bus(), which may matter on busy buses or in long-running programs.
+owm_result_t
+owm_scan_bus_into (
+    uint8_t (*rom_ids)[OWC_ID_SIZE_BYTES], uint8_t max_count, uint8_t *count );
+
 // Start the transaction sequence as described in the
 // Maxim_DS18B20_datasheet.pdf page 10, "TRANSACTION SEQUENCE" section.
 // This routine performs steps 1, 2, and the first half of 3 from this
@@ -136,12 +175,19 @@ owm_free_rom_ids_list (uint8_t **rom_ids);
 // Arguments:
 //
 //   rom_cmd          May be OWC_READ_ROM_COMMAND (if there's only one slave on
-//                    the bus), OWC_MATCH_ROM_COMMAND, or OWC_SKIP_ROM_COMMAND
+//                    the bus), OWC_MATCH_ROM_COMMAND, OWC_SKIP_ROM_COMMAND,
+//                    OWC_OVERDRIVE_MATCH_ROM_COMMAND, or
+//                    OWC_OVERDRIVE_SKIP_ROM_COMMAND.  For the overdrive
+//                    variants, the reset pulse and command byte are sent at
+//                    standard speed, and then owm_set_speed() is used to
+//                    switch to overdrive speed (so the rest of this
+//                    transaction, and all later ones until owm_set_speed()
+//                    is used again, happen at overdrive speed)
 //
 //   rom_id           For OWC_READ_ROM_COMMAND, this contains the read ROM ID
-//                    on return.  For OWC_MATCH_ROM_COMMAND, it must contain
-//                    the ROM ID being addressed.  For OWC_SKIP_ROM_COMMAND it
-//                    is unused (and may be NULL)
+//                    on return.  For OWC_MATCH_ROM_COMMAND (or its overdrive
+//                    variant), it must contain the ROM ID being addressed.
+//                    For OWC_SKIP_ROM_COMMAND it is unused (and may be NULL)
 //
 //   function_cmd     The function command to send.  This must not be a ROM
 //                    command
@@ -162,6 +208,31 @@ owm_free_rom_ids_list (uint8_t **rom_ids);
 owm_result_t
 owm_start_transaction (uint8_t rom_cmd, uint8_t *rom_id, uint8_t function_cmd);
 
+// Bus speeds.
+typedef enum {
+  OWM_SPEED_STANDARD,
+  OWM_SPEED_OVERDRIVE
+} owm_speed_t;
+
+// Set the speed used by all the functions in this interface (the default is
+// OWM_SPEED_STANDARD).  Note that this changes only what the master does.
+// Slaves must be switched to overdrive speed using one of the overdrive ROM
+// commands (see owm_start_transaction()), and are switched back to standard
+// speed by the first standard speed reset pulse (i.e. the first call to
+// owm_touch_reset() after owm_set_speed (OWM_SPEED_STANDARD)).  Only some
+// slaves support overdrive speed (the DS18B20 doesn't, for example, and
+// neither does the one_wire_slave.h interface).  Overdrive speed time slots
+// are only about 10 us long and are timed in software, so any interrupt
+// that occurs during a slot will probably corrupt it: it's probably a good
+// idea to disable interrupts during overdrive transactions.  Overdrive speed
+// isn't available with OWM_USE_UART_BACKEND.
+void
+owm_set_speed (owm_speed_t speed);
+
+// Return the speed currently in use.
+owm_speed_t
+owm_speed (void);
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Reset and Individual Bit Functions
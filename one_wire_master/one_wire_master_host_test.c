@@ -0,0 +1,496 @@
+// Host test driver for the bus search functions in one_wire_master.c (see
+// the host_test target in generic.mk).
+//
+// The real one_wire_master.c is compiled for the host (see
+// one_wire_master_host_test.h), with the bit-level functions it normally
+// implements itself (owm_touch_reset(), owm_write_bit(), and owm_read_bit())
+// supplied here by a simulated bus full of slaves.  The slaves answer
+// the SEARCH ROM command bit by bit as real ones do: each read slot is
+// the wired-AND of the bits (or complement bits) of all the slaves still
+// participating, and slaves whose bit differs from the one the master
+// writes drop out.  This lets owm_scan_bus_into() and friends be tried on
+// buses with dozens of slaves whose IDs share long prefixes, which would
+// be tedious to build in real life.
+//
+// The IDs found must be exactly the IDs on the bus, each found once, in
+// the order the search algorithm visits them (increasing, comparing the
+// bits in the order they go over the wire), using exactly one search pass
+// per slave.  When the table is too small, OWM_RESULT_TOO_MANY_SLAVES must
+// result, with the table holding the first IDs in search order.
+//
+// This program exits with a non-zero status after printing a description
+// of the first failure, or prints a summary line per test and exits with
+// status zero if everything passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "one_wire_master_host_test.h"
+#include "host_test_util.h"
+#include "one_wire_master.h"
+
+// Largest number of slaves we ever put on the simulated bus.
+#define MAX_SLAVES 64
+
+// Length of slave ROM IDs, in bits
+#define ID_BIT_COUNT (OWC_ID_SIZE_BYTES * BITS_PER_BYTE)
+
+// Family code used for most simulated slaves (that of the DS18B20).
+#define DS18B20_FAMILY_CODE 0x28
+
+typedef struct {
+  uint8_t id[OWC_ID_SIZE_BYTES];
+  uint8_t selected;   // TRUE iff still participating in the current search
+} slave_t;
+
+static slave_t slaves[MAX_SLAVES];
+static uint8_t slave_count;
+
+// What the slaves on the simulated bus are doing.
+typedef enum {
+  BUS_STATE_IDLE,                // Waiting for a reset pulse
+  BUS_STATE_RECEIVING_COMMAND,   // Getting the ROM command bits
+  BUS_STATE_SEARCHING            // Taking part in a SEARCH ROM command
+} bus_state_t;
+
+static bus_state_t bus_state;
+static uint8_t command;               // ROM command being received
+static uint8_t command_bit_count;     // Bits of command received so far
+static uint8_t search_bit_number;     // ID bit being searched (from 0)
+static uint8_t search_slot;           // 0 for bit, 1 complement, 2 direction
+
+// Number of reset pulses the master has sent (which for scans is the
+// number of search passes).
+static uint32_t reset_count;
+
+static uint8_t
+id_bit (uint8_t const *id, uint8_t bit_number)
+{
+  // Return bit bit_number of id, counting in the order bits go over the
+  // wire (least significant bit of byte 0 first).
+
+  return (id[bit_number / BITS_PER_BYTE] >> (bit_number % BITS_PER_BYTE)) & 1;
+}
+
+static int
+compare_ids_in_search_order (void const *a, void const *b)
+{
+  for ( uint8_t ii = 0 ; ii < ID_BIT_COUNT ; ii++ ) {
+    uint8_t a_bit = id_bit (a, ii), b_bit = id_bit (b, ii);
+    if ( a_bit != b_bit ) {
+      return a_bit - b_bit;
+    }
+  }
+
+  return 0;
+}
+
+static char const *
+id_as_string (uint8_t const *id)
+{
+  // Return a static string representation of id, in byte order.
+
+  static char buf[2 * OWC_ID_SIZE_BYTES + 1];
+
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
+    sprintf (buf + 2 * ii, "%02x", id[ii]);
+  }
+
+  return buf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Simulated Bus
+//
+// These are the functions that one_wire_master.c expects to find here when
+// it's compiled for the host (see the comments near owm_init() there).
+//
+
+void
+owm_init (void)
+{
+  bus_state = BUS_STATE_IDLE;
+}
+
+uint8_t
+owm_touch_reset (void)
+{
+  reset_count++;
+
+  bus_state = BUS_STATE_RECEIVING_COMMAND;
+  command = 0;
+  command_bit_count = 0;
+
+  return slave_count > 0;   // Presence pulse
+}
+
+void
+owm_write_bit (uint8_t value)
+{
+  switch ( bus_state ) {
+
+    case BUS_STATE_IDLE:
+      break;
+
+    case BUS_STATE_RECEIVING_COMMAND:
+      command |= (value ? 1 : 0) << command_bit_count++;
+      if ( command_bit_count == BITS_PER_BYTE ) {
+        if ( command == OWC_SEARCH_ROM_COMMAND ) {
+          for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+            slaves[ii].selected = TRUE;
+          }
+          bus_state = BUS_STATE_SEARCHING;
+          search_bit_number = 0;
+          search_slot = 0;
+        }
+        else {
+          // No other ROM commands are simulated, so the slaves go quiet
+          bus_state = BUS_STATE_IDLE;
+        }
+      }
+      break;
+
+    case BUS_STATE_SEARCHING:
+      if ( search_slot != 2 ) {
+        fail (
+            "master wrote a bit during search slot %u of ID bit %u",
+            search_slot,
+            search_bit_number );
+      }
+      for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+        if ( id_bit (slaves[ii].id, search_bit_number) != (value ? 1 : 0) ) {
+          slaves[ii].selected = FALSE;
+        }
+      }
+      search_slot = 0;
+      if ( ++search_bit_number == ID_BIT_COUNT ) {
+        bus_state = BUS_STATE_IDLE;
+      }
+      break;
+  }
+}
+
+uint8_t
+owm_read_bit (void)
+{
+  if ( bus_state != BUS_STATE_SEARCHING ) {
+    return 1;   // Nobody pulls the line low
+  }
+
+  if ( search_slot == 2 ) {
+    fail (
+        "master read a bit when it should have written the search direction "
+        "for ID bit %u",
+        search_bit_number );
+  }
+
+  // The line is only high if no participating slave holds it low
+  uint8_t line = 1;
+  for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+    if ( slaves[ii].selected ) {
+      uint8_t bit = id_bit (slaves[ii].id, search_bit_number);
+      line &= (search_slot == 0 ? bit : ! bit);
+    }
+  }
+  search_slot++;
+
+  return line;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Slave ID Generation
+//
+
+static void
+set_crc (uint8_t *id)
+{
+  // Set the CRC byte at the end of id to match the other bytes.
+
+  uint8_t crc = 0;
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES - 1 ; ii++ ) {
+    crc = _crc_ibutton_update (crc, id[ii]);
+  }
+  id[OWC_ID_SIZE_BYTES - 1] = crc;
+}
+
+static uint8_t
+on_bus (uint8_t const *id)
+{
+  for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+    if ( memcmp (slaves[ii].id, id, OWC_ID_SIZE_BYTES) == 0 ) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+add_slave (uint8_t const *id)
+{
+  if ( slave_count == MAX_SLAVES ) {
+    fail ("too many simulated slaves");
+  }
+
+  memcpy (slaves[slave_count++].id, id, OWC_ID_SIZE_BYTES);
+}
+
+static void
+populate_bus (uint8_t count)
+{
+  // Put count slaves with distinct IDs on the bus.  Most IDs share long
+  // prefixes with other IDs, since those make the search backtrack the
+  // most: after the first ID, each is made by taking an existing ID,
+  // flipping a serial number bit (usually a late one), and randomizing
+  // the bits after that.  A few have other family codes.
+
+  uint8_t const serial_first_bit = BITS_PER_BYTE;
+  uint8_t const serial_end_bit = ID_BIT_COUNT - BITS_PER_BYTE;
+
+  slave_count = 0;
+
+  while ( slave_count < count ) {
+    uint8_t id[OWC_ID_SIZE_BYTES];
+    if ( slave_count == 0 ) {
+      for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
+        id[ii] = random_uint32 ();
+      }
+      id[0] = DS18B20_FAMILY_CODE;
+    }
+    else {
+      memcpy (id, slaves[random_uint32 () % slave_count].id, sizeof (id));
+      // Pick the bit to flip, favoring the late ones
+      uint8_t serial_bits = serial_end_bit - serial_first_bit;
+      uint8_t offset = random_uint32 () % serial_bits;
+      if ( random_uint32 () % 2 ) {
+        offset = serial_bits - 1 - offset / 8;
+      }
+      uint8_t flip_bit = serial_first_bit + offset;
+      for ( uint8_t ii = flip_bit ; ii < serial_end_bit ; ii++ ) {
+        uint8_t new_bit
+          = (ii == flip_bit ? ! id_bit (id, ii) : random_uint32 () % 2);
+        id[ii / BITS_PER_BYTE] &= ~(1 << (ii % BITS_PER_BYTE));
+        id[ii / BITS_PER_BYTE] |= new_bit << (ii % BITS_PER_BYTE);
+      }
+      if ( random_uint32 () % 8 == 0 ) {
+        id[0] = 1 + random_uint32 () % UINT8_MAX;   // Never zero
+      }
+    }
+    set_crc (id);
+    if ( ! on_bus (id) ) {
+      add_slave (id);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Tests
+//
+
+static void
+check_scan (uint8_t max_count)
+{
+  // Scan the bus with a table that has room for max_count IDs, and check
+  // the results.
+
+  uint8_t expected[MAX_SLAVES][OWC_ID_SIZE_BYTES];
+  for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+    memcpy (expected[ii], slaves[ii].id, OWC_ID_SIZE_BYTES);
+  }
+  qsort (
+      expected, slave_count, OWC_ID_SIZE_BYTES, compare_ids_in_search_order );
+
+  // One more than needed, to catch writes past max_count
+  uint8_t rom_ids[MAX_SLAVES + 1][OWC_ID_SIZE_BYTES];
+  memset (rom_ids, 0xA5, sizeof (rom_ids));
+  uint8_t count = UINT8_MAX;
+  reset_count = 0;
+
+  owm_result_t result = owm_scan_bus_into (rom_ids, max_count, &count);
+
+  if ( slave_count == 0 ) {
+    if ( result != OWM_RESULT_DID_NOT_GET_PRESENCE_PULSE || count != 0 ) {
+      fail ("empty bus scan gave result %d and count %u", result, count);
+    }
+    return;
+  }
+
+  uint8_t expected_count;
+  if ( slave_count <= max_count ) {
+    if ( result != OWM_RESULT_SUCCESS ) {
+      fail (
+          "scan of %u slaves into table of %u gave result %d",
+          slave_count,
+          max_count,
+          result );
+    }
+    if ( reset_count != slave_count ) {
+      fail (
+          "scan of %u slaves took %lu search passes",
+          slave_count,
+          (unsigned long) reset_count );
+    }
+    expected_count = slave_count;
+  }
+  else {
+    if ( result != OWM_RESULT_TOO_MANY_SLAVES ) {
+      fail (
+          "scan of %u slaves into table of %u gave result %d instead of "
+          "OWM_RESULT_TOO_MANY_SLAVES",
+          slave_count,
+          max_count,
+          result );
+    }
+    expected_count = max_count;
+  }
+
+  if ( count != expected_count ) {
+    fail (
+        "scan of %u slaves into table of %u gave count %u",
+        slave_count,
+        max_count,
+        count );
+  }
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    if ( memcmp (rom_ids[ii], expected[ii], OWC_ID_SIZE_BYTES) != 0 ) {
+      char expected_string[2 * OWC_ID_SIZE_BYTES + 1];
+      strcpy (expected_string, id_as_string (expected[ii]));
+      fail (
+          "scan of %u slaves put ID %s at index %u, expected %s",
+          slave_count,
+          id_as_string (rom_ids[ii]),
+          ii,
+          expected_string );
+    }
+  }
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
+    if ( rom_ids[max_count][ii] != 0xA5 ) {
+      fail ("scan into table of %u wrote past its end", max_count);
+    }
+  }
+}
+
+static void
+check_scan_bus_agrees (void)
+{
+  // Check that owm_scan_bus() finds the same IDs as owm_scan_bus_into().
+
+  uint8_t rom_ids[MAX_SLAVES][OWC_ID_SIZE_BYTES];
+  uint8_t count;
+  owm_result_t result = owm_scan_bus_into (rom_ids, MAX_SLAVES, &count);
+
+  uint8_t **rom_ids_list;
+  if ( owm_scan_bus (&rom_ids_list) != result ) {
+    fail ("owm_scan_bus() and owm_scan_bus_into() results differ");
+  }
+  if ( result != OWM_RESULT_SUCCESS ) {
+    return;
+  }
+
+  for ( uint8_t ii = 0 ; ii <= count ; ii++ ) {
+    if ( ii == count ) {
+      if ( rom_ids_list[ii] != NULL ) {
+        fail ("owm_scan_bus() found more slaves than owm_scan_bus_into()");
+      }
+    }
+    else if ( rom_ids_list[ii] == NULL ||
+              memcmp (rom_ids_list[ii], rom_ids[ii], OWC_ID_SIZE_BYTES) ) {
+      fail ("owm_scan_bus() and owm_scan_bus_into() IDs differ");
+    }
+  }
+
+  owm_free_rom_ids_list (rom_ids_list);
+}
+
+static void
+check_verify (void)
+{
+  // Check that owm_verify() finds every slave, and no made-up ones.
+
+  for ( uint8_t ii = 0 ; ii < slave_count ; ii++ ) {
+    if ( owm_verify (slaves[ii].id) != OWM_RESULT_SUCCESS ) {
+      fail ("owm_verify() didn't find %s", id_as_string (slaves[ii].id));
+    }
+    uint8_t absent_id[OWC_ID_SIZE_BYTES];
+    memcpy (absent_id, slaves[ii].id, sizeof (absent_id));
+    absent_id[OWC_ID_SIZE_BYTES - 2] ^= 0x80;
+    set_crc (absent_id);
+    if ( ! on_bus (absent_id) &&
+         owm_verify (absent_id) != OWM_RESULT_NO_SUCH_SLAVE ) {
+      fail ("owm_verify() found absent %s", id_as_string (absent_id));
+    }
+  }
+}
+
+static void
+check_all (void)
+{
+  // Run all the checks on the current bus population.
+
+  check_scan (MAX_SLAVES);
+  check_scan (slave_count);
+  if ( slave_count > 0 ) {
+    check_scan (slave_count - 1);
+    check_scan (random_uint32 () % slave_count);
+    check_scan (0);
+  }
+  check_scan_bus_agrees ();
+  check_verify ();
+}
+
+int
+main (void)
+{
+  owm_init ();
+  random_state = 42;
+
+  test_name = "empty bus";
+  slave_count = 0;
+  check_all ();
+  printf ("%s: ok\n", test_name);
+
+  test_name = "single slave";
+  populate_bus (1);
+  check_all ();
+  printf ("%s: ok\n", test_name);
+
+  // IDs that differ only in their last serial number bit, or only in their
+  // first one, are the deepest and shallowest possible discrepancies
+  test_name = "extreme discrepancies";
+  slave_count = 0;
+  uint8_t id[OWC_ID_SIZE_BYTES] = { DS18B20_FAMILY_CODE, 0, 0, 0, 0, 0, 0, 0 };
+  for ( uint8_t ii = 0 ; ii < 2 ; ii++ ) {
+    for ( uint8_t jj = 0 ; jj < 2 ; jj++ ) {
+      id[1] = ii;
+      id[OWC_ID_SIZE_BYTES - 2] = jj << 7;
+      set_crc (id);
+      add_slave (id);
+    }
+  }
+  check_all ();
+  printf ("%s: ok\n", test_name);
+
+  test_name = "dozens of slaves";
+  populate_bus (48);
+  check_all ();
+  printf ("%s: ok\n", test_name);
+
+  test_name = "full bus";
+  populate_bus (MAX_SLAVES);
+  check_all ();
+  printf ("%s: ok\n", test_name);
+
+  test_name = "random buses";
+  uint16_t const random_bus_count = 500;
+  for ( uint16_t ii = 0 ; ii < random_bus_count ; ii++ ) {
+    populate_bus (1 + random_uint32 () % MAX_SLAVES);
+    check_all ();
+  }
+  printf ("%s: ok: %u buses\n", test_name, random_bus_count);
+
+  return EXIT_SUCCESS;
+}
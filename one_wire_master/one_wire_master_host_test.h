@@ -0,0 +1,51 @@
+// Stand-Ins Letting one_wire_master.c Compile on the Development Machine
+//
+// Host test driver: one_wire_master_host_test.c
+//
+// This header is force-included (with the compiler's -include option) when
+// one_wire_master.c is compiled for the host (see the Makefile).  It claims
+// the include guards of util.h and dio.h, which are AVR-only, and supplies
+// the few things one_wire_master.c needs from them (and from the avr-libc
+// headers it doesn't include on the host) instead.
+
+#ifndef ONE_WIRE_MASTER_HOST_TEST_H
+#define ONE_WIRE_MASTER_HOST_TEST_H
+
+#include <stdint.h>
+
+#define UTIL_H
+#define DIO_H
+
+#define TRUE  0x01
+#define FALSE 0x00
+
+#define LIKELY(condition)   __builtin_expect (!!(condition), 1)
+#define UNLIKELY(condition) __builtin_expect (!!(condition), 0)
+
+#define BITS_PER_BYTE 8
+
+#define B00000001 UINT8_C (1)
+#define B10000000 UINT8_C (128)
+
+// one_wire_master.h insists on this, but it isn't used on the host.
+#define OWM_PIN DIO_PIN_DIGITAL_2
+
+// Equivalent of the function from avr-libc's <util/crc16.h> (this is the
+// C version given in the avr-libc documentation).
+static inline uint8_t
+_crc_ibutton_update (uint8_t crc, uint8_t data)
+{
+  crc = crc ^ data;
+  for ( uint8_t ii = 0 ; ii < BITS_PER_BYTE ; ii++ ) {
+    if ( crc & 0x01 ) {
+      crc = (crc >> 1) ^ 0x8C;
+    }
+    else {
+      crc >>= 1;
+    }
+  }
+
+  return crc;
+}
+
+#endif // ONE_WIRE_MASTER_HOST_TEST_H
@@ -37,6 +37,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <util/atomic.h>
 
 #include "dio.h"
 #include "ds18b20_commands.h"
@@ -253,6 +254,24 @@ main (void)
     owm_free_rom_ids_list ((uint8_t **) rom_ids);
     PFP ("seemed to work.\n");
 
+    PFP ("Trying owm_scan_bus_into()... ");
+    {
+      uint64_t id_table[2];
+      uint8_t slave_count;
+      OWM_CHECK (
+          owm_scan_bus_into (
+            (uint8_t (*)[OWC_ID_SIZE_BYTES]) id_table, 2, &slave_count ) );
+      PFP_ASSERT (slave_count == 1);
+      PFP_ASSERT (id_table[0] == rid);
+      // With no room in the table, we should be told there are too many.
+      owm_result_t result
+        = owm_scan_bus_into (
+            (uint8_t (*)[OWC_ID_SIZE_BYTES]) id_table, 0, &slave_count );
+      PFP_ASSERT (result == OWM_RESULT_TOO_MANY_SLAVES);
+      PFP_ASSERT (slave_count == 0);
+    }
+    PFP ("ok.\n");
+
     PFP ("Starting temperature conversion... ");
     // NOTE: the DS18B20 doesn't seem to require an addressing command before
     // the "Convert T" command here, which is contrary to its own datasheet.
@@ -431,6 +450,73 @@ main (void)
   OWM_CHECK (owm_verify ((uint8_t *) &second_slave_id));
   PFP ("ok, found it.\n");
 
+  PFP ("Trying owm_scan_bus_into()... ");
+  {
+    uint64_t id_table[3];
+    uint8_t slave_count;
+    OWM_CHECK (
+        owm_scan_bus_into (
+          (uint8_t (*)[OWC_ID_SIZE_BYTES]) id_table, 3, &slave_count ) );
+    PFP_ASSERT (slave_count == 2);
+    PFP_ASSERT (id_table[0] == first_slave_id);
+    PFP_ASSERT (id_table[1] == second_slave_id);
+    // A table with room for only one ID should get the first one.
+    result
+      = owm_scan_bus_into (
+          (uint8_t (*)[OWC_ID_SIZE_BYTES]) id_table, 1, &slave_count );
+    PFP_ASSERT (result == OWM_RESULT_TOO_MANY_SLAVES);
+    PFP_ASSERT (slave_count == 1);
+    PFP_ASSERT (id_table[0] == first_slave_id);
+  }
+  PFP ("ok.\n");
+
+  PFP ("All tests passed.\n");
+  PFP ("\n");
+
+#endif
+
+#ifdef TEST_CONDITION_OVERDRIVE_SLAVE
+
+  // This test requires exactly one slave, which must support overdrive
+  // speed (a DS2431 or DS2401 for example, but not a DS18B20).  Only ROM
+  // commands are used, so it doesn't matter exactly what sort of slave it is.
+
+  uint64_t rid;   // ROM ID
+
+  PFP ("Trying owm_read_id() at standard speed... ");
+  OWM_CHECK (owm_read_id ((uint8_t *) &rid));
+  PFP ("ok, found slave with ID ");
+  print_slave_id (rid);
+  PFP (".\n");
+
+  PFP ("Switching slave to overdrive speed... ");
+  PFP_ASSERT (owm_touch_reset ());
+  owm_write_byte (OWC_OVERDRIVE_SKIP_ROM_COMMAND);
+  owm_set_speed (OWM_SPEED_OVERDRIVE);
+  PFP_ASSERT (owm_speed () == OWM_SPEED_OVERDRIVE);
+  PFP ("ok.\n");
+
+  // Overdrive time slots are too short to survive any interrupts.
+  PFP ("Trying owm_read_id() and owm_verify() at overdrive speed... ");
+  uint64_t od_rid;   // OverDrive ROM ID
+  owm_result_t od_read_result, od_verify_result;
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    od_read_result = owm_read_id ((uint8_t *) &od_rid);
+    od_verify_result = owm_verify ((uint8_t *) &rid);
+  }
+  OWM_CHECK (od_read_result);
+  PFP_ASSERT (od_rid == rid);
+  OWM_CHECK (od_verify_result);
+  PFP ("ok.\n");
+
+  PFP ("Switching back to standard speed... ");
+  owm_set_speed (OWM_SPEED_STANDARD);
+  PFP_ASSERT (owm_touch_reset ());   // Standard reset returns slave to std
+  OWM_CHECK (owm_read_id ((uint8_t *) &rid));
+  PFP_ASSERT (od_rid == rid);
+  PFP ("ok.\n");
+
   PFP ("All tests passed.\n");
   PFP ("\n");
 
@@ -0,0 +1 @@
+../dio/dio.h
\ No newline at end of file
@@ -0,0 +1 @@
+../one_wire_master/one_wire_master.c
\ No newline at end of file
@@ -0,0 +1,281 @@
+// Implementation of the interface described in one_wire_master_async.h.
+
+#include <assert.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/power.h>
+#include <stdlib.h>
+
+#include "dio.h"
+#include "one_wire_common.h"
+#include "one_wire_master_async.h"
+#include "util.h"
+
+// This must agree with the equivalent setup in one_wire_master.c, since
+// the two interfaces may share a bus.
+#ifndef OWM_USE_INTERNAL_PULLUP
+#  define RELEASE_LINE() \
+  OWC_RELEASE_LINE (OWM_PIN)
+#else
+#  define RELEASE_LINE() \
+  DIO_INIT (OWM_PIN, DIO_INPUT, DIO_ENABLE_PULLUP, DIO_DONT_CARE)
+#endif
+
+#define DRIVE_LINE_LOW()  OWC_DRIVE_LINE_LOW (OWM_PIN)
+#define SAMPLE_LINE()     OWC_SAMPLE_LINE (OWM_PIN)
+#define TICK_DELAY(ticks) OWC_TICK_DELAY (ticks)
+
+// We run timer2 with a prescaler of 32, which gives 2 us timer ticks at
+// 16 MHz.  That's plenty of resolution given that all the scheduled (as
+// opposed to busy-waited) delays are only minimums anyway.
+#define TIMER2_PRESCALER_DIVIDER 32
+#define TIMER2_PRESCALER_CS_BITS (_BV (CS21) | _BV (CS20))
+
+// Number of timer2 ticks required to wait at least us microseconds.
+#define TIMER2_TICKS(us)                                          \
+  ( ((us) * (F_CPU / 1000000UL) + TIMER2_PRESCALER_DIVIDER - 1) / \
+    TIMER2_PRESCALER_DIVIDER )
+
+// The longest delay we schedule is the reset pulse, which has to fit in
+// the 8 bit timer.
+#if TIMER2_TICKS (OWC_TICK_DELAY_H) > UINT8_MAX + 1
+#  error F_CPU too high for the timer2 prescaler used here
+#endif
+
+// Number of timer2 ticks to wait before the first slot of a byte operation
+// (which is started from the ISR).
+#define KICK_TICKS 1
+
+typedef enum {
+  PHASE_RESET_LOW,        // Reset pulse is being driven
+  PHASE_RESET_SAMPLE,     // Waiting to sample the presence pulse
+  PHASE_SLOT_START,       // Waiting to start the next time slot
+  PHASE_WRITE_ZERO_LOW,   // Line is being held low to write a zero bit
+  PHASE_DONE              // Waiting for the final recovery time to elapse
+} phase_t;
+
+static volatile uint8_t busy = FALSE;
+static volatile uint8_t result;
+
+// Operation state.  Only the ISR touches these while busy is TRUE.
+static phase_t phase;
+static owma_callback_t callback;
+static uint8_t const *write_data;   // Data to write, or NULL when reading
+static uint8_t *read_buf;           // Buffer to read into, or NULL
+static uint8_t count;               // Number of bytes in the operation
+static uint8_t byte_index;          // Index of the current byte
+static uint8_t bit_mask;            // Mask of the current bit in the byte
+
+static void
+schedule (uint8_t ticks)
+{
+  // Arrange for the ISR to be triggered ticks timer2 ticks from now.
+
+  TCNT2 = 0;
+  OCR2A = ticks - 1;
+}
+
+static void
+start_timer (uint8_t ticks)
+{
+  // Start timer2 running and arrange for the ISR to be triggered ticks
+  // timer2 ticks from now.
+
+  schedule (ticks);
+  // Writing a logic one clears the flag (so no "|=" is required).
+  TIFR2 = _BV (OCF2A);
+  TCCR2B = TIMER2_PRESCALER_CS_BITS;
+  TIMSK2 |= _BV (OCIE2A);
+}
+
+static void
+stop_timer (void)
+{
+  TIMSK2 &= ~(_BV (OCIE2A));
+  TCCR2B = 0;   // Disconnect the clock source (saves a little power)
+}
+
+static void
+advance (void)
+{
+  // Move on to the next bit, or to the final phase if we're out of bits.
+
+  bit_mask <<= 1;
+  if ( bit_mask == 0 ) {
+    bit_mask = B00000001;
+    byte_index++;
+  }
+
+  phase = (byte_index == count ? PHASE_DONE : PHASE_SLOT_START);
+}
+
+ISR (TIMER2_COMPA_vect)
+{
+  switch ( phase ) {
+
+    case PHASE_RESET_LOW:
+      RELEASE_LINE ();
+      schedule (TIMER2_TICKS (OWC_TICK_DELAY_I));
+      phase = PHASE_RESET_SAMPLE;
+      break;
+
+    case PHASE_RESET_SAMPLE:
+      result = ! SAMPLE_LINE ();   // Look for presence pulse from slave
+      schedule (TIMER2_TICKS (OWC_TICK_DELAY_J));
+      phase = PHASE_DONE;
+      break;
+
+    case PHASE_SLOT_START:
+      if ( read_buf != NULL ) {
+        if ( bit_mask == B00000001 ) {
+          read_buf[byte_index] = 0;
+        }
+        // This is the same sequence as owm_read_bit() uses.
+        DRIVE_LINE_LOW ();
+        TICK_DELAY (OWC_TICK_DELAY_A);
+        RELEASE_LINE ();
+        TICK_DELAY (OWC_TICK_DELAY_E);
+        uint8_t bit = SAMPLE_LINE ();   // Sample bit value from slave
+        schedule (TIMER2_TICKS (OWC_TICK_DELAY_F));
+        if ( bit ) {
+          read_buf[byte_index] |= bit_mask;
+        }
+        advance ();
+      }
+      else if ( write_data[byte_index] & bit_mask ) {
+        DRIVE_LINE_LOW ();
+        TICK_DELAY (OWC_TICK_DELAY_A);
+        RELEASE_LINE ();
+        schedule (TIMER2_TICKS (OWC_TICK_DELAY_B));
+        advance ();
+      }
+      else {
+        DRIVE_LINE_LOW ();
+        schedule (TIMER2_TICKS (OWC_TICK_DELAY_C));
+        phase = PHASE_WRITE_ZERO_LOW;
+      }
+      break;
+
+    case PHASE_WRITE_ZERO_LOW:
+      RELEASE_LINE ();
+      schedule (TIMER2_TICKS (OWC_TICK_DELAY_D));
+      advance ();
+      break;
+
+    case PHASE_DONE:
+      stop_timer ();
+      // Note that busy must be cleared before the callback is called, so
+      // that the callback can start another operation.
+      busy = FALSE;
+      if ( callback != NULL ) {
+        callback (result);
+      }
+      break;
+
+    default:
+      assert (FALSE);   // Shouldn't be here
+      break;
+  }
+}
+
+// Default value of the timer/counter2 control register A (for the ATmega328P
+// at least), according to the datasheet.
+#define TCCR2A_DEFAULT_VALUE 0x00
+
+void
+owma_init (void)
+{
+  RELEASE_LINE ();
+
+  power_timer2_enable ();   // Ensure timer2 not shut down to save power
+
+  // Clear Timer on Compare match (CTC) mode, with the clock source not yet
+  // connected (start_timer() connects it).
+  TCCR2A = TCCR2A_DEFAULT_VALUE;
+  TCCR2A |= _BV (WGM21);
+  TCCR2B = 0;
+  TIMSK2 &= ~(_BV (OCIE2A));
+
+  busy = FALSE;
+
+  sei ();   // Ensure that interrupts are enabled.
+}
+
+void
+owma_touch_reset (owma_callback_t cb)
+{
+  assert (! busy);
+
+  busy = TRUE;
+  callback = cb;
+  result = FALSE;
+
+  TICK_DELAY (OWC_TICK_DELAY_G);
+  DRIVE_LINE_LOW ();
+  phase = PHASE_RESET_LOW;
+  start_timer (TIMER2_TICKS (OWC_TICK_DELAY_H));
+}
+
+static void
+start_byte_operation (
+    uint8_t const *data, uint8_t *buf, uint8_t cnt, owma_callback_t cb )
+{
+  // Set up and start a read (if buf is non-NULL) or write operation.
+
+  assert (! busy);
+  assert (cnt > 0);
+
+  busy = TRUE;
+  callback = cb;
+  result = TRUE;
+
+  write_data = data;
+  read_buf = buf;
+  count = cnt;
+  byte_index = 0;
+  bit_mask = B00000001;
+  phase = PHASE_SLOT_START;
+
+  start_timer (KICK_TICKS);
+}
+
+void
+owma_write_bytes (uint8_t const *data, uint8_t cnt, owma_callback_t cb)
+{
+  assert (data != NULL);
+
+  start_byte_operation (data, NULL, cnt, cb);
+}
+
+void
+owma_read_bytes (uint8_t *buf, uint8_t cnt, owma_callback_t cb)
+{
+  assert (buf != NULL);
+
+  start_byte_operation (NULL, buf, cnt, cb);
+}
+
+uint8_t
+owma_busy (void)
+{
+  return busy;
+}
+
+uint8_t
+owma_wait (void)
+{
+  while ( busy ) {
+    ;
+  }
+
+  return result;
+}
+
+void
+owma_shutdown (void)
+{
+  owma_wait ();
+
+  stop_timer ();
+  power_timer2_disable ();
+}
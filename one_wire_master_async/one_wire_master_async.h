@@ -0,0 +1,133 @@
+// Interrupt-driven (asynchronous) one-wire master bit engine
+//
+// Test driver: one_wire_master_async_test.c    Implementation: one_wire_master_async.c
+//
+// The one_wire_master.h interface times every part of every 1-wire time
+// slot with busy-waits.  Each slot takes around 70 us, so for example
+// reading the nine byte scratchpad of a DS18B20 burns about 5 ms of CPU
+// time doing nothing.  Most of a slot is just waiting for the slot to end
+// and the line to recover though: only the first 15 us or so (where the
+// master starts the slot and possibly samples the line) are really timing
+// critical.  This interface uses the compare match interrupt of timer2
+// to run the slots, busy-waiting only for the critical bits and returning
+// control to the foreground code the rest of the time.
+//
+// Each operation (reset, write bytes, read bytes) is started with a call
+// that returns immediately.  When the operation completes, an optional
+// callback is called, and owma_busy() starts returning FALSE.  So it's
+// possible either to poll (or block in owma_wait()) or to chain operations
+// together from the callbacks.  For example, to read the scratchpad from
+// the only DS18B20 on the bus:
+//
+//   static uint8_t const cmds[]
+//     = { OWC_SKIP_ROM_COMMAND, DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND };
+//   static uint8_t scratchpad[9];
+//   static volatile uint8_t got_scratchpad = FALSE;
+//
+//   static void
+//   read_done (uint8_t result) { got_scratchpad = TRUE; }
+//
+//   static void
+//   write_done (uint8_t result) { owma_read_bytes (scratchpad, 9, read_done); }
+//
+//   static void
+//   reset_done (uint8_t result)
+//   {
+//     if ( result ) { owma_write_bytes (cmds, sizeof (cmds), write_done); }
+//   }
+//
+//   owma_init ();
+//   owma_touch_reset (reset_done);
+//   while ( ! got_scratchpad ) {
+//     // Do other useful work
+//   }
+//
+// This interface uses the same OWM_PIN (and OWM_USE_INTERNAL_PULLUP setting)
+// as one_wire_master.h, so the two interfaces can be used together on the
+// same bus (for example, one_wire_master.h for the complicated but
+// infrequent bus search operations, and this interface for the routine
+// data transfers).  The one_wire_master.h functions must not be called
+// while an operation from this interface is in progress though.
+//
+// WARNING: this interface supports only standard speed, not the overdrive
+// speed available via owm_set_speed().
+//
+// WARNING: the callbacks are called from interrupt context.  They should
+// be short, and any variables they share with the foreground code should
+// be volatile.
+//
+// WARNING: other interrupts that occur during an operation may delay the
+// timer2 interrupt.  This is mostly harmless, since the protocol tolerates
+// the ends of slots and recovery times being stretched, but delays of more
+// than about 60 us while a zero bit is being written (or of more than about
+// 200 us while a reset presence pulse is expected) will corrupt things.
+// The timing-critical parts of each slot are done with interrupts disabled
+// (since they happen inside the timer2 ISR), so this interface itself may
+// delay other interrupts by up to about 20 us.
+//
+// WARNING: this interface uses timer2, so it can't be used together with
+// any other interface that uses it (the dc_motor.h interface for example).
+
+#ifndef ONE_WIRE_MASTER_ASYNC_H
+#define ONE_WIRE_MASTER_ASYNC_H
+
+#include "dio.h"
+#include "one_wire_common.h"
+
+#ifndef OWM_PIN
+#  error OWM_PIN not defined (it must be explicitly set to one of \
+         the DIO_PIN_* tuple macros before this header is included)
+#endif
+
+// Type of the completion callbacks.  The meaning of result depends on the
+// operation (see below).  Callbacks run from the timer2 interrupt, after
+// owma_busy() has started returning FALSE, so they may start another
+// operation.
+typedef void (*owma_callback_t)(uint8_t result);
+
+// Initialize the pin and timer2.  Interrupts are enabled globally (with
+// sei()) by this function.  Note that the pin initialization is the same
+// as that performed by owm_init() from one_wire_master.h.
+void
+owma_init (void);
+
+// Start a reset pulse and presence pulse detection sequence.  The callback
+// result (and the value subsequently returned by owma_wait()) is TRUE iff a
+// presence pulse was detected.  No operation may already be in progress.
+void
+owma_touch_reset (owma_callback_t callback);
+
+// Start writing count bytes from data to the bus (LSB of each byte first,
+// as for owm_write_byte()).  The data must stay valid (and unchanged)
+// until the operation completes.  The callback result is always TRUE.
+// The count must be greater than zero, and no operation may already be in
+// progress.
+void
+owma_write_bytes (uint8_t const *data, uint8_t count, owma_callback_t callback);
+
+// Start reading count bytes from the bus into buf (LSB of each byte first,
+// as for owm_read_byte()).  The contents of buf are undefined until the
+// operation completes.  The callback result is always TRUE.  The count must
+// be greater than zero, and no operation may already be in progress.
+void
+owma_read_bytes (uint8_t *buf, uint8_t count, owma_callback_t callback);
+
+// Return TRUE iff an operation is in progress.
+uint8_t
+owma_busy (void);
+
+// Wait for any operation in progress to complete, then return the result
+// of the most recent operation (the same value passed to its callback).
+// Note that this must not be called from a callback (since callbacks run
+// from interrupt context, the operation could never complete).
+uint8_t
+owma_wait (void);
+
+// Wait for any operation in progress to complete, then disable the timer2
+// interrupt and shut down timer2 entirely (to save a little power).  The
+// pin is left released.  owma_init() must be called again before this
+// interface is reused.
+void
+owma_shutdown (void);
+
+#endif // ONE_WIRE_MASTER_ASYNC_H
@@ -0,0 +1,178 @@
+// Test/demo for the one_wire_master_async.h interface.
+//
+// This test program requires the same hardware setup as the default
+// (TEST_CONDITION_SINGLE_SLAVE) configuration of one_wire_master_test.c:
+// exactly one externally powered DS18B20 on DIO_PIN_DIGITAL_2, with a 4.7
+// kohm pull-up resistor.
+//
+// The scratchpad of the DS18B20 is read using a chain of callbacks, while
+// the foreground code counts how many times it gets to spin around its loop
+// during the transaction (to show that the CPU really is mostly free).
+// The result is then cross-checked against a scratchpad read done using
+// the ordinary one_wire_master.h interface.
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+//
+// The entire test sequence repeats perpetually.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "dio.h"
+#include "ds18b20_commands.h"
+#include "one_wire_master.h"
+#include "one_wire_master_async.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+#define DS18B20_SCRATCHPAD_SIZE 9
+
+static uint8_t const read_scratchpad_cmds[] = {
+  OWC_SKIP_ROM_COMMAND,
+  DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND };
+
+static uint8_t async_spb[DS18B20_SCRATCHPAD_SIZE];   // Async Scratchpad Buf
+static uint8_t sync_spb[DS18B20_SCRATCHPAD_SIZE];    // Sync Scratchpad Buf
+
+// Flags set from the callbacks (i.e. from interrupt context).
+static volatile uint8_t transaction_done;
+static volatile uint8_t got_presence;
+static volatile uint8_t write_succeeded;
+static volatile uint8_t read_succeeded;
+
+static void
+read_done (uint8_t result)
+{
+  read_succeeded = result;
+  transaction_done = TRUE;
+}
+
+static void
+write_done (uint8_t result)
+{
+  write_succeeded = result;
+  if ( result ) {
+    owma_read_bytes (async_spb, DS18B20_SCRATCHPAD_SIZE, read_done);
+  }
+  else {
+    transaction_done = TRUE;
+  }
+}
+
+static void
+reset_done (uint8_t result)
+{
+  got_presence = result;
+  if ( result ) {
+    owma_write_bytes (
+        read_scratchpad_cmds, sizeof (read_scratchpad_cmds), write_done );
+  }
+  else {
+    transaction_done = TRUE;
+  }
+}
+
+static uint8_t
+scratchpad_crc_ok (uint8_t const *spb)
+{
+  // Return TRUE iff the CRC byte at the end of scratchpad spb is correct.
+
+  uint8_t crc = 0;
+  for ( uint8_t ii = 0 ; ii < DS18B20_SCRATCHPAD_SIZE - 1 ; ii++ ) {
+    crc = _crc_ibutton_update (crc, spb[ii]);
+  }
+
+  return crc == spb[DS18B20_SCRATCHPAD_SIZE - 1];
+}
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  owm_init ();
+  owma_init ();
+  PFP ("Did owm_init() and owma_init().\n");
+
+  for ( ; ; ) {
+
+    PFP ("\n");
+
+    PFP ("Trying owma_touch_reset() and owma_wait()... ");
+    owma_touch_reset (NULL);
+    assert (owma_busy ());
+    uint8_t presence = owma_wait ();
+    if ( ! presence ) {
+      PFP ("failed: didn't get presence pulse\n");
+      assert (FALSE);
+    }
+    assert (! owma_busy ());
+    PFP ("ok.\n");
+
+    PFP ("Reading scratchpad with chained callbacks... ");
+    transaction_done = FALSE;
+    got_presence = FALSE;
+    write_succeeded = FALSE;
+    read_succeeded = FALSE;
+    uint32_t spin_count = 0;
+    owma_touch_reset (reset_done);
+    while ( ! transaction_done ) {
+      spin_count++;
+    }
+    if ( ! got_presence ) {
+      PFP ("failed: didn't get presence pulse\n");
+      assert (FALSE);
+    }
+    if ( ! write_succeeded ) {
+      PFP ("failed: command write didn't succeed\n");
+      assert (FALSE);
+    }
+    if ( ! read_succeeded ) {
+      PFP ("failed: scratchpad read didn't succeed\n");
+      assert (FALSE);
+    }
+    if ( ! scratchpad_crc_ok (async_spb) ) {
+      PFP ("failed: scratchpad CRC mismatch\n");
+      assert (FALSE);
+    }
+    PFP ("ok, foreground loop spun %lu times meanwhile.\n", spin_count);
+
+    PFP ("Reading scratchpad with one_wire_master.h for comparison... ");
+    if ( ! owm_touch_reset () ) {
+      PFP ("failed: didn't get presence pulse\n");
+      assert (FALSE);
+    }
+    owm_write_byte (OWC_SKIP_ROM_COMMAND);
+    owm_write_byte (DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND);
+    for ( uint8_t ii = 0 ; ii < DS18B20_SCRATCHPAD_SIZE ; ii++ ) {
+      sync_spb[ii] = owm_read_byte ();
+    }
+    if ( memcmp (async_spb, sync_spb, DS18B20_SCRATCHPAD_SIZE) != 0 ) {
+      PFP ("failed: scratchpad contents differ\n");
+      assert (FALSE);
+    }
+    PFP ("ok, contents match.\n");
+
+    PFP ("Trying owma_shutdown() and re-init... ");
+    owma_shutdown ();
+    owma_init ();
+    PFP ("ok.\n");
+
+    PFP ("All tests passed (will repeat in 1 s).\n");
+    _delay_ms (1000.0);
+  }
+}
@@ -0,0 +1 @@
+../term_io/term_io.h
\ No newline at end of file
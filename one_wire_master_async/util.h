@@ -0,0 +1 @@
+../util.h
\ No newline at end of file
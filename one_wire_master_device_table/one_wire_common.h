@@ -0,0 +1 @@
+../one_wire_master/one_wire_common.h
\ No newline at end of file
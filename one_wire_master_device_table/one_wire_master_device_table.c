@@ -0,0 +1,178 @@
+// Implementation of the interface described in one_wire_master_device_table.h.
+
+#include <assert.h>
+#include <avr/eeprom.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/crc16.h>
+
+#include "one_wire_master.h"
+#include "one_wire_master_device_table.h"
+#include "util.h"
+
+static uint8_t id_count = 0;
+static uint8_t ids[OWMDT_MAX_DEVICES][OWC_ID_SIZE_BYTES];
+
+#ifdef OWMDT_USE_EEPROM
+
+// The stored table is the count, followed by all OWMDT_MAX_DEVICES ID
+// slots, followed by a CRC of all that.  Note that erased EEPROM (all
+// 0xFF bytes) never looks valid, since the count is then too large.
+#  define EEPROM_COUNT_ADDRESS ((uint8_t *) OWMDT_EEPROM_ADDRESS)
+#  define EEPROM_IDS_ADDRESS   (EEPROM_COUNT_ADDRESS + 1)
+#  define EEPROM_CRC_ADDRESS   (EEPROM_IDS_ADDRESS + sizeof (ids))
+
+static uint8_t
+table_crc (void)
+{
+  uint8_t crc = _crc_ibutton_update (0, id_count);
+  for ( uint8_t ii = 0 ; ii < OWMDT_MAX_DEVICES ; ii++ ) {
+    for ( uint8_t jj = 0 ; jj < OWC_ID_SIZE_BYTES ; jj++ ) {
+      crc = _crc_ibutton_update (crc, ids[ii][jj]);
+    }
+  }
+
+  return crc;
+}
+
+static void
+save_table (void)
+{
+  // The update (rather than write) functions only write the bytes that
+  // actually changed, which saves EEPROM wear and time.
+  eeprom_update_byte (EEPROM_COUNT_ADDRESS, id_count);
+  eeprom_update_block (ids, EEPROM_IDS_ADDRESS, sizeof (ids));
+  eeprom_update_byte (EEPROM_CRC_ADDRESS, table_crc ());
+}
+
+static void
+load_table (void)
+{
+  id_count = eeprom_read_byte (EEPROM_COUNT_ADDRESS);
+  eeprom_read_block (ids, EEPROM_IDS_ADDRESS, sizeof (ids));
+  uint8_t stored_crc = eeprom_read_byte (EEPROM_CRC_ADDRESS);
+
+  if ( id_count > OWMDT_MAX_DEVICES || stored_crc != table_crc () ) {
+    id_count = 0;
+  }
+}
+
+#endif
+
+static void
+set_table (uint8_t (*new_ids)[OWC_ID_SIZE_BYTES], uint8_t count)
+{
+  // Replace the table contents with the count IDs in new_ids.  Unused
+  // entries are zeroed so the stored table CRC is well-defined.
+
+  memset (ids, 0, sizeof (ids));
+  memcpy (ids, new_ids, count * OWC_ID_SIZE_BYTES);
+  id_count = count;
+
+#ifdef OWMDT_USE_EEPROM
+  save_table ();
+#endif
+}
+
+static uint8_t
+in_table (uint8_t const *id)
+{
+  for ( uint8_t ii = 0 ; ii < id_count ; ii++ ) {
+    if ( memcmp (ids[ii], id, OWC_ID_SIZE_BYTES) == 0 ) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+void
+owmdt_init (void)
+{
+#ifdef OWMDT_USE_EEPROM
+  load_table ();
+#else
+  id_count = 0;
+#endif
+}
+
+owm_result_t
+owmdt_rescan (uint8_t *changed)
+{
+  uint8_t new_ids[OWMDT_MAX_DEVICES][OWC_ID_SIZE_BYTES];
+  uint8_t new_count;
+
+  owm_result_t result
+    = owm_scan_bus_into (new_ids, OWMDT_MAX_DEVICES, &new_count);
+  if ( result != OWM_RESULT_SUCCESS &&
+       result != OWM_RESULT_TOO_MANY_SLAVES ) {
+    new_count = 0;
+  }
+
+  *changed
+    = ( new_count != id_count ||
+        memcmp (new_ids, ids, new_count * OWC_ID_SIZE_BYTES) != 0 );
+  if ( *changed ) {
+    set_table (new_ids, new_count);
+  }
+
+  return result;
+}
+
+owm_result_t
+owmdt_refresh (uint8_t check_alarmed, uint8_t *changed)
+{
+  if ( id_count == 0 ) {
+    return owmdt_rescan (changed);
+  }
+
+  for ( uint8_t ii = 0 ; ii < id_count ; ii++ ) {
+    if ( owm_verify (ids[ii]) != OWM_RESULT_SUCCESS ) {
+      return owmdt_rescan (changed);
+    }
+  }
+
+  if ( check_alarmed ) {
+    uint8_t alarmed_id[OWC_ID_SIZE_BYTES];
+    owm_result_t result = owm_first_alarmed (alarmed_id);
+    while ( result == OWM_RESULT_SUCCESS ) {
+      if ( ! in_table (alarmed_id) ) {
+        return owmdt_rescan (changed);
+      }
+      result = owm_next_alarmed (alarmed_id);
+    }
+    // Running out of alarmed slaves is the normal way for this to end.
+    if ( result != OWM_RESULT_NO_SUCH_SLAVE ) {
+      return owmdt_rescan (changed);
+    }
+  }
+
+  *changed = FALSE;
+
+  return OWM_RESULT_SUCCESS;
+}
+
+uint8_t
+owmdt_count (void)
+{
+  return id_count;
+}
+
+uint8_t *
+owmdt_id (uint8_t index)
+{
+  assert (index < id_count);
+
+  return ids[index];
+}
+
+void
+owmdt_clear (void)
+{
+  memset (ids, 0, sizeof (ids));
+  id_count = 0;
+
+#ifdef OWMDT_USE_EEPROM
+  save_table ();
+#endif
+}
@@ -0,0 +1,106 @@
+// Incrementally refreshed table of known 1-wire slaves (optionally in EEPROM)
+//
+// Test driver: one_wire_master_device_table_test.c    Implementation: one_wire_master_device_table.c
+//
+// A full bus search (as done by owm_scan_bus() or owm_scan_bus_into())
+// discovers slave IDs bit by bit, backtracking at every discrepancy.  On a
+// bus whose membership rarely changes, it's cheaper just to confirm that
+// each slave we already know about is still present (using owm_verify(),
+// which walks directly to a known ID) and to do a full search only when
+// that fails.  This interface maintains such a table of known slave IDs.
+// It can optionally also look for new slaves that are signalling an alarm
+// condition (this is cheap if few slaves are alarmed), since those are
+// probably the ones the application cares most about noticing.
+//
+// WARNING: slaves that are added to the bus without any other slave being
+// removed, and which aren't alarmed, can't be noticed by owmdt_refresh().
+// Applications that need to find such slaves must call owmdt_rescan() from
+// time to time.
+//
+// If OWMDT_USE_EEPROM is defined, the table is saved to EEPROM whenever it
+// changes, and restored by owmdt_init(), so that after a reset the known
+// slaves can be verified rather than searched for.
+//
+// Typical use looks like this:
+//
+//   owm_init ();
+//   owmdt_init ();
+//   for ( ; ; ) {
+//     uint8_t changed;
+//     owm_result_t result = owmdt_refresh (TRUE, &changed);
+//     if ( result == OWM_RESULT_SUCCESS ) {
+//       for ( uint8_t ii = 0 ; ii < owmdt_count () ; ii++ ) {
+//         // Talk to the slave with ID owmdt_id (ii)
+//       }
+//     }
+//   }
+
+#ifndef ONE_WIRE_MASTER_DEVICE_TABLE_H
+#define ONE_WIRE_MASTER_DEVICE_TABLE_H
+
+#include <stdint.h>
+
+#include "one_wire_master.h"
+
+// Maximum number of slaves the table can hold.  Each one costs
+// OWC_ID_SIZE_BYTES of RAM (and of EEPROM, if OWMDT_USE_EEPROM is defined).
+#ifndef OWMDT_MAX_DEVICES
+#  define OWMDT_MAX_DEVICES 8
+#endif
+
+#if OWMDT_MAX_DEVICES < 1 || OWMDT_MAX_DEVICES > UINT8_MAX
+#  error OWMDT_MAX_DEVICES must be between 1 and UINT8_MAX
+#endif
+
+#ifdef OWMDT_USE_EEPROM
+
+// Location in EEPROM where the table is stored.  The stored table takes
+// OWMDT_MAX_DEVICES * OWC_ID_SIZE_BYTES + 2 bytes.  The default location
+// stays clear of the one_wire_slave.h part ID (at the start of EEPROM) and
+// the LASSERT() message area from util.h (near the end).
+#  ifndef OWMDT_EEPROM_ADDRESS
+#    define OWMDT_EEPROM_ADDRESS ((void *) 512)
+#  endif
+
+#endif
+
+// Initialize the table.  If OWMDT_USE_EEPROM is defined and a valid table
+// is stored in EEPROM, it's loaded, otherwise the table starts out empty.
+// Note that owm_init() must be called separately.
+void
+owmdt_init (void);
+
+// Bring the table up to date with the bus.  If the table is empty, or any
+// slave in it fails owm_verify(), a full search is done and the table is
+// replaced with the result.  Otherwise, if check_alarmed is TRUE, an alarm
+// search is done and a full search follows if it finds any slave not in
+// the table.  The location pointed to by changed is set to TRUE iff the
+// table contents changed.  On success, OWM_RESULT_SUCCESS is returned.
+// If a full search finds more than OWMDT_MAX_DEVICES slaves,
+// OWM_RESULT_TOO_MANY_SLAVES is returned (and the table holds the first
+// OWMDT_MAX_DEVICES found).  Otherwise, on failure the table is emptied
+// and the result of the failing search is returned (in particular, an empty
+// bus gives OWM_RESULT_DID_NOT_GET_PRESENCE_PULSE).
+owm_result_t
+owmdt_refresh (uint8_t check_alarmed, uint8_t *changed);
+
+// Like owmdt_refresh(), but always does a full search.
+owm_result_t
+owmdt_rescan (uint8_t *changed);
+
+// Return the number of slaves in the table.
+uint8_t
+owmdt_count (void);
+
+// Return a pointer to the OWC_ID_SIZE_BYTES byte ID of slave index in the
+// table.  The index must be less than owmdt_count().  The IDs are kept in
+// search discovery order.
+uint8_t *
+owmdt_id (uint8_t index);
+
+// Empty the table (and erase the stored copy in EEPROM, if
+// OWMDT_USE_EEPROM is defined).
+void
+owmdt_clear (void);
+
+#endif // ONE_WIRE_MASTER_DEVICE_TABLE_H
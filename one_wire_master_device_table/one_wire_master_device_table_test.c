@@ -0,0 +1,98 @@
+// Test/demo for the one_wire_master_device_table.h interface.
+//
+// This test program requires exactly one slave on the bus connected to
+// DIO_PIN_DIGITAL_2 (a DS18B20 works fine, see one_wire_master_test.c for
+// details about the hardware setup).  Unplugging and replugging the slave
+// while the test loop is running should produce the expected
+// "changed" messages.
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "one_wire_master.h"
+#include "one_wire_master_device_table.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+char result_buf[OWM_RESULT_DESCRIPTION_MAX_LENGTH + 1];
+
+#define OWM_CHECK(result)                                        \
+  PFP_ASSERT_SUCCESS (result, owm_result_as_string, result_buf);
+
+static void
+print_id (uint8_t const *id)
+{
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES ; ii++ ) {
+    PFP ("%02x", id[ii]);
+  }
+}
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  owm_init ();
+  owmdt_init ();
+  PFP ("Did owm_init() and owmdt_init().\n");
+
+#ifdef OWMDT_USE_EEPROM
+  PFP ("Table restored from EEPROM has %u entries.\n", owmdt_count ());
+#endif
+
+  PFP ("Trying owm_read_id() to get the real slave ID... ");
+  uint8_t slave_id[OWC_ID_SIZE_BYTES];
+  OWM_CHECK (owm_read_id (slave_id));
+  PFP ("ok, ID is ");
+  print_id (slave_id);
+  PFP (".\n");
+
+  PFP ("Trying owmdt_clear() and owmdt_refresh()... ");
+  owmdt_clear ();
+  PFP_ASSERT (owmdt_count () == 0);
+  uint8_t changed;
+  OWM_CHECK (owmdt_refresh (FALSE, &changed));
+  PFP_ASSERT (changed);
+  PFP_ASSERT (owmdt_count () == 1);
+  PFP_ASSERT (memcmp (owmdt_id (0), slave_id, OWC_ID_SIZE_BYTES) == 0);
+  PFP ("ok.\n");
+
+  PFP ("Trying owmdt_refresh() again (should verify, not search)... ");
+  OWM_CHECK (owmdt_refresh (TRUE, &changed));
+  PFP_ASSERT (! changed);
+  PFP_ASSERT (owmdt_count () == 1);
+  PFP ("ok.\n");
+
+  PFP ("Trying owmdt_rescan()... ");
+  OWM_CHECK (owmdt_rescan (&changed));
+  PFP_ASSERT (! changed);
+  PFP_ASSERT (owmdt_count () == 1);
+  PFP ("ok.\n");
+
+  PFP ("Now refreshing perpetually, try unplugging the slave...\n");
+  for ( ; ; ) {
+    owm_result_t result = owmdt_refresh (TRUE, &changed);
+    if ( changed ) {
+      PFP (
+          "Table changed (%s), now has %u entries.\n",
+          owm_result_as_string (result, result_buf),
+          owmdt_count () );
+    }
+    _delay_ms (100.0);
+  }
+}
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <util/crc16.h>
 
@@ -11,14 +12,47 @@
 //#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
 #include "term_io.h"
 
+// TRUE iff the slave has acknowledged the start of a batch session (see
+// start_session()) since owml_init() was last called.
+static uint8_t session_started = FALSE;
+
 void
 owml_init (void)
 {
   owm_init ();
+
+  session_started = FALSE;
 }
 
 // FIXME: WORK POINT: error propagationin this module hasn't been considered
 
+static void
+start_logger_transaction (uint8_t function_cmd)
+{
+  // Address the logger slave and send it function_cmd.
+
+  owm_result_t owr;   // 1-Wire Result (function return code storage)
+
+#if OWML_TARGET_SLAVE == OWML_ONLY_SLAVE
+
+  // We were promised a private line, so there's no need to address the
+  // slave by ID.
+  owr = owm_start_transaction (OWC_SKIP_ROM_COMMAND, NULL, function_cmd);
+  assert (owr == OWM_RESULT_SUCCESS);
+
+#else
+
+  uint64_t slave_id = __builtin_bswap64 (UINT64_C (OWML_TARGET_SLAVE));
+
+  owr = owm_start_transaction (
+      OWC_MATCH_ROM_COMMAND,
+      (uint8_t *) &slave_id,
+      function_cmd );
+  assert (owr == OWM_RESULT_SUCCESS);
+
+#endif
+}
+
 int
 owml_printf (char const *format, ...)
 {
@@ -31,44 +65,13 @@ owml_printf (char const *format, ...)
   va_end (ap);
   assert (chars_written >= 0);
 
-  owm_result_t owr;   // 1-Wire Result (function return code storage)
-
-  uint64_t slave_id;   // Slave we're going to talk to
-
   // This is the function command code we send to the slave so indicate the
   // start of a a "printf" transaction.  Note that the one_wire_slave_logger.h
   // must agree to use this value and implement its end of the transaction
   // protocol.
   uint8_t const printf_function_cmd = 0x44;
 
-#if OWML_TARGET_SLAVE == OWML_ONLY_SLAVE
-
-  uint64_t **rom_ids;
-  owr = owm_scan_bus ((uint8_t ***) (&rom_ids));
-  assert (owr == OWM_RESULT_SUCCESS);
-
-  slave_id = *(rom_ids[0]);
-  assert (rom_ids[1] == NULL);   // We were promised a private line
-
-  owr = owm_start_transaction (
-      OWC_READ_ROM_COMMAND,
-      (uint8_t *) &slave_id,
-      printf_function_cmd );
-  assert (owr == OWM_RESULT_SUCCESS);
-
-  owm_free_rom_ids_list ((uint8_t **) rom_ids);
-
-#else
-
-  slave_id = __builtin_bswap64 (UINT64_C (OWML_TARGET_SLAVE));
-
-  owr = owm_start_transaction (
-      OWC_MATCH_ROM_COMMAND,
-      (uint8_t *) &slave_id,
-      printf_function_cmd );
-  assert (owr == OWM_RESULT_SUCCESS);
-
-#endif
+  start_logger_transaction (printf_function_cmd);
 
   // To be nice to the slave, we provide a little bit of interbyte delay as
   // per the recommendation in one_wire_slave.h.
@@ -114,3 +117,152 @@ owml_printf (char const *format, ...)
 
   return chars_written;
 }
+
+// This is the function command code we send to the slave to indicate
+// the start of a batch transaction.  Note that the one_wire_slave_logger.h
+// must agree to use this value (and the acknowledgement values below) and
+// implement its end of the transaction protocol.
+#define BATCH_FUNCTION_CMD 0x45
+
+// Status bytes the slave sends back at the end of a batch transaction.
+#define BATCH_ACK 0x42
+#define BATCH_NAK 0x24
+
+// This is the function command code we send to the slave before our first
+// batch after owml_init().  It tells the slave to forget the sequence
+// number of the last batch it handled: we start counting from 0 again
+// after a reset, so our next batch might otherwise be mistaken for a
+// duplicate and dropped.  The slave answers with a BATCH_ACK byte.
+#define SESSION_START_FUNCTION_CMD 0x46
+
+// Maximum number of owm_read_bit() calls we make waiting for the slave to
+// finish relaying a batch (at about 70 us per call, this is a few seconds).
+#define MAX_BUSY_POLLS UINT16_MAX
+
+static char batch_buffer[OWML_BATCH_BUFFER_SIZE];
+static uint8_t batch_length = 0;
+static uint8_t sequence_number = 0;
+
+static uint8_t
+start_session (void)
+{
+  // Tell the slave that a new batch session is starting, returning TRUE
+  // iff it acknowledges.  The slave doesn't need to do anything slow, so
+  // we just give it a moment to get ready to send before we read its
+  // answer.
+
+  start_logger_transaction (SESSION_START_FUNCTION_CMD);
+
+  double const turnaround_us = 10.0;
+  _delay_us (turnaround_us);
+
+  return owm_read_byte () == BATCH_ACK;
+}
+
+static uint8_t
+send_batch (void)
+{
+  // Send the current batch in a single transaction, returning TRUE iff
+  // the slave acknowledges it.  The batch is framed as the sequence
+  // number, the length, the NUL-terminated messages themselves, and a
+  // CRC16 of all that (high byte first).  Like owml_printf(), we leave an
+  // inter-byte delay before each byte: ows_read_block() on the slave end
+  // still reads (and CRCs) one byte at a time, so it needs the same
+  // recovery time between bytes.
+
+  start_logger_transaction (BATCH_FUNCTION_CMD);
+
+  double const ibd_us = 10.0;
+
+  uint16_t crc = 0xffff;
+  crc = _crc16_update (crc, sequence_number);
+  _delay_us (ibd_us);
+  owm_write_byte (sequence_number);
+  crc = _crc16_update (crc, batch_length);
+  _delay_us (ibd_us);
+  owm_write_byte (batch_length);
+  for ( uint8_t ii = 0 ; ii < batch_length ; ii++ ) {
+    _delay_us (ibd_us);
+    crc = _crc16_update (crc, batch_buffer[ii]);
+    owm_write_byte (batch_buffer[ii]);
+  }
+  _delay_us (ibd_us);
+  owm_write_byte (HIGH_BYTE (crc));
+  _delay_us (ibd_us);
+  owm_write_byte (LOW_BYTE (crc));
+
+  _delay_us (ibd_us);
+
+  // Wait for the slave to send the zero it sends when it's done relaying
+  // the batch (or deciding that it's corrupt).
+  uint16_t polls = 0;
+  while ( owm_read_bit () ) {
+    if ( ++polls == MAX_BUSY_POLLS ) {
+      return FALSE;
+    }
+  }
+
+  _delay_us (ibd_us);
+  uint8_t status = owm_read_byte ();
+  _delay_us (ibd_us);
+  uint8_t acked_sequence_number = owm_read_byte ();
+
+  return status == BATCH_ACK && acked_sequence_number == sequence_number;
+}
+
+int
+owml_flush (void)
+{
+  if ( batch_length == 0 ) {
+    return 0;
+  }
+
+  // Starting the session (if it's needed) counts against the same retry
+  // limit as the batch itself.
+  uint8_t acked = FALSE;
+  for ( uint8_t ii = 0 ; ii <= OWML_MAX_RETRIES && ! acked ; ii++ ) {
+    if ( ! session_started ) {
+      session_started = start_session ();
+    }
+    if ( session_started ) {
+      acked = send_batch ();
+    }
+  }
+
+  // Whether or not the batch got through, we move on to a new batch (with
+  // a new sequence number, so the slave doesn't mistake it for a duplicate).
+  batch_length = 0;
+  sequence_number++;
+
+  return acked ? 0 : -1;
+}
+
+int
+owml_batch_printf (char const *format, ...)
+{
+  va_list ap;
+
+  // Find the length the message will have (we need to know if it fits).
+  va_start (ap, format);
+  int message_length = vsnprintf (NULL, 0, format, ap);
+  va_end (ap);
+  assert (message_length >= 0);
+  if ( message_length > OWML_BATCH_BUFFER_SIZE - 1 ) {
+    message_length = OWML_BATCH_BUFFER_SIZE - 1;
+  }
+
+  // Room for the message and its terminating NUL byte.
+  uint8_t required = message_length + 1;
+  if ( batch_length + required > OWML_BATCH_BUFFER_SIZE ) {
+    if ( owml_flush () != 0 ) {
+      return -1;
+    }
+  }
+
+  va_start (ap, format);
+  vsnprintf (batch_buffer + batch_length, required, format, ap);
+  va_end (ap);
+  batch_length += required;
+
+  return message_length;
+}
@@ -13,6 +13,8 @@
 #ifndef ONE_WIRE_MASTER_LOGGER_H
 #define ONE_WIRE_MASTER_LOGGER_H
 
+#include <stdint.h>
+
 // See the notes in the Makefile for this module for details about why we
 // require variable from the OWM_* namespace to be set here.
 #ifndef OWM_PIN
@@ -57,4 +59,67 @@ int
 owml_printf (char const *format, ...)
   __attribute__ ((format (printf, 1, 2)));   // For printf format warnings
 
+// Batched Logging
+//
+// Each owml_printf() call costs a complete 1-wire transaction (reset,
+// addressing, function command, busy-wait for the slave to relay the
+// message, and acknowledgement), and sends the message itself with
+// generous inter-byte delays.  For small frequent messages that overhead
+// dominates.  The functions below instead pack many messages into a
+// buffer, and send the whole batch in a single transaction (still with the
+// same inter-byte delays, since the slave still handles each byte
+// separately, but with the transaction overhead paid only once per
+// batch).  Each batch carries a sequence number
+// and a CRC16.  The slave acknowledges each batch, and the master resends
+// batches that aren't acknowledged (the sequence number lets the slave
+// recognize and discard duplicates when an acknowledgement is lost).
+// Since the sequence numbers start over when the master is reset, the first
+// owml_flush() after owml_init() also tells the slave to forget the
+// sequence number of the last batch it saw before sending the batch.
+//
+// There's still a window in which a batch can be relayed twice: if the
+// slave is reset after relaying a batch but before the master sees its
+// acknowledgement, the resent batch isn't recognized as a duplicate.
+// Batches are never silently dropped as duplicates unless the slave
+// really did relay them, as long as the master calls owml_init() after
+// every reset.
+//
+// Batches are only supported by slaves using a one_wire_slave_logger.h
+// that supports them, but such slaves also still accept owml_printf()
+// messages.
+
+// Size of the buffer used to accumulate a batch of messages.  It cannot be
+// defined to be greater than or equal to UINT8_MAX, and should not exceed
+// the OWSL_MAX_BATCH_LENGTH used in one_wire_slave_logger.h.
+#ifndef OWML_BATCH_BUFFER_SIZE
+#  define OWML_BATCH_BUFFER_SIZE 128
+#endif
+
+#if OWML_BATCH_BUFFER_SIZE >= UINT8_MAX
+#  error OWML_BATCH_BUFFER_SIZE must be less than UINT8_MAX
+#endif
+
+// Number of times owml_flush() will resend an unacknowledged batch before
+// giving up.
+#ifndef OWML_MAX_RETRIES
+#  define OWML_MAX_RETRIES 3
+#endif
+
+// Format a message and add it to the current batch.  If the batch buffer
+// doesn't have room for the message, owml_flush() is called first to make
+// room.  Messages longer than OWML_BATCH_BUFFER_SIZE - 1 characters are
+// truncated.  On success the number of characters queued is returned,
+// otherwise (if the implicit owml_flush() failed) a negative value is
+// returned and the message is discarded.
+int
+owml_batch_printf (char const *format, ...)
+  __attribute__ ((format (printf, 1, 2)));   // For printf format warnings
+
+// Send the current batch (if it isn't empty), and wait for the slave to
+// acknowledge that it has relayed all the messages in it.  Returns 0 on
+// success, or a negative value if the batch still wasn't acknowledged after
+// OWML_MAX_RETRIES retries (in which case the batch is discarded).
+int
+owml_flush (void);
+
 #endif // ONE_WIRE_MASTER_LOGGER_H
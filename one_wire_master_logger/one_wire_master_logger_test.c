@@ -59,12 +59,30 @@ main (void)
   PFP ("ok, it returned.\n");
   PFP ("\n");
 
-  // Send test messages forever
+  // Send a few test messages individually
   uint32_t tmn = 1;   // Test Message Number
-  for ( ; ; ) {
+  uint32_t const individual_message_count = 10;
+  while ( tmn <= individual_message_count ) {
     PFP ("About to send message \"Message %" PRIu32 "\"...", tmn);
     owml_printf ("Message %" PRIu32 "\n", tmn);
     PFP (" sent and acknowledge received.\n");
     tmn++;
   }
+
+  PFP ("\n");
+
+  // Then send test messages in batches forever.  These should appear at
+  // the slave end much faster.
+  uint8_t const messages_per_batch = 8;
+  for ( ; ; ) {
+    PFP ("About to batch messages %" PRIu32 " to ", tmn);
+    for ( uint8_t ii = 0 ; ii < messages_per_batch ; ii++ ) {
+      int result = owml_batch_printf ("Batched message %" PRIu32 "\n", tmn);
+      PFP_ASSERT (result >= 0);
+      tmn++;
+    }
+    PFP ("%" PRIu32 "...", tmn - 1);
+    PFP_ASSERT (owml_flush () == 0);
+    PFP (" flushed and acknowledge received.\n");
+  }
 }
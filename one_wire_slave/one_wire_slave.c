@@ -426,6 +426,48 @@ ows_read_byte (uint8_t *byte_value_ptr)
   return OWS_RESULT_SUCCESS;
 }
 
+ows_result_t
+ows_write_block (uint8_t const *data, uint8_t count, uint16_t *crc_ptr)
+{
+  uint16_t crc = (crc_ptr != NULL ? *crc_ptr : 0);
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    cbytevu = data[ii];
+    CPE (write_byte ());
+    // Since write_byte() returns as soon as the last bit is written, this
+    // happens in the time between the master's slots.
+    if ( crc_ptr != NULL ) {
+      crc = _crc16_update (crc, data[ii]);
+    }
+  }
+
+  if ( crc_ptr != NULL ) {
+    *crc_ptr = crc;
+  }
+
+  return OWS_RESULT_SUCCESS;
+}
+
+ows_result_t
+ows_read_block (uint8_t *buf, uint8_t count, uint16_t *crc_ptr)
+{
+  uint16_t crc = (crc_ptr != NULL ? *crc_ptr : 0);
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    CPE (read_byte ());
+    buf[ii] = cbytevu;
+    if ( crc_ptr != NULL ) {
+      crc = _crc16_update (crc, buf[ii]);
+    }
+  }
+
+  if ( crc_ptr != NULL ) {
+    *crc_ptr = crc;
+  }
+
+  return OWS_RESULT_SUCCESS;
+}
+
 ows_result_t
 ows_unbusy (void)
 {
@@ -539,6 +581,16 @@ ows_wait_for_function_transaction (uint8_t *command_ptr, uint8_t jgur)
             case OWC_ALARM_SEARCH_COMMAND:
               state = SDASC;
               break;
+            case OWC_OVERDRIVE_SKIP_ROM_COMMAND:
+            case OWC_OVERDRIVE_MATCH_ROM_COMMAND:
+              // We don't support overdrive speed (see the comments near
+              // ows_wait_for_function_transaction() in one_wire_slave.h),
+              // so we do what standard speed slaves are supposed to do:
+              // ignore everything until the next standard speed reset.
+              // Overdrive reset pulses are much too short for CFR() to
+              // mistake them for standard speed ones.
+              state = SWFR;
+              break;
             default:
               return OWS_RESULT_ERROR_GOT_INVALID_ROM_COMMAND;
               break;
@@ -588,3 +640,61 @@ ows_wait_for_function_transaction (uint8_t *command_ptr, uint8_t jgur)
     }
   }
 }
+
+static ows_result_t
+write_register_block (ows_function_command_t const *entry)
+{
+  uint16_t crc = OWS_CRC16_INITIAL_VALUE;
+  CPE (ows_write_block (entry->block, entry->block_size, &crc));
+
+  uint8_t const crc_bytes[sizeof (crc)] = { HIGH_BYTE (crc), LOW_BYTE (crc) };
+
+  return ows_write_block (crc_bytes, sizeof (crc_bytes), NULL);
+}
+
+ows_result_t
+ows_dispatch_function_transactions (
+    ows_function_command_t const *table,
+    uint8_t entry_count,
+    uint8_t *command_ptr )
+{
+  uint8_t jgur = FALSE;
+
+  while ( TRUE ) {
+
+    ows_result_t result = ows_wait_for_function_transaction (command_ptr, jgur);
+    jgur = FALSE;
+    if ( result == OWS_RESULT_GOT_UNEXPECTED_RESET ) {
+      jgur = TRUE;
+      continue;
+    }
+    if ( result != OWS_RESULT_SUCCESS ) {
+      return result;
+    }
+
+    ows_function_command_t const *entry = NULL;
+    for ( uint8_t ii = 0 ; ii < entry_count ; ii++ ) {
+      if ( table[ii].command == *command_ptr ) {
+        entry = &(table[ii]);
+        break;
+      }
+    }
+    if ( UNLIKELY (entry == NULL) ) {
+      return OWS_RESULT_GOT_UNKNOWN_FUNCTION_COMMAND;
+    }
+
+    if ( entry->handler == NULL ) {
+      result = write_register_block (entry);
+    }
+    else {
+      result = entry->handler (*command_ptr);
+    }
+
+    if ( result == OWS_RESULT_GOT_UNEXPECTED_RESET ) {
+      jgur = TRUE;
+    }
+    else if ( result != OWS_RESULT_SUCCESS ) {
+      return result;
+    }
+  }
+}
@@ -243,7 +243,9 @@
   /* continue operation when they hear talk addressed to another slave.  */  \
   X (OWS_RESULT_ROM_ID_MISMATCH)                                             \
   /* Only master misbehavior or noise should cause this one.  */             \
-  X (OWS_RESULT_ERROR_GOT_INVALID_ROM_COMMAND)
+  X (OWS_RESULT_ERROR_GOT_INVALID_ROM_COMMAND)                               \
+  /* See ows_dispatch_function_transactions().  */                           \
+  X (OWS_RESULT_GOT_UNKNOWN_FUNCTION_COMMAND)
 
 // Return type representing the result of an operation.
 typedef enum {
@@ -331,6 +333,15 @@ ows_set_timeout (uint16_t time_us);
 // slave searches (i.e. respond to any incoming OWC_SEARCH_ROM_COMMAND or
 // OWC_ALARM_SEARCH_COMMAND commands).
 //
+// Overdrive speed is not supported.  At overdrive speed a slave has to
+// start pulling the line low within about 1 us of the start of a time slot,
+// but even at 16 MHz it takes us about 4 us just to notice the falling
+// edge and get ready to respond (see the comments in read_bit() in
+// one_wire_slave.c), so this isn't something tighter code can fix.  If
+// OWC_OVERDRIVE_SKIP_ROM_COMMAND or OWC_OVERDRIVE_MATCH_ROM_COMMAND is
+// received, we behave like other standard speed slaves and ignore the bus
+// until the next standard speed reset pulse.
+//
 // The jgur (Just Got Unexpected Reset) argument should be FALSE unless
 // you just got an unexpected reset (see below).
 //
@@ -382,6 +393,73 @@ ows_write_byte (uint8_t byte_value);
 ows_result_t
 ows_read_byte (uint8_t *byte_value_ptr);
 
+// Initial value for the CRC16 accumulated by ows_write_block() and
+// ows_read_block() (as specified for _crc16_update() from AVR libc, and as
+// used by the one_wire_master_logger.h and one_wire_slave_logger.h
+// interfaces).
+#define OWS_CRC16_INITIAL_VALUE 0xFFFF
+
+// Write the count bytes at data (when the master requests them).  This is
+// a convenience equivalent to a loop of ows_write_byte() calls (it still
+// transfers and checks the result for each byte separately, so the master
+// must leave the same gaps between bytes).  If crc_ptr isn't NULL, each
+// byte written is also folded into *crc_ptr using _crc16_update() from AVR
+// libc (after the byte is written, so the master's inter-byte gap must
+// allow for that as well).  Returns OWS_RESULT_TIMEOUT or
+// OWS_RESULT_GOT_UNEXPECTED_RESET on error (in which case *crc_ptr is
+// unchanged), or OWS_RESULT_SUCCESS otherwise.  READ THE ENTIRE TEXT AT THE
+// TOP OF THIS FILE.
+ows_result_t
+ows_write_block (uint8_t const *data, uint8_t count, uint16_t *crc_ptr);
+
+// Like ows_write_block(), but read count bytes sent by the master into buf
+// (and accumulate their CRC16 in *crc_ptr, if crc_ptr isn't NULL).
+ows_result_t
+ows_read_block (uint8_t *buf, uint8_t count, uint16_t *crc_ptr);
+
+// Type of the function command handlers used by
+// ows_dispatch_function_transactions().  The handler gets the command that
+// selected it, and should use the other functions in this interface to
+// carry out the rest of the transaction, returning OWS_RESULT_SUCCESS or
+// the first error that occurs.
+typedef ows_result_t (*ows_function_command_handler_t)(uint8_t command);
+
+// Entry in a function command dispatch table.  If handler is NULL, the
+// command is treated as a register read: the block_size bytes at block are
+// written to the master using ows_write_block(), followed by their CRC16
+// (starting from OWS_CRC16_INITIAL_VALUE, high byte first).  Otherwise
+// block and block_size are ignored and handler is called.
+typedef struct {
+  uint8_t command;
+  ows_function_command_handler_t handler;
+  uint8_t const *block;
+  uint8_t block_size;
+} ows_function_command_t;
+
+// Repeatedly call ows_wait_for_function_transaction() and service each
+// function command received using the matching entry of the entry_count
+// entry table.  Unexpected resets (whether they occur while waiting or
+// during a handler) are dealt with automatically.  This function only
+// returns when something else happens:
+//
+//   * OWS_RESULT_TIMEOUT if a timeout occurs while waiting for a
+//     transaction (see ows_set_timeout()), so the caller can do other work
+//     and then call this function again.
+//
+//   * OWS_RESULT_GOT_UNKNOWN_FUNCTION_COMMAND if a function command that
+//     isn't in the table arrives.  The command is stored in *command_ptr.
+//     The rest of the transaction is ignored if this function is called
+//     again.
+//
+//   * Any other error returned by ows_wait_for_function_transaction() or by
+//     a handler.
+//
+ows_result_t
+ows_dispatch_function_transactions (
+    ows_function_command_t const *table,
+    uint8_t entry_count,
+    uint8_t *command_ptr );
+
 // If set to a non-zero value, this flag indicates an alarm condition.
 // Clients of this interface can ascribe particular meanings to particular
 // non-zero values if desired.  Slaves with an alarm condition will respond
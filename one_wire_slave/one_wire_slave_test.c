@@ -50,8 +50,8 @@ char result_buf[OWS_RESULT_DESCRIPTION_MAX_LENGTH + 1];
 #define OWS_CHECK(result)                                        \
   PFP_ASSERT_SUCCESS (result, ows_result_as_string, result_buf);
 
-static void
-send_fake_ds18b20_scratchpad_contents (void)
+static ows_result_t
+send_fake_ds18b20_scratchpad_contents (uint8_t command)
 {
   // Send the appropriate response to a read scratchpad command from the
   // master, at least as far as the one_wire_master_test.c program cares.
@@ -59,26 +59,56 @@ send_fake_ds18b20_scratchpad_contents (void)
   // the CRC that a real DS18B20 would send.  Of course, in real life one
   // would want to use a CRC of some sort.
 
-  // Temperature least and most significant bits st the temperature comes
-  // out to 42.0 degrees C (see Fig. 2 of Maxim DS18B20 datasheet).
-  uint8_t const t_lsb = B10100000;
-  uint8_t const t_msb = B00000010;
+  // The first two bytes are the temperature least and most significant
+  // bits st the temperature comes out to 42.0 degrees C (see Fig. 2 of
+  // Maxim DS18B20 datasheet).  The test program that supposed to be running
+  // on the master doesn't care about anything except the temperature bytes,
+  // so we just send 0 for the remaining bytes.
+  uint8_t const scratchpad[9]
+    = { B10100000, B00000010, 0, 0, 0, 0, 0, 0, 0 };
 
-  OWS_CHECK (ows_write_byte (t_lsb));
-  OWS_CHECK (ows_write_byte (t_msb));
+  // We should only be called for the command we handle
+  assert (command == DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND);
 
-  // Remaining Scratchpad Size (after temp. bytes).  This is a property of
-  // the DS18B20.
-  uint8_t const rss = 7;
+  return ows_write_block (scratchpad, sizeof (scratchpad), NULL);
+}
 
-  // The test program that supposed to be running on the master doesn't care
-  // about anything except the temperature bytes, so we just send 0 for the
-  // remaining bytes.
-  for ( uint8_t ii = 0 ; ii < rss ; ii++ ) {
-    OWS_CHECK (ows_write_byte (0));
-  }
+static ows_result_t
+fake_ds18b20_convert_t (uint8_t command)
+{
+  // Here we dodge a significant issue that comes up with slaves implemented
+  // using this module.  Because we're just making up a number, we convert
+  // instantly, so we can immediately send the one that the DS18B20 sends
+  // when it's done converting.  In reality, this conversion would take
+  // time, and the send-0-until-done-then-send-1 approach that the real
+  // DS18B20 uses is not implementable with this module: see the header
+  // comments in one_wire_slave.h for the reasons for this and what to do
+  // instead.
+
+  assert (command == DS18B20_COMMANDS_CONVERT_T_COMMAND);
+
+  return ows_write_bit (1);
 }
 
+// Function commands we support, for ows_dispatch_function_transactions().
+// A command that just sends back a fixed block of data (with a CRC16)
+// could use an entry with a NULL handler instead.
+static ows_function_command_t const function_commands[] = {
+  { DS18B20_COMMANDS_CONVERT_T_COMMAND,
+    fake_ds18b20_convert_t, NULL, 0 },
+  { DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND,
+    send_fake_ds18b20_scratchpad_contents, NULL, 0 }
+};
+
+#define FUNCTION_COMMAND_COUNT \
+  (sizeof (function_commands) / sizeof (function_commands[0]))
+
+// Number of function transactions to serve by calling
+// ows_wait_for_function_transaction() directly, before switching to
+// ows_dispatch_function_transactions().  Each pass of the
+// one_wire_master_test.c program does a handful of them.
+#define DIRECT_FUNCTION_TRANSACTION_COUNT 42
+
 int
 main (void)
 {
@@ -151,9 +181,14 @@ main (void)
   // get presence pulses in time).
   ows_set_timeout (OWS_MIN_TIMEOUT_US);
 
+  // The first few passes of the one_wire_master_test.c program are served
+  // using ows_wait_for_function_transaction() directly, and the rest using
+  // ows_dispatch_function_transactions() (which is built on it).  The
+  // master output should look the same throughout.
+
   uint8_t jgur = FALSE;   // Gets set TRUE iff we Just Got an Unexpected Reset
 
-  for ( ; ; ) {
+  for ( uint8_t ii = 0 ; ii < DIRECT_FUNCTION_TRANSACTION_COUNT ; ) {
 
     result = ows_wait_for_function_transaction (&fcmd, jgur);
 
@@ -191,19 +226,11 @@ main (void)
     switch ( fcmd ) {
 
       case DS18B20_COMMANDS_CONVERT_T_COMMAND:
-        // Here we dodge a significant issue that comes up with slaves
-        // implemented using this module.  Because we're just making up a
-        // number, we convert instantly, so we can immediately send the one
-        // that the DS18B20 sends when it's done converting.  In reality, this
-        // conversion would take time, and the send-0-until-done-then-send-1
-        // approach that the real DS18B20 uses is not implementable with
-        // this module: see the header comments in one_wire_slave.h for the
-        // reasons for this and what to do instead.
-        ows_write_bit (1);
+        OWS_CHECK (fake_ds18b20_convert_t (fcmd));
         break;
 
       case DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND:
-        send_fake_ds18b20_scratchpad_contents ();
+        OWS_CHECK (send_fake_ds18b20_scratchpad_contents (fcmd));
         break;
 
       default:
@@ -212,6 +239,31 @@ main (void)
 
     }
 
+    ii++;
+  }
+
+  for ( ; ; ) {
+
+    // Unexpected resets are handled inside this call (see the similar
+    // comment in the loop above).
+    result
+      = ows_dispatch_function_transactions (
+          function_commands, FUNCTION_COMMAND_COUNT, &fcmd );
+
+    if ( result != OWS_RESULT_TIMEOUT ) {
+      // For diagnostic purposes we do this.  Normally printing something
+      // out at this point might take too much time that could otherwise be
+      // spent eating the error and waiting for the line to sort itself out :)
+      PFP ("\n");
+      PFP (
+          "Unexpected ows_dispatch_function_transactions() result: %s "
+          "(command 0x%02x)",
+          ows_result_as_string (result, result_buf),
+          fcmd );
+      PFP ("\n");
+      PFP_ASSERT_NOT_REACHED ();
+    }
+
   }
 
 }
@@ -0,0 +1 @@
+../one_wire_master/ds18b20_commands.h
\ No newline at end of file
@@ -0,0 +1,574 @@
+// Implementation of the interface described in one_wire_slave_async.h.
+
+#include <assert.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdlib.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include <util/delay.h>
+
+#include "dio.h"
+#include "one_wire_common.h"
+#include "one_wire_slave_async.h"
+#include "timer1_stopwatch.h"
+#include "util.h"
+
+#if TIMER1_STOPWATCH_PRESCALER_DIVIDER > F_CPU / 1000000UL
+#  error TIMER1_STOPWATCH_PRESCALER_DIVIDER too large for this interface
+#endif
+
+// Aliases for some operations from one_wire_commoh.h (for readability).
+#define RELEASE_LINE()    OWC_RELEASE_LINE (OWSA_PIN)
+#define DRIVE_LINE_LOW()  OWC_DRIVE_LINE_LOW (OWSA_PIN)
+#define SAMPLE_LINE()     OWC_SAMPLE_LINE (OWSA_PIN)
+
+// Convert an integer number of microseconds to timer1 ticks (the same as
+// US2T1T() in one_wire_slave.c).
+#define US2T1T(us) \
+  (us * CLOCK_CYCLES_PER_MICROSECOND () / TIMER1_STOPWATCH_PRESCALER_DIVIDER)
+
+// Slave timing constants (all in microseconds).  These mostly follow the
+// ST_* values in one_wire_slave.c (which mimic the DS18B20).  Low pulses
+// shorter than SLOT_BIT_THRESHOLD are master ones (or read slot starts),
+// longer ones are master zeros.  When we write a zero we hold the line low
+// until ZERO_HOLD after the start of the slot, which is well after the
+// master samples it (OWC_TICK_DELAY_A + OWC_TICK_DELAY_E) but before the
+// slot ends (OWC_TICK_DELAY_A + OWC_TICK_DELAY_E + OWC_TICK_DELAY_F).
+#define RESET_PULSE_LENGTH_REQUIRED 240
+#define DELAY_BEFORE_PRESENCE_PULSE  28
+#define PRESENCE_PULSE_LENGTH       116
+#define SLOT_BIT_THRESHOLD           30
+#define ZERO_HOLD                    60
+
+// Time allowed for the line to rise after we release it (so we don't
+// mistake our own rising edge for one caused by the master).
+#define RELEASE_SETTLE_TIME 2.0
+
+typedef enum {
+  STATE_IDLE,               // Ignoring everything until the next reset
+  STATE_PRESENCE,           // Sending presence pulse
+  STATE_ROM_COMMAND,        // Receiving ROM command
+  STATE_READ_ROM,           // Sending our ROM ID
+  STATE_MATCH_ROM,          // Comparing master's ROM ID to ours
+  STATE_SEARCH_ROM,         // Taking part in a (possibly alarm) search
+  STATE_FUNCTION_COMMAND,   // Receiving function command
+  STATE_APPLICATION         // Function command delivered, app in charge
+} state_t;
+
+// What to do in the next time slot.
+typedef enum {
+  SLOT_IGNORE,
+  SLOT_READ,
+  SLOT_WRITE_ONE,
+  SLOT_WRITE_ZERO
+} slot_action_t;
+
+// Things the timer1 compare match A interrupt can be scheduled to do.
+typedef enum {
+  ACTION_RELEASE_ZERO,      // End a zero bit we're writing
+  ACTION_PRESENCE_START,    // Start presence pulse
+  ACTION_PRESENCE_END       // End presence pulse
+} action_t;
+
+typedef enum {
+  TRANSFER_NONE,
+  TRANSFER_READ,
+  TRANSFER_WRITE
+} transfer_t;
+
+volatile uint8_t owsa_alarm = FALSE;
+
+static uint8_t rom_id[OWC_ID_SIZE_BYTES];
+static owsa_command_callback_t command_callback;
+
+// One-deep function command mailbox (used when command_callback is NULL).
+static volatile uint8_t mailbox_full = FALSE;
+static volatile uint8_t mailbox_command;
+
+// Protocol engine state.  Only touched from the ISRs, except for the
+// transfer setup done by owsa_write_bytes() and owsa_read_bytes() (which
+// do it atomically).
+static volatile state_t state = STATE_IDLE;
+static slot_action_t slot_action = SLOT_IGNORE;
+static action_t action;
+static uint8_t driving = FALSE;        // TRUE while we're holding line low
+static uint8_t last_level;             // Last line level we acted on
+static uint16_t fall_time;             // Timer1 count at last falling edge
+static uint8_t command;                // ROM or function command buffer
+
+// Byte transfer cursor (used for ROM commands and IDs as well as for the
+// application transfers).
+static uint8_t const *out_data;
+static uint8_t *in_data;
+static uint8_t xfer_count;
+static uint8_t byte_index;
+static uint8_t bit_mask;
+
+static uint8_t search_bit_index;       // Index of bit being searched on
+static uint8_t search_phase;           // 0 = bit, 1 = complement, 2 = dir
+
+static volatile transfer_t transfer = TRANSFER_NONE;
+static owsa_done_callback_t done_callback;
+
+// Evaluate to the value of Bit Number bn (0-indexed) of rom_id.
+#define ROM_ID_BIT(bn) \
+  (((rom_id[bn / BITS_PER_BYTE]) >> (bn % BITS_PER_BYTE)) & B00000001)
+
+static void
+schedule (uint16_t when, action_t new_action)
+{
+  // Arrange for the timer1 compare match A ISR to perform new_action when
+  // timer1 reaches when.
+
+  action = new_action;
+  OCR1A = when;
+  // Writing a logic one clears the flag (so no "|=" is required).
+  TIFR1 = _BV (OCF1A);
+  TIMSK1 |= _BV (OCIE1A);
+}
+
+static void
+release_line (void)
+{
+  // Stop driving the line low, and note the level it settles to.  If the
+  // master is still holding it low we keep fall_time as it was, so a reset
+  // pulse that started during our own low pulse is still measured
+  // correctly.  If the line went high, the pin change was our own doing,
+  // so its interrupt flag is cleared (the pin change ISR takes any other
+  // interrupt that finds the line still high to mean a short slot it was
+  // too late to see start).  The master always waits much longer than
+  // RELEASE_SETTLE_TIME after we release a zero or a presence pulse before
+  // starting another slot, so this can't hide one of its edges.
+
+  RELEASE_LINE ();
+  driving = FALSE;
+  _delay_us (RELEASE_SETTLE_TIME);
+  last_level = SAMPLE_LINE ();
+  if ( last_level == HIGH ) {
+    DIO_CLEAR_PIN_CHANGE_INTERRUPT_FLAG (OWSA_PIN);
+  }
+}
+
+static void
+start_cursor (uint8_t const *out, uint8_t *in, uint8_t count)
+{
+  out_data = out;
+  in_data = in;
+  xfer_count = count;
+  byte_index = 0;
+  bit_mask = B00000001;
+}
+
+static uint8_t
+advance_cursor (void)
+{
+  // Move on to the next bit, returning TRUE iff we're out of bits.
+
+  bit_mask <<= 1;
+  if ( bit_mask == 0 ) {
+    bit_mask = B00000001;
+    byte_index++;
+  }
+
+  return byte_index == xfer_count;
+}
+
+static void
+store_bit (uint8_t bit)
+{
+  if ( bit_mask == B00000001 ) {
+    in_data[byte_index] = 0;
+  }
+  if ( bit ) {
+    in_data[byte_index] |= bit_mask;
+  }
+}
+
+static void
+set_write_slot (uint8_t bit)
+{
+  slot_action = (bit ? SLOT_WRITE_ONE : SLOT_WRITE_ZERO);
+}
+
+static void
+set_next_write_slot (void)
+{
+  set_write_slot (out_data[byte_index] & bit_mask);
+}
+
+static void
+enter_state (state_t new_state)
+{
+  state = new_state;
+
+  switch ( new_state ) {
+    case STATE_ROM_COMMAND:
+    case STATE_FUNCTION_COMMAND:
+      start_cursor (NULL, &command, 1);
+      slot_action = SLOT_READ;
+      break;
+    case STATE_READ_ROM:
+      start_cursor (rom_id, NULL, OWC_ID_SIZE_BYTES);
+      set_next_write_slot ();
+      break;
+    case STATE_MATCH_ROM:
+      start_cursor (rom_id, NULL, OWC_ID_SIZE_BYTES);
+      slot_action = SLOT_READ;
+      break;
+    case STATE_SEARCH_ROM:
+      search_bit_index = 0;
+      search_phase = 0;
+      set_write_slot (ROM_ID_BIT (0));
+      break;
+    default:
+      slot_action = SLOT_IGNORE;
+      break;
+  }
+}
+
+static void
+finish_transfer (uint8_t completed)
+{
+  owsa_done_callback_t callback = done_callback;
+
+  transfer = TRANSFER_NONE;
+  slot_action = SLOT_IGNORE;
+  if ( callback != NULL ) {
+    callback (completed);
+  }
+}
+
+static void
+handle_rom_command (void)
+{
+  switch ( command ) {
+    case OWC_READ_ROM_COMMAND:
+      enter_state (STATE_READ_ROM);
+      break;
+    case OWC_MATCH_ROM_COMMAND:
+      enter_state (STATE_MATCH_ROM);
+      break;
+    case OWC_SKIP_ROM_COMMAND:
+      enter_state (STATE_FUNCTION_COMMAND);
+      break;
+    case OWC_SEARCH_ROM_COMMAND:
+      enter_state (STATE_SEARCH_ROM);
+      break;
+    case OWC_ALARM_SEARCH_COMMAND:
+      enter_state (owsa_alarm ? STATE_SEARCH_ROM : STATE_IDLE);
+      break;
+    default:
+      // This includes the overdrive ROM commands, which we don't support.
+      enter_state (STATE_IDLE);
+      break;
+  }
+}
+
+static void
+handle_function_command (void)
+{
+  enter_state (STATE_APPLICATION);
+
+  if ( command_callback != NULL ) {
+    command_callback (command);
+  }
+  else {
+    mailbox_command = command;
+    mailbox_full = TRUE;
+  }
+}
+
+static void
+handle_search_slot (uint8_t bit)
+{
+  // Each bit of a search takes three slots: we write our ID bit, then its
+  // complement, then read the master's chosen direction.
+
+  uint8_t id_bit = ROM_ID_BIT (search_bit_index);
+
+  switch ( search_phase ) {
+    case 0:
+      search_phase = 1;
+      set_write_slot (! id_bit);
+      break;
+    case 1:
+      search_phase = 2;
+      slot_action = SLOT_READ;
+      break;
+    default:
+      if ( bit != id_bit ) {
+        // Master went the other way, so we're out of this search.
+        enter_state (STATE_IDLE);
+        break;
+      }
+      search_bit_index++;
+      if ( search_bit_index == OWC_ID_SIZE_BYTES * BITS_PER_BYTE ) {
+        // Search found us.  A real DS18B20 would now expect a function
+        // command, but one_wire_slave.h doesn't do that either, and no
+        // master we know of relies on it.
+        enter_state (STATE_IDLE);
+        break;
+      }
+      search_phase = 0;
+      set_write_slot (ROM_ID_BIT (search_bit_index));
+      break;
+  }
+}
+
+static void
+slot_done (uint8_t bit)
+{
+  // Called at the end of each time slot we took part in, with the bit
+  // value the slot carried.
+
+  switch ( state ) {
+    case STATE_ROM_COMMAND:
+      store_bit (bit);
+      if ( advance_cursor () ) {
+        handle_rom_command ();
+      }
+      break;
+    case STATE_FUNCTION_COMMAND:
+      store_bit (bit);
+      if ( advance_cursor () ) {
+        handle_function_command ();
+      }
+      break;
+    case STATE_READ_ROM:
+      if ( advance_cursor () ) {
+        enter_state (STATE_FUNCTION_COMMAND);
+      }
+      else {
+        set_next_write_slot ();
+      }
+      break;
+    case STATE_MATCH_ROM:
+      if ( bit != ! ! (out_data[byte_index] & bit_mask) ) {
+        enter_state (STATE_IDLE);
+      }
+      else if ( advance_cursor () ) {
+        enter_state (STATE_FUNCTION_COMMAND);
+      }
+      break;
+    case STATE_SEARCH_ROM:
+      handle_search_slot (bit);
+      break;
+    case STATE_APPLICATION:
+      if ( transfer == TRANSFER_READ ) {
+        store_bit (bit);
+      }
+      if ( advance_cursor () ) {
+        finish_transfer (TRUE);
+      }
+      else if ( transfer == TRANSFER_WRITE ) {
+        set_next_write_slot ();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+handle_reset (void)
+{
+  state = STATE_PRESENCE;
+  slot_action = SLOT_IGNORE;
+  schedule (
+      TIMER1_STOPWATCH_TICKS () + US2T1T (DELAY_BEFORE_PRESENCE_PULSE),
+      ACTION_PRESENCE_START );
+
+  // Any transfer in progress is abandoned.
+  if ( transfer != TRANSFER_NONE ) {
+    finish_transfer (FALSE);
+  }
+}
+
+ISR (DIO_PIN_CHANGE_INTERRUPT_VECTOR (OWSA_PIN))
+{
+  uint16_t now = TIMER1_STOPWATCH_TICKS ();
+
+  if ( driving ) {
+    return;
+  }
+
+  uint8_t level = SAMPLE_LINE ();
+  if ( level == last_level ) {
+    if ( level == HIGH ) {
+      // The line went low and came back up before we could sample it.
+      // Our own rising edges don't get here (see release_line()), so this
+      // was a master low pulse short enough to be a write-one slot or the
+      // start of a read slot (they only last about OWC_TICK_DELAY_A).
+      // The slot is counted anyway, so we stay in step with the master for
+      // the rest of the transfer.  If we were supposed to write a zero it's
+      // too late now, and the master reads a one (which its CRC check or
+      // search logic will notice).
+      if ( slot_action == SLOT_READ || slot_action == SLOT_WRITE_ONE ) {
+        slot_done (1);
+      }
+      else if ( slot_action == SLOT_WRITE_ZERO ) {
+        slot_done (0);
+      }
+    }
+    return;
+  }
+  last_level = level;
+
+  if ( level == LOW ) {
+    fall_time = now;
+    if ( slot_action == SLOT_WRITE_ZERO ) {
+      DRIVE_LINE_LOW ();
+      driving = TRUE;
+      schedule (fall_time + US2T1T (ZERO_HOLD), ACTION_RELEASE_ZERO);
+    }
+    return;
+  }
+
+  uint16_t width = now - fall_time;
+
+  if ( width >= US2T1T (RESET_PULSE_LENGTH_REQUIRED) ) {
+    handle_reset ();
+  }
+  else if ( slot_action == SLOT_READ ) {
+    slot_done (width < US2T1T (SLOT_BIT_THRESHOLD));
+  }
+  else if ( slot_action == SLOT_WRITE_ONE ) {
+    slot_done (1);
+  }
+}
+
+ISR (TIMER1_COMPA_vect)
+{
+  TIMSK1 &= ~(_BV (OCIE1A));
+
+  switch ( action ) {
+    case ACTION_RELEASE_ZERO:
+      release_line ();
+      slot_done (0);
+      break;
+    case ACTION_PRESENCE_START:
+      DRIVE_LINE_LOW ();
+      driving = TRUE;
+      schedule (
+          TIMER1_STOPWATCH_TICKS () + US2T1T (PRESENCE_PULSE_LENGTH),
+          ACTION_PRESENCE_END );
+      break;
+    case ACTION_PRESENCE_END:
+      release_line ();
+      enter_state (STATE_ROM_COMMAND);
+      break;
+  }
+}
+
+void
+owsa_init (uint8_t const *part_id, owsa_command_callback_t callback)
+{
+  uint8_t crc = 0;
+  for ( uint8_t ii = 0 ; ii < OWC_ID_SIZE_BYTES - 1 ; ii++ ) {
+    rom_id[ii] = part_id[ii];
+    crc = _crc_ibutton_update (crc, rom_id[ii]);
+  }
+  rom_id[OWC_ID_SIZE_BYTES - 1] = crc;
+
+  command_callback = callback;
+  mailbox_full = FALSE;
+  transfer = TRANSFER_NONE;
+  enter_state (STATE_IDLE);
+
+  RELEASE_LINE ();
+  driving = FALSE;
+  last_level = SAMPLE_LINE ();
+
+  timer1_stopwatch_init ();
+
+  DIO_ENABLE_PIN_CHANGE_INTERRUPT (OWSA_PIN);
+
+  sei ();
+}
+
+uint8_t
+owsa_get_command (uint8_t *command_ptr)
+{
+  uint8_t result = FALSE;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    if ( mailbox_full ) {
+      *command_ptr = mailbox_command;
+      mailbox_full = FALSE;
+      result = TRUE;
+    }
+  }
+
+  return result;
+}
+
+static uint8_t
+start_transfer (
+    transfer_t type,
+    uint8_t const *out,
+    uint8_t *in,
+    uint8_t count,
+    owsa_done_callback_t callback )
+{
+  assert (count > 0);
+
+  uint8_t result = FALSE;
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    assert (transfer == TRANSFER_NONE);
+    if ( state == STATE_APPLICATION ) {
+      transfer = type;
+      done_callback = callback;
+      start_cursor (out, in, count);
+      if ( type == TRANSFER_WRITE ) {
+        set_next_write_slot ();
+      }
+      else {
+        slot_action = SLOT_READ;
+      }
+      result = TRUE;
+    }
+  }
+
+  return result;
+}
+
+uint8_t
+owsa_write_bytes (
+    uint8_t const *data,
+    uint8_t count,
+    owsa_done_callback_t callback )
+{
+  return start_transfer (TRANSFER_WRITE, data, NULL, count, callback);
+}
+
+uint8_t
+owsa_read_bytes (uint8_t *buf, uint8_t count, owsa_done_callback_t callback)
+{
+  return start_transfer (TRANSFER_READ, NULL, buf, count, callback);
+}
+
+uint8_t
+owsa_transfer_in_progress (void)
+{
+  return transfer != TRANSFER_NONE;
+}
+
+void
+owsa_shutdown (void)
+{
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    DIO_DISABLE_PIN_CHANGE_INTERRUPT (OWSA_PIN);
+    TIMSK1 &= ~(_BV (OCIE1A));
+    RELEASE_LINE ();
+    driving = FALSE;
+    transfer = TRANSFER_NONE;
+    enter_state (STATE_IDLE);
+  }
+
+  timer1_stopwatch_shutdown ();
+}
@@ -0,0 +1,165 @@
+// Interrupt-driven (background) 1-wire slave
+//
+// Test driver: one_wire_slave_async_test.c    Implementation: one_wire_slave_async.c
+//
+// The one_wire_slave.h interface only notices bus activity while a call
+// into it is in progress, so a slave built on it can't do anything else
+// while it waits for the master (and is deaf to the master while it's doing
+// anything else).  This interface instead runs the slave side of the
+// protocol entirely from interrupts: a pin change interrupt on OWSA_PIN
+// timestamps each edge on the wire (using timer1 as a free-running
+// counter), and the timer1 output compare A interrupt schedules the end of
+// each zero bit the slave writes and the presence pulses it sends.  Reset
+// pulses, presence pulses, and all the ROM commands (including SEARCH ROM
+// and ALARM SEARCH) are handled in the background.  The foreground code
+// only hears about a transaction once the master has sent a function
+// command addressed to this slave.
+//
+// Function commands are delivered either to a callback (which runs in
+// interrupt context) or, if no callback is given, to a one-deep mailbox
+// which the foreground code can poll with owsa_get_command().  The rest of
+// the transaction is then carried out with owsa_write_bytes() and
+// owsa_read_bytes(), which also return immediately and report completion
+// via a callback.  For example, a slave that answers READ SCRATCHPAD might
+// look like this:
+//
+//   static uint8_t scratchpad[9];   // Including CRC, kept up to date
+//
+//   static void
+//   handle_command (uint8_t command)
+//   {
+//     if ( command == DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND ) {
+//       owsa_write_bytes (scratchpad, sizeof (scratchpad), NULL);
+//     }
+//   }
+//
+//   owsa_init (part_id, handle_command);
+//   for ( ; ; ) {
+//     // Do other useful work, like keeping scratchpad up to date
+//   }
+//
+// Timing: the master's low pulse at the start of a read slot (and the whole
+// low part of a write-one slot) only lasts about 6 us (OWC_TICK_DELAY_A).
+// The pin change ISR has to sample the line while that pulse is still in
+// progress, both to see the slot and (for read slots in which a zero is
+// to be written) to start driving the line before the master lets go of
+// it.  So the time from the falling edge to the sample in the ISR, which
+// includes the couple of microseconds of ISR entry and prologue, must be
+// less than about 6 us.  This means that other interrupts (and
+// ATOMIC_BLOCK sections in the foreground) must never delay this
+// interface's ISRs by more than two or three microseconds.  In particular,
+// the term_io.h interface is fine (it doesn't use interrupts), but
+// long-running ISRs are not.  If a short pulse is missed anyway, the slot
+// is still counted, so the slave stays in step with the master, but a
+// zero the slave was to write in it reads as a one.  This interface has
+// been designed for 16 MHz operation.  The first slot after
+// a function command (or after a completed owsa_read_bytes() or
+// owsa_write_bytes() operation) is another timing hazard: if the next
+// transfer hasn't been started by then, the slot is missed (read slots
+// read as ones, write slots are ignored).  The command callback runs right
+// after the final bit of the command is received, so starting a transfer
+// from it (or from a done callback) is usually fast enough.  If polling
+// with owsa_get_command() is used, the transaction protocol must require
+// the master to wait long enough for the foreground loop to react.  This
+// is similar to the recovery time advice in one_wire_slave.h, but the
+// delays required are potentially much longer.
+//
+// Unlike one_wire_slave.h, this interface doesn't need any variables
+// locked into registers, so no special CFLAGS are required.
+//
+// WARNING: this interface uses timer1 (which it runs continuously with
+// the TIMER1_STOPWATCH_PRESCALER_DIVIDER prescaler) and the timer1 compare
+// match A interrupt, so it can't be used together with anything else that
+// uses timer1 (the one_wire_slave.h or timer1_stopwatch.h interfaces
+// for example).  TIMER1_STOPWATCH_PRESCALER_DIVIDER must be defined
+// such that each timer tick is no more than 1 us long (for example
+// -DTIMER1_STOPWATCH_PRESCALER_DIVIDER=8 works for 16 MHz).
+//
+// WARNING: this interface owns the pin change interrupt vector for the
+// port containing OWSA_PIN, so no other pin in the same port can use pin
+// change interrupts.
+//
+// WARNING: overdrive speed isn't supported (the reaction time required is
+// only about 1 us).  The overdrive ROM commands are treated like any other
+// unknown command: the slave ignores the bus until the next reset pulse.
+
+#ifndef ONE_WIRE_SLAVE_ASYNC_H
+#define ONE_WIRE_SLAVE_ASYNC_H
+
+#include "dio.h"
+#include "one_wire_common.h"
+
+#ifndef OWSA_PIN
+#  error OWSA_PIN not defined (it must be explicitly set to one of \
+         the DIO_PIN_* tuple macros before this header is included)
+#endif
+
+#ifndef TIMER1_STOPWATCH_PRESCALER_DIVIDER
+#  error TIMER1_STOPWATCH_PRESCALER_DIVIDER not defined (see above)
+#endif
+
+// Type of the function command callback.  It's called from interrupt
+// context, immediately after the final bit of the command byte has been
+// received.
+typedef void (*owsa_command_callback_t)(uint8_t command);
+
+// Type of the transfer completion callback.  The completed argument is TRUE
+// if the transfer finished, or FALSE if it was abandoned because the
+// master sent a reset pulse first.  It's called from interrupt context,
+// and may start another transfer.
+typedef void (*owsa_done_callback_t)(uint8_t completed);
+
+// If this is set to TRUE, the slave will respond to the ALARM SEARCH
+// command (see the similar ows_alarm in one_wire_slave.h).
+extern volatile uint8_t owsa_alarm;
+
+// Initialize the pin, timer1, and the pin change and timer1 interrupts,
+// and start responding to the master.  The OWC_ID_SIZE_BYTES - 1 byte
+// part_id is the family code followed by the six byte serial number (the
+// CRC byte of the full ROM ID is computed by this function).  If
+// command_callback is NULL, function commands are delivered to the
+// mailbox read by owsa_get_command() instead.  Interrupts are enabled
+// globally (with sei()) by this function.
+void
+owsa_init (uint8_t const *part_id, owsa_command_callback_t command_callback);
+
+// If a function command has arrived since the last call, set *command to
+// it and return TRUE, otherwise return FALSE.  Only meaningful if
+// owsa_init() was called with a NULL command_callback.  A command that
+// isn't collected before the next one arrives is lost.
+uint8_t
+owsa_get_command (uint8_t *command);
+
+// Start writing count bytes from data to the master (LSB of each byte
+// first), one byte per eight master read slots.  The data must stay valid
+// (and unchanged) until the transfer completes.  The done callback may be
+// NULL.  Returns TRUE if the transfer was started, or FALSE if the slave
+// isn't currently in the function phase of a transaction (because the
+// master has reset the bus since the function command, for example).
+// The count must be greater than zero, and no other transfer may be in
+// progress.
+uint8_t
+owsa_write_bytes (
+    uint8_t const *data,
+    uint8_t count,
+    owsa_done_callback_t done_callback );
+
+// Like owsa_write_bytes(), but read count bytes written by the master into
+// buf.  The contents of buf are undefined until the transfer completes.
+uint8_t
+owsa_read_bytes (
+    uint8_t *buf,
+    uint8_t count,
+    owsa_done_callback_t done_callback );
+
+// Return TRUE iff a transfer started with owsa_write_bytes() or
+// owsa_read_bytes() is in progress.
+uint8_t
+owsa_transfer_in_progress (void);
+
+// Disable the interrupts, release the line, and shut down timer1.
+// owsa_init() must be called again before this interface is reused.
+void
+owsa_shutdown (void);
+
+#endif // ONE_WIRE_SLAVE_ASYNC_H
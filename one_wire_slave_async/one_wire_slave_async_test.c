@@ -0,0 +1,170 @@
+// Test/demo for the one_wire_slave_async.h interface.
+//
+// This program implements a simple 1-wire slave device which acts a bit
+// like a Maxim DS18B20 whose temperature slowly rises.  It supports the
+// CONVERT T, READ SCRATCHPAD and WRITE SCRATCHPAD function commands (and
+// of course all the ROM commands, which are handled by the interface).
+// Unlike the one_wire_slave_test.c program, the foreground loop here is
+// free to do other things (in this case counting its own iterations and
+// printing progress messages) while the master is talking to the slave.
+//
+// The physical test setup is the same as for one_wire_slave_test.c: a
+// master Arduino running one_wire_master_test.c (or any other program that
+// talks to a DS18B20), with its data line connected to DIO_PIN_DIGITAL_2
+// of a second Arduino running this program, and the grounds connected.
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <util/crc16.h>
+
+#include "ds18b20_commands.h"
+#include "one_wire_slave_async.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+// DS18B20 family code followed by a made-up serial number.
+static uint8_t const part_id[OWC_ID_SIZE_BYTES - 1]
+  = { 0x28, 0x44, 0x44, 0x44, 0x22, 0x22, 0x22 };
+
+#define SCRATCHPAD_SIZE 9
+
+// Scratchpad contents, in the DS18B20 layout (temperature LSB and MSB,
+// TH, TL, configuration, three reserved bytes, and CRC).  The initial
+// temperature is 42.5 degrees C.
+static uint8_t scratchpad[SCRATCHPAD_SIZE]
+  = { 0xA8, 0x02, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x00 };
+
+// Incoming data for the WRITE SCRATCHPAD command (TH, TL, configuration).
+static uint8_t scratchpad_write_buf[3];
+
+static volatile uint16_t conversions = 0;
+static volatile uint16_t scratchpad_reads = 0;
+static volatile uint16_t scratchpad_writes = 0;
+static volatile uint16_t abandoned_transfers = 0;
+
+static void
+update_scratchpad_crc (void)
+{
+  uint8_t crc = 0;
+  for ( uint8_t ii = 0 ; ii < SCRATCHPAD_SIZE - 1 ; ii++ ) {
+    crc = _crc_ibutton_update (crc, scratchpad[ii]);
+  }
+  scratchpad[SCRATCHPAD_SIZE - 1] = crc;
+}
+
+static void
+scratchpad_read_done (uint8_t completed)
+{
+  if ( completed ) {
+    scratchpad_reads++;
+  }
+  else {
+    abandoned_transfers++;
+  }
+}
+
+static void
+scratchpad_write_done (uint8_t completed)
+{
+  if ( completed ) {
+    scratchpad[2] = scratchpad_write_buf[0];
+    scratchpad[3] = scratchpad_write_buf[1];
+    scratchpad[4] = scratchpad_write_buf[2];
+    update_scratchpad_crc ();
+    scratchpad_writes++;
+  }
+  else {
+    abandoned_transfers++;
+  }
+}
+
+static void
+handle_command (uint8_t command)
+{
+  // Note that this runs in interrupt context, so it starts the transfers
+  // right away, in time for the master's next time slot.
+
+  uint8_t started;
+
+  switch ( command ) {
+    case DS18B20_COMMANDS_CONVERT_T_COMMAND:
+      // Our "conversion" is instantaneous: the master will see ones (i.e.
+      // conversion complete) if it polls for completion.  We bump the
+      // temperature by one 12 bit LSB (1/16 degree C) each time.
+      {
+        uint16_t temp = scratchpad[0] | (((uint16_t) scratchpad[1]) << 8);
+        temp++;
+        scratchpad[0] = temp & 0xFF;
+        scratchpad[1] = temp >> BITS_PER_BYTE;
+        update_scratchpad_crc ();
+      }
+      conversions++;
+      break;
+    case DS18B20_COMMANDS_READ_SCRATCHPAD_COMMAND:
+      started
+        = owsa_write_bytes (
+            scratchpad, SCRATCHPAD_SIZE, scratchpad_read_done );
+      assert (started);
+      break;
+    case DS18B20_COMMANDS_WRITE_SCRATCHPAD_COMMAND:
+      started
+        = owsa_read_bytes (
+            scratchpad_write_buf,
+            sizeof (scratchpad_write_buf),
+            scratchpad_write_done );
+      assert (started);
+      break;
+    default:
+      // Unsupported command, just ignore the rest of the transaction.
+      break;
+  }
+}
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  update_scratchpad_crc ();
+
+  owsa_init (part_id, handle_command);
+  PFP ("Did owsa_init(), slave is now live.\n");
+  PFP ("Start the master, and watch the foreground loop keep running...\n");
+
+  uint32_t idle_iterations = 0;
+  uint16_t last_conversions = 0, last_reads = 0, last_writes = 0;
+  for ( ; ; ) {
+    idle_iterations++;
+    if ( idle_iterations % 100000 == 0 ) {
+      if ( conversions != last_conversions ||
+           scratchpad_reads != last_reads ||
+           scratchpad_writes != last_writes ) {
+        PFP (
+            "%lu foreground iterations, %u conversions, %u scratchpad "
+            "reads, %u scratchpad writes, %u abandoned transfers.\n",
+            idle_iterations,
+            conversions,
+            scratchpad_reads,
+            scratchpad_writes,
+            abandoned_transfers );
+        last_conversions = conversions;
+        last_reads = scratchpad_reads;
+        last_writes = scratchpad_writes;
+      }
+    }
+  }
+}
@@ -1,5 +1,7 @@
 // Implementation of the interface described in one_wire_master_logger.h.
 
+#include <assert.h>
+#include <avr/pgmspace.h>
 #include <string.h>
 
 #include "one_wire_slave.h"
@@ -8,8 +10,6 @@
 //#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
 #include "term_io.h"
 
-#include <util/crc16.h>
-
 // Call call, Propagating Most Failures.  Unexpected resets aren't
 // propagated, but instead end up arming a jgur argument for the next
 // ows_wait_for_function_transaction() call.  This macro may only be used
@@ -26,6 +26,97 @@
     }                                                   \
   } while ( 0 )
 
+// This is the function command code we expect to get from the master to
+// indicate the start of a batch transaction, and the status bytes we send
+// back at the end of it.  Note that the one_wire_master_logger.h must agree
+// to use these values and implement its end of the transaction protocol.
+#define BATCH_FUNCTION_CMD 0x45
+#define BATCH_ACK 0x42
+#define BATCH_NAK 0x24
+
+// Function command the master sends before its first batch after it's
+// been (re)initialized, since it starts its sequence numbers over then.
+// We answer with a BATCH_ACK byte.
+#define SESSION_START_FUNCTION_CMD 0x46
+
+// Sequence number of the last batch we handled, so we can recognize
+// batches resent because our acknowledgement got lost.
+static uint8_t have_last_sequence_number = FALSE;
+static uint8_t last_sequence_number;
+
+// Call call, Propagating Errors.  The call argument must be a call to a
+// function returning ows_result_t.
+#define CPE(call)                                     \
+  do {                                                \
+    ows_result_t XxX_err = call;                      \
+    if ( UNLIKELY (XxX_err != OWS_RESULT_SUCCESS) ) { \
+      return XxX_err;                                 \
+    }                                                 \
+  } while ( 0 )
+
+static ows_result_t
+handle_batch (int (*message_handler)(char const *message), int *mhr_ptr)
+{
+  // Receive a batch of messages, pass any new ones to message_handler, and
+  // acknowledge the batch (or reject it if it's corrupt).  See the batch
+  // framing description in one_wire_master_logger.c.  If message_handler
+  // fails, its result is stored in *mhr_ptr and we return immediately
+  // (without acknowledging the batch), otherwise *mhr_ptr is set to 0.
+
+  *mhr_ptr = 0;
+
+  uint16_t crc = OWS_CRC16_INITIAL_VALUE;
+
+  uint8_t header[2];   // Sequence number and batch length
+  CPE (ows_read_block (header, sizeof (header), &crc));
+  uint8_t sequence_number = header[0], batch_length = header[1];
+
+  uint8_t status = BATCH_NAK;
+
+  if ( batch_length <= OWSL_MAX_BATCH_LENGTH ) {
+
+    char batch[OWSL_MAX_BATCH_LENGTH + 1];
+    CPE (ows_read_block ((uint8_t *) batch, batch_length, &crc));
+    batch[batch_length] = '\0';   // In case the last message isn't
+
+    uint8_t crc_bytes[2];   // CRC High and Low Bytes (as sent by master)
+    CPE (ows_read_block (crc_bytes, sizeof (crc_bytes), NULL));
+    uint16_t received_crc
+      = ((uint16_t) crc_bytes[0] << BITS_PER_BYTE) | ((uint16_t) crc_bytes[1]);
+
+    if ( crc == received_crc ) {
+      status = BATCH_ACK;
+      // As for single messages, we're now busy until we call ows_unbusy().
+      if ( ! ( have_last_sequence_number &&
+               sequence_number == last_sequence_number ) ) {
+        for ( uint8_t ii = 0 ; ii < batch_length ; ) {
+          *mhr_ptr = message_handler (batch + ii);
+          if ( *mhr_ptr != 0 ) {
+            return OWS_RESULT_SUCCESS;
+          }
+          ii += strlen (batch + ii) + 1;
+        }
+        have_last_sequence_number = TRUE;
+        last_sequence_number = sequence_number;
+      }
+    }
+  }
+  else {
+    // The length must have been corrupted.  We can't store the batch, but
+    // we have to let the master finish sending it before we answer.
+    for ( uint16_t ii = 0 ; ii < batch_length + sizeof (crc) ; ii++ ) {
+      uint8_t junk;
+      CPE (ows_read_byte (&junk));
+    }
+  }
+
+  CPE (ows_unbusy ());
+
+  uint8_t const answer[2] = { status, sequence_number };
+
+  return ows_write_block (answer, sizeof (answer), NULL);
+}
+
 int
 owsl_init (int (*message_handler)(char const *message))
 {
@@ -45,30 +136,56 @@ owsl_init (int (*message_handler)(char const *message))
     // its end of the transaction protocol.
     uint8_t const printf_function_cmd = 0x44;
 
+    if ( cmd == SESSION_START_FUNCTION_CMD ) {
+      have_last_sequence_number = FALSE;
+      ows_result_t result = ows_write_byte (BATCH_ACK);
+      if ( result == OWS_RESULT_GOT_UNEXPECTED_RESET ) {
+        goto arm_jgur;
+      }
+      if ( result != OWS_RESULT_SUCCESS ) {
+        return result;
+      }
+      jgur = FALSE;
+      continue;
+    }
+
+    if ( cmd == BATCH_FUNCTION_CMD ) {
+      int mhr;
+      ows_result_t result = handle_batch (message_handler, &mhr);
+      if ( mhr != 0 ) {
+        return mhr;
+      }
+      if ( result == OWS_RESULT_GOT_UNEXPECTED_RESET ) {
+        goto arm_jgur;
+      }
+      if ( result != OWS_RESULT_SUCCESS ) {
+        return result;
+      }
+      jgur = FALSE;
+      continue;
+    }
+
     if ( cmd != printf_function_cmd ) {
       return OWSL_RESULT_ERROR_INVALID_FUNCTION_CMD;
     }
 
-    // CRC (initial value as specified for _crc16_update() from AVR libc)
-    uint16_t crc = 0xffff;
+    uint16_t crc = OWS_CRC16_INITIAL_VALUE;
 
     // Read message length from master
     uint8_t ml;
-    CPMF (ows_read_byte (&ml));
-    crc = _crc16_update (crc, ml);
+    CPMF (ows_read_block (&ml, 1, &crc));
+    if ( ml > OWSL_MAX_MESSAGE_LENGTH ) {
+      return OWSL_RESULT_ERROR_BAD_MESSAGE_LENGTH;
+    }
 
     // Read the message itself from master
     char message_buffer[OWSL_MAX_MESSAGE_LENGTH + 1];
-    for ( uint8_t ii = 0 ; ii < ml ; ii++ ) {
-      CPMF (ows_read_byte (((uint8_t *) message_buffer) + ii));
-      crc = _crc16_update (crc, (uint8_t) (message_buffer[ii]));
-    }
+    CPMF (ows_read_block ((uint8_t *) message_buffer, ml, &crc));
 
-    uint8_t crc_hb, crc_lb;   // CRC High/Low Byte (as sent by master)
-    CPMF (ows_read_byte (&crc_hb));
-    CPMF (ows_read_byte (&crc_lb));
+    uint8_t crc_bytes[2];   // CRC High and Low Bytes (as sent by master)
+    CPMF (ows_read_block (crc_bytes, sizeof (crc_bytes), NULL));
     uint16_t received_crc
-      = ((uint16_t) crc_hb << BITS_PER_BYTE) | ((uint16_t) crc_lb);
+      = ((uint16_t) crc_bytes[0] << BITS_PER_BYTE) | ((uint16_t) crc_bytes[1]);
     if ( crc != received_crc ) {
       return OWSL_RESULT_ERROR_CRC_MISMATCH;
     }
@@ -121,3 +238,40 @@ owsl_relay_via_term_io (char const *message)
 
   return 0;
 }
+
+#ifdef OWS_BUILD_RESULT_DESCRIPTION_FUNCTION
+
+// We hand the buffer on to ows_result_as_string() for ows_result_t values
+#  if OWSL_RESULT_DESCRIPTION_MAX_LENGTH < OWS_RESULT_DESCRIPTION_MAX_LENGTH
+#    error OWSL_RESULT_DESCRIPTION_MAX_LENGTH is too small
+#  endif
+
+char *
+owsl_result_as_string (int result, char *buf)
+{
+  switch ( result ) {
+
+#  define X(result_code)                                                   \
+    case result_code:                                                      \
+      assert (strlen (#result_code) < OWSL_RESULT_DESCRIPTION_MAX_LENGTH); \
+      strcpy_P (buf, PSTR (#result_code));                                 \
+      break;
+    X (OWSL_RESULT_ERROR_INVALID_FUNCTION_CMD)
+    X (OWSL_RESULT_ERROR_CRC_MISMATCH)
+    X (OWSL_RESULT_ERROR_BAD_MESSAGE_LENGTH)
+#  undef X
+
+    default:
+      if ( result < 0 ) {
+        strcpy_P (buf, PSTR ("message_handler failed"));
+      }
+      else {
+        ows_result_as_string ((ows_result_t) result, buf);
+      }
+      break;
+  }
+
+  return buf;
+}
+
+#endif
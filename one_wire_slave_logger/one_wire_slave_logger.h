@@ -26,17 +26,32 @@
 #  define OWSL_MAX_MESSAGE_LENGTH 242
 #endif
 
+// This is the maximum length of a batch of messages (as sent using
+// owml_batch_printf() and owml_flush() from one_wire_master_logger.h).
+// It should match or exceed the OWML_BATCH_BUFFER_SIZE used in
+// one_wire_master_logger.h.  It cannot be defined to be greater than or
+// equal to UINT8_MAX.
+#ifndef OWSL_MAX_BATCH_LENGTH
+#  define OWSL_MAX_BATCH_LENGTH OWSL_MAX_MESSAGE_LENGTH
+#endif
+
 // The owsl_init() command can return these error codes in addition to
 // those defined in ows_result_t.  These errors should only occur in the
 // event of data corruption on the line.  The values are high enough not
 // to intersect with the numeric values defined in ows_result_t :)
 #define OWSL_RESULT_ERROR_INVALID_FUNCTION_CMD 142
 #define OWSL_RESULT_ERROR_CRC_MISMATCH         143
+#define OWSL_RESULT_ERROR_BAD_MESSAGE_LENGTH   144
 
 // Initialize (or reinitialize) the module, and start waiting for messages.
 // The *message_handler should handle the given NULL-byte-terminated message
 // as appropriate (save it, relay it, whatever), then return 0 on success or
-// negative value otherwise.  This function only returns on error, in which
+// negative value otherwise.  Both individual messages (from owml_printf())
+// and batches of messages are accepted.  The messages in a batch are passed
+// to the handler one at a time, in order.  Corrupt batches are rejected
+// (and resent by the master), and duplicate batches (resent because our
+// acknowledgement didn't get through) are acknowledged but not handled
+// again.  This function only returns on error, in which
 // case it returns the (negative) value returned by *message_handler (if
 // it failed), or one of the ows_result_t codes if there's a 1-wire error,
 // or one of the OWSL_RESULT_ERROR_* values otherwise.  Unexpected 1-wire
@@ -44,6 +59,21 @@
 int
 owsl_init (int (*message_handler)(char const *message));
 
+#ifdef OWS_BUILD_RESULT_DESCRIPTION_FUNCTION
+
+#  define OWSL_RESULT_DESCRIPTION_MAX_LENGTH 81
+
+// Put the string form of result (as returned by owsl_init()) in buf.  This
+// handles the OWSL_RESULT_ERROR_* values, passes ows_result_t values along
+// to ows_result_as_string(), and describes anything else as a
+// message_handler failure.  The buf argument must point to a memory space
+// large enough to hold OWSL_RESULT_DESCRIPTION_MAX_LENGTH + 1 bytes.  As a
+// convenience, buf is returned.
+char *
+owsl_result_as_string (int result, char *buf);
+
+#endif
+
 // This is an example of a useful message_handler that can be passed to
 // owsl_init().  This handler just relays the given NULL-byte-terminated
 // message via printf() as set up by term_io.h interface.  Clients must ensure
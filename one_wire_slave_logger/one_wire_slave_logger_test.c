@@ -60,11 +60,17 @@ main (void)
   PFP ("Trying owsl_init()... ");
   PFP ("\n");
   // Initialize the interface.  Note that in this case
-  owsl_init (owsl_relay_via_term_io);
+  int result = owsl_init (owsl_relay_via_term_io);
   // Use this if you want to use an ID that you've loaded into EEPROM:
   //ows_init (TRUE);   // Initialize the 1-wire interface slave end
   // FIXME: ultimately we probably want _init and the listener function to
   // be seperate.  As it is owsl_init() doesn't return so we dont see this:
   PFP ("ok, it returned, we should be relaying messages now...\n");
+#ifdef OWS_BUILD_RESULT_DESCRIPTION_FUNCTION
+  char result_buf[OWSL_RESULT_DESCRIPTION_MAX_LENGTH + 1];
+  PFP ("owsl_init() returned %s\n", owsl_result_as_string (result, result_buf));
+#else
+  PFP ("owsl_init() returned %d\n", result);
+#endif
 
 }
@@ -90,6 +90,25 @@ static uint16_t cur_offset;   // Offset within current block
 // sd_card_read/write_partial_block() functions.
 static uint8_t partial_block_read_mode;   // Mode supporting partai block reads
 static uint8_t status;   // SD controller status
+
+// Operations which may be left running on the card while we go do other
+// things (see sd_card_start_write_block() and sd_card_start_erase_blocks()).
+typedef enum {
+  PENDING_OPERATION_NONE = 0,
+  PENDING_OPERATION_WRITE,
+  PENDING_OPERATION_ERASE
+} pending_operation_t;
+
+static pending_operation_t pending_operation;   // Started but not finished
+
+// State for the sd_card_preerase_*() functions.
+// Initially nothing is to be pre-erased (preerase_next > preerase_last).
+static uint32_t preerase_next = 1;      // Next block to be pre-erased
+static uint32_t preerase_last = 0;      // Last block of pre-erase region
+static uint32_t preerase_chunk_end;     // Last block of chunk being erased
+static uint16_t preerase_sector_size;   // Card erase sector size, in blocks
+static uint32_t preerased_count;        // Blocks finished so far
+static uint8_t preerase_chunk_pending;  // True iff we're erasing a chunk
 static sd_card_type_t card_type;   // Type of installed SD card
 
 sd_card_spi_speed_t speed = SD_CARD_SPI_SPEED_UNSET;
@@ -177,6 +196,22 @@ read_end (void)
   }
 }
 
+static uint8_t
+card_busy (void)
+{
+  // Return TRUE iff the card is still busy with a write or erase that we've
+  // left it to do in the background.  A deselected card keeps working on
+  // these, and resumes signaling busy on DO when it's selected again (SD
+  // Physical Layer Simplified Specification Version 4.10 section 7.2.4),
+  // so a single byte is enough to tell.
+
+  SD_CARD_SPI_SLAVE_SELECT_SET_LOW ();
+  uint8_t busy = (receive_byte () == SD_CARD_BUSY_SIGNAL_BYTE_VALUE);
+  SD_CARD_SPI_SLAVE_SELECT_SET_HIGH ();
+
+  return busy;
+}
+
 //------------------------------------------------------------------------------
 static uint8_t
 card_command (uint8_t cmd, uint32_t arg)
@@ -185,6 +220,11 @@ card_command (uint8_t cmd, uint32_t arg)
   // error code, or zero for OK.  If cmd is SD_CARD_CMD8, then arg is required
   // to be SD_CARD_CMD8_SUPPORTED_ARGUMENT_VALUE.
 
+  // Clients are required to call sd_card_finish_write() after
+  // sd_card_start_write_partial_block() (or sd_card_finish_erase() after
+  // sd_card_start_erase_blocks()) before doing anything else.
+  assert (pending_operation == PENDING_OPERATION_NONE);
+
   // Ensure read is done (in case we're in partial_block_read_mode mode)
   read_end ();
 
@@ -427,6 +467,12 @@ sd_card_error_description (sd_card_error_t error, char *buf)
     case SD_CARD_ERROR_SCK_RATE:
       strcpy_P (buf, PSTR ("incorrect rate selected"));
       break;
+    case SD_CARD_ERROR_READ_CSD:
+      strcpy_P (buf, PSTR ("couldn't read CSD to find erase sector size"));
+      break;
+    case SD_CARD_ERROR_BAD_WRITE_BL_LEN:
+      strcpy_P (buf, PSTR ("reserved WRITE_BL_LEN value in CSD"));
+      break;
     default:
       strcpy_P (buf, PSTR ("unhandled or unknown error value"));
       break;
@@ -490,6 +536,16 @@ sd_card_single_block_erase_supported (void)
 
 uint8_t
 sd_card_erase_blocks (uint32_t first_block, uint32_t last_block)
+{
+  if ( ! sd_card_start_erase_blocks (first_block, last_block) ) {
+    return FALSE;
+  }
+
+  return sd_card_finish_erase ();
+}
+
+uint8_t
+sd_card_start_erase_blocks (uint32_t first_block, uint32_t last_block)
 {
   if ( ! sd_card_single_block_erase_supported () ) {
     error (SD_CARD_ERROR_ERASE_SINGLE_BLOCK);
@@ -508,6 +564,38 @@ sd_card_erase_blocks (uint32_t first_block, uint32_t last_block)
       goto fail;
   }
 
+  // Like a write, an erase keeps going while the card is deselected (see
+  // card_busy()).
+  SD_CARD_SPI_SLAVE_SELECT_SET_HIGH ();
+  pending_operation = PENDING_OPERATION_ERASE;
+  return TRUE;
+
+  fail:
+  SD_CARD_SPI_SLAVE_SELECT_SET_HIGH ();
+  return FALSE;
+}
+
+uint8_t
+sd_card_erase_done (void)
+{
+  if ( pending_operation != PENDING_OPERATION_ERASE ) {
+    return TRUE;
+  }
+
+  return ! card_busy ();
+}
+
+uint8_t
+sd_card_finish_erase (void)
+{
+  if ( pending_operation != PENDING_OPERATION_ERASE ) {
+    return TRUE;
+  }
+
+  pending_operation = PENDING_OPERATION_NONE;
+
+  SD_CARD_SPI_SLAVE_SELECT_SET_LOW ();
+
 #ifdef SD_CARD_USE_TIMER0_FOR_TIMEOUTS
   if ( ! wait_not_busy (SD_CARD_ERASE_TIMEOUT) ) {
 #else
@@ -525,6 +613,134 @@ sd_card_erase_blocks (uint32_t first_block, uint32_t last_block)
   return FALSE;
 }
 
+static uint16_t
+erase_sector_size (void)
+{
+  // Return the size of the erase sector of the card in blocks, or 0 on
+  // error.  See SD Physical Layer Simplified Specification Version 4.10
+  // sections 5.3.2 and 5.3.3.  For SDHC cards this is always 128 blocks
+  // (64 KB), for SD1 and SD2 cards it varies.
+
+  sd_card_csd_t csd;
+  if ( ! sd_card_read_csd (&csd) ) {
+    error (SD_CARD_ERROR_READ_CSD);
+    return 0;
+  }
+
+  // The sector_size and write_bl_len fields are at the same place in both
+  // CSD versions.  SECTOR_SIZE is in units of the write block length,
+  // which is 2^WRITE_BL_LEN bytes.  That's always 512 bytes for SDHC
+  // cards, but older cards may also use 1024 or 2048 bytes.
+  uint8_t const sd_card_block_size_log2 = 9;   // log2 (SD_CARD_BLOCK_SIZE)
+  uint8_t const max_write_bl_len = 11;
+  uint8_t write_bl_len
+    = (csd.v1.write_bl_len_high << 2) | csd.v1.write_bl_len_low;
+  if ( write_bl_len < sd_card_block_size_log2 ||
+       write_bl_len > max_write_bl_len ) {
+    error (SD_CARD_ERROR_BAD_WRITE_BL_LEN);   // Reserved, so CSD is garbage
+    return 0;
+  }
+
+  uint16_t sector_size_in_write_blocks
+    = ((csd.v1.sector_size_high << 1) | csd.v1.sector_size_low) + 1;
+
+  return sector_size_in_write_blocks
+         << (write_bl_len - sd_card_block_size_log2);
+}
+
+static uint8_t
+preerase_start_next_chunk (void)
+{
+  // Start erasing the next chunk of the pre-erase region.  The chunk runs
+  // to the end of the erase sector containing preerase_next, or to
+  // preerase_last if that comes first.
+
+  uint32_t sector_end
+    = preerase_next - (preerase_next % preerase_sector_size)
+      + preerase_sector_size - 1;
+  preerase_chunk_end
+    = (sector_end < preerase_last ? sector_end : preerase_last);
+
+  if ( ! sd_card_start_erase_blocks (preerase_next, preerase_chunk_end) ) {
+    return FALSE;
+  }
+  preerase_chunk_pending = TRUE;
+
+  return TRUE;
+}
+
+static uint8_t
+preerase_finish_chunk (void)
+{
+  // Wait for the chunk currently being erased to finish (if it hasn't
+  // already) and update the pre-erase progress.
+
+  preerase_chunk_pending = FALSE;
+
+  if ( ! sd_card_finish_erase () ) {
+    return FALSE;
+  }
+
+  preerased_count += preerase_chunk_end - preerase_next + 1;
+  preerase_next = preerase_chunk_end + 1;
+
+  return TRUE;
+}
+
+uint8_t
+sd_card_preerase_init (uint32_t first_block, uint32_t last_block)
+{
+  assert (last_block >= first_block);
+  assert (! preerase_chunk_pending);
+
+  // On failure erase_sector_size() has already set the error code.
+  preerase_sector_size = erase_sector_size ();
+  if ( preerase_sector_size == 0 ) {
+    return FALSE;
+  }
+
+  preerase_next = first_block;
+  preerase_last = last_block;
+  preerased_count = 0;
+
+  return TRUE;
+}
+
+uint8_t
+sd_card_preerase_step (void)
+{
+  if ( preerase_chunk_pending ) {
+    if ( card_busy () ) {
+      return TRUE;
+    }
+    if ( ! preerase_finish_chunk () ) {
+      return FALSE;
+    }
+  }
+
+  if ( preerase_next <= preerase_last ) {
+    return preerase_start_next_chunk ();
+  }
+
+  return TRUE;
+}
+
+uint8_t
+sd_card_preerase_wait (void)
+{
+  if ( ! preerase_chunk_pending ) {
+    return TRUE;
+  }
+
+  return preerase_finish_chunk ();
+}
+
+uint32_t
+sd_card_preerased_count (void)
+{
+  return preerased_count;
+}
+
 static uint8_t
 card_application_command (uint8_t cmd, uint32_t arg)
 {
@@ -546,6 +762,8 @@ sd_card_init (sd_card_spi_speed_t speed)
   card_type = SD_CARD_TYPE_INDETERMINATE;
   in_block = FALSE;
   partial_block_read_mode = FALSE;
+  pending_operation = PENDING_OPERATION_NONE;
+  preerase_chunk_pending = FALSE;
 
   // Initialize SPI interface to the SD card controller.
   SD_CARD_SPI_SLAVE_SELECT_INIT (DIO_OUTPUT, DIO_DONT_CARE, HIGH);
@@ -799,6 +1017,23 @@ sd_card_write_partial_block (uint32_t block, uint16_t cnt, uint8_t const *src)
 {
   // NOTE: if cnt is SD_CARD_BLOCK_SIZE the entire block is written.
 
+  if ( ! sd_card_start_write_partial_block (block, cnt, src) ) {
+    return FALSE;
+  }
+
+  return sd_card_finish_write ();
+}
+
+uint8_t
+sd_card_start_write_block (uint32_t block, uint8_t const *src)
+{
+  return sd_card_start_write_partial_block (block, SD_CARD_BLOCK_SIZE, src);
+}
+
+uint8_t
+sd_card_start_write_partial_block (
+    uint32_t block, uint16_t cnt, uint8_t const *src )
+{
 #if SD_CARD_PROTECT_BLOCK_ZERO
   // Don't allow write to first block
   if ( block == 0 ) {
@@ -819,7 +1054,46 @@ sd_card_write_partial_block (uint32_t block, uint16_t cnt, uint8_t const *src)
     goto fail;
   }
 
-  // Wait for flash programming to complete
+  // The card has accepted the data and is now programming its flash.  It's
+  // allowed to deselect a busy card (SD Physical Layer Simplified
+  // Specification Version 4.10 section 7.2.4): it keeps programming, and
+  // resumes signaling busy on DO when it gets selected again.  So we let go
+  // of the SPI bus here and let sd_card_write_done() or sd_card_finish_write()
+  // pick things up later.
+  SD_CARD_SPI_SLAVE_SELECT_SET_HIGH ();
+  pending_operation = PENDING_OPERATION_WRITE;
+  return TRUE;
+
+  fail:
+  SD_CARD_SPI_SLAVE_SELECT_SET_HIGH ();
+  return FALSE;
+}
+
+uint8_t
+sd_card_write_done (void)
+{
+  if ( pending_operation != PENDING_OPERATION_WRITE ) {
+    return TRUE;
+  }
+
+  return ! card_busy ();
+}
+
+uint8_t
+sd_card_finish_write (void)
+{
+  if ( pending_operation != PENDING_OPERATION_WRITE ) {
+    return TRUE;
+  }
+
+  // This must be cleared before card_command() gets called below.
+  pending_operation = PENDING_OPERATION_NONE;
+
+  SD_CARD_SPI_SLAVE_SELECT_SET_LOW ();
+
+  // Wait for flash programming to complete.  We don't know how much of
+  // the timeout has already elapsed since the write started, so we just
+  // allow the whole thing again.
 #ifdef SD_CARD_USE_TIMER0_FOR_TIMEOUTS
   if ( ! wait_not_busy (SD_CARD_WRITE_TIMEOUT) ) {
 #else
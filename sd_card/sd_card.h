@@ -145,7 +145,9 @@ typedef enum {
   SD_CARD_ERROR_WRITE_MULTIPLE     = 0x13,
   SD_CARD_ERROR_WRITE_PROGRAMMING  = 0x14,
   SD_CARD_ERROR_WRITE_TIMEOUT      = 0x15,
-  SD_CARD_ERROR_SCK_RATE           = 0x16
+  SD_CARD_ERROR_SCK_RATE           = 0x16,
+  SD_CARD_ERROR_READ_CSD           = 0x17,
+  SD_CARD_ERROR_BAD_WRITE_BL_LEN   = 0x18
 } sd_card_error_t;
 
 // Return error code for last error.  Many other functions in this interface
@@ -275,6 +277,62 @@ sd_card_read_partial_block (uint32_t block, uint16_t cnt, uint8_t *dst);
 uint8_t
 sd_card_write_partial_block (uint32_t block, uint16_t cnt, uint8_t const *src);
 
+// Split-phase writes.  Once an SD card has accepted a block of data it
+// still has to program it into flash, which can take hundreds of
+// milliseconds on some cards.  The sd_card_write_block() and
+// sd_card_write_partial_block() functions just busy-wait through this
+// time.  The functions below let the client do something useful instead
+// (fill the next buffer, for instance).  Usage looks about like this:
+//
+//   sentinel = sd_card_start_write_block (some_block, buf_a);
+//   assert (sentinel);
+//
+//   fill_buffer_while_card_programs (buf_b);
+//
+//   while ( ! sd_card_write_done () ) {
+//     do_something_else ();
+//   }
+//
+//   sentinel = sd_card_finish_write ();
+//   assert (sentinel);
+//
+// After a successful call to sd_card_start_write_block() or
+// sd_card_start_write_partial_block(), sd_card_finish_write() MUST be called
+// before any other function in this interface except sd_card_write_done().
+// The SD card is deselected while it's programming, so other devices on
+// the SPI bus may be used in the meantime.
+
+// Like sd_card_write_block(), but return as soon as the card has accepted
+// the data, without waiting for it to finish programming.  Returns TRUE
+// on success, or FALSE on failure (in which case sd_card_last_error()
+// can be called, and sd_card_finish_write() doesn't need to be).
+uint8_t
+sd_card_start_write_block (uint32_t block, uint8_t const *src);
+
+// Like sd_card_start_write_block(), but analagous to
+// sd_card_write_partial_block().
+uint8_t
+sd_card_start_write_partial_block (
+    uint32_t block, uint16_t cnt, uint8_t const *src );
+
+// Return TRUE iff the card has finished programming the data from the
+// last sd_card_start_write_block() or sd_card_start_write_partial_block()
+// call (or no such write is in progress).  This never blocks, and only
+// costs a byte or so of SPI traffic.  A TRUE result doesn't mean that the
+// write succeeded: for that sd_card_finish_write() must still be called.
+uint8_t
+sd_card_write_done (void);
+
+// Wait (with timeout SD_CARD_WRITE_TIMEOUT) for a write started with
+// sd_card_start_write_block() or sd_card_start_write_partial_block() to
+// finish programming, then verify that it worked.  Returns TRUE on success,
+// or FALSE on failure (in which case sd_card_last_error() can be called).
+// If sd_card_write_done() has already returned TRUE, this function doesn't
+// have to wait and returns quickly.  Calling it when no write is in progress
+// is harmless and returns TRUE.
+uint8_t
+sd_card_finish_write (void);
+
 // Returns TRUE iff the SD card provides an erase operation for individual
 // blocks.  Note that it's always possible to simply overwrite blocks.
 uint8_t
@@ -287,4 +345,90 @@ sd_card_single_block_erase_supported (void);
 uint8_t
 sd_card_erase_blocks (uint32_t first_block, uint32_t last_block);
 
+// Like sd_card_erase_blocks(), but return as soon as the card has accepted
+// the erase commands, without waiting (possibly for seconds) for it to
+// actually do the erase.  This works like sd_card_start_write_block():
+// after a successful call, sd_card_finish_erase() MUST be called before
+// any other function in this interface except sd_card_erase_done().
+uint8_t
+sd_card_start_erase_blocks (uint32_t first_block, uint32_t last_block);
+
+// Return TRUE iff the card has finished the erase started by the last
+// sd_card_start_erase_blocks() call (or no such erase is in progress).
+// This never blocks.
+uint8_t
+sd_card_erase_done (void);
+
+// Wait (with timeout SD_CARD_ERASE_TIMEOUT) for an erase started with
+// sd_card_start_erase_blocks() to finish.  Returns TRUE on success, or
+// FALSE on failure (in which case sd_card_last_error() can be called).
+// Calling it when no erase is in progress is harmless and returns TRUE.
+uint8_t
+sd_card_finish_erase (void);
+
+// Background pre-erase.  Many cards program blocks that have been erased
+// in advance much faster than they overwrite old data (the old data has to
+// be erased first, and for most cards that means shuffling the rest of
+// the erase sector around as well).  A logging application can use these
+// functions to erase the region it's going to write next during otherwise
+// idle time, so the erase latency stays out of the write path.  The region
+// is erased in chunks that are aligned to the card's erase sector size
+// (as reported in the CSD register), so the card is never asked to erase
+// part of a sector unless the region itself begins or ends in the middle
+// of one.  Each block is erased only once per sd_card_preerase_init() call.
+// Usage looks about like this:
+//
+//   sentinel = sd_card_preerase_init (log_start_block, log_end_block);
+//   assert (sentinel);
+//
+//   for ( ; ; ) {
+//     if ( have_data_to_write () ) {
+//       // Any chunk erase still in progress must finish before the write
+//       sentinel = sd_card_preerase_wait ();
+//       assert (sentinel);
+//       sentinel = sd_card_write_block (next_log_block++, buf);
+//       assert (sentinel);
+//     }
+//     else {
+//       sentinel = sd_card_preerase_step ();
+//       assert (sentinel);
+//     }
+//   }
+//
+// Between sd_card_preerase_step() and sd_card_preerase_wait() an erase
+// may be in progress on the card, so no other function in this interface
+// may be called (though sd_card_erase_done() can be used to find out if
+// sd_card_preerase_wait() would return immediately).  Similarly,
+// sd_card_preerase_step() must not be called while a split-phase write is
+// in progress.
+
+// Set up the region from first_block to last_block inclusive to be
+// pre-erased by subsequent sd_card_preerase_step() calls.  No erasing is
+// actually done by this function.  Any previous pre-erase region is
+// forgotten (sd_card_preerase_wait() must have been called if necessary).
+// The requirements of sd_card_erase_blocks() apply.  Returns TRUE on success,
+// or FALSE on failure (in which case sd_card_last_error() can be called).
+uint8_t
+sd_card_preerase_init (uint32_t first_block, uint32_t last_block);
+
+// Make a bit of progress on pre-erasing the current region, without ever
+// blocking for the erase itself.  If a chunk erase is in progress and the
+// card is still busy, this does nothing.  Otherwise it finishes off that
+// chunk and starts erasing the next one.  Returns TRUE on success, or
+// FALSE on failure (in which case sd_card_last_error() can be called).
+uint8_t
+sd_card_preerase_step (void);
+
+// Wait for any chunk erase started by sd_card_preerase_step() to finish.
+// Returns TRUE on success, or FALSE on failure (in which case
+// sd_card_last_error() can be called).
+uint8_t
+sd_card_preerase_wait (void);
+
+// Return the number of blocks from the beginning of the current pre-erase
+// region which are known to be erased.  When this equals the size of the
+// region the whole thing is done.
+uint32_t
+sd_card_preerased_count (void);
+
 #endif  // SD_CARD_H
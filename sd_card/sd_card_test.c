@@ -139,6 +139,114 @@ speed_test_1000_blocks (void)
   PFP ("done.\n");
 }
 
+static void
+speed_test_1000_blocks_split_phase (void)
+{
+  // Write 1000 blocks using the split-phase write functions and two
+  // alternating buffers, refilling one buffer while the card programs the
+  // other, then read them back in to verify them.  This is the way a logger
+  // that wants to sustain a high data rate would use the interface.
+
+  uint8_t buffers[2][SD_CARD_BLOCK_SIZE];
+  uint8_t cb = 0;   // Current Buffer
+  for ( int ii = 0 ; ii < SD_CARD_BLOCK_SIZE ; ii++ ) {
+    buffers[cb][ii] = 43;
+  }
+
+  PFP ("Speed test: writing 1000 blocks using split-phase writes... ");
+  uint32_t busy_polls = 0;   // Number of times the card was still busy
+  for ( uint32_t ii = 0 ; ii < 1000 ; ii++ ) {
+    uint8_t return_code = sd_card_start_write_block (ii + 1, buffers[cb]);
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    cb = ! cb;
+    // Fill the other buffer while the card programs the one we just sent.
+    for ( int jj = 0 ; jj < SD_CARD_BLOCK_SIZE ; jj++ ) {
+      buffers[cb][jj] = 43;
+    }
+    while ( ! sd_card_write_done () ) {
+      busy_polls++;
+    }
+    return_code = sd_card_finish_write ();
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+  }
+  PFP ("done (card busy for %lu polls after buffer refills).\n", busy_polls);
+
+  PFP ("Verifying split-phase written blocks... ");
+  for ( uint32_t ii = 0 ; ii < 1000 ; ii++ ) {
+    uint8_t return_code = sd_card_read_block (ii + 1, buffers[0]);
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    for ( int jj = 0 ; jj < SD_CARD_BLOCK_SIZE ; jj++ ) {
+      if ( buffers[0][jj] != 43 ) {
+        PFP ("failed: didn't read expected value");
+        assert (0);
+      }
+    }
+  }
+  PFP ("ok.\n");
+}
+
+static void
+test_preerase (void)
+{
+  // Pre-erase a region a few erase sectors long that starts and ends in the
+  // middle of sectors, stepping the pre-erase along while counting how much
+  // idle time we had available, then check that the region really got
+  // erased.
+
+  uint32_t const first_block = 2042, last_block = 2042 + 3 * 128;
+  uint32_t const block_count = last_block - first_block + 1;
+
+  PFP ("Trying sd_card_preerase_init()... ");
+  uint8_t return_code = sd_card_preerase_init (first_block, last_block);
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  assert (sd_card_preerased_count () == 0);
+  PFP ("ok.\n");
+
+  PFP ("Trying sd_card_preerase_step() until the region is erased... ");
+  uint32_t idle_steps = 0;   // Steps that found the card still busy
+  uint32_t last_count = 0;
+  while ( sd_card_preerased_count () < block_count ) {
+    return_code = sd_card_preerase_step ();
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    if ( sd_card_preerased_count () == last_count ) {
+      idle_steps++;
+    }
+    last_count = sd_card_preerased_count ();
+  }
+  return_code = sd_card_preerase_wait ();
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  PFP ("ok (%lu steps available for other work).\n", idle_steps);
+
+  PFP ("Verifying that the pre-erased region is erased... ");
+  uint8_t data_block[SD_CARD_BLOCK_SIZE];
+  return_code = sd_card_read_block (first_block, data_block);
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  uint8_t const erased_value = data_block[0];
+  if ( erased_value != 0x00 && erased_value != 0xFF ) {
+    PFP ("failed: erased block contains unexpected value");
+    assert (0);
+  }
+  for ( uint32_t ii = first_block ; ii <= last_block ; ii++ ) {
+    return_code = sd_card_read_block (ii, data_block);
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    for ( uint16_t jj = 0 ; jj < SD_CARD_BLOCK_SIZE ; jj++ ) {
+      if ( data_block[jj] != erased_value ) {
+        PFP ("failed: block %lu isn't erased", ii);
+        assert (0);
+      }
+    }
+  }
+  PFP ("ok.\n");
+}
+
 static void
 per_speed_tests (sd_card_spi_speed_t speed, char const *speed_string)
 {
@@ -234,8 +342,12 @@ per_speed_tests (sd_card_spi_speed_t speed, char const *speed_string)
     assert (0);
   }
 
+  test_preerase ();
+
   speed_test_1000_blocks ();
 
+  speed_test_1000_blocks_split_phase ();
+
   PFP ("Everything worked with %s\n", speed_string);
 }
 
@@ -0,0 +1 @@
+../sd_card/sd_card.c
\ No newline at end of file
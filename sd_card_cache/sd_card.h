@@ -0,0 +1 @@
+../sd_card/sd_card.h
\ No newline at end of file
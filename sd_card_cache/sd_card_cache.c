@@ -0,0 +1,191 @@
+// Implementation of the interface described in sd_card_cache.h.
+
+#include <assert.h>
+// FIXME: here only cause assert.h wrongly needs it, remove when that bug
+// is fixed (which it is in more recent upstream AVR libc)
+#include <stdlib.h>
+#include <string.h>
+
+#include "sd_card_cache.h"
+
+// A cached block.
+typedef struct {
+  uint8_t  valid;                      // True iff this slot holds a block
+  uint8_t  dirty;                      // True iff data differs from card's
+  uint32_t block;                      // Block number of the cached block
+  uint8_t  data[SD_CARD_BLOCK_SIZE];   // The block data itself
+} slot_t;
+
+static slot_t slots[SD_CARD_CACHE_BLOCK_COUNT];
+
+// Slot indices in order of use, most recently used first.
+static uint8_t lru_order[SD_CARD_CACHE_BLOCK_COUNT];
+
+static sd_card_cache_stats_t stats;
+
+// Increment a statistics counter, saturating rather than wrapping.
+#define STAT_INCREMENT(counter)      \
+  do {                               \
+    if ( (counter) != UINT32_MAX ) { \
+      (counter)++;                   \
+    }                                \
+  } while ( 0 )
+
+static void
+mark_most_recently_used (uint8_t si)
+{
+  // Move slot index si to the front of lru_order.
+
+  uint8_t ii;
+  for ( ii = 0 ; lru_order[ii] != si ; ii++ ) {
+    ;
+  }
+  for ( ; ii > 0 ; ii-- ) {
+    lru_order[ii] = lru_order[ii - 1];
+  }
+  lru_order[0] = si;
+}
+
+static uint8_t
+write_back (slot_t *slot)
+{
+  // Write slot to the card if it's dirty.  Return TRUE on success, FALSE
+  // otherwise.
+
+  if ( slot->valid && slot->dirty ) {
+    if ( ! sd_card_write_block (slot->block, slot->data) ) {
+      return FALSE;
+    }
+    slot->dirty = FALSE;
+    STAT_INCREMENT (stats.write_backs);
+  }
+
+  return TRUE;
+}
+
+static slot_t *
+get_slot (uint32_t block, uint8_t need_contents)
+{
+  // Return the slot caching block, caching it first if necessary.  If
+  // need_contents is false and block isn't already cached, the slot is
+  // assigned to block but its data isn't read from the card (the caller
+  // must be about to overwrite all of it).  Return NULL on error.
+
+  for ( uint8_t ii = 0 ; ii < SD_CARD_CACHE_BLOCK_COUNT ; ii++ ) {
+    uint8_t si = lru_order[ii];
+    if ( slots[si].valid && slots[si].block == block ) {
+      STAT_INCREMENT (stats.hits);
+      mark_most_recently_used (si);
+      return &(slots[si]);
+    }
+  }
+
+  STAT_INCREMENT (stats.misses);
+
+  // Evict the least recently used slot (which might not be valid at all).
+  uint8_t si = lru_order[SD_CARD_CACHE_BLOCK_COUNT - 1];
+  slot_t *slot = &(slots[si]);
+  if ( ! write_back (slot) ) {
+    return NULL;
+  }
+
+  slot->valid = FALSE;
+  if ( need_contents ) {
+    if ( ! sd_card_read_block (block, slot->data) ) {
+      return NULL;
+    }
+  }
+  slot->block = block;
+  slot->dirty = FALSE;
+  slot->valid = TRUE;
+  mark_most_recently_used (si);
+
+  return slot;
+}
+
+uint8_t
+sd_card_cache_init (sd_card_spi_speed_t speed)
+{
+  sd_card_cache_invalidate ();
+  sd_card_cache_reset_stats ();
+
+  return sd_card_init (speed);
+}
+
+uint8_t
+sd_card_cache_read (uint32_t block, uint16_t offset, uint16_t cnt, void *dst)
+{
+  assert ((uint32_t) offset + cnt <= SD_CARD_BLOCK_SIZE);
+
+  slot_t *slot = get_slot (block, TRUE);
+  if ( slot == NULL ) {
+    return FALSE;
+  }
+
+  memcpy (dst, slot->data + offset, cnt);
+
+  return TRUE;
+}
+
+uint8_t
+sd_card_cache_write (
+    uint32_t block, uint16_t offset, uint16_t cnt, void const *src )
+{
+  assert ((uint32_t) offset + cnt <= SD_CARD_BLOCK_SIZE);
+
+#if SD_CARD_PROTECT_BLOCK_ZERO
+  // Failing here is better than accepting data that could never be flushed.
+  if ( block == 0 ) {
+    return FALSE;
+  }
+#endif  // SD_CARD_PROTECT_BLOCK_ZERO
+
+  slot_t *slot = get_slot (block, cnt != SD_CARD_BLOCK_SIZE);
+  if ( slot == NULL ) {
+    return FALSE;
+  }
+
+  memcpy (slot->data + offset, src, cnt);
+  slot->dirty = TRUE;
+
+  return TRUE;
+}
+
+uint8_t
+sd_card_cache_flush (void)
+{
+  // We keep going after a failure so as much as possible gets written,
+  // since the caller might be about to lose power or something.
+  uint8_t result = TRUE;
+  for ( uint8_t ii = 0 ; ii < SD_CARD_CACHE_BLOCK_COUNT ; ii++ ) {
+    if ( ! write_back (&(slots[ii])) ) {
+      result = FALSE;
+    }
+  }
+
+  return result;
+}
+
+void
+sd_card_cache_invalidate (void)
+{
+  for ( uint8_t ii = 0 ; ii < SD_CARD_CACHE_BLOCK_COUNT ; ii++ ) {
+    slots[ii].valid = FALSE;
+    slots[ii].dirty = FALSE;
+    lru_order[ii] = ii;
+  }
+}
+
+void
+sd_card_cache_get_stats (sd_card_cache_stats_t *stats_out)
+{
+  *stats_out = stats;
+}
+
+void
+sd_card_cache_reset_stats (void)
+{
+  stats.hits = 0;
+  stats.misses = 0;
+  stats.write_backs = 0;
+}
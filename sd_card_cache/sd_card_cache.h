@@ -0,0 +1,114 @@
+// Interface providing a small write-back block cache on top of sd_card.h.
+//
+// Test driver: sd_card_cache_test.c    Implementation: sd_card_cache.c
+//
+// Every call to sd_card_read_partial_block() sends a CMD17 and clocks a
+// whole block (plus CRC) across the SPI bus, no matter how few bytes are
+// actually wanted.  Applications that read or update small records in the
+// same block over and over therefore pay full block latency every time.
+// This module keeps up to SD_CARD_CACHE_BLOCK_COUNT recently used blocks in
+// RAM, so repeated accesses to them don't involve the card at all.  Writes
+// only touch the cached copy and mark it dirty: the block is written to the
+// card when it gets evicted to make room for another block (least recently
+// used blocks are evicted first), or when sd_card_cache_flush() is called.
+//
+// WARNING: dirty data lives only in RAM until it's flushed or evicted, so
+// a reset or power cut will lose it.  Call sd_card_cache_flush() at points
+// where the data on the card must be up to date.
+//
+// WARNING: this module doesn't know about reads or writes done with
+// sd_card.h directly.  If blocks that might be cached are accessed that
+// way, sd_card_cache_flush() must be called first (and for writes,
+// sd_card_cache_invalidate() afterwards), or the cache and the card will
+// disagree.
+//
+// Basic use looks about like this:
+//
+//   uint8_t sentinel = sd_card_cache_init (SD_CARD_SPI_SPEED_FULL);
+//   assert (sentinel);
+//
+//   // Update a small record in block 42 (only the cache is touched if
+//   // block 42 is already cached)
+//   sentinel = sd_card_cache_write (42, record_offset, sizeof (rec), &rec);
+//   assert (sentinel);
+//
+//   // Read another record from the same block (no SD card traffic)
+//   sentinel = sd_card_cache_read (42, other_offset, sizeof (rec2), &rec2);
+//   assert (sentinel);
+//
+//   sentinel = sd_card_cache_flush ();
+//   assert (sentinel);
+
+#ifndef SD_CARD_CACHE_H
+#define SD_CARD_CACHE_H
+
+#include "sd_card.h"
+
+// Number of SD_CARD_BLOCK_SIZE byte blocks to cache.  Each one uses a bit
+// more than SD_CARD_BLOCK_SIZE bytes of RAM, so on an ATmega328P only one
+// or two are realistic.
+#ifndef SD_CARD_CACHE_BLOCK_COUNT
+#  define SD_CARD_CACHE_BLOCK_COUNT 1
+#endif
+
+#if SD_CARD_CACHE_BLOCK_COUNT < 1 || SD_CARD_CACHE_BLOCK_COUNT > UINT8_MAX
+#  error SD_CARD_CACHE_BLOCK_COUNT must be between 1 and UINT8_MAX
+#endif
+
+// Initialize the SD card (by calling sd_card_init (speed)) and this
+// interface.  Any cached data is discarded without being written to the
+// card, and the statistics are reset.  Returns TRUE on success, or FALSE
+// on error (in which case sd_card_last_error() can be called).
+uint8_t
+sd_card_cache_init (sd_card_spi_speed_t speed);
+
+// Read cnt bytes starting at offset within block into dst.  The bytes must
+// all be in the same block (i.e. offset + cnt must be no more than
+// SD_CARD_BLOCK_SIZE).  If the block isn't cached, it's read into the
+// cache first (possibly evicting a dirty block, which then gets written to
+// the card).  Returns TRUE on success, or FALSE on error (in which case
+// sd_card_last_error() may be called).
+uint8_t
+sd_card_cache_read (uint32_t block, uint16_t offset, uint16_t cnt, void *dst);
+
+// Write cnt bytes from src into block starting at offset.  The same
+// restrictions as for sd_card_cache_read() apply.  Only the cached copy of
+// the block is changed (and marked dirty).  If the block isn't cached and
+// the write doesn't cover the whole block, the rest of the block is read
+// from the card first.  Writes that do cover the whole block don't require
+// a read.  If SD_CARD_PROTECT_BLOCK_ZERO is set (it is by default),
+// attempts to write block zero immediately fail (but in this case
+// sd_card_last_error() will not return anything meaningful).  Returns
+// TRUE on success, or FALSE on error (in which case sd_card_last_error()
+// may be called).
+uint8_t
+sd_card_cache_write (
+    uint32_t block, uint16_t offset, uint16_t cnt, void const *src );
+
+// Write all dirty cached blocks to the card.  The blocks remain cached (and
+// are now clean).  Returns TRUE on success, or FALSE on error (in which case
+// sd_card_last_error() may be called, and any blocks that didn't get written
+// remain dirty).
+uint8_t
+sd_card_cache_flush (void);
+
+// Discard all cached blocks WITHOUT writing dirty ones to the card.
+void
+sd_card_cache_invalidate (void);
+
+// Cache statistics.  The counters saturate rather than wrapping around.
+typedef struct {
+  uint32_t hits;         // Reads or writes satisfied by an already cached block
+  uint32_t misses;       // Reads or writes that required a block to be cached
+  uint32_t write_backs;  // Dirty blocks written to the card
+} sd_card_cache_stats_t;
+
+// Get the current cache statistics.
+void
+sd_card_cache_get_stats (sd_card_cache_stats_t *stats);
+
+// Reset all the cache statistics to zero.
+void
+sd_card_cache_reset_stats (void);
+
+#endif // SD_CARD_CACHE_H
@@ -0,0 +1,245 @@
+// Test/demo for the sd_card_cache.h interface.
+//
+// This test driver requires the same hardware as sd_card_test.c (an Arduino
+// SD Card/Ethernet shield with an SDHC card in it).  It also requires
+// SD_CARD_CACHE_BLOCK_COUNT to be exactly 2, so it can check which blocks
+// get evicted.
+//
+// Diagnostic output is produced on an attached terminal using the term_io.h
+// interface.
+//
+// WARNING: this test overwrites some blocks near the start of the card.
+
+#include <assert.h>
+#include <avr/pgmspace.h>
+// FIXME: do we need stdlib here once we have the new avr libc which has
+// the fixed assert.h?  I doubt it but it needs checked..
+#include <stdlib.h>
+
+#include "sd_card_cache.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+
+#ifndef SD_CARD_BUILD_ERROR_DESCRIPTION_FUNCTION
+#  error This test program requires SD_CARD_BUILD_ERROR_DESCRIPTION_FUNCTION
+#endif
+
+#if SD_CARD_CACHE_BLOCK_COUNT != 2
+#  error This test program requires SD_CARD_CACHE_BLOCK_COUNT to be 2
+#endif
+
+// Blocks used for testing.
+#define BLOCK_A 42
+#define BLOCK_B 43
+#define BLOCK_C 44
+
+static void
+check_maybe_print_possible_failure_message (uint8_t code)
+{
+  // Check that code is 0, if it isn't, print a message describing the error
+  // returned by sd_card_last_error(), followed by a newline.
+
+  if ( ! code ) {
+    sd_card_error_t last_error = sd_card_last_error ();
+    char err_buf[SD_CARD_ERROR_DESCRIPTION_MAX_LENGTH + 1];
+    sd_card_error_description (last_error, err_buf);
+    PFP ("failed: %s\n", err_buf);
+  }
+}
+
+static void
+check_stats (uint32_t hits, uint32_t misses, uint32_t write_backs)
+{
+  // Verify that the cache statistics have the given values.
+
+  sd_card_cache_stats_t stats;
+  sd_card_cache_get_stats (&stats);
+  if ( stats.hits != hits ||
+       stats.misses != misses ||
+       stats.write_backs != write_backs ) {
+    PFP (
+        "failed: expected hits/misses/write-backs %lu/%lu/%lu, got "
+        "%lu/%lu/%lu\n",
+        hits, misses, write_backs,
+        stats.hits, stats.misses, stats.write_backs );
+    assert (0);
+  }
+}
+
+static void
+fill_block_directly (uint32_t block, uint8_t value)
+{
+  // Fill block with value using sd_card.h directly (bypassing the cache).
+
+  uint8_t data_block[SD_CARD_BLOCK_SIZE];
+  for ( uint16_t ii = 0 ; ii < SD_CARD_BLOCK_SIZE ; ii++ ) {
+    data_block[ii] = value;
+  }
+  uint8_t return_code = sd_card_write_block (block, data_block);
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+}
+
+static void
+check_record (uint32_t block, uint16_t offset, uint32_t expected)
+{
+  // Read a uint32_t record from block at offset through the cache and
+  // verify that it has the expected value.
+
+  uint32_t record;
+  uint8_t return_code
+    = sd_card_cache_read (block, offset, sizeof (record), &record);
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  if ( record != expected ) {
+    PFP ("failed: didn't read expected value\n");
+    assert (0);
+  }
+}
+
+int
+main (void)
+{
+  // This isn't what we're testing exactly, but we need to know if its
+  // working or not to interpret other results.
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  PFP ("Trying sd_card_cache_init()... ");
+  uint8_t return_code = sd_card_cache_init (SD_CARD_SPI_SPEED_FULL);
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  check_stats (0, 0, 0);
+  PFP ("ok.\n");
+
+  // Put known data in the test blocks (without using the cache).
+  PFP ("Filling test blocks using sd_card.h directly... ");
+  fill_block_directly (BLOCK_A, 0x00);
+  fill_block_directly (BLOCK_B, 0x00);
+  fill_block_directly (BLOCK_C, 0x00);
+  PFP ("ok.\n");
+
+  PFP ("Trying sd_card_cache_write() of small records... ");
+  uint16_t const record_count = 16;
+  for ( uint16_t ii = 0 ; ii < record_count ; ii++ ) {
+    uint32_t record = ii;
+    return_code
+      = sd_card_cache_write (BLOCK_A, ii * sizeof (record), sizeof (record),
+                             &record );
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+  }
+  // Only the first write should have touched the card.
+  check_stats (record_count - 1, 1, 0);
+  PFP ("ok.\n");
+
+  PFP ("Trying sd_card_cache_read() of small records... ");
+  for ( uint16_t ii = 0 ; ii < record_count ; ii++ ) {
+    check_record (BLOCK_A, ii * sizeof (uint32_t), ii);
+  }
+  check_stats (2 * record_count - 1, 1, 0);
+  PFP ("ok.\n");
+
+  PFP ("Trying sd_card_cache_flush()... ");
+  return_code = sd_card_cache_flush ();
+  check_maybe_print_possible_failure_message (return_code);
+  assert (return_code);
+  check_stats (2 * record_count - 1, 1, 1);
+  // Flushing again shouldn't write anything, since nothing is dirty now.
+  return_code = sd_card_cache_flush ();
+  assert (return_code);
+  check_stats (2 * record_count - 1, 1, 1);
+  PFP ("ok.\n");
+
+  PFP ("Verifying flushed data using sd_card.h directly... ");
+  {
+    uint32_t records[record_count];
+    return_code
+      = sd_card_read_partial_block (BLOCK_A, sizeof (records),
+                                    (uint8_t *) records );
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    for ( uint16_t ii = 0 ; ii < record_count ; ii++ ) {
+      if ( records[ii] != ii ) {
+        PFP ("failed: didn't read expected value\n");
+        assert (0);
+      }
+    }
+  }
+  PFP ("ok.\n");
+
+  PFP ("Testing least-recently-used eviction... ");
+  sd_card_cache_reset_stats ();
+  // Cache has A.  Dirty B, then touch A again so B is least recently used.
+  uint32_t record = 0xB0B0B0B0;
+  return_code = sd_card_cache_write (BLOCK_B, 0, sizeof (record), &record);
+  assert (return_code);
+  check_record (BLOCK_A, 0, 0);
+  check_stats (1, 1, 0);
+  // Bringing in C should evict (and write back) dirty B, not A.
+  check_record (BLOCK_C, 0, 0);
+  check_stats (1, 2, 1);
+  check_record (BLOCK_A, 0, 0);
+  check_stats (2, 2, 1);
+  // B should come back from the card with the data we wrote to it.
+  check_record (BLOCK_B, 0, 0xB0B0B0B0);
+  check_stats (2, 3, 1);
+  PFP ("ok.\n");
+
+  PFP ("Testing that full block writes don't need a read... ");
+  {
+    uint8_t data_block[SD_CARD_BLOCK_SIZE];
+    for ( uint16_t ii = 0 ; ii < SD_CARD_BLOCK_SIZE ; ii++ ) {
+      data_block[ii] = 0xCC;
+    }
+    sd_card_cache_reset_stats ();
+    // Block C isn't cached at this point (A and B are).
+    return_code
+      = sd_card_cache_write (BLOCK_C, 0, SD_CARD_BLOCK_SIZE, data_block);
+    check_maybe_print_possible_failure_message (return_code);
+    assert (return_code);
+    check_stats (0, 1, 0);
+  }
+  check_record (BLOCK_C, 0, 0xCCCCCCCC);
+  PFP ("ok.\n");
+
+  PFP ("Trying sd_card_cache_invalidate()... ");
+  // Block C is dirty, so invalidating it should lose the 0xCC data.
+  sd_card_cache_invalidate ();
+  sd_card_cache_reset_stats ();
+  check_record (BLOCK_C, 0, 0);
+  check_stats (0, 1, 0);
+  PFP ("ok.\n");
+
+  PFP ("Checking that block zero writes are refused... ");
+  return_code = sd_card_cache_write (0, 0, sizeof (record), &record);
+  assert (! return_code);
+  PFP ("ok.\n");
+
+  PFP ("Speed test: 1000 small record reads through the cache... ");
+  sd_card_cache_reset_stats ();
+  for ( uint16_t ii = 0 ; ii < 1000 ; ii++ ) {
+    check_record (BLOCK_A, (ii % record_count) * sizeof (uint32_t),
+                  ii % record_count );
+  }
+  PFP ("done.\n");
+  // Only the first read needs to bring block A back in.
+  check_stats (999, 1, 0);
+
+  PFP ("Speed test: 1000 small record reads using sd_card.h directly... ");
+  for ( uint16_t ii = 0 ; ii < 1000 ; ii++ ) {
+    uint32_t direct_record;
+    return_code
+      = sd_card_read_partial_block (BLOCK_B, sizeof (direct_record),
+                                    (uint8_t *) &direct_record );
+    assert (return_code);
+  }
+  PFP ("done.\n");
+  PFP ("\n");
+
+  PFP ("Everything worked!\n");
+  PFP ("\n");
+}
@@ -0,0 +1 @@
+../sd_card/sd_card_private.h
\ No newline at end of file
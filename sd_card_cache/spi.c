@@ -0,0 +1 @@
+../spi/spi.c
\ No newline at end of file
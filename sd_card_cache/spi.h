@@ -0,0 +1 @@
+../spi/spi.h
\ No newline at end of file
@@ -0,0 +1 @@
+../term_io/term_io.c
\ No newline at end of file
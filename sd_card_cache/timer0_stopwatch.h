@@ -0,0 +1 @@
+../timer0_stopwatch/timer0_stopwatch.h
\ No newline at end of file
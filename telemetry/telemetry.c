@@ -0,0 +1,209 @@
+// Implementation of the interface described in telemetry.h.
+
+#include <assert.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+// This file doesn't use util.h (which would tie it to the AVR), so it
+// needs these itself.
+#ifndef TRUE
+#  define TRUE  0x01
+#endif
+#ifndef FALSE
+#  define FALSE 0x00
+#endif
+
+// Record header layout
+#define HEADER_KEY_RECORD_FLAG     0x80
+#define HEADER_SEQUENCE_NUMBER_MASK 0x7F
+
+// Varint layout
+#define VARINT_CONTINUATION_FLAG 0x80
+#define VARINT_DATA_MASK         0x7F
+#define VARINT_BITS_PER_BYTE     7
+#define VARINT_MAX_LENGTH        5
+// Only this many bits of the final byte of a maximum length varint fit in
+// a uint32_t.
+#define VARINT_LAST_BYTE_MAX     0x0F
+
+void
+tlm_init (
+    tlm_codec_t *codec,
+    uint8_t field_count,
+    uint8_t const *field_types,
+    uint8_t key_interval )
+{
+  assert (field_count <= TLM_MAX_FIELDS);
+  assert (key_interval >= 1);
+
+  codec->field_count = field_count;
+  codec->field_types = field_types;
+  codec->key_interval = key_interval;
+  codec->records_since_key = 0;
+  codec->sequence_number = 0;
+  codec->have_previous = FALSE;
+}
+
+static uint32_t
+zigzag_encode (int32_t value)
+{
+  // The sign is smeared across all the bits without relying on arithmetic
+  // right shifts (which C doesn't guarantee for signed values).
+  uint32_t sign_mask = -(((uint32_t) value) >> 31);
+
+  return (((uint32_t) value) << 1) ^ sign_mask;
+}
+
+static int32_t
+zigzag_decode (uint32_t value)
+{
+  return (int32_t) ((value >> 1) ^ -(value & 1));
+}
+
+static uint8_t
+put_varint (uint32_t value, uint8_t *buf)
+{
+  // Write value into buf as a varint, and return the number of bytes used.
+
+  uint8_t ii = 0;
+
+  while ( value > VARINT_DATA_MASK ) {
+    buf[ii++] = ((uint8_t) value) | VARINT_CONTINUATION_FLAG;
+    value >>= VARINT_BITS_PER_BYTE;
+  }
+  buf[ii++] = value;
+
+  return ii;
+}
+
+static uint8_t
+get_varint (uint8_t count, uint8_t const *buf, uint32_t *value)
+{
+  // Read a varint from the (up to) count bytes at buf into *value, and
+  // return the number of bytes used, or 0 if the varint is malformed or
+  // runs off the end.
+
+  uint32_t result = 0;
+
+  for ( uint8_t ii = 0 ; ii < count && ii < VARINT_MAX_LENGTH ; ii++ ) {
+    uint8_t cb = buf[ii];   // Current Byte
+    if ( ii == VARINT_MAX_LENGTH - 1 && cb > VARINT_LAST_BYTE_MAX ) {
+      return 0;
+    }
+    uint32_t data = cb & VARINT_DATA_MASK;
+    result |= data << (VARINT_BITS_PER_BYTE * ii);
+    if ( ! (cb & VARINT_CONTINUATION_FLAG) ) {
+      *value = result;
+      return ii + 1;
+    }
+  }
+
+  return 0;
+}
+
+uint8_t
+tlm_encode (tlm_codec_t *codec, int32_t const *values, uint8_t *buf)
+{
+  uint8_t key
+    = ( (! codec->have_previous) ||
+        codec->records_since_key >= codec->key_interval );
+
+  if ( key ) {
+    codec->records_since_key = 0;
+  }
+  codec->records_since_key++;
+
+  uint8_t length = 0;
+
+  buf[length++]
+    = (codec->sequence_number & HEADER_SEQUENCE_NUMBER_MASK) |
+      (key ? HEADER_KEY_RECORD_FLAG : 0);
+  codec->sequence_number++;
+
+  for ( uint8_t ii = 0 ; ii < codec->field_count ; ii++ ) {
+    uint8_t ft = codec->field_types[ii];   // Field Type
+    int32_t value = values[ii];
+    uint8_t is_signed = ((ft & ~TLM_FIELD_DELTA) == TLM_FIELD_SIGNED);
+    if ( (ft & TLM_FIELD_DELTA) && (! key) ) {
+      // Differences can go either way, so they're always signed
+      value = (int32_t) ((uint32_t) value - (uint32_t) codec->previous[ii]);
+      is_signed = TRUE;
+    }
+    length
+      += put_varint (
+          is_signed ? zigzag_encode (value) : (uint32_t) value,
+          buf + length );
+  }
+
+  memcpy (codec->previous, values, codec->field_count * sizeof (int32_t));
+  codec->have_previous = TRUE;
+
+  return length;
+}
+
+void
+tlm_force_key_record (tlm_codec_t *codec)
+{
+  codec->have_previous = FALSE;
+}
+
+uint8_t
+tlm_decode (
+    tlm_codec_t *codec,
+    uint8_t count,
+    uint8_t const *buf,
+    int32_t *values )
+{
+  if ( count < 1 ) {
+    return FALSE;
+  }
+
+  uint8_t key = buf[0] & HEADER_KEY_RECORD_FLAG;
+  uint8_t sn = buf[0] & HEADER_SEQUENCE_NUMBER_MASK;   // Sequence Number
+
+  if ( ! key ) {
+    uint8_t expected_sn
+      = (codec->sequence_number + 1) & HEADER_SEQUENCE_NUMBER_MASK;
+    if ( (! codec->have_previous) || sn != expected_sn ) {
+      // We've missed something, so the deltas would be relative to the
+      // wrong record.  Nothing to do but wait for the next key record.
+      codec->have_previous = FALSE;
+      return FALSE;
+    }
+  }
+
+  uint8_t position = 1;
+
+  for ( uint8_t ii = 0 ; ii < codec->field_count ; ii++ ) {
+    uint32_t raw;
+    uint8_t used = get_varint (count - position, buf + position, &raw);
+    if ( used == 0 ) {
+      return FALSE;
+    }
+    position += used;
+
+    uint8_t ft = codec->field_types[ii];   // Field Type
+    if ( (ft & TLM_FIELD_DELTA) && (! key) ) {
+      values[ii]
+        = (int32_t) ((uint32_t) codec->previous[ii] +
+                     (uint32_t) zigzag_decode (raw));
+    }
+    else if ( (ft & ~TLM_FIELD_DELTA) == TLM_FIELD_SIGNED ) {
+      values[ii] = zigzag_decode (raw);
+    }
+    else {
+      values[ii] = (int32_t) raw;
+    }
+  }
+
+  if ( position != count ) {
+    return FALSE;   // Trailing garbage, so probably not our schema
+  }
+
+  memcpy (codec->previous, values, codec->field_count * sizeof (int32_t));
+  codec->sequence_number = sn;
+  codec->have_previous = TRUE;
+
+  return TRUE;
+}
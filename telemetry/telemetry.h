@@ -0,0 +1,127 @@
+// Compact Binary Telemetry Records (Varint/Zigzag, With Optional Deltas)
+//
+// Test driver: telemetry_test.c    Implementation: telemetry.c
+// Host test driver: telemetry_host_test.c
+//
+// Sending telemetry as text (with wx_put_string_frame_printf() or
+// wx_log_message() from wireless_xbee.h, for example) is easy to read,
+// but formatting with vsnprintf() is slow on the AVR, and the text is
+// several times larger than the data in it, so it takes correspondingly
+// longer to send over the air.  This interface encodes a record of numeric
+// fields into a compact binary form instead:
+//
+//   * Each record is described by a schema: an array of TLM_FIELD_* field
+//     types, one per field.  The encoder and the decoder must use the same
+//     schema.
+//
+//   * Each field is encoded as a varint: seven bits per byte, least
+//     significant group first, with the high bit of each byte set if more
+//     bytes follow.  So small values take one byte, and no 32 bit value
+//     takes more than five.
+//
+//   * Signed fields are zigzag encoded first (0, -1, 1, -2, 2... become
+//     0, 1, 2, 3, 4...), so small negative values are small too.
+//
+//   * Fields with the TLM_FIELD_DELTA flag are encoded as the (zigzag
+//     encoded) difference from the same field in the previous record.
+//     Slowly changing values (temperatures, counters, timestamps) then take
+//     a single byte most of the time.
+//
+// Every record starts with a one byte header holding a seven bit sequence
+// number and a flag that says whether it's a key record.  Key records
+// encode every field in full (ignoring TLM_FIELD_DELTA).  Since delta
+// records are useless if the record before them was lost, the decoder
+// refuses a delta record unless it decoded the previous sequence number,
+// and the encoder sends a key record every key_interval records (see
+// tlm_init()) so the decoder can get back in step.  Since the sequence
+// number only has seven bits, the decoder can't notice the loss of exactly
+// a multiple of 128 records in a row, and would decode the delta record
+// after such a gap relative to the wrong record.
+//
+// A record of eight typical sensor fields usually encodes to ten or fifteen
+// bytes, where the equivalent printf() text is often three times that.  See
+// telemetry_test.c for actual sizes and timings.
+//
+// Sending a record with wireless_xbee.h looks like this:
+//
+//   uint8_t buf[TLM_MAX_RECORD_LENGTH (FIELD_COUNT)];
+//   uint8_t length = tlm_encode (&codec, values, buf);
+//   wx_put_frame (length, buf);
+//
+// This interface is plain C99 with no AVR dependencies, so telemetry.c can
+// be compiled into a program on the receiving host unchanged.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// Maximum number of fields in a record.  This determines the size of
+// tlm_codec_t (each field takes four bytes).
+#ifndef TLM_MAX_FIELDS
+#  define TLM_MAX_FIELDS 8
+#endif
+
+// Field types.  Unsigned fields carry their value as a uint32_t in the
+// int32_t values arrays (i.e. the full unsigned range is available, just
+// cast on the way in and out).
+#define TLM_FIELD_UNSIGNED 0x00
+#define TLM_FIELD_SIGNED   0x01
+
+// Flag that can be or'ed into a field type to encode the field as a
+// difference from the previous record.  Differences are computed modulo
+// 2^32, so counters that wrap around are fine.
+#define TLM_FIELD_DELTA    0x80
+
+// Maximum length of an encoded record with field_count fields.
+#define TLM_MAX_RECORD_LENGTH(field_count) (1 + 5 * (field_count))
+
+// State of an encoder or a decoder.  Each direction of each stream needs its
+// own one.  The fields should only be accessed through the functions below.
+typedef struct {
+  uint8_t field_count;
+  uint8_t const *field_types;
+  uint8_t key_interval;
+  uint8_t records_since_key;          // Encoder only
+  uint8_t sequence_number;            // Of the next (encoder) or last record
+  uint8_t have_previous;              // TRUE if previous is meaningful
+  int32_t previous[TLM_MAX_FIELDS];   // Values of the previous record
+} tlm_codec_t;
+
+// Initialize *codec for use with a schema of field_count fields, with types
+// from field_types (which isn't copied, so it must remain valid).  The
+// key_interval is the maximum number of records from one key record to the
+// next (so 1 means every record is a key record) and only matters for
+// encoding.  Every stream starts with a key record.
+void
+tlm_init (
+    tlm_codec_t *codec,
+    uint8_t field_count,
+    uint8_t const *field_types,
+    uint8_t key_interval );
+
+// Encode the record with field values values (one per field in the schema)
+// into buf, which must have room for TLM_MAX_RECORD_LENGTH (field_count)
+// bytes.  Return the length of the encoded record.
+uint8_t
+tlm_encode (tlm_codec_t *codec, int32_t const *values, uint8_t *buf);
+
+// Make the next record tlm_encode() produces a key record.  This is useful
+// if the receiver is known to have missed something.
+void
+tlm_force_key_record (tlm_codec_t *codec);
+
+// Decode the count byte record in buf into values (which must have room
+// for one value per field in the schema).  Return TRUE on success, or
+// FALSE if the record is malformed (too short, too long, or containing
+// an overlong varint), or is a delta record that doesn't immediately
+// follow the last record successfully decoded.  In the latter case the
+// decoder keeps returning FALSE until a key record arrives.
+uint8_t
+tlm_decode (
+    tlm_codec_t *codec,
+    uint8_t count,
+    uint8_t const *buf,
+    int32_t *values );
+
+#endif // TELEMETRY_H
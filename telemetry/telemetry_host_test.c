@@ -0,0 +1,397 @@
+// Host test driver for telemetry.c (see the host_test target in generic.mk).
+//
+// telemetry.c has no AVR dependencies, so it's tested here unchanged.
+// Compared to telemetry_test.c, this program can afford long streams and
+// exhaustive value combinations:
+//
+//   * A long stream of simulated sensor records (the same ones
+//     telemetry_test.c uses) goes through a channel that loses, duplicates,
+//     and reorders records.  A model of the decoder predicts exactly which
+//     records must be decoded (key records, and delta records following
+//     the record they're relative to) and which refused, and every decoded
+//     record must match the one that was encoded.
+//
+//   * Every pair of a set of boundary values (around each varint length,
+//     and the extremes of both signed and unsigned fields) is encoded as
+//     consecutive records for every field type, and must round trip with
+//     exactly the expected encoded length.
+//
+//   * Every truncation of every record, and records with trailing bytes or
+//     overlong varints, must be refused.
+//
+//   * The average encoded size must be well under the size of the same
+//     record as text.
+//
+// This program exits with a non-zero status after printing a description
+// of the first failure, or prints a summary line per test and exits with
+// status zero if everything passes.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test_util.h"
+#include "telemetry.h"
+
+#define TRUE  0x01
+#define FALSE 0x00
+
+// Schema of the simulated records (see telemetry_test.c).
+#define FIELD_COUNT 8
+static uint8_t const field_types[FIELD_COUNT] = {
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_SIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_UNSIGNED,
+  TLM_FIELD_SIGNED,
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_SIGNED,
+  TLM_FIELD_UNSIGNED };
+
+#define KEY_INTERVAL 16
+
+#define STREAM_RECORD_COUNT 100000
+
+// Number of recent records the simulated channel can deliver again (as
+// duplicates or out of order).
+#define HISTORY_LENGTH 8
+
+// Longest burst of lost records.  The seven bit sequence number can't tell
+// a burst of exactly 128 lost records from no loss at all (see telemetry.h)
+// so bursts are kept well short of that.
+#define MAX_LOSS_BURST 40
+
+static int32_t const initial_values[FIELD_COUNT]
+  = { 0, 2150, 3300, 0, 0, 0, 0, 0 };
+
+static void
+next_record (int32_t *values)
+{
+  // Advance the simulated sensor readings in values (like telemetry_test.c
+  // does).
+
+  values[0] += 1000;                  // One second later, in ms
+  values[1] += random () % 5 - 2;     // Temperature wanders slowly
+  values[2] -= (random () % 8 == 0);  // Battery slowly discharges
+  values[3] = random () % 1024;       // Light is all over the place
+  values[4] = random () % 201 - 100;  // So is acceleration
+  values[5]++;                        // Packet counter
+  values[6] = -(random () % 40) - 50; // Signal strength (dBm)
+  values[7] = (random () % 100 == 0 ? 0xFF : 0x00);
+}
+
+// Format values the way a node using wx_put_string_frame_printf() might.
+#define FORMAT_RECORD(buf, values)                              \
+  sprintf (                                                     \
+      buf,                                                      \
+      "%" PRIu32 " %" PRId32 " %" PRIu32 " %" PRIu32            \
+      " %" PRId32 " %" PRIu32 " %" PRId32 " %" PRIu32 "\n",     \
+      (uint32_t) values[0],                                     \
+      values[1],                                                \
+      (uint32_t) values[2],                                     \
+      (uint32_t) values[3],                                     \
+      values[4],                                                \
+      (uint32_t) values[5],                                     \
+      values[6],                                                \
+      (uint32_t) values[7] )
+
+typedef struct {
+  uint32_t index;                     // Position in the encoded stream
+  uint8_t key;                        // TRUE iff it's a key record
+  uint8_t length;
+  uint8_t buf[TLM_MAX_RECORD_LENGTH (FIELD_COUNT)];
+  int32_t values[FIELD_COUNT];
+} record_t;
+
+static void
+test_stream (void)
+{
+  test_name = "lossy stream";
+
+  srandom (42);
+
+  tlm_codec_t encoder, decoder;
+  tlm_init (&encoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+  tlm_init (&decoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+
+  record_t history[HISTORY_LENGTH];
+  int32_t values[FIELD_COUNT];
+  memcpy (values, initial_values, sizeof (values));
+
+  // Decoder model: index of the last record successfully decoded, if any
+  uint8_t have_last_decoded = FALSE;
+  uint32_t last_decoded = 0;
+
+  uint32_t decoded_count = 0, refused_count = 0, lost_count = 0;
+  uint32_t binary_bytes = 0, text_bytes = 0;
+  uint16_t loss_burst = 0;
+
+  for ( uint32_t ii = 0 ; ii < STREAM_RECORD_COUNT ; ii++ ) {
+    next_record (values);
+
+    record_t *record = &(history[ii % HISTORY_LENGTH]);
+    record->index = ii;
+    memcpy (record->values, values, sizeof (values));
+    record->length = tlm_encode (&encoder, values, record->buf);
+    if ( record->length > sizeof (record->buf) ) {
+      fail ("record %" PRIu32 " too long", ii);
+    }
+    record->key = (record->buf[0] & 0x80) != 0;
+    if ( ii % KEY_INTERVAL == 0 && ! record->key ) {
+      fail ("record %" PRIu32 " should have been a key record", ii);
+    }
+
+    binary_bytes += record->length;
+    char text[100];
+    text_bytes += FORMAT_RECORD (text, values);
+
+    // Decide what the channel delivers: usually the new record, but
+    // sometimes nothing (in bursts), or an older record instead.
+    if ( loss_burst > 0 ) {
+      loss_burst--;
+      lost_count++;
+      continue;
+    }
+    long int fate = random () % 100;
+    if ( fate < 1 ) {
+      loss_burst = random () % MAX_LOSS_BURST;
+      lost_count++;
+      continue;
+    }
+    if ( fate < 3 && ii >= HISTORY_LENGTH ) {
+      record = &(history[(ii - random () % HISTORY_LENGTH) % HISTORY_LENGTH]);
+    }
+
+    uint8_t expect_decoded
+      = record->key ||
+        (have_last_decoded && last_decoded + 1 == record->index);
+
+    int32_t decoded[FIELD_COUNT];
+    uint8_t result
+      = tlm_decode (&decoder, record->length, record->buf, decoded);
+
+    if ( result != expect_decoded ) {
+      fail (
+          "record %" PRIu32 " (%s) %s",
+          record->index,
+          record->key ? "key" : "delta",
+          result ? "decoded but shouldn't have been" : "refused" );
+    }
+    if ( result ) {
+      if ( memcmp (decoded, record->values, sizeof (decoded)) != 0 ) {
+        fail ("record %" PRIu32 " decoded wrongly", record->index);
+      }
+      have_last_decoded = TRUE;
+      last_decoded = record->index;
+      decoded_count++;
+    }
+    else {
+      have_last_decoded = FALSE;
+      refused_count++;
+    }
+  }
+
+  printf (
+      "%s: ok: %" PRIu32 " decoded, %" PRIu32 " refused, %" PRIu32 " lost\n",
+      test_name,
+      decoded_count,
+      refused_count,
+      lost_count );
+
+  test_name = "record size";
+  double binary_average = (double) binary_bytes / STREAM_RECORD_COUNT;
+  double text_average = (double) text_bytes / STREAM_RECORD_COUNT;
+  if ( binary_average * 2 > text_average ) {
+    fail (
+        "average %.1f bytes binary isn't much better than %.1f bytes text",
+        binary_average,
+        text_average );
+  }
+  printf (
+      "%s: ok: average %.1f bytes binary, %.1f bytes text\n",
+      test_name,
+      binary_average,
+      text_average );
+}
+
+static uint8_t
+expected_varint_length (uint32_t value)
+{
+  uint8_t length = 1;
+  for ( uint64_t limit = 1 << 7 ; value >= limit ; limit <<= 7 ) {
+    length++;
+  }
+
+  return length;
+}
+
+static uint32_t
+expected_zigzag (int32_t value)
+{
+  return value >= 0 ? 2 * (uint32_t) value : 2 * (uint32_t) -(value + 1) + 1;
+}
+
+static void
+test_boundary_values (void)
+{
+  test_name = "boundary values";
+
+  // Values around each varint length boundary (for both plain and zigzag
+  // encodings), and the extremes
+  int32_t boundaries[64];
+  uint8_t boundary_count = 0;
+  for ( uint8_t bits = 6 ; bits <= 28 ; bits += 7 ) {
+    for ( int8_t offset = -1 ; offset <= 1 ; offset++ ) {
+      for ( uint8_t plain = 0 ; plain < 2 ; plain++ ) {
+        int32_t value = (INT32_C (1) << (bits + plain)) + offset;
+        boundaries[boundary_count++] = value;
+        boundaries[boundary_count++] = -value;
+      }
+    }
+  }
+  boundaries[boundary_count++] = 0;
+  boundaries[boundary_count++] = INT32_MAX;
+  boundaries[boundary_count++] = INT32_MIN;
+  boundaries[boundary_count++] = -1;   // UINT32_MAX for unsigned fields
+
+  uint8_t const types[] = {
+    TLM_FIELD_UNSIGNED,
+    TLM_FIELD_SIGNED,
+    TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+    TLM_FIELD_SIGNED | TLM_FIELD_DELTA };
+
+  uint32_t pair_count = 0;
+
+  for ( uint8_t tt = 0 ; tt < sizeof (types) ; tt++ ) {
+    for ( uint8_t ii = 0 ; ii < boundary_count ; ii++ ) {
+      for ( uint8_t jj = 0 ; jj < boundary_count ; jj++ ) {
+        tlm_codec_t encoder, decoder;
+        tlm_init (&encoder, 1, &(types[tt]), UINT8_MAX);
+        tlm_init (&decoder, 1, &(types[tt]), UINT8_MAX);
+
+        int32_t values[2] = { boundaries[ii], boundaries[jj] };
+        for ( uint8_t rr = 0 ; rr < 2 ; rr++ ) {
+          uint8_t buf[TLM_MAX_RECORD_LENGTH (1)];
+          uint8_t length = tlm_encode (&encoder, &(values[rr]), buf);
+
+          uint32_t raw;
+          if ( rr == 1 && (types[tt] & TLM_FIELD_DELTA) ) {
+            raw = expected_zigzag (
+                (int32_t) ((uint32_t) values[1] - (uint32_t) values[0]) );
+          }
+          else if ( (types[tt] & ~TLM_FIELD_DELTA) == TLM_FIELD_SIGNED ) {
+            raw = expected_zigzag (values[rr]);
+          }
+          else {
+            raw = values[rr];
+          }
+          if ( length != 1 + expected_varint_length (raw) ) {
+            fail (
+                "type 0x%02x record %u of (%" PRId32 ", %" PRId32 ") "
+                "encoded to %u bytes",
+                types[tt], rr, values[0], values[1], length );
+          }
+
+          int32_t decoded;
+          if ( ! tlm_decode (&decoder, length, buf, &decoded) ||
+               decoded != values[rr] ) {
+            fail (
+                "type 0x%02x record %u of (%" PRId32 ", %" PRId32 ") "
+                "didn't round trip",
+                types[tt], rr, values[0], values[1] );
+          }
+        }
+        pair_count++;
+      }
+    }
+  }
+
+  printf ("%s: ok: %" PRIu32 " pairs\n", test_name, pair_count);
+}
+
+static void
+test_malformed_records (void)
+{
+  test_name = "malformed records";
+
+  srandom (43);
+
+  // The malformed versions of each record are given to copies of decoder,
+  // and then decoder itself decodes the real record to stay in step.
+  tlm_codec_t encoder, decoder;
+  tlm_init (&encoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+  tlm_init (&decoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+
+  int32_t values[FIELD_COUNT];
+  memcpy (values, initial_values, sizeof (values));
+
+  uint32_t rejected_count = 0;
+
+  for ( uint16_t ii = 0 ; ii < 1000 ; ii++ ) {
+    next_record (values);
+    if ( ii % 3 == 0 ) {
+      values[ii % FIELD_COUNT] = (ii % 2 ? INT32_MIN : -1);   // Long varints
+    }
+    uint8_t buf[TLM_MAX_RECORD_LENGTH (FIELD_COUNT) + 1];
+    uint8_t length = tlm_encode (&encoder, values, buf);
+    uint8_t key = (buf[0] & 0x80) != 0;
+
+    for ( uint8_t truncated = 0 ; truncated < length ; truncated++ ) {
+      tlm_codec_t dc = decoder;
+      int32_t decoded[FIELD_COUNT];
+      if ( tlm_decode (&dc, truncated, buf, decoded) ) {
+        fail ("record %u truncated to %u bytes decoded", ii, truncated);
+      }
+      rejected_count++;
+    }
+
+    tlm_codec_t dc = decoder;
+    int32_t decoded[FIELD_COUNT];
+    buf[length] = 0x00;
+    if ( tlm_decode (&dc, length + 1, buf, decoded) ) {
+      fail ("record %u with a trailing byte decoded", ii);
+    }
+    rejected_count++;
+
+    // The record itself must decode (so the above refusals mean something)
+    if ( ! tlm_decode (&decoder, length, buf, decoded) ||
+         memcmp (decoded, values, sizeof (decoded)) != 0 ) {
+      fail ("%s record %u didn't decode", key ? "key" : "delta", ii);
+    }
+  }
+
+  // Varints that are too long, or have too many bits for a uint32_t
+  uint8_t const type = TLM_FIELD_UNSIGNED;
+  tlm_init (&decoder, 1, &type, 1);
+  uint8_t const overlong[][7] = {
+    { 0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x10 },
+    { 0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F },
+    { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 } };
+  uint8_t const overlong_lengths[] = { 6, 6, 7 };
+  for ( uint8_t ii = 0 ; ii < sizeof (overlong_lengths) ; ii++ ) {
+    int32_t decoded;
+    if ( tlm_decode (&decoder, overlong_lengths[ii], overlong[ii], &decoded) ) {
+      fail ("overlong varint %u decoded", ii);
+    }
+    rejected_count++;
+  }
+  uint8_t const longest[] = { 0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+  int32_t decoded;
+  if ( ! tlm_decode (&decoder, sizeof (longest), longest, &decoded) ||
+       (uint32_t) decoded != UINT32_MAX ) {
+    fail ("longest valid varint didn't decode");
+  }
+
+  printf ("%s: ok: %" PRIu32 " refused\n", test_name, rejected_count);
+}
+
+int
+main (void)
+{
+  test_stream ();
+  test_boundary_values ();
+  test_malformed_records ();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+// Test/demo for the telemetry.h interface.
+//
+// This program encodes a stream of simulated sensor records, decodes them
+// again and checks that the results match, including when records are
+// lost along the way.  Then it compares the encoded size and the CPU
+// cycles per record (using timer1 as a cycle counter) with those of the
+// same record formatted as text with sprintf().
+//
+// Test results are output via the term_io.h interface.  Run
+//
+//   make -rR run_screen
+//
+// from the module directory to see them.
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry.h"
+#define TERM_IO_POLLUTE_NAMESPACE_WITH_DEBUGGING_GOOP
+#include "term_io.h"
+#include "timer1_stopwatch.h"
+#include "util.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+#if TIMER1_STOPWATCH_PRESCALER_DIVIDER != 1
+#  error This test counts cycles, so it needs a prescaler divider of 1
+#endif
+
+// Schema of the simulated records: a timestamp, a temperature in
+// hundredths of a degree, a battery voltage in millivolts, a light level,
+// a signed acceleration, a packet counter, a signal strength and a status
+// byte.
+#define FIELD_COUNT 8
+static uint8_t const field_types[FIELD_COUNT] = {
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_SIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_UNSIGNED,
+  TLM_FIELD_SIGNED,
+  TLM_FIELD_UNSIGNED | TLM_FIELD_DELTA,
+  TLM_FIELD_SIGNED,
+  TLM_FIELD_UNSIGNED };
+
+#define KEY_INTERVAL 16
+
+#define RECORD_COUNT 1000
+
+// One in this many records is "lost" between the encoder and decoder.
+#define LOSS_INTERVAL 37
+
+static void
+next_record (int32_t *values)
+{
+  // Advance the simulated sensor readings in values.
+
+  values[0] += 1000;                  // One second later, in ms
+  values[1] += random () % 5 - 2;     // Temperature wanders slowly
+  values[2] -= (random () % 8 == 0);  // Battery slowly discharges
+  values[3] = random () % 1024;       // Light is all over the place
+  values[4] = random () % 201 - 100;  // So is acceleration
+  values[5]++;                        // Packet counter
+  values[6] = -(random () % 40) - 50; // Signal strength (dBm)
+  values[7] = (random () % 100 == 0 ? 0xFF : 0x00);
+}
+
+// Format values the way a node using wx_put_string_frame_printf() might.
+#define FORMAT_RECORD(buf, values)                              \
+  sprintf (                                                     \
+      buf,                                                      \
+      "%" PRIu32 " %" PRId32 " %" PRIu32 " %" PRIu32            \
+      " %" PRId32 " %" PRIu32 " %" PRId32 " %" PRIu32 "\n",     \
+      (uint32_t) values[0],                                     \
+      values[1],                                                \
+      (uint32_t) values[2],                                     \
+      (uint32_t) values[3],                                     \
+      values[4],                                                \
+      (uint32_t) values[5],                                     \
+      values[6],                                                \
+      (uint32_t) values[7] )
+
+static int32_t const initial_values[FIELD_COUNT]
+  = { 0, 2150, 3300, 0, 0, 0, 0, 0 };
+
+int
+main (void)
+{
+  term_io_init ();
+  PFP ("\n");
+  PFP ("\n");
+  PFP ("term_io_init() worked.\n");
+  PFP ("\n");
+
+  srandom (42);
+
+  tlm_codec_t encoder, decoder;
+  tlm_init (&encoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+  tlm_init (&decoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+
+  int32_t values[FIELD_COUNT];
+  memcpy (values, initial_values, sizeof (values));
+  int32_t decoded[FIELD_COUNT];
+  uint8_t buf[TLM_MAX_RECORD_LENGTH (FIELD_COUNT)];
+  char text[100];
+
+  uint32_t binary_bytes = 0, text_bytes = 0;
+  uint16_t decoded_count = 0, refused_count = 0;
+
+  PFP ("Round trip of %u records (with losses)... ", RECORD_COUNT);
+  for ( uint16_t ii = 0 ; ii < RECORD_COUNT ; ii++ ) {
+    next_record (values);
+    uint8_t length = tlm_encode (&encoder, values, buf);
+    PFP_ASSERT (length <= sizeof (buf));
+    binary_bytes += length;
+    text_bytes += FORMAT_RECORD (text, values);
+    if ( ii % LOSS_INTERVAL == LOSS_INTERVAL - 1 ) {
+      continue;
+    }
+    if ( tlm_decode (&decoder, length, buf, decoded) ) {
+      PFP_ASSERT (! memcmp (decoded, values, sizeof (values)));
+      decoded_count++;
+    }
+    else {
+      // Only delta records after a loss should get refused (the high bit
+      // of the header byte is the key record flag)
+      PFP_ASSERT (! (buf[0] & 0x80));
+      refused_count++;
+    }
+  }
+  PFP ("ok.\n");
+  PFP ("  %u decoded, %u refused after losses\n", decoded_count, refused_count);
+
+  PFP ("Extreme values... ");
+  tlm_force_key_record (&encoder);
+  for ( uint8_t ii = 0 ; ii < FIELD_COUNT ; ii++ ) {
+    values[ii] = (ii % 2 ? INT32_MIN : INT32_MAX);
+  }
+  for ( uint8_t ii = 0 ; ii < 2 ; ii++ ) {
+    uint8_t length = tlm_encode (&encoder, values, buf);
+    PFP_ASSERT (tlm_decode (&decoder, length, buf, decoded));
+    PFP_ASSERT (! memcmp (decoded, values, sizeof (values)));
+    for ( uint8_t jj = 0 ; jj < FIELD_COUNT ; jj++ ) {
+      values[jj] = ~values[jj];   // Biggest possible deltas
+    }
+  }
+  PFP ("ok.\n");
+
+  PFP ("Malformed records... ");
+  uint8_t length = tlm_encode (&encoder, values, buf);
+  PFP_ASSERT (! tlm_decode (&decoder, length - 1, buf, decoded));
+  PFP_ASSERT (! tlm_decode (&decoder, length + 1, buf, decoded));
+  PFP_ASSERT (! tlm_decode (&decoder, 0, buf, decoded));
+  PFP ("ok.\n");
+  PFP ("\n");
+
+  PFP (
+      "Average size: %lu.%lu bytes binary, %lu.%lu bytes text\n",
+      binary_bytes / RECORD_COUNT,
+      (binary_bytes * 10 / RECORD_COUNT) % 10,
+      text_bytes / RECORD_COUNT,
+      (text_bytes * 10 / RECORD_COUNT) % 10 );
+
+  timer1_stopwatch_init ();
+
+  memcpy (values, initial_values, sizeof (values));
+  tlm_init (&encoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+  tlm_init (&decoder, FIELD_COUNT, field_types, KEY_INTERVAL);
+
+  uint32_t encode_cycles = 0, decode_cycles = 0, format_cycles = 0;
+#define TIMED_RECORDS 100
+  for ( uint8_t ii = 0 ; ii < TIMED_RECORDS ; ii++ ) {
+    next_record (values);
+
+    TIMER1_STOPWATCH_RESET ();
+    length = tlm_encode (&encoder, values, buf);
+    encode_cycles += TIMER1_STOPWATCH_TICKS ();
+    PFP_ASSERT (! TIMER1_STOPWATCH_OVERFLOWED ());
+
+    TIMER1_STOPWATCH_RESET ();
+    uint8_t sentinel = tlm_decode (&decoder, length, buf, decoded);
+    decode_cycles += TIMER1_STOPWATCH_TICKS ();
+    PFP_ASSERT (! TIMER1_STOPWATCH_OVERFLOWED ());
+    PFP_ASSERT (sentinel);
+
+    TIMER1_STOPWATCH_RESET ();
+    FORMAT_RECORD (text, values);
+    format_cycles += TIMER1_STOPWATCH_TICKS ();
+    PFP_ASSERT (! TIMER1_STOPWATCH_OVERFLOWED ());
+  }
+
+  PFP ("Average cycles per record:\n");
+  PFP ("  tlm_encode()  %6lu\n", encode_cycles / TIMED_RECORDS);
+  PFP ("  tlm_decode()  %6lu\n", decode_cycles / TIMED_RECORDS);
+  PFP ("  sprintf()     %6lu\n", format_cycles / TIMED_RECORDS);
+
+  PFP ("\n");
+  PFP ("All tests passed.\n");
+
+  for ( ; ; ) {
+    ;
+  }
+}
@@ -0,0 +1 @@
+../timer1_stopwatch/timer1_stopwatch.h
\ No newline at end of file
@@ -0,0 +1 @@
+../term_io/uart.h
\ No newline at end of file
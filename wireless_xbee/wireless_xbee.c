@@ -5,11 +5,14 @@
 #  error The HANDLE_ERRORS() macro in this file requires assert()
 #endif
 #include <assert.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>   // FIXXME: probably only needed for broken assert header
 #include <string.h>
+#include <util/atomic.h>
 #include <util/crc16.h>
 #include <util/delay.h>
 
@@ -23,10 +26,23 @@
 #undef BTRAP
 #define BTRAP() BTRAP_USING (DDRD, DDD4, PORTD, PORTD4, 100.0)
 
+#ifdef WX_RX_INTERRUPT_DRIVEN
+// These are defined along with the receive ISR below
+static void
+rx_interrupt_enable (void);
+static void
+rx_interrupt_disable (void);
+#endif
+
 void
 wx_init (void)
 {
   uart_init ();
+
+#ifdef WX_RX_INTERRUPT_DRIVEN
+  rx_interrupt_enable ();
+  sei ();
+#endif
 }
 
 // Define a HANDLE_ERRORS macro that either asserts the given condition, or
@@ -112,6 +128,12 @@ wx_enter_at_command_mode (void)
   // success.  After this function returns, the XBee will remain in command
   // mode for up to 10 seconds (or until exit_at_command_mode() is called.
 
+#ifdef WX_RX_INTERRUPT_DRIVEN
+  // The AT command responses are read by polling, so the receive ISR has
+  // to get out of the way.
+  rx_interrupt_disable ();
+#endif
+
   // This magic sequence should send us into AT command mode
   double const dwmms = 1042;   // Delay With Margin (in ms) -- AT requires 1 s
   _delay_ms (dwmms);
@@ -145,7 +167,13 @@ wx_enter_at_command_mode (void)
   _delay_ms (magic_guard_time);
 
   // Now try a command to ensure that we've made in into command mode.
-  HANDLE_ERRORS (wx_at_command_expect_ok (""));
+  uint8_t sentinel = wx_at_command_expect_ok ("");
+#ifdef WX_RX_INTERRUPT_DRIVEN
+  if ( ! sentinel ) {
+    rx_interrupt_enable ();   // Since we apparently aren't in command mode
+  }
+#endif
+  HANDLE_ERRORS (sentinel);
 
   return TRUE;
 }
@@ -158,7 +186,11 @@ wx_exit_at_command_mode (void)
 
   char response[WX_MCOSL];
 
-  HANDLE_ERRORS (wx_at_command ("CN", response));
+  uint8_t sentinel = wx_at_command ("CN", response);
+#ifdef WX_RX_INTERRUPT_DRIVEN
+  rx_interrupt_enable ();   // Even on failure, so frames aren't shut out
+#endif
+  HANDLE_ERRORS (sentinel);
 
   HANDLE_ERRORS (! strcmp (response, "OK"));
 
@@ -305,6 +337,119 @@ wx_restore_defaults (void)
   return TRUE;
 }
 
+static uint8_t
+ensure_parameter (char const *parameter, uint16_t value, uint8_t *changed)
+{
+  // Require AT command mode.  Query parameter (a two character command
+  // string like "ID"), and if it isn't set to value, set it (without saving
+  // the settings) and set *changed to TRUE.
+
+  char buf[WX_MCOSL];   // Buffer for command/output string storage
+
+  uint8_t cp = sprintf_P (buf, PSTR ("%s"), parameter);   // Chars Printed
+  HANDLE_ERRORS (cp == 2);
+
+  HANDLE_ERRORS (wx_at_command (buf, buf));
+
+  int const base_16 = 16;   // Base to use to convert retrieved string
+  char *endptr;   //  Pointer to be set to end of converted string
+  long int ev = strtol (buf, &endptr, base_16);   // Existing Value
+  // Didn't get a convertible string back from command
+  HANDLE_ERRORS (*buf != '\0' && *endptr == '\0');
+  if ( ev == value ) {
+    return TRUE;
+  }
+
+  // The argument must be upper case, without any leading "0x" or "0X".
+  cp = sprintf_P (buf, PSTR ("%s%" PRIX16), parameter, value);
+  HANDLE_ERRORS (cp > 2);
+
+  HANDLE_ERRORS (wx_at_command_expect_ok (buf));
+
+  *changed = TRUE;
+
+  return TRUE;
+}
+
+static uint8_t
+apply_config (wx_config_t const *config)
+{
+  // Require AT command mode.  Ensure all the parameters in *config are
+  // set, and save the settings if anything changed.
+
+  uint8_t changed = FALSE;
+
+  HANDLE_ERRORS (ensure_parameter ("ID", config->network_id, &changed));
+  HANDLE_ERRORS (ensure_parameter ("CH", config->channel, &changed));
+  HANDLE_ERRORS (ensure_parameter ("MY", config->source_address, &changed));
+  HANDLE_ERRORS (
+      ensure_parameter ("DL", config->destination_address, &changed) );
+  HANDLE_ERRORS (ensure_parameter ("PL", config->power_level, &changed));
+
+  if ( changed ) {
+    HANDLE_ERRORS (wx_at_command_expect_ok ("WR"));
+  }
+
+  return TRUE;
+}
+
+// The configuration hash is stored followed by its complement, so erased
+// EEPROM (all 0xff bytes) never looks like a stored hash.
+#define EEPROM_CONFIG_HASH_ADDRESS ((uint16_t *) WX_CONFIG_HASH_EEPROM_ADDRESS)
+#define EEPROM_CONFIG_HASH_COMPLEMENT_ADDRESS (EEPROM_CONFIG_HASH_ADDRESS + 1)
+
+static uint16_t
+config_hash (wx_config_t const *config)
+{
+  // avr-gcc doesn't pad structures, so all the bytes of *config are
+  // meaningful.
+
+  uint16_t hash = 0;
+
+  for ( uint8_t ii = 0 ; ii < sizeof (wx_config_t) ; ii++ ) {
+    hash = _crc_ccitt_update (hash, ((uint8_t const *) config)[ii]);
+  }
+
+  return hash;
+}
+
+uint8_t
+wx_ensure_config (wx_config_t const *config)
+{
+  HANDLE_ERRORS (config->channel >= 0x0b);
+  HANDLE_ERRORS (config->channel <= 0x1a);
+  HANDLE_ERRORS (config->power_level <= 4);
+
+  uint16_t hash = config_hash (config);
+  uint16_t hash_complement = ~hash;
+
+  if ( eeprom_read_word (EEPROM_CONFIG_HASH_ADDRESS) == hash &&
+       eeprom_read_word (EEPROM_CONFIG_HASH_COMPLEMENT_ADDRESS)
+         == hash_complement ) {
+    return TRUE;   // Already applied, no need to talk to the XBee at all
+  }
+
+  HANDLE_ERRORS (wx_enter_at_command_mode ());
+
+  // We want to leave command mode even if something went wrong
+  uint8_t applied = apply_config (config);
+  uint8_t exited = wx_exit_at_command_mode ();
+  HANDLE_ERRORS (applied);
+  HANDLE_ERRORS (exited);
+
+  eeprom_update_word (EEPROM_CONFIG_HASH_ADDRESS, hash);
+  eeprom_update_word (EEPROM_CONFIG_HASH_COMPLEMENT_ADDRESS, hash_complement);
+
+  return TRUE;
+}
+
+void
+wx_forget_config (void)
+{
+  eeprom_update_word (EEPROM_CONFIG_HASH_COMPLEMENT_ADDRESS, UINT16_MAX);
+  eeprom_update_word (EEPROM_CONFIG_HASH_ADDRESS, UINT16_MAX);
+}
+
 // Factor of safety to use when delaying to force radio packet transmission.
 // We make this a little large since the character time might actually be
 // a bit greater than what we calculate in DELAY_TO_FORCE_TRANSMISSION()
@@ -335,24 +480,33 @@ wx_restore_defaults (void)
 // The CRC algorithm being used starts with this value
 #define CRC_INITIAL_VALUE 0xffff
 
+// Bit b % 8 of entry b / 8 of escape_bitmap is set iff byte value b needs
+// to be escaped (so entry 0x02 holds XON and XOFF, and entry 0x0F holds
+// ESCAPE and FRAME_DELIMITER).  The AVR has no barrel shifter, so bit_mask
+// supplies the bit instead of a variable shift.
+
+static uint8_t const escape_bitmap[32] PROGMEM = {
+  0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static uint8_t const bit_mask[8] PROGMEM = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
+};
+
 static uint8_t
 needs_escaped (uint8_t byte)
 {
-  // Return true iff byte is one of the ones that needs to be escaped in
-  // our frame scheme.
-
-  switch ( byte ) {
-    // NOTE: we're using fall-through behavior of C switch statement here
-    case FRAME_DELIMITER:
-    case ESCAPE:
-    case XON:
-    case XOFF:
-      return TRUE;
-      break;
-    default:
-      return FALSE;
-      break;
-  }
+  // Return true (non-zero) iff byte is one of the ones that needs to be
+  // escaped in our frame scheme.  This is a pair of table lookups rather
+  // than a comparison against each special value, since it's called for
+  // every payload byte.
+
+  return
+    pgm_read_byte (&escape_bitmap[byte >> 3]) &
+    pgm_read_byte (&bit_mask[byte & 0x07]);
 }
 
 // Put two possibly escaped CRC bytes out over the air (a total of up to 4
@@ -375,30 +529,71 @@ needs_escaped (uint8_t byte)
     } \
   } while ( 0 )
 
-uint8_t
-wx_put_frame (uint8_t count, void const *buf)
+static uint16_t
+escaped_length (uint8_t count, uint8_t const *buf)
 {
-  uint8_t epl = 0;   // Escaped payload length
-  uint8_t ii;        // Index variable
+  // Return the number of bytes buf will take up once escaped.  The result
+  // can't overflow because each byte at most doubles.
 
-  uint16_t lcrc = CRC_INITIAL_VALUE;   // Length (and delimiter) CRC value
-  uint16_t pcrc = CRC_INITIAL_VALUE;   // Payload CRC value
+  uint16_t el = count;   // Escaped Length
 
-  // Compute checksum and escaped payload length
-  for ( ii = 0 ; ii < count ; ii++ ) {
-    if ( needs_escaped(((uint8_t *) buf)[ii]) ) {
-      pcrc = _crc_ccitt_update (pcrc, ESCAPE);
-      pcrc = _crc_ccitt_update (pcrc, ((uint8_t *) buf)[ii] ^ ESCAPE_MODIFIER);
-      epl += 2;
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    if ( UNLIKELY (needs_escaped (buf[ii])) ) {
+      el++;
     }
-    else {
-      pcrc = _crc_ccitt_update (pcrc, ((uint8_t *) buf)[ii]);
-      epl++;
+  }
+
+  return el;
+}
+
+static uint16_t
+put_escaped_payload (uint16_t pcrc, uint8_t count, uint8_t const *buf)
+{
+  // Put count bytes from buf out over the air, escaping them as required,
+  // and return pcrc updated with the bytes actually sent.  The CRC is
+  // updated while we wait for the UART to take the next byte anyway, so at
+  // 9600 baud it costs nothing.
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    uint8_t cb = buf[ii];   // Current Byte
+    if ( UNLIKELY (needs_escaped (cb)) ) {
+      WX_PUT_BYTE (ESCAPE);
+      pcrc = _crc_ccitt_update (pcrc, ESCAPE);
+      cb ^= ESCAPE_MODIFIER;
     }
+    WX_PUT_BYTE (cb);
+    pcrc = _crc_ccitt_update (pcrc, cb);
+  }
+
+  return pcrc;
+}
+
+uint8_t
+wx_put_split_frame (
+    uint8_t header_count,
+    void const *header,
+    uint8_t body_count,
+    void const *body )
+{
+  // Escaped payload length.  The payload length has to go in the frame
+  // before the payload, so unlike the CRC it can't be computed as we go.
+  uint16_t epl
+    = escaped_length (header_count, header) + escaped_length (body_count, body);
+
+  // These are constant properties of our frame format
+  uint8_t const fdbc = 1;   // Frame Delimiter Byte Count
+  uint8_t const lbc  = 2;   // Length Byte Count
+  uint8_t const cbc  = 4;   // CRC Byte Count
+
+  // Check this before computing anything else, since epl might not even fit
+  // in the length field.  This check is repeated more precisely below.
+  if ( fdbc + lbc + cbc + epl > WX_TRANSPARENT_MODE_MAX_PACKET_SIZE ) {
+    return FALSE;
   }
 
   // Compute the length field bytes and the CRC that covers the frame
   // delimiter and length bytes
+  uint16_t lcrc = CRC_INITIAL_VALUE;   // Length (and delimiter) CRC value
   uint8_t lxorfb;   // Lenght XOR'ed Flag Byte
   uint8_t pxlb;     // Possibley Xor'ed Length Byte
   lcrc = _crc_ccitt_update (lcrc, FRAME_DELIMITER);
@@ -413,37 +608,26 @@ wx_put_frame (uint8_t count, void const *buf)
   lcrc = _crc_ccitt_update (lcrc, lxorfb);
   lcrc = _crc_ccitt_update (lcrc, pxlb);
 
-  // These are constant properties of our frame format
-  uint8_t const fdbc = 1;   // Frame Delimiter Byte Count
-  uint8_t const lbc  = 2;   // Length Byte Count
-  uint8_t const cbc  = 4;   // CRC Byte Count
-
   uint8_t cebc = 0;   // CRC escape byte count
   if ( needs_escaped (HIGH_BYTE (lcrc)) ) { cebc++; }
   if ( needs_escaped (LOW_BYTE (lcrc)) )  { cebc++; }
-  if ( needs_escaped (HIGH_BYTE (pcrc)) ) { cebc++; }
-  if ( needs_escaped (LOW_BYTE (pcrc)) )  { cebc++; }
+  // The payload CRC isn't known until the payload has been sent, so we
+  // have to assume that both its bytes will need escaping.
+  cebc += 2;
 
-  // If our frame won't fit in a radio packet, return FALSE
+  // If our frame might not fit in a radio packet, return FALSE
   if ( fdbc + lbc + cbc + cebc + epl > WX_TRANSPARENT_MODE_MAX_PACKET_SIZE ) {
     return FALSE;
   }
 
-  // Transmit the actual frame
+  // Transmit the actual frame, computing the payload CRC as we go
   WX_PUT_BYTE (FRAME_DELIMITER);
   WX_PUT_BYTE (lxorfb);
   WX_PUT_BYTE (pxlb);
   PUT_POSSIBLY_ESCAPED_CRC_BYTES (lcrc);
-  for ( ii = 0 ; ii < count ; ii++ ) {
-    // NOTE: we're using fall-through behavior of C switch statement here
-    if ( needs_escaped (((uint8_t *) buf)[ii]) ) {
-        WX_PUT_BYTE (ESCAPE);
-        WX_PUT_BYTE (((uint8_t *) buf)[ii] ^ ESCAPE_MODIFIER);
-    }
-    else{
-      WX_PUT_BYTE (((uint8_t *) buf)[ii]);
-    }
-  }
+  uint16_t pcrc = CRC_INITIAL_VALUE;   // Payload CRC value
+  pcrc = put_escaped_payload (pcrc, header_count, header);
+  pcrc = put_escaped_payload (pcrc, body_count, body);
   PUT_POSSIBLY_ESCAPED_CRC_BYTES (pcrc);
 
   DELAY_TO_FORCE_TRANSMISSION ();
@@ -451,6 +635,12 @@ wx_put_frame (uint8_t count, void const *buf)
   return TRUE;
 }
 
+uint8_t
+wx_put_frame (uint8_t count, void const *buf)
+{
+  return wx_put_split_frame (0, NULL, count, buf);
+}
+
 uint8_t
 wx_put_string_frame (char const *str)
 {
@@ -585,15 +775,392 @@ crc_ccitt_update (uint16_t crc, uint8_t data)
 }
 */
 
+// State of a frame being received.  This is what wx_get_frame() (or the
+// receive ISR, if WX_RX_INTERRUPT_DRIVEN is defined) keeps between bytes.
+typedef struct {
+  uint8_t fs;       // Frame State
+  uint16_t crc;     // Cyclic Redundany Check value
+  uint8_t lxorfb;   // Length XOR'ed Flag Byte
+  uint8_t epl;      // Escaped Payload Length
+  uint8_t epbr;     // Escaped Payload Bytes Read (so far)
+  uint8_t mfps;     // Maximum Frame Payload Size
+  uint8_t rfps;     // Received Frame Payload Size (so far)
+  uint8_t *buf;     // Buffer into which unescaped payload is written
+} deframer_t;
+
+static void
+deframer_reset (deframer_t *df, uint8_t mfps, void *buf)
+{
+  df->fs = FRAME_STATE_OUTSIDE_FRAME;
+  df->crc = CRC_INITIAL_VALUE;
+  df->lxorfb = 42;   // Bogus initialization
+  df->epl = 42;      // Bogus initialization
+  df->epbr = 0;
+  df->mfps = mfps;
+  df->rfps = 0;
+  df->buf = buf;
+}
+
+// Possible results of deframe_byte()
+#define DEFRAME_RESULT_IN_PROGRESS 0
+#define DEFRAME_RESULT_ERROR       1
+#define DEFRAME_RESULT_COMPLETE    2
+
+static uint8_t
+deframe_byte (deframer_t *df, uint8_t cb)
+{
+  // Feed Current Byte cb to the frame state machine in df.  Return
+  // DEFRAME_RESULT_COMPLETE if cb completes a correct frame, or
+  // DEFRAME_RESULT_ERROR if it shows that the frame being read is corrupt
+  // or too big for df->buf, or DEFRAME_RESULT_IN_PROGRESS otherwise.
+
+  if ( cb == FRAME_DELIMITER ) {
+    // A frame delimiter should only occur unescaped when we aren't
+    // already reading a frame.  If we see it elsewhere it means corrupt
+    // data.  Since this is an an error from every frame state except
+    // one, we check for it just once up front.  In theory the CRC
+    // check would catch this anyway since it should only occur due to
+    // data corruption.  But it could also be due to a malformed frame,
+    // so we check for it explicitly.
+    if ( df->fs != FRAME_STATE_OUTSIDE_FRAME ) {
+      return DEFRAME_RESULT_ERROR;
+    }
+  }
+  // The XON and XOFF bytes should never occur unescaped in a frame
+  else if ( df->fs != FRAME_STATE_OUTSIDE_FRAME && (cb == XON || cb == XOFF) ) {
+    return DEFRAME_RESULT_ERROR;
+  }
+
+  switch ( df->fs ) {
+
+    case FRAME_STATE_OUTSIDE_FRAME:
+      if ( cb == FRAME_DELIMITER ) {
+        df->crc = _crc_ccitt_update (df->crc, cb);
+        df->fs = FRAME_STATE_AT_LENGTH_XORED_FLAG;
+      }
+      break;
+
+    case FRAME_STATE_AT_LENGTH_XORED_FLAG:
+      df->crc = _crc_ccitt_update (df->crc, cb);
+      df->lxorfb = cb;
+      if ( df->lxorfb != WX_LENGTH_BYTE_XORED &&
+           df->lxorfb != WX_LENGTH_BYTE_NOT_XORED ) {
+        // This flag must be one of two possible values
+        return DEFRAME_RESULT_ERROR;
+      }
+      df->fs = FRAME_STATE_AT_LENGTH_ITSELF;
+      break;
+
+    case FRAME_STATE_AT_LENGTH_ITSELF:
+      df->crc = _crc_ccitt_update (df->crc, cb);
+      df->epl = cb;
+      if ( df->lxorfb == WX_LENGTH_BYTE_XORED ) {
+        df->epl ^= ESCAPE_MODIFIER;
+      }
+      df->fs = FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE;
+      break;
+
+    case FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE:
+      if ( cb == ESCAPE ) {
+        df->fs = FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE_ESCAPED;
+      }
+      else {
+        if ( cb != HIGH_BYTE (df->crc) ) {
+          // CRC of frame delimiter and length failed
+          return DEFRAME_RESULT_ERROR;
+        }
+        df->fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE;
+      }
+      break;
+
+    case FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE_ESCAPED:
+      if ( (cb ^ ESCAPE_MODIFIER) != HIGH_BYTE (df->crc) ) {
+        return DEFRAME_RESULT_ERROR;
+      }
+      df->fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE;
+      break;
+
+    case FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE:
+      if ( cb == ESCAPE ) {
+        df->fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE_ESCAPED;
+      }
+      else {
+        if ( cb != LOW_BYTE (df->crc) ) {
+          // CRC of frame delimiter and length failed
+          return DEFRAME_RESULT_ERROR;
+        }
+        df->crc = CRC_INITIAL_VALUE;  // Reset for later use on payload
+        if ( df->epl > 0 ) {
+          df->fs = FRAME_STATE_IN_PAYLOAD;
+        }
+        else {
+          df->fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
+        }
+      }
+      break;
+
+    case FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE_ESCAPED:
+      if ( (cb ^ ESCAPE_MODIFIER) != LOW_BYTE (df->crc) ) {
+        return DEFRAME_RESULT_ERROR;
+      }
+      df->crc = CRC_INITIAL_VALUE;  // Reset for later use on payload
+      if ( df->epl > 0 ) {
+        df->fs = FRAME_STATE_IN_PAYLOAD;
+      }
+      else {
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
+      }
+      break;
+
+    case FRAME_STATE_IN_PAYLOAD:
+      df->crc = _crc_ccitt_update (df->crc, cb);
+      if ( cb == ESCAPE ) {
+        df->fs = FRAME_STATE_IN_PAYLOAD_ESCAPED;
+      }
+      else {
+        df->buf[df->rfps] = cb;
+        df->rfps++;
+      }
+      df->epbr++;
+      if ( df->epbr == df->epl ) {
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
+      }
+      else if ( df->rfps == df->mfps ) {
+        // Frame exceeded caller-supplied max size
+        return DEFRAME_RESULT_ERROR;
+      }
+      break;
+
+    case FRAME_STATE_IN_PAYLOAD_ESCAPED:
+      df->crc = _crc_ccitt_update (df->crc, cb);
+      df->buf[df->rfps] = cb ^ ESCAPE_MODIFIER;
+      df->rfps++;
+      df->epbr++;
+      if ( df->epbr == df->epl ) {
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
+      }
+      // FIXXME: we could detect this error once we get as far as
+      // reading the length in the frame, but wasting a little time
+      // reading the frame bytes probably doesn't make much difference
+      // at least given our current very coarse error reporting scheme
+      else if ( df->rfps == df->mfps ) {
+        // Frame exceeded caller-supplied max size
+        return DEFRAME_RESULT_ERROR;
+      }
+      else {
+        df->fs = FRAME_STATE_IN_PAYLOAD;
+      }
+      break;
+
+    case FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE:
+      if ( cb == ESCAPE ) {
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE_ESCAPED;
+      }
+      else {
+        if ( cb != HIGH_BYTE (df->crc) ) {
+          return DEFRAME_RESULT_ERROR;   // CRC failed
+        }
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE;
+      }
+      break;
+
+    case FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE_ESCAPED:
+      if ( (cb ^ ESCAPE_MODIFIER) != HIGH_BYTE (df->crc) ) {
+        return DEFRAME_RESULT_ERROR;
+      }
+      df->fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE;
+      break;
+
+    case FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE:
+      if ( cb == ESCAPE ) {
+        df->fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE_ESCAPED;
+      }
+      else {
+        if ( cb != LOW_BYTE (df->crc) ) {
+          return DEFRAME_RESULT_ERROR;   // CRC failed
+        }
+        df->fs = FRAME_STATE_COMPLETE;
+        return DEFRAME_RESULT_COMPLETE;
+      }
+      break;
+
+    case FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE_ESCAPED:
+      if ( (cb ^ ESCAPE_MODIFIER) != LOW_BYTE (df->crc) ) {
+        return DEFRAME_RESULT_ERROR;
+      }
+      df->fs = FRAME_STATE_COMPLETE;
+      return DEFRAME_RESULT_COMPLETE;
+
+    default:
+      assert (0);   // Shouldn't be here
+      break;
+  }
+
+  return DEFRAME_RESULT_IN_PROGRESS;
+}
+
+#ifdef WX_RX_INTERRUPT_DRIVEN
+
+volatile uint16_t wx_rx_dropped_frame_count = 0;
+volatile uint16_t wx_rx_bad_frame_count = 0;
+
+// A received frame waiting in the queue
+typedef struct {
+  uint8_t length;
+  uint8_t payload[WX_RX_QUEUE_MAX_PAYLOAD];
+} queued_frame_t;
+
+// The frame queue.  The ISR is the only thing that increments rx_queue_count
+// and it only ever writes into the slot just past the last queued frame.
+// The foreground is the only thing that changes rx_queue_head or decrements
+// rx_queue_count, and it only does so after it's done with the frame at
+// rx_queue_head, and always changes both together in one ATOMIC_BLOCK (so
+// the ISR never sees a head and count that disagree).
+static queued_frame_t rx_queue[WX_RX_QUEUE_FRAMES];
+static volatile uint8_t rx_queue_head = 0;
+static volatile uint8_t rx_queue_count = 0;
+
+// Deframer state for the receive ISR, and the queue slot it's filling.  The
+// slot is chosen once when the frame starts, and the length is stored in
+// that same slot when it completes.
+static deframer_t rx_deframer;
+static uint8_t rx_slot;
+
+static uint8_t
+start_queued_frame (void)
+{
+  // Point rx_deframer at the free queue slot and return TRUE, or return
+  // FALSE if there isn't a free slot.  Must only be called from the ISR.
+
+  if ( rx_queue_count == WX_RX_QUEUE_FRAMES ) {
+    return FALSE;
+  }
+
+  rx_slot = (rx_queue_head + rx_queue_count) % WX_RX_QUEUE_FRAMES;
+  deframer_reset (
+      &rx_deframer, WX_RX_QUEUE_MAX_PAYLOAD, rx_queue[rx_slot].payload );
+
+  return TRUE;
+}
+
+ISR (USART_RX_vect)
+{
+  // The error flags must be read before the data register
+  uint8_t rx_error = WX_UART_RX_ERROR ();
+  uint8_t cb = WX_GET_BYTE ();   // Current Byte
+
+  if ( UNLIKELY (rx_error) ) {
+    // Whatever frame we were in the middle of has lost at least one byte
+    if ( rx_deframer.fs != FRAME_STATE_OUTSIDE_FRAME ) {
+      wx_rx_bad_frame_count++;
+      rx_deframer.fs = FRAME_STATE_OUTSIDE_FRAME;
+    }
+    return;
+  }
+
+  if ( rx_deframer.fs == FRAME_STATE_OUTSIDE_FRAME ) {
+    // Data outside frames is ignored.  The escaping guarantees that the
+    // rest of a frame we don't have room for doesn't contain a delimiter,
+    // so it gets ignored as well.
+    if ( cb != FRAME_DELIMITER ) {
+      return;
+    }
+    if ( ! start_queued_frame () ) {
+      wx_rx_dropped_frame_count++;
+      return;
+    }
+  }
+
+  uint8_t result = deframe_byte (&rx_deframer, cb);
+
+  if ( LIKELY (result == DEFRAME_RESULT_IN_PROGRESS) ) {
+    return;
+  }
+
+  if ( result == DEFRAME_RESULT_COMPLETE ) {
+    rx_queue[rx_slot].length = rx_deframer.rfps;
+    rx_queue_count++;
+    rx_deframer.fs = FRAME_STATE_OUTSIDE_FRAME;
+    return;
+  }
+
+  // Otherwise the frame was bad
+  wx_rx_bad_frame_count++;
+  rx_deframer.fs = FRAME_STATE_OUTSIDE_FRAME;
+  // An unexpected delimiter is most likely the start of a new frame (the
+  // previous one having been truncated), so we resynchronize on it
+  // rather than waiting for the next one.
+  if ( cb == FRAME_DELIMITER && start_queued_frame () ) {
+    deframe_byte (&rx_deframer, cb);
+  }
+}
+
+static void
+rx_interrupt_enable (void)
+{
+  WX_UART_FLUSH_RX_BUFFER ();
+  rx_deframer.fs = FRAME_STATE_OUTSIDE_FRAME;
+  UCSR0B |= _BV (RXCIE0);
+}
+
+static void
+rx_interrupt_disable (void)
+{
+  UCSR0B &= ~(_BV (RXCIE0));
+}
+
+uint8_t
+wx_frame_available (void)
+{
+  return rx_queue_count != 0;
+}
+
+uint8_t
+wx_get_frame (uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout)
+{
+  uint16_t et = 0;    // Elapsed Time
+
+  *rfps = 0;   // We've received nothing so far
+
+  while ( rx_queue_count == 0 ) {
+    if ( et >= timeout ) {
+      return FALSE;   // Timeout
+    }
+    // See the comments near the similar delay in the polling version of
+    // this function below.
+    uint16_t const poll_interval_ms = 1;
+    double const poll_interval_ms_double = 1.0;
+    _delay_ms (poll_interval_ms_double);
+    et += poll_interval_ms;
+  }
+
+  queued_frame_t const *qf = &(rx_queue[rx_queue_head]);
+  uint8_t result = FALSE;
+  if ( qf->length <= mfps ) {
+    memcpy (buf, qf->payload, qf->length);
+    *rfps = qf->length;
+    result = TRUE;
+  }
+  // Otherwise the frame exceeds the caller-supplied max size, and is dropped
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    rx_queue_head = (rx_queue_head + 1) % WX_RX_QUEUE_FRAMES;
+    rx_queue_count--;
+  }
+
+  return result;
+}
+
+#else
+
 uint8_t
 wx_get_frame (uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout)
 {
-  uint8_t fs = FRAME_STATE_OUTSIDE_FRAME;   // Frame State
-  uint16_t crc = CRC_INITIAL_VALUE;         // Cyclic Redundany Check value
+  deframer_t df;      // DeFramer
   uint16_t et = 0;    // Elapsed Time
-  uint8_t lxorfb = 42;   // Length XOR'ed Flag Byte (bogus initialization)
-  uint8_t epl = 42;   // Escaped Payload Length  (bogus "= 42" for compiler)
-  uint8_t epbr = 0;   // Escaped Payload Bytes Read (so far)
+
+  deframer_reset (&df, mfps, buf);
 
   *rfps = 0;   // We've received nothing so far
 
@@ -639,185 +1206,13 @@ wx_get_frame (uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout)
         return FALSE;   // UART says somethig bad happened
       }
 
-      uint8_t cb = WX_GET_BYTE ();   // Current Byte
-
-      if ( cb == FRAME_DELIMITER ) {
-        // A frame delimiter should only occur unescaped when we aren't
-        // already reading a frame.  If we see it elsewhere it means corrupt
-        // data.  Since this is an an error from every frame state except
-        // one, we check for it just once up front.  In theory the CRC
-        // check would catch this anyway since it should only occur due to
-        // data corruption.  But it could also be due to a malformed frame,
-        // so we check for it explicitly.
-        if ( fs != FRAME_STATE_OUTSIDE_FRAME ) {
-          return FALSE;
-        }
-      }
-      // The XON and XOFF bytes should never occur unescaped in a frame
-      else if ( fs != FRAME_STATE_OUTSIDE_FRAME && (cb == XON || cb == XOFF) ) {
+      uint8_t result = deframe_byte (&df, WX_GET_BYTE ());
+      *rfps = df.rfps;
+      if ( result == DEFRAME_RESULT_ERROR ) {
         return FALSE;
       }
-
-      switch ( fs ) {
-
-        case FRAME_STATE_OUTSIDE_FRAME:
-          if ( cb == FRAME_DELIMITER ) {
-            crc = _crc_ccitt_update (crc, cb);
-            fs = FRAME_STATE_AT_LENGTH_XORED_FLAG;
-          }
-          break;
-
-        case FRAME_STATE_AT_LENGTH_XORED_FLAG:
-          crc = _crc_ccitt_update (crc, cb);
-          lxorfb = cb;
-          if ( lxorfb != WX_LENGTH_BYTE_XORED &&
-               lxorfb != WX_LENGTH_BYTE_NOT_XORED ) {
-            return FALSE;   // This flag must be one of two possible values
-          }
-          fs = FRAME_STATE_AT_LENGTH_ITSELF;
-          break;
-
-        case FRAME_STATE_AT_LENGTH_ITSELF:
-          crc = _crc_ccitt_update (crc, cb);
-          epl = cb;
-          if ( lxorfb == WX_LENGTH_BYTE_XORED ) {
-            epl ^= ESCAPE_MODIFIER;
-          }
-          fs = FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE;
-          break;
-
-        case FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE:
-          if ( cb == ESCAPE ) {
-            fs = FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE_ESCAPED;
-          }
-          else {
-            if ( cb != HIGH_BYTE (crc) ) {
-              return FALSE;   // CRC of frame delimiter and length failed
-            }
-            fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE;
-          }
-          break;
-
-        case FRAME_STATE_AT_LENGTH_CRC_HIGH_BYTE_ESCAPED:
-          if ( (cb ^ ESCAPE_MODIFIER) != HIGH_BYTE (crc) ) {
-            return FALSE;
-          }
-          fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE;
-          break;
-
-        case FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE:
-          if ( cb == ESCAPE ) {
-            fs = FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE_ESCAPED;
-          }
-          else {
-            if ( cb != LOW_BYTE (crc) ) {
-              return FALSE;   // CRC of frame delimiter and length failed
-            }
-            crc = CRC_INITIAL_VALUE;  // Reset for later use on payload
-            if ( epl > 0 ) {
-              fs = FRAME_STATE_IN_PAYLOAD;
-            }
-            else {
-              fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
-            }
-          }
-          break;
-
-        case FRAME_STATE_AT_LENGTH_CRC_LOW_BYTE_ESCAPED:
-          if ( (cb ^ ESCAPE_MODIFIER) != LOW_BYTE (crc) ) {
-            return FALSE;
-          }
-          crc = CRC_INITIAL_VALUE;  // Reset for later use on payload
-          if ( epl > 0 ) {
-            fs = FRAME_STATE_IN_PAYLOAD;
-          }
-          else {
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
-          }
-          break;
-
-        case FRAME_STATE_IN_PAYLOAD:
-          crc = _crc_ccitt_update (crc, cb);
-          if ( cb == ESCAPE ) {
-            fs = FRAME_STATE_IN_PAYLOAD_ESCAPED;
-          }
-          else {
-            ((uint8_t *) buf)[*rfps] = cb;
-            (*rfps)++;
-          }
-          epbr++;
-          if ( epbr == epl ) {
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
-          }
-          else if ( *rfps == mfps ) {
-            return FALSE;   // Frame exceeded caller-supplied max size
-          }
-          break;
-
-        case FRAME_STATE_IN_PAYLOAD_ESCAPED:
-          crc = _crc_ccitt_update (crc, cb);
-          ((uint8_t *) buf)[*rfps] = cb ^ ESCAPE_MODIFIER;
-          (*rfps)++;
-          epbr++;
-          if ( epbr == epl ) {
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE;
-          }
-          // FIXXME: we could detect this error once we get as far as
-          // reading the length in the frame, but wasting a little time
-          // reading the frame bytes probably doesn't make much difference
-          // at least given our current very coarse error reporting scheme
-          else if ( *rfps == mfps ) {
-            return FALSE;   // Frame exceeded caller-supplied max size
-          }
-          else {
-            fs = FRAME_STATE_IN_PAYLOAD;
-          }
-          break;
-
-        case FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE:
-          if ( cb == ESCAPE ) {
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE_ESCAPED;
-          }
-          else {
-            if ( cb != HIGH_BYTE (crc) ) {
-              return FALSE;   // CRC failed
-            }
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE;
-          }
-          break;
-
-        case FRAME_STATE_AT_PAYLOAD_CRC_HIGH_BYTE_ESCAPED:
-          if ( (cb ^ ESCAPE_MODIFIER) != HIGH_BYTE (crc) ) {
-            return FALSE;
-          }
-          fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE;
-          break;
-
-        case FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE:
-          if ( cb == ESCAPE ) {
-            fs = FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE_ESCAPED;
-          }
-          else {
-            if ( cb != LOW_BYTE (crc) ) {
-              return FALSE;   // CRC failed
-            }
-            // Frame is complete and correct.  Note that we don't ever need
-            // to actually set fs to FRAME_STATE_COMPLETE.
-            return TRUE;
-          }
-          break;
-
-        case FRAME_STATE_AT_PAYLOAD_CRC_LOW_BYTE_ESCAPED:
-          if ( (cb ^ ESCAPE_MODIFIER) != LOW_BYTE (crc) ) {
-            return FALSE;
-          }
-          // Frame is complete and correct.  Note that we don't ever need
-          // to actually set fs to FRAME_STATE_COMPLETE.
-          return TRUE;
-
-        default:
-          assert (0);   // Shouldn't be here
-          break;
+      if ( result == DEFRAME_RESULT_COMPLETE ) {
+        return TRUE;   // Frame is complete and correct
       }
     }
 
@@ -842,6 +1237,8 @@ wx_get_frame (uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout)
   return FALSE;   // Timeout
 }
 
+#endif
+
 uint8_t
 wx_get_string_frame (uint8_t msl, char *str, uint16_t timeout)
 {
@@ -301,6 +301,50 @@ wx_ensure_channel_set_to (uint8_t channel);
 uint8_t
 wx_restore_defaults (void);
 
+// The XBee configuration parameters that wx_ensure_config() manages.  See
+// the XBee Product Manual for details about each parameter.
+typedef struct {
+  uint16_t network_id;            // ID parameter, 0x0000 - 0xffff
+  uint8_t channel;                // CH parameter, 0x0b - 0x1a
+  uint16_t source_address;        // MY parameter
+  uint16_t destination_address;   // DL parameter (DH isn't touched)
+  uint8_t power_level;            // PL parameter, 0 - 4
+} wx_config_t;
+
+// Location in EEPROM where wx_ensure_config() keeps a hash of the last
+// configuration it applied.  This takes four bytes.  The default location
+// stays clear of the one_wire_master_device_table.h table and the LASSERT()
+// message area from util.h.
+#ifndef WX_CONFIG_HASH_EEPROM_ADDRESS
+#  define WX_CONFIG_HASH_EEPROM_ADDRESS ((void *) 944)
+#endif
+
+// Ensure that the XBee is configured as described by *config.  Unlike the
+// wx_ensure_*_set_to() functions above, this function takes care of AT
+// command mode itself (so the XBee must NOT already be in command mode),
+// and it makes all the changes in a single command mode session: each
+// parameter is queried and only set if it differs, the settings are saved
+// to non-volatile memory only if something changed, and command mode is
+// left (which makes the changes take effect).  So one command mode session
+// costs a few seconds of guard times, instead of one per parameter.
+//
+// Better still, when everything succeeds a hash of *config is stored at
+// WX_CONFIG_HASH_EEPROM_ADDRESS.  If a later call (after a reboot, for
+// example) finds the hash of its *config already stored there, it assumes
+// the XBee is still configured that way, and returns TRUE immediately
+// without talking to the XBee at all.  If the XBee configuration might have
+// been changed by some other means (the XBee was swapped, reset to defaults
+// with wx_restore_defaults(), or reconfigured with usb_xbee), call
+// wx_forget_config() first.  Returns TRUE on success, or FALSE otherwise.
+// NOTE: this function may permanently alter the XBee configuration.
+uint8_t
+wx_ensure_config (wx_config_t const *config);
+
+// Erase the configuration hash stored by wx_ensure_config(), so that the
+// next call to wx_ensure_config() actually checks the XBee configuration.
+void
+wx_forget_config (void);
+
 // I don't think the Sparkfun WRL-10854 gives us any connection to the
 // SLEEP_RQ pin of the XBee module, so FIXXME: this is unimplemented.
 // However, hibernating is probably the first thing you'll want to do for
@@ -323,6 +367,10 @@ wx_restore_defaults (void);
 //   * The XBee Product manual version v1.xEx (a copy is in this module's
 //     directory) has a description of the sleep mode options on page 23.
 //
+//   * The wireless_xbee_duty_cycle.h interface uses WX_SLEEP() and
+//     WX_WAKE() along with microcontroller sleep to run a node that's
+//     asleep most of the time.
+//
 //void
 //wx_hibernate (void);
 
@@ -330,7 +378,9 @@ wx_restore_defaults (void);
 // configuration, you can just send them to the serial port.  See the
 // corresponding UART_*() in uart.h for details.  If you want your
 // transmissions to arrive atomically (not interleaved with other
-// transmissions) see the wx_put_*_frame() routines.
+// transmissions) see the wx_put_*_frame() routines.  Note that if
+// WX_RX_INTERRUPT_DRIVEN is defined (see below) the receive ISR consumes
+// all incoming bytes, so the receive-side macros here aren't useful.
 #define WX_PUT_BYTE(byte)               UART_PUT_BYTE (byte)
 #define WX_BYTE_AVAILABLE()             UART_BYTE_AVAILABLE()
 #define WX_WAIT_FOR_BYTE()              UART_WAIT_FOR_BYTE()
@@ -435,16 +485,34 @@ wx_restore_defaults (void);
 //     resulting in a sequence of up to four bytes.
 //
 // The data is first scanned to determine its length after escape bytes
-// are added.  If the escaped data sequence is too long to go in a single
-// radio packet, nothing is transmitted and false is returned (unless
-// WX_ASSERT_SUCCESS is defined, in which case an assertion violation
+// are added.  If the escaped data sequence might be too long to go in
+// a single radio packet, nothing is transmitted and false is returned
+// (unless WX_ASSERT_SUCCESS is defined, in which case an assertion violation
 // is triggered).  Otherwise the packet is transmitted and true is returned.
+// The payload CRC is computed as the payload is transmitted, so for the
+// purposes of this check both its bytes are assumed to need escaping
+// (the WX_FRAME_SAFE_* lengths already allow for this).
 //
 // These frames are not in any way compatible with the XBee API mode frames.
+// For a driver that actually runs the XBee in API mode (with per-packet
+// delivery status and AT commands that don't need guard times) see
+// wireless_xbee_api.h.
 //
 uint8_t
 wx_put_frame (uint8_t count, void const *buf);
 
+// Like wx_put_frame(), but the payload is the header_count bytes at header
+// followed by the body_count bytes at body.  This lets clients put their
+// own header in front of data that lives elsewhere without first copying
+// both into a single buffer.  Either count may be zero (in which case the
+// corresponding pointer may be NULL).
+uint8_t
+wx_put_split_frame (
+    uint8_t header_count,
+    void const *header,
+    uint8_t body_count,
+    void const *body );
+
 // Convenience wrappar around wx_put_frame().  If NUL-terminated string str
 // is longer than UINT8_MAX - 1 (which is too long to go in one of our frames
 // anyway) an assertion violation will be triggered.  The str argument must
@@ -565,6 +633,73 @@ wx_get_frame (uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout);
 uint8_t
 wx_get_string_frame (uint8_t msl, char *str, uint16_t timeout);
 
+// Interrupt-Driven Frame Reception
+//
+// Since wx_get_frame() only reads the UART while it's running, any frame
+// that arrives while the client is busy doing something else is lost
+// (usually to a UART data overrun).  If WX_RX_INTERRUPT_DRIVEN is defined
+// (see the Makefile for this module), wx_init() instead enables the USART
+// receive complete interrupt, and an ISR runs the frame state machine one
+// byte at a time as the bytes arrive.  Frames that pass both CRC checks
+// are put in a queue with room for WX_RX_QUEUE_FRAMES frames, and
+// wx_get_frame() (and so wx_get_string_frame()) then just takes the
+// oldest frame from the queue (waiting up to timeout milliseconds for
+// one if the queue is empty).  This changes the behavior of wx_get_frame()
+// described above in a few ways:
+//
+//   * Frames received before the call are returned (not just those that
+//     start during the call), and a timeout of 0 can be used to check the
+//     queue without waiting at all.
+//
+//   * Corrupt or malformed frames are silently discarded (and counted in
+//     wx_rx_bad_frame_count) so wx_get_frame() only fails on timeout, or
+//     when the frame at the head of the queue has more than mfps bytes of
+//     payload (in which case the frame is discarded).
+//
+//   * The UART error flags are handled by the ISR, so clients don't need
+//     to (and shouldn't) use WX_UART_FLUSH_RX_BUFFER() after a failure.
+//
+// Frames that arrive while the queue is full are discarded and counted in
+// wx_rx_dropped_frame_count.  Each queue slot takes a bit more than
+// WX_RX_QUEUE_MAX_PAYLOAD bytes of RAM.  The interrupt is disabled by
+// wx_enter_at_command_mode() and re-enabled by wx_exit_at_command_mode()
+// (whether or not it succeeds, and also by wx_enter_at_command_mode()
+// itself if it fails).  Interrupts are enabled globally (with sei())
+// by wx_init() in this mode.
+
+#ifdef WX_RX_INTERRUPT_DRIVEN
+
+#  ifndef WX_RX_QUEUE_FRAMES
+#    define WX_RX_QUEUE_FRAMES 2
+#  endif
+
+// Maximum payload size of queued frames.  This is the largest payload that
+// wx_put_frame() will ever send: one with no bytes needing escaping, and
+// no escapes needed for the length CRC bytes (the payload CRC bytes always
+// have room reserved for their escapes, since wx_put_frame() can't know
+// them in advance).
+#  define WX_RX_QUEUE_MAX_PAYLOAD              \
+     (   WX_TRANSPARENT_MODE_MAX_PACKET_SIZE    \
+       - WX_FRAME_DELIMITER_LENGTH              \
+       - WX_FRAME_LENGTH_FIELD_LENGTH           \
+       - 4                                      \
+       - 2 )
+
+// Number of frames discarded because the queue was full, and number of
+// corrupt or malformed frames discarded, since wx_init() was called.
+// These wrap around at UINT16_MAX.  Reads of them should be done from an
+// ATOMIC_BLOCK.
+extern volatile uint16_t wx_rx_dropped_frame_count;
+extern volatile uint16_t wx_rx_bad_frame_count;
+
+// Return TRUE iff a received frame is waiting in the queue.  This is the
+// interrupt-driven equivalent of using WX_BYTE_AVAILABLE() to decide when
+// it's worth calling wx_get_frame().
+uint8_t
+wx_frame_available (void);
+
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -168,6 +168,36 @@ main (void)
   sentinel = wx_exit_at_command_mode ();
   assert (sentinel);
 
+  // Test wx_ensure_config().  The first call has to actually check the
+  // configuration (and change it), the second should return immediately
+  // on the strength of the hash stored in EEPROM by the first.  Finally we
+  // put the default settings back.
+  wx_forget_config ();
+  wx_config_t config = {
+    .network_id = NON_DEFAULT_NETWORK_ID,
+    .channel = NON_DEFAULT_CHANNEL,
+    .source_address = 0x0000,
+    .destination_address = 0x0000,
+    .power_level = 4 };
+  sentinel = wx_ensure_config (&config);
+  assert (sentinel);
+  sentinel = wx_ensure_config (&config);
+  assert (sentinel);
+  sentinel = wx_enter_at_command_mode ();
+  assert (sentinel);
+  sentinel = wx_at_command ("ID", co);
+  assert (sentinel);
+  assert (! strcmp (co, NON_DEFAULT_NETWORK_ID_STRING));
+  sentinel = wx_at_command ("CH", co);
+  assert (sentinel);
+  assert (! strcmp (co, NON_DEFAULT_CHANNEL_STRING));
+  sentinel = wx_exit_at_command_mode ();
+  assert (sentinel);
+  config.network_id = DEFAULT_NETWORK_ID;
+  config.channel = DEFAULT_CHANNEL;
+  sentinel = wx_ensure_config (&config);
+  assert (sentinel);
+
   // This first batch of blinks mean all the AT command stuff worked :)
   CHKP_PD4 ();
 
@@ -214,10 +244,12 @@ main (void)
 
     sentinel = wx_get_string_frame (MPLFU + 1, rstr, tpra_ms);
     if ( ! sentinel ) {
+#  ifndef WX_RX_INTERRUPT_DRIVEN
       // In kindness to other callers, we clean up after any UART Rx error.
       if ( WX_UART_RX_ERROR () ) {
         WX_UART_FLUSH_RX_BUFFER ();
       }
+#  endif
       // Timeouts, bad frames, all sorts of errors end up getting eaten
       // here FIXXME: the frame functions should probably do some sort of
       // error propagation.
@@ -261,10 +293,12 @@ main (void)
 
     sentinel = wx_get_frame (MPLFU, &rfps, rpyld, tpra_ms);
     if ( ! sentinel ) {
+#  ifndef WX_RX_INTERRUPT_DRIVEN
       // In kindness to other callers, we clean up after any UART Rx error.
       if ( WX_UART_RX_ERROR () ) {
         WX_UART_FLUSH_RX_BUFFER ();
       }
+#  endif
       // Timeouts, bad frames, all sorts of errors end up getting eaten
       // here FIXXME: the frame functions should probably do some sort of
       // error propagation.
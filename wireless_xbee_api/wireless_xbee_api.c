@@ -0,0 +1,668 @@
+// Implementation of the interface described in wireless_xbee_api.h.
+
+#include <assert.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+#include "uart.h"
+#include "util.h"
+#include "wireless_xbee_api.h"
+
+// Bytes that need to be escaped in API mode 2 (everywhere except for the
+// frame delimiter at the start of a frame)
+#define FRAME_DELIMITER 0x7E
+#define ESCAPE          0x7D
+#define XON             0x11
+#define XOFF            0x13
+
+// Escaped bytes are transmitted as an ESCAPE byte followed by the byte
+// value xor'ed with this value.
+#define ESCAPE_MODIFIER 0x20
+
+// API identifiers (the first byte of the frame data) that we use
+#define API_ID_TX_REQUEST_64       0x00
+#define API_ID_TX_REQUEST_16       0x01
+#define API_ID_AT_COMMAND          0x08
+#define API_ID_RX_PACKET_64        0x80
+#define API_ID_RX_PACKET_16        0x81
+#define API_ID_AT_COMMAND_RESPONSE 0x88
+#define API_ID_TX_STATUS           0x89
+#define API_ID_MODEM_STATUS        0x8A
+
+// Layouts of the frames we receive (offsets into the frame data)
+#define RX_PACKET_64_HEADER_LENGTH      11
+#define RX_PACKET_16_HEADER_LENGTH      5
+#define AT_COMMAND_RESPONSE_STATUS_INDEX 4
+#define AT_COMMAND_RESPONSE_VALUE_INDEX  5
+#define TX_STATUS_STATUS_INDEX           2
+#define MODEM_STATUS_STATUS_INDEX        1
+
+// Largest frames we'll receive (in frame data bytes)
+#define MAX_RX_PACKET_FRAME_DATA_LENGTH \
+  (RX_PACKET_64_HEADER_LENGTH + WXA_MAX_PAYLOAD_LENGTH)
+#define MAX_RESPONSE_FRAME_DATA_LENGTH \
+  (AT_COMMAND_RESPONSE_VALUE_INDEX + WXA_MAX_AT_RESPONSE_VALUE_LENGTH)
+
+// Header lengths of the frames we send
+#define AT_COMMAND_HEADER_LENGTH   4
+#define TX_REQUEST_16_HEADER_LENGTH 5
+#define TX_REQUEST_64_HEADER_LENGTH 11
+
+volatile uint16_t wxa_rx_dropped_packet_count = 0;
+volatile uint16_t wxa_rx_bad_frame_count = 0;
+volatile uint8_t wxa_modem_status = 0xFF;
+
+// Received RX packet frames waiting for wxa_receive().  This works like the
+// frame queue in wireless_xbee.c: the ISR only writes into the slot just
+// past the last queued frame (which it picks once per frame, see rx_slot),
+// and only increments rx_queue_count.  The foreground advances
+// rx_queue_head and decrements rx_queue_count together in one
+// ATOMIC_BLOCK.
+typedef struct {
+  uint8_t length;
+  uint8_t data[MAX_RX_PACKET_FRAME_DATA_LENGTH];
+} queued_frame_t;
+static queued_frame_t rx_queue[WXA_RX_QUEUE_PACKETS];
+static volatile uint8_t rx_queue_head = 0;
+static volatile uint8_t rx_queue_count = 0;
+
+// The most recent AT Command Response or TX Status frame.  Requests are
+// made one at a time, so one slot is enough.  The ISR clears response_ready
+// as soon as a new response starts arriving, so the foreground only has
+// to copy the response out atomically to get a consistent one.
+static uint8_t response[MAX_RESPONSE_FRAME_DATA_LENGTH];
+static volatile uint8_t response_length;
+static volatile uint8_t response_ready = FALSE;
+
+// Buffer for Modem Status frames
+static uint8_t modem_status_frame[MODEM_STATUS_STATUS_INDEX + 1];
+
+// States of the receive ISR
+#define RECEIVE_STATE_WAITING     1   // For a frame delimiter
+#define RECEIVE_STATE_LENGTH_HIGH 2
+#define RECEIVE_STATE_LENGTH_LOW  3
+#define RECEIVE_STATE_FRAME_DATA  4
+#define RECEIVE_STATE_CHECKSUM    5
+
+// Possible destinations for incoming frame data
+#define DESTINATION_NONE         1
+#define DESTINATION_RX_QUEUE     2
+#define DESTINATION_RESPONSE     3
+#define DESTINATION_MODEM_STATUS 4
+
+static uint8_t rs = RECEIVE_STATE_WAITING;   // Receive State
+static uint8_t escaped;     // TRUE iff the previous byte was ESCAPE
+static uint16_t fdl;        // Frame Data Length
+static uint8_t fdbr;        // Frame Data Bytes Received (so far)
+static uint8_t checksum;    // Running sum of the frame data bytes
+static uint8_t destination;
+static uint8_t *dp;         // Destination Pointer
+static uint8_t ds;          // Destination Size
+static uint8_t rx_slot;     // Queue slot, for DESTINATION_RX_QUEUE
+
+static void
+choose_destination (uint8_t api_id)
+{
+  // Decide where the frame data of a frame with API identifier api_id
+  // should go.
+
+  destination = DESTINATION_NONE;
+  ds = 0;
+
+  switch ( api_id ) {
+    case API_ID_RX_PACKET_64:
+    case API_ID_RX_PACKET_16:
+      if ( rx_queue_count == WXA_RX_QUEUE_PACKETS ) {
+        wxa_rx_dropped_packet_count++;
+        break;
+      }
+      destination = DESTINATION_RX_QUEUE;
+      rx_slot = (rx_queue_head + rx_queue_count) % WXA_RX_QUEUE_PACKETS;
+      dp = rx_queue[rx_slot].data;
+      ds = MAX_RX_PACKET_FRAME_DATA_LENGTH;
+      break;
+    case API_ID_AT_COMMAND_RESPONSE:
+    case API_ID_TX_STATUS:
+      response_ready = FALSE;
+      destination = DESTINATION_RESPONSE;
+      dp = response;
+      ds = MAX_RESPONSE_FRAME_DATA_LENGTH;
+      break;
+    case API_ID_MODEM_STATUS:
+      destination = DESTINATION_MODEM_STATUS;
+      dp = modem_status_frame;
+      ds = sizeof (modem_status_frame);
+      break;
+    default:
+      // Some frame type we don't handle, ignore it
+      break;
+  }
+}
+
+static void
+file_frame (void)
+{
+  // Make a correctly received frame available to the foreground.
+
+  switch ( destination ) {
+    case DESTINATION_RX_QUEUE:
+      rx_queue[rx_slot].length = fdl;
+      rx_queue_count++;
+      break;
+    case DESTINATION_RESPONSE:
+      // Overlong AT command values have been truncated
+      response_length = (fdl < ds ? fdl : ds);
+      response_ready = TRUE;
+      break;
+    case DESTINATION_MODEM_STATUS:
+      wxa_modem_status = modem_status_frame[MODEM_STATUS_STATUS_INDEX];
+      break;
+    default:
+      break;
+  }
+}
+
+ISR (USART_RX_vect)
+{
+  // The error flags must be read before the data register
+  uint8_t rx_error = UART_RX_ERROR ();
+  uint8_t cb = UART_GET_BYTE ();   // Current Byte
+
+  if ( UNLIKELY (rx_error) ) {
+    if ( rs != RECEIVE_STATE_WAITING ) {
+      wxa_rx_bad_frame_count++;
+      rs = RECEIVE_STATE_WAITING;
+    }
+    return;
+  }
+
+  // Since the frame delimiter is always escaped inside frames, one always
+  // means a new frame is starting, even if the last one wasn't finished.
+  if ( cb == FRAME_DELIMITER ) {
+    if ( rs != RECEIVE_STATE_WAITING ) {
+      wxa_rx_bad_frame_count++;
+    }
+    rs = RECEIVE_STATE_LENGTH_HIGH;
+    escaped = FALSE;
+    return;
+  }
+
+  if ( rs == RECEIVE_STATE_WAITING ) {
+    return;
+  }
+
+  if ( cb == ESCAPE ) {
+    escaped = TRUE;
+    return;
+  }
+  if ( escaped ) {
+    cb ^= ESCAPE_MODIFIER;
+    escaped = FALSE;
+  }
+
+  switch ( rs ) {
+
+    case RECEIVE_STATE_LENGTH_HIGH:
+      fdl = ((uint16_t) cb) << BITS_PER_BYTE;
+      rs = RECEIVE_STATE_LENGTH_LOW;
+      break;
+
+    case RECEIVE_STATE_LENGTH_LOW:
+      fdl |= cb;
+      if ( fdl == 0 || fdl > MAX_RX_PACKET_FRAME_DATA_LENGTH ) {
+        wxa_rx_bad_frame_count++;
+        rs = RECEIVE_STATE_WAITING;
+        break;
+      }
+      fdbr = 0;
+      checksum = 0;
+      rs = RECEIVE_STATE_FRAME_DATA;
+      break;
+
+    case RECEIVE_STATE_FRAME_DATA:
+      if ( fdbr == 0 ) {
+        choose_destination (cb);
+      }
+      if ( fdbr < ds ) {
+        dp[fdbr] = cb;
+      }
+      checksum += cb;
+      fdbr++;
+      if ( fdbr == fdl ) {
+        rs = RECEIVE_STATE_CHECKSUM;
+      }
+      break;
+
+    case RECEIVE_STATE_CHECKSUM:
+      rs = RECEIVE_STATE_WAITING;
+      if ( (uint8_t) (checksum + cb) != 0xFF ) {
+        wxa_rx_bad_frame_count++;
+        break;
+      }
+      file_frame ();
+      break;
+
+    default:
+      assert (0);   // Shouldn't be here
+      break;
+  }
+}
+
+void
+wxa_init (void)
+{
+  uart_init ();
+
+  rs = RECEIVE_STATE_WAITING;
+  UCSR0B |= _BV (RXCIE0);
+
+  sei ();
+}
+
+static uint8_t
+needs_escaped (uint8_t byte)
+{
+  return byte == FRAME_DELIMITER || byte == ESCAPE ||
+         byte == XON || byte == XOFF;
+}
+
+static void
+put_possibly_escaped_byte (uint8_t byte)
+{
+  if ( UNLIKELY (needs_escaped (byte)) ) {
+    UART_PUT_BYTE (ESCAPE);
+    byte ^= ESCAPE_MODIFIER;
+  }
+  UART_PUT_BYTE (byte);
+}
+
+static uint8_t
+put_bytes (uint8_t checksum, uint8_t count, uint8_t const *data)
+{
+  // Put count bytes from data out (escaped), and return checksum with
+  // them added in.
+
+  for ( uint8_t ii = 0 ; ii < count ; ii++ ) {
+    put_possibly_escaped_byte (data[ii]);
+    checksum += data[ii];
+  }
+
+  return checksum;
+}
+
+static void
+put_frame (
+    uint8_t header_count,
+    uint8_t const *header,
+    uint8_t data_count,
+    void const *data )
+{
+  // Send an API frame with frame data consisting of header_count bytes
+  // from header followed by data_count bytes from data.
+
+  uint16_t length = header_count + data_count;
+
+  UART_PUT_BYTE (FRAME_DELIMITER);
+  put_possibly_escaped_byte (HIGH_BYTE (length));
+  put_possibly_escaped_byte (LOW_BYTE (length));
+  uint8_t sum = put_bytes (0, header_count, header);
+  sum = put_bytes (sum, data_count, data);
+  put_possibly_escaped_byte (0xFF - sum);
+}
+
+static uint8_t
+next_frame_id (void)
+{
+  // Return the frame ID to use for the next request.  Zero would mean
+  // that we don't want a response, so it's skipped.
+
+  static uint8_t frame_id = 0;
+
+  frame_id++;
+  if ( frame_id == 0 ) {
+    frame_id++;
+  }
+
+  return frame_id;
+}
+
+static uint8_t
+wait_for_response (
+    uint8_t api_id,
+    uint8_t frame_id,
+    uint8_t *buf,
+    uint8_t *length,
+    uint16_t timeout )
+{
+  // Spend up to about timeout milliseconds waiting for a response frame
+  // with the given API identifier and frame ID.  If it arrives, copy its
+  // frame data into buf (which must have room for
+  // MAX_RESPONSE_FRAME_DATA_LENGTH bytes), set *length to the frame data
+  // length, and return TRUE.  Otherwise return FALSE.  Any other responses
+  // (presumably late responses to earlier requests) are discarded.
+
+  uint16_t et = 0;   // Elapsed Time
+
+  for ( ; ; ) {
+    if ( response_ready ) {
+      uint8_t match = FALSE;
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        if ( response_ready ) {
+          if ( response[0] == api_id && response[1] == frame_id ) {
+            memcpy (buf, response, response_length);
+            *length = response_length;
+            match = TRUE;
+          }
+          response_ready = FALSE;
+        }
+      }
+      if ( match ) {
+        return TRUE;
+      }
+    }
+
+    if ( et >= timeout ) {
+      return FALSE;
+    }
+
+    // The XBee answers AT commands within a few milliseconds, but TX status
+    // can take much longer if retries are required, so this granularity
+    // is fine.
+    uint16_t const poll_interval_ms = 1;
+    double const poll_interval_ms_double = 1.0;
+    _delay_ms (poll_interval_ms_double);
+    et += poll_interval_ms;
+  }
+}
+
+uint8_t
+wxa_at_command (
+    char const *command,
+    uint8_t param_count,
+    void const *param,
+    uint8_t *value_length,
+    void *value,
+    uint16_t timeout )
+{
+  assert (strlen (command) == 2);
+
+  uint8_t frame_id = next_frame_id ();
+
+  uint8_t header[AT_COMMAND_HEADER_LENGTH]
+    = { API_ID_AT_COMMAND, frame_id, command[0], command[1] };
+  put_frame (AT_COMMAND_HEADER_LENGTH, header, param_count, param);
+
+  uint8_t rfd[MAX_RESPONSE_FRAME_DATA_LENGTH];   // Response Frame Data
+  uint8_t rfdl;                                  // Response Frame Data Length
+  if ( ! wait_for_response (
+             API_ID_AT_COMMAND_RESPONSE, frame_id, rfd, &rfdl, timeout ) ) {
+    return WXA_AT_STATUS_TIMEOUT;
+  }
+  if ( rfdl < AT_COMMAND_RESPONSE_VALUE_INDEX ) {
+    return WXA_AT_STATUS_TIMEOUT;   // Malformed, so we never really got one
+  }
+
+  uint8_t vl = rfdl - AT_COMMAND_RESPONSE_VALUE_INDEX;   // Value Length
+  if ( value != NULL ) {
+    memcpy (value, rfd + AT_COMMAND_RESPONSE_VALUE_INDEX, vl);
+  }
+  if ( value_length != NULL ) {
+    *value_length = vl;
+  }
+
+  return rfd[AT_COMMAND_RESPONSE_STATUS_INDEX];
+}
+
+uint8_t
+wxa_get_parameter (char const *command, uint16_t *value)
+{
+  uint8_t vb[WXA_MAX_AT_RESPONSE_VALUE_LENGTH];   // Value Buffer
+  uint8_t vl;                                     // Value Length
+
+  uint8_t status
+    = wxa_at_command (command, 0, NULL, &vl, vb, WXA_RESPONSE_TIMEOUT_MS);
+  if ( status != WXA_AT_STATUS_OK || vl < 1 || vl > sizeof (uint16_t) ) {
+    return FALSE;
+  }
+
+  *value = vb[0];
+  if ( vl == sizeof (uint16_t) ) {
+    *value = (*value << BITS_PER_BYTE) | vb[1];
+  }
+
+  return TRUE;
+}
+
+uint8_t
+wxa_set_parameter (char const *command, uint16_t value)
+{
+  // Big-endian, and only as many bytes as are needed, since some
+  // parameters are only one byte wide
+  uint8_t param[sizeof (uint16_t)] = { HIGH_BYTE (value), LOW_BYTE (value) };
+  uint8_t pc = (value > UINT8_MAX ? 2 : 1);   // Param Count
+
+  uint8_t status
+    = wxa_at_command (
+        command,
+        pc,
+        param + sizeof (param) - pc,
+        NULL,
+        NULL,
+        WXA_RESPONSE_TIMEOUT_MS );
+
+  return status == WXA_AT_STATUS_OK;
+}
+
+static uint8_t
+send_tx_request (
+    uint8_t header_count,
+    uint8_t *header,
+    uint8_t count,
+    void const *data,
+    uint16_t timeout )
+{
+  // Send a TX request with the given header (which must have room for the
+  // frame ID at index 1) and data, and wait for the TX status.
+
+  assert (count <= WXA_MAX_PAYLOAD_LENGTH);
+
+  uint8_t frame_id = next_frame_id ();
+  header[1] = frame_id;
+
+  put_frame (header_count, header, count, data);
+
+  uint8_t rfd[MAX_RESPONSE_FRAME_DATA_LENGTH];   // Response Frame Data
+  uint8_t rfdl;                                  // Response Frame Data Length
+  if ( ! wait_for_response (
+             API_ID_TX_STATUS, frame_id, rfd, &rfdl, timeout ) ||
+       rfdl <= TX_STATUS_STATUS_INDEX ) {
+    return WXA_TX_STATUS_TIMEOUT;
+  }
+
+  return rfd[TX_STATUS_STATUS_INDEX];
+}
+
+uint8_t
+wxa_send16 (
+    uint16_t destination,
+    uint8_t options,
+    uint8_t count,
+    void const *data,
+    uint16_t timeout )
+{
+  uint8_t header[TX_REQUEST_16_HEADER_LENGTH]
+    = { API_ID_TX_REQUEST_16,
+        0,   // Frame ID, filled in by send_tx_request()
+        HIGH_BYTE (destination),
+        LOW_BYTE (destination),
+        options };
+
+  return send_tx_request (
+      TX_REQUEST_16_HEADER_LENGTH, header, count, data, timeout );
+}
+
+uint8_t
+wxa_send64 (
+    uint64_t destination,
+    uint8_t options,
+    uint8_t count,
+    void const *data,
+    uint16_t timeout )
+{
+  uint8_t header[TX_REQUEST_64_HEADER_LENGTH];
+
+  header[0] = API_ID_TX_REQUEST_64;
+  // header[1] is the frame ID, filled in by send_tx_request()
+  for ( uint8_t ii = 0 ; ii < sizeof (uint64_t) ; ii++ ) {
+    header[2 + ii]
+      = destination >> (BITS_PER_BYTE * (sizeof (uint64_t) - 1 - ii));
+  }
+  header[TX_REQUEST_64_HEADER_LENGTH - 1] = options;
+
+  return send_tx_request (
+      TX_REQUEST_64_HEADER_LENGTH, header, count, data, timeout );
+}
+
+uint8_t
+wxa_receive (wxa_rx_packet_t *packet, uint16_t timeout)
+{
+  uint16_t et = 0;   // Elapsed Time
+
+  while ( rx_queue_count == 0 ) {
+    if ( et >= timeout ) {
+      return FALSE;
+    }
+    uint16_t const poll_interval_ms = 1;
+    double const poll_interval_ms_double = 1.0;
+    _delay_ms (poll_interval_ms_double);
+    et += poll_interval_ms;
+  }
+
+  queued_frame_t const *qf = &(rx_queue[rx_queue_head]);
+  uint8_t const *fd = qf->data;   // Frame Data
+  uint8_t hl;                     // Header Length
+
+  if ( fd[0] == API_ID_RX_PACKET_64 ) {
+    hl = RX_PACKET_64_HEADER_LENGTH;
+    packet->source16 = WXA_SOURCE16_UNKNOWN;
+    packet->source64 = 0;
+    for ( uint8_t ii = 0 ; ii < sizeof (uint64_t) ; ii++ ) {
+      packet->source64 = (packet->source64 << BITS_PER_BYTE) | fd[1 + ii];
+    }
+  }
+  else {
+    hl = RX_PACKET_16_HEADER_LENGTH;
+    packet->source16 = (((uint16_t) fd[1]) << BITS_PER_BYTE) | fd[2];
+    packet->source64 = 0;
+  }
+  packet->rssi = fd[hl - 2];
+  packet->options = fd[hl - 1];
+  // Frames too short to even have a header give empty packets
+  packet->length = (qf->length > hl ? qf->length - hl : 0);
+  memcpy (packet->data, fd + hl, packet->length);
+
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    rx_queue_head = (rx_queue_head + 1) % WXA_RX_QUEUE_PACKETS;
+    rx_queue_count--;
+  }
+
+  return TRUE;
+}
+
+static uint8_t
+transparent_mode_command (char const *command)
+{
+  // With the XBee in AT command mode (and the receive interrupt disabled),
+  // send the AT command (with "AT" prefix and "\r" postfix added) and
+  // return TRUE iff the response is "OK\r".
+
+  UART_PUT_BYTE ('A');
+  UART_PUT_BYTE ('T');
+  for ( uint8_t ii = 0 ; command[ii] != '\0' ; ii++ ) {
+    UART_PUT_BYTE (command[ii]);
+  }
+  UART_PUT_BYTE ('\r');
+
+  char const expected[] = "OK\r";
+  uint16_t const timeout_ms = 200;
+  uint16_t et = 0;   // Elapsed Time
+
+  for ( uint8_t ii = 0 ; ii < strlen (expected) ; ii++ ) {
+    while ( ! UART_BYTE_AVAILABLE () ) {
+      if ( et >= timeout_ms ) {
+        return FALSE;
+      }
+      uint16_t const poll_interval_ms = 1;
+      double const poll_interval_ms_double = 1.0;
+      _delay_ms (poll_interval_ms_double);
+      et += poll_interval_ms;
+    }
+    if ( UART_RX_ERROR () ) {
+      UART_FLUSH_RX_BUFFER ();
+      return FALSE;
+    }
+    if ( UART_GET_BYTE () != expected[ii] ) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+uint8_t
+wxa_ensure_api_mode (void)
+{
+  uint16_t ap;
+
+  if ( wxa_get_parameter ("AP", &ap) && ap == 2 ) {
+    return TRUE;
+  }
+
+  // The XBee didn't understand us, so presumably it's in transparent
+  // mode.  The responses to the AT command mode commands are read by
+  // polling, so the receive ISR has to get out of the way.
+  UCSR0B &= ~(_BV (RXCIE0));
+
+  // This is the same AT command mode entry ritual as in wireless_xbee.c
+  // (see the comments there).
+  double const dwmms = 1042;   // Delay With Margin (in ms) -- AT requires 1 s
+  _delay_ms (dwmms);
+  UART_PUT_BYTE ('+');
+  UART_PUT_BYTE ('+');
+  UART_PUT_BYTE ('+');
+  _delay_ms (dwmms);
+
+  // The "OK\r" response to "+++" (and any stray API frame bytes) must be
+  // flushed now, or each transparent_mode_command() would end up reading
+  // the response to the command before it.
+  double const flushing_time_ms = 300.42;   // Total time to spend flushing
+  double const ms_per_flush     = 4.2;      // Plenty Time for 2 byte buf fill
+  double       et_ms            = 0.0;      // Elapsed Time in milliseconds
+  while ( et_ms < flushing_time_ms ) {
+    UART_FLUSH_RX_BUFFER ();
+    _delay_ms (ms_per_flush);
+    et_ms += ms_per_flush;
+  }
+  double const magic_guard_time = 4.2;
+  _delay_ms (magic_guard_time);
+
+  uint8_t result
+    = transparent_mode_command ("")      &&
+      transparent_mode_command ("AP2")   &&
+      transparent_mode_command ("WR")    &&
+      transparent_mode_command ("CN");
+
+  rs = RECEIVE_STATE_WAITING;
+  UCSR0B |= _BV (RXCIE0);
+
+  if ( ! result ) {
+    return FALSE;
+  }
+
+  // Make sure it actually worked
+  return wxa_get_parameter ("AP", &ap) && ap == 2;
+}
@@ -0,0 +1,200 @@
+// MaxStream XBee Series 1 Interface Using API Mode (Binary Frames)
+//
+// Test driver: wireless_xbee_api_test.c    Implementation: wireless_xbee_api.c
+//
+// The wireless_xbee.h interface runs the XBee in transparent mode, where
+// data sent to the serial port simply goes out over the air, and changing
+// a configuration parameter means using AT command mode.  Getting into AT
+// command mode requires guard times of silence on the serial line before
+// and after the "+++" sequence, so every configuration change takes a few
+// seconds.  It's also hard to tell whether a transmission was actually
+// received.
+//
+// This interface instead runs the XBee in API mode.  Everything going
+// to or from the XBee is then wrapped in a binary frame (see the "API
+// Operation" section of the XBee Product Manual, a copy of which is in the
+// wireless_xbee module directory):
+//
+//   * Configuration is done by sending AT Command frames, each of which
+//     gets an AT Command Response frame back within a few milliseconds, so
+//     parameters can be read or changed at any time without guard delays.
+//
+//   * Data is sent with TX Request frames, each of which gets a TX Status
+//     frame back telling whether the destination XBee acknowledged the
+//     packet (after the XBee's own retries).
+//
+//   * Data received over the air arrives in RX Packet frames, which
+//     include the source address and signal strength.
+//
+// Incoming frames are received in the background by the USART receive
+// complete interrupt handler, which checks them and then files them: RX
+// packets go into a queue with room for WXA_RX_QUEUE_PACKETS packets
+// (which wxa_receive() takes them from), and responses go to whichever of
+// wxa_at_command(), wxa_send16() or wxa_send64() is waiting for them.
+// Since responses carry the frame ID of the request they belong to, a late
+// response to an earlier request that timed out can't be mistaken for the
+// current one.
+//
+// The XBee must be configured to use API mode with escaped characters
+// (AP parameter set to 2).  Since the AP setting can be saved in the XBee's
+// non-volatile memory, this normally only needs to be done once, and
+// wxa_ensure_api_mode() will do it if required.  The escaping scheme
+// (which the wireless_xbee.h simple frames also imitate) ensures that the
+// frame delimiter never occurs inside a frame, so the receiver can always
+// resynchronize quickly after noise or a dropped byte.
+//
+// See wireless_xbee.h for notes about the hardware (shields, the serial
+// port switch, resetting the XBee, etc.) which apply to this interface
+// as well.  This interface can't be used together with wireless_xbee.h.
+//
+// WARNING: this interface owns the USART0 receive complete interrupt
+// (USART_RX_vect), so it can't be used with anything else that uses the
+// hardware serial port (term_io.h for example).
+
+#ifndef WIRELESS_XBEE_API_H
+#define WIRELESS_XBEE_API_H
+
+#include <inttypes.h>
+
+// Maximum RF data payload of a single packet (for Series 1 modules).
+#define WXA_MAX_PAYLOAD_LENGTH 100
+
+// Maximum length of the value returned by an AT command that we'll accept
+// (longer values are truncated).  This is enough for all the numeric
+// parameters and the NI (node identifier) string.
+#define WXA_MAX_AT_RESPONSE_VALUE_LENGTH 20
+
+// Number of received packets the background receiver can hold.  Each takes
+// about WXA_MAX_PAYLOAD_LENGTH + 12 bytes of RAM.
+#ifndef WXA_RX_QUEUE_PACKETS
+#  define WXA_RX_QUEUE_PACKETS 2
+#endif
+
+// Time to wait for AT Command Response and TX Status frames (in
+// milliseconds) in the convenience functions below which don't take an
+// explicit timeout.  A TX status can take a while if the XBee has to retry.
+#ifndef WXA_RESPONSE_TIMEOUT_MS
+#  define WXA_RESPONSE_TIMEOUT_MS 500
+#endif
+
+// 16 bit destination address that sends to all nodes in the PAN.  Packets
+// sent to it aren't acknowledged by the receivers.
+#define WXA_BROADCAST_ADDRESS 0xFFFF
+
+// Source address value that means the packet was sent using a 64 bit
+// address (so the source64 field of wxa_rx_packet_t should be used).
+#define WXA_SOURCE16_UNKNOWN 0xFFFE
+
+// Possible values returned by wxa_at_command().  The first four are the
+// status values from the AT Command Response frame.
+#define WXA_AT_STATUS_OK                0
+#define WXA_AT_STATUS_ERROR             1
+#define WXA_AT_STATUS_INVALID_COMMAND   2
+#define WXA_AT_STATUS_INVALID_PARAMETER 3
+#define WXA_AT_STATUS_TIMEOUT           0xFF
+
+// Possible values returned by the wxa_send*() functions.  The first four
+// are the status values from the TX Status frame.
+#define WXA_TX_STATUS_SUCCESS     0   // Sent and acknowledged (if unicast)
+#define WXA_TX_STATUS_NO_ACK      1   // All retries failed
+#define WXA_TX_STATUS_CCA_FAILURE 2   // Channel was always busy
+#define WXA_TX_STATUS_PURGED      3   // Coordinator timed out indirect TX
+#define WXA_TX_STATUS_TIMEOUT     0xFF
+
+// Option bits for the wxa_send*() functions (from the TX Request frame).
+#define WXA_TX_OPTION_DISABLE_ACK     0x01
+#define WXA_TX_OPTION_PAN_BROADCAST   0x04
+
+// A received packet.
+typedef struct {
+  uint16_t source16;   // Or WXA_SOURCE16_UNKNOWN if 64 bit address used
+  uint64_t source64;   // Only valid if source16 is WXA_SOURCE16_UNKNOWN
+  uint8_t rssi;        // Received signal strength, in -dBm
+  uint8_t options;     // Bit 1 set: address broadcast, bit 2: PAN broadcast
+  uint8_t length;      // Length of data
+  uint8_t data[WXA_MAX_PAYLOAD_LENGTH];
+} wxa_rx_packet_t;
+
+// Initialize the serial port and enable the receive interrupt.  Interrupts
+// are enabled globally (with sei()) by this function.
+void
+wxa_init (void);
+
+// Ensure that the XBee is in API mode with escaping (AP = 2).  First this
+// tries to query the AP parameter using an AT Command frame, which takes
+// only a few milliseconds if the XBee is already in the right mode.  If that
+// doesn't work, the AT command mode ritual from wireless_xbee.h (which takes
+// a few seconds) is used to set AP to 2 and save the setting.  Returns
+// TRUE on success, or FALSE otherwise.
+uint8_t
+wxa_ensure_api_mode (void);
+
+// Send the two character AT command (e.g. "ID") with the param_count byte
+// parameter value param (which may be NULL if param_count is 0, meaning
+// the parameter is being queried), and wait up to timeout milliseconds for
+// the response.  The value returned by the XBee (if any) is written to
+// value (which must point to at least WXA_MAX_AT_RESPONSE_VALUE_LENGTH
+// bytes, or be NULL if no value is expected) and its length is written to
+// *value_length (if value_length isn't NULL).  Multi-byte numeric parameters
+// and values are big-endian.  Returns one of the WXA_AT_STATUS_* values.
+// Note that most parameter changes take effect immediately (without an
+// AC command) but aren't saved in non-volatile memory unless the WR
+// command is used.
+uint8_t
+wxa_at_command (
+    char const *command,
+    uint8_t param_count,
+    void const *param,
+    uint8_t *value_length,
+    void *value,
+    uint16_t timeout );
+
+// Convenience wrappers around wxa_at_command() for the common case of
+// numeric parameters up to 16 bits wide (they use WXA_RESPONSE_TIMEOUT_MS).
+// The get function returns FALSE unless the status is WXA_AT_STATUS_OK.
+uint8_t
+wxa_get_parameter (char const *command, uint16_t *value);
+uint8_t
+wxa_set_parameter (char const *command, uint16_t value);
+
+// Send count bytes of data to the node with 16 bit address destination
+// (see the MY parameter), using the WXA_TX_OPTION_* bits in options, and
+// wait up to timeout milliseconds for the TX Status.  The count must not be
+// greater than WXA_MAX_PAYLOAD_LENGTH.  Returns one of the WXA_TX_STATUS_*
+// values.
+uint8_t
+wxa_send16 (
+    uint16_t destination,
+    uint8_t options,
+    uint8_t count,
+    void const *data,
+    uint16_t timeout );
+
+// Like wxa_send16(), but for a 64 bit destination address (the serial
+// number formed from the SH and SL parameters).
+uint8_t
+wxa_send64 (
+    uint64_t destination,
+    uint8_t options,
+    uint8_t count,
+    void const *data,
+    uint16_t timeout );
+
+// Wait up to timeout milliseconds for a packet to be received.  If one
+// is (or was already waiting) copy it to *packet and return TRUE,
+// otherwise return FALSE.
+uint8_t
+wxa_receive (wxa_rx_packet_t *packet, uint16_t timeout);
+
+// Number of received packets discarded because the queue was full, and of
+// frames discarded because they were corrupt, since wxa_init() was called.
+// These wrap around at UINT16_MAX.  Reads of them should be done from an
+// ATOMIC_BLOCK.
+extern volatile uint16_t wxa_rx_dropped_packet_count;
+extern volatile uint16_t wxa_rx_bad_frame_count;
+
+// Most recent Modem Status frame status byte (see the XBee Product Manual),
+// or 0xFF if none has been received.
+extern volatile uint8_t wxa_modem_status;
+
+#endif // WIRELESS_XBEE_API_H
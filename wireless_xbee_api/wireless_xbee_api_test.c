@@ -0,0 +1,96 @@
+// Test/demo for the wireless_xbee_api.h interface.
+//
+// This program needs an Arduino with an XBee shield (see
+// wireless_xbee_test.c for notes about the shield, and the CHKP_PD4()
+// macro definition there for why a LED must be connected from Digital 4
+// (PD4) to ground).  It first puts the XBee in API mode if required (which
+// takes a few seconds the first time), then checks that AT commands work
+// by changing the PAN ID and changing it back.  The LED blinks three times
+// when this is done.
+//
+// After that the program broadcasts a packet with an incrementing counter
+// every WAIT_TIME_MS milliseconds, and blinks the LED once for each packet
+// it receives.  So with two nodes running this program, both LEDs should
+// blink steadily.  If something goes wrong, the LED blinks frantically
+// forever.
+
+#include <assert.h>
+#include <string.h>
+#include <util/delay.h>
+
+#include "util.h"
+#include "wireless_xbee_api.h"
+
+// See the comments in wireless_xbee_test.c for the story behind these.
+#define CHKP_PD4_SB() CHKP_USING (DDRD, DDD4, PORTD, PORTD4, 300.0, 1)
+#define CHKP_PD4_TB() CHKP_USING (DDRD, DDD4, PORTD, PORTD4, 300.0, 3)
+#undef BTRAP
+#define BTRAP() BTRAP_USING (DDRD, DDD4, PORTD, PORTD4, 100.0)
+
+#define WAIT_TIME_MS 1000
+
+// PAN ID to change to temporarily (chosen so it has to be escaped).
+#define TEST_PAN_ID 0x117E
+
+int
+main (void)
+{
+  wxa_init ();
+
+  if ( ! wxa_ensure_api_mode () ) {
+    BTRAP ();
+  }
+
+  uint16_t original_pan_id;
+  if ( ! wxa_get_parameter ("ID", &original_pan_id) ) {
+    BTRAP ();
+  }
+  if ( ! wxa_set_parameter ("ID", TEST_PAN_ID) ) {
+    BTRAP ();
+  }
+  uint16_t pan_id;
+  if ( ! wxa_get_parameter ("ID", &pan_id) || pan_id != TEST_PAN_ID ) {
+    BTRAP ();
+  }
+  // Since we never sent WR, resetting the XBee would also do this
+  if ( ! wxa_set_parameter ("ID", original_pan_id) ) {
+    BTRAP ();
+  }
+  if ( ! wxa_get_parameter ("ID", &pan_id) || pan_id != original_pan_id ) {
+    BTRAP ();
+  }
+
+  // An unknown command should be politely refused
+  uint8_t status
+    = wxa_at_command ("Q?", 0, NULL, NULL, NULL, WXA_RESPONSE_TIMEOUT_MS);
+  if ( status != WXA_AT_STATUS_INVALID_COMMAND ) {
+    BTRAP ();
+  }
+
+  CHKP_PD4_TB ();
+
+  uint16_t counter = 0;
+
+  for ( ; ; ) {
+    // Broadcasts aren't acknowledged, so this should always succeed
+    status
+      = wxa_send16 (
+          WXA_BROADCAST_ADDRESS,
+          0x00,
+          sizeof (counter),
+          &counter,
+          WXA_RESPONSE_TIMEOUT_MS );
+    if ( status != WXA_TX_STATUS_SUCCESS ) {
+      BTRAP ();
+    }
+    counter++;
+
+    wxa_rx_packet_t packet;
+    if ( wxa_receive (&packet, WAIT_TIME_MS) ) {
+      if ( packet.length != sizeof (counter) ) {
+        BTRAP ();
+      }
+      CHKP_PD4_SB ();
+    }
+  }
+}
@@ -0,0 +1 @@
+../generic.mk
\ No newline at end of file
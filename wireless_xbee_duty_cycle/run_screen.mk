@@ -0,0 +1 @@
+../uart/run_screen.mk
\ No newline at end of file
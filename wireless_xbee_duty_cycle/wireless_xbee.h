@@ -0,0 +1 @@
+../wireless_xbee/wireless_xbee.h
\ No newline at end of file
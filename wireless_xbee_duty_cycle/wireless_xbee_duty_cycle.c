@@ -0,0 +1,215 @@
+// Implementation of the interface described in wireless_xbee_duty_cycle.h.
+
+#include <assert.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include "timer0_stopwatch.h"
+#include "util.h"
+#include "wireless_xbee_duty_cycle.h"
+
+#if WXDC_MAX_FRAME_LENGTH > WX_FRAME_SAFE_UNESCAPED_PAYLOAD_LENGTH
+#  error WXDC_MAX_FRAME_LENGTH is greater than \
+         WX_FRAME_SAFE_UNESCAPED_PAYLOAD_LENGTH
+#endif
+
+#define TIMER0_TICKS_PER_MS (F_CPU / TIMER0_STOPWATCH_PRESCALER_DIVIDER / 1000)
+
+typedef struct {
+  uint8_t length;
+  uint8_t data[WXDC_MAX_FRAME_LENGTH];
+} batch_slot_t;
+
+static batch_slot_t batch[WXDC_BATCH_FRAMES];
+static uint8_t batch_count;
+
+static wxdc_stats_t stats;
+
+// Set by the watchdog timer ISR, so wxdc_sleep() can tell its wake-ups from
+// those caused by other interrupts.
+static volatile uint8_t wdt_fired;
+
+ISR (WDT_vect)
+{
+  wdt_fired = TRUE;
+}
+
+void
+wxdc_init (void)
+{
+  timer0_stopwatch_init ();
+
+  batch_count = 0;
+  memset (&stats, 0, sizeof (stats));
+
+  WX_SLEEP_RQ_CONTROL_PIN_INIT ();
+  WX_SLEEP ();
+}
+
+uint8_t
+wxdc_queue_frame (uint8_t count, void const *data)
+{
+  assert (count <= WXDC_MAX_FRAME_LENGTH);
+
+  if ( batch_count == WXDC_BATCH_FRAMES ) {
+    stats.frames_rejected++;
+    return FALSE;
+  }
+
+  batch[batch_count].length = count;
+  memcpy (batch[batch_count].data, data, count);
+  batch_count++;
+
+  return TRUE;
+}
+
+uint8_t
+wxdc_queued_frame_count (void)
+{
+  return batch_count;
+}
+
+static uint8_t
+handle_received_frame (wxdc_frame_handler_t handler)
+{
+  // Take one frame from the receive queue (which must be non-empty) and
+  // pass it to handler (if that isn't NULL).  Return TRUE iff a frame
+  // was actually received.
+
+  uint8_t frame[WX_RX_QUEUE_MAX_PAYLOAD];
+  uint8_t count;
+
+  if ( ! wx_get_frame (sizeof (frame), &count, frame, 0) ) {
+    return FALSE;
+  }
+  stats.frames_received++;
+  if ( handler != NULL ) {
+    handler (count, frame);
+  }
+
+  return TRUE;
+}
+
+uint8_t
+wxdc_wake_cycle (wxdc_frame_handler_t handler)
+{
+  uint8_t received = 0;
+
+  uint32_t start_ticks = timer0_stopwatch_ticks ();
+
+  WX_WAKE ();
+
+  // Sending the batch before listening gives the other nodes a hint that
+  // we're awake.  The handler may queue more frames, so the batch is
+  // emptied first.  Those frames go out in the next cycle.
+  uint8_t sc = batch_count;   // Send Count
+  batch_count = 0;
+  for ( uint8_t ii = 0 ; ii < sc ; ii++ ) {
+    // This can't fail since WXDC_MAX_FRAME_LENGTH is a safe length
+    uint8_t sentinel = wx_put_frame (batch[ii].length, batch[ii].data);
+    assert (sentinel);
+    stats.frames_sent++;
+  }
+
+  // Listen.  Between frames the CPU idles (the receive ISR and the timer0
+  // overflow interrupt both wake it), which saves a few milliamps.  If a
+  // frame arrives between the check and the sleep, we just idle until the
+  // next timer0 overflow (about a millisecond) before noticing.
+  uint32_t const window_ticks
+    = (uint32_t) WXDC_LISTEN_WINDOW_MS * TIMER0_TICKS_PER_MS;
+  uint32_t listen_start_ticks = timer0_stopwatch_ticks ();
+  set_sleep_mode (SLEEP_MODE_IDLE);
+  while ( timer0_stopwatch_ticks () - listen_start_ticks < window_ticks ) {
+    if ( wx_frame_available () ) {
+      received += handle_received_frame (handler);
+    }
+    else {
+      sleep_mode ();
+    }
+  }
+
+  // The radio is about to go to sleep, so nothing else can arrive after
+  // this, and anything already queued would otherwise wait a whole cycle.
+  while ( wx_frame_available () ) {
+    received += handle_received_frame (handler);
+  }
+
+  WX_SLEEP ();
+
+  stats.radio_on_ms
+    += (timer0_stopwatch_ticks () - start_ticks) / TIMER0_TICKS_PER_MS;
+  stats.wake_cycles++;
+
+  return received;
+}
+
+static void
+sleep_for_wdt_period (uint8_t wdto)
+{
+  // Sleep in power-down mode until the watchdog timer interrupt fires after
+  // period wdto (one of the WDTO_* values from avr/wdt.h).
+
+  // The WDTO_* values are the prescaler bits, except that the high bit
+  // (WDP3) isn't next to the others in WDTCSR.
+  uint8_t const prescaler_bits
+    = (wdto & 0x08 ? _BV (WDP3) : 0) | (wdto & 0x07);
+
+  wdt_fired = FALSE;
+
+  // Timed sequence to put the watchdog timer in interrupt mode (no reset),
+  // see the ATmega328P datasheet.
+  ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+  {
+    wdt_reset ();
+    MCUSR &= ~(_BV (WDRF));
+    WDTCSR = _BV (WDCE) | _BV (WDE);
+    WDTCSR = _BV (WDIE) | prescaler_bits;
+  }
+
+  set_sleep_mode (SLEEP_MODE_PWR_DOWN);
+
+  while ( ! wdt_fired ) {
+    // Interrupts are disabled until the instruction after sei() executes,
+    // so the watchdog interrupt can't sneak in between the check and the
+    // sleep and leave us sleeping forever.
+    cli ();
+    if ( ! wdt_fired ) {
+      sleep_enable ();
+      sleep_bod_disable ();
+      sei ();
+      sleep_cpu ();
+      sleep_disable ();
+    }
+    sei ();
+  }
+
+  wdt_disable ();
+}
+
+void
+wxdc_sleep (uint16_t seconds)
+{
+  uint16_t const long_period_s = 8;
+
+  uint16_t remaining = seconds;
+
+  while ( remaining >= long_period_s ) {
+    sleep_for_wdt_period (WDTO_8S);
+    remaining -= long_period_s;
+  }
+  while ( remaining > 0 ) {
+    sleep_for_wdt_period (WDTO_1S);
+    remaining--;
+  }
+
+  stats.sleep_s += seconds;
+}
+
+void
+wxdc_get_stats (wxdc_stats_t *stats_ptr)
+{
+  *stats_ptr = stats;
+}
@@ -0,0 +1,156 @@
+// Duty-Cycled (Mostly Sleeping) XBee Node Runtime
+//
+// Test driver: wireless_xbee_duty_cycle_test.c    Implementation: wireless_xbee_duty_cycle.c
+//
+// An XBee that's awake draws about 50 mA, whether or not it's doing
+// anything, and an ATmega328P that's awake draws several more.  A battery
+// powered node that leaves them on lasts days.  A node that spends nearly
+// all its time with both asleep, and wakes up every so often to talk for a
+// moment, can last months.  This interface coordinates that:
+//
+//   * Outgoing frames are batched with wxdc_queue_frame() rather than sent
+//     right away, so the radio only has to be woken once per batch.
+//
+//   * wxdc_wake_cycle() wakes the XBee (using WX_WAKE()), sends the batch,
+//     listens for WXDC_LISTEN_WINDOW_MS milliseconds, passes every frame
+//     received to a client-supplied handler (including any still in the
+//     receive queue when the window closes), and puts the XBee back to
+//     sleep (using WX_SLEEP()).
+//
+//   * wxdc_sleep() puts the microcontroller in power-down sleep mode,
+//     using the watchdog timer interrupt to wake it up again after the
+//     requested number of seconds.
+//
+// So a typical node main loop looks something like this:
+//
+//   for ( ; ; ) {
+//     take_measurement (&measurement);
+//     wxdc_queue_frame (sizeof (measurement), &measurement);
+//     wxdc_wake_cycle (handle_incoming_frame);
+//     wxdc_sleep (SECONDS_BETWEEN_MEASUREMENTS);
+//   }
+//
+// The time the radio spends awake is measured and can be retrieved with
+// wxdc_get_stats(), so the actual duty cycle (and so the battery life) can
+// be estimated without any special measuring equipment.
+//
+// Since this node can only hear frames while it's awake, the other nodes
+// need to know when that is: either they keep retrying until they get an
+// answer (wireless_xbee_link.h does this), or this node sends something
+// at the start of each wake cycle (which it does anyway if it has queued
+// frames) and they only reply to that.
+//
+// Requirements:
+//
+//   * WX_SLEEP_RQ_CONTROL_PIN must be defined (see wireless_xbee.h and the
+//     Makefile for this module) and connected to the XBee SLEEP_RQ pin,
+//     and the XBee must be configured to honor it (SM parameter set to 1,
+//     e.g. using wx_at_command_expect_ok("SM1") and then "WR").
+//
+//   * WX_RX_INTERRUPT_DRIVEN must be defined (see wireless_xbee.h), since
+//     frames that arrive while the client handler is running would
+//     otherwise be lost.
+//
+//   * wx_init() must be called before wxdc_init().
+//
+// WARNING: this interface uses the watchdog timer (in interrupt mode) to
+// wake from sleep, so it can't be used together with a watchdog reset
+// timeout.  The watchdog timer is turned off again when wxdc_sleep()
+// returns.  It also uses timer0 via the timer0_stopwatch.h interface (see
+// the warning there about the effect of that interface on timer1).  Note
+// that timer0 (like every other clock source except the watchdog timer)
+// is stopped during power-down sleep.
+
+#ifndef WIRELESS_XBEE_DUTY_CYCLE_H
+#define WIRELESS_XBEE_DUTY_CYCLE_H
+
+#include <inttypes.h>
+#include <util/delay.h>   // WX_WAKE() needs this
+
+#include "wireless_xbee.h"
+
+#ifndef WX_SLEEP_RQ_CONTROL_PIN
+#  error WX_SLEEP_RQ_CONTROL_PIN must be defined to use this interface
+#endif
+#ifndef WX_RX_INTERRUPT_DRIVEN
+#  error WX_RX_INTERRUPT_DRIVEN must be defined to use this interface
+#endif
+
+// Number of frames that can be queued for the next wake cycle.
+#ifndef WXDC_BATCH_FRAMES
+#  define WXDC_BATCH_FRAMES 4
+#endif
+
+// Maximum payload length of queued frames.  Each batch slot takes this
+// many bytes of RAM (plus one).  It must not be greater than
+// WX_FRAME_SAFE_UNESCAPED_PAYLOAD_LENGTH, which ensures that every queued
+// frame can actually be sent.
+#ifndef WXDC_MAX_FRAME_LENGTH
+#  define WXDC_MAX_FRAME_LENGTH 32
+#endif
+
+// Time to listen for incoming frames in each wake cycle, in milliseconds
+// (after the batch has been sent).
+#ifndef WXDC_LISTEN_WINDOW_MS
+#  define WXDC_LISTEN_WINDOW_MS 100
+#endif
+
+// Statistics about the time spent awake and asleep.  The times are only
+// approximate: the radio on time is measured using timer0 (from just
+// before WX_WAKE() to just after WX_SLEEP()), but the sleep time is the
+// nominal watchdog timer period, and the watchdog timer oscillator isn't
+// very accurate (it's within about ten percent at room temperature).
+typedef struct {
+  uint32_t wake_cycles;        // Number of wxdc_wake_cycle() calls
+  uint32_t radio_on_ms;        // Total time the radio was awake
+  uint32_t sleep_s;            // Total time wxdc_sleep() has slept
+  uint16_t frames_sent;
+  uint16_t frames_received;
+  uint16_t frames_rejected;    // By wxdc_queue_frame() (batch full)
+} wxdc_stats_t;
+
+// Type of the client-supplied function that wxdc_wake_cycle() calls for
+// each received frame.  The frame data is only valid until the function
+// returns.
+typedef void (*wxdc_frame_handler_t) (uint8_t count, uint8_t const *frame);
+
+// Initialize the interface (including timer0_stopwatch.h), and put the
+// XBee to sleep.  Interrupts are enabled globally by this function.
+void
+wxdc_init (void);
+
+// Queue count bytes from data to be sent as a frame (see wx_put_frame())
+// during the next wake cycle.  The data is copied, so the caller can reuse
+// it as soon as this function returns.  The count must be at most
+// WXDC_MAX_FRAME_LENGTH.  Returns TRUE if the frame was queued, or FALSE
+// if WXDC_BATCH_FRAMES frames are already waiting.
+uint8_t
+wxdc_queue_frame (uint8_t count, void const *data);
+
+// Return the number of frames waiting to be sent.
+uint8_t
+wxdc_queued_frame_count (void);
+
+// Wake the radio, send all queued frames, spend WXDC_LISTEN_WINDOW_MS
+// milliseconds passing any frames received to handler (which may be NULL
+// if frames should just be discarded), pass any frames that are still
+// queued after that to handler as well, and put the radio back to sleep.
+// The handler may call wxdc_queue_frame(), but frames it queues aren't
+// sent until the next wake cycle.  Returns the number of frames received.
+uint8_t
+wxdc_wake_cycle (wxdc_frame_handler_t handler);
+
+// Put the microcontroller in power-down sleep mode for about seconds
+// seconds.  The watchdog timer wakes it up every eight seconds (or every
+// second near the end) to keep count, which costs very little power.
+// Interrupts from other sources (pin change interrupts, for example) also
+// wake the microcontroller, in which case this function goes right back
+// to sleep.
+void
+wxdc_sleep (uint16_t seconds);
+
+// Get the current statistics.
+void
+wxdc_get_stats (wxdc_stats_t *stats_ptr);
+
+#endif // WIRELESS_XBEE_DUTY_CYCLE_H
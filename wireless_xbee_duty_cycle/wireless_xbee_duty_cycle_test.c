@@ -0,0 +1,124 @@
+// Test/demo for the wireless_xbee_duty_cycle.h interface.
+//
+// This program needs an Arduino with an XBee shield (see
+// wireless_xbee_test.c for notes about the shield, and the CHKP_PD4()
+// macro definition there for why a LED must be connected from Digital 4
+// (PD4) to ground).  The XBee SLEEP_RQ pin must also be connected to the
+// pin WX_SLEEP_RQ_CONTROL_PIN is set to in the Makefile (the Sparkfun
+// shield doesn't do this, so a jumper wire is needed).
+//
+// The program temporarily sets the XBee sleep mode parameter (SM) to 1
+// (the setting isn't saved, so it goes back to normal when the XBee is
+// reset).  Then it wakes the radio every SLEEP_TIME_S seconds, sends a
+// frame containing a counter and the radio on time so far, and blinks the
+// LED once for each frame received during the listen window.  After
+// CHECK_CYCLES cycles it checks that the statistics make sense (and blinks
+// the LED three times if they do).  If anything goes wrong, the LED blinks
+// frantically forever.
+//
+// The frames can be watched using usb_xbee from the wireless_xbee module
+// directory (in framed mode).  Frames sent from there only arrive if they
+// happen to be sent during the listen window, so try sending a burst of
+// them just after one of the frames from this node shows up.
+//
+// With a meter in series with the power supply, the current should be a
+// fraction of a milliamp most of the time, with a spike to about 60 mA
+// for a bit over WXDC_LISTEN_WINDOW_MS milliseconds during each cycle.
+
+#include <assert.h>
+#include <string.h>
+#include <util/delay.h>
+
+#include "util.h"
+#include "wireless_xbee_duty_cycle.h"
+
+// See the definition of this macro in util.h to understand why its here.
+WATCHDOG_TIMER_MCUSR_MANTRA
+
+// See the comments in wireless_xbee_test.c for the story behind these.
+#define CHKP_PD4_SB() CHKP_USING (DDRD, DDD4, PORTD, PORTD4, 300.0, 1)
+#define CHKP_PD4_TB() CHKP_USING (DDRD, DDD4, PORTD, PORTD4, 300.0, 3)
+#undef BTRAP
+#define BTRAP() BTRAP_USING (DDRD, DDD4, PORTD, PORTD4, 100.0)
+
+#define SLEEP_TIME_S 10
+#define CHECK_CYCLES 5
+
+static void
+handle_frame (uint8_t count, uint8_t const *frame)
+{
+  // Frames arrive through the same receive buffer wxdc uses internally,
+  // so anything longer than that or without data means the handler is
+  // getting garbage.
+  if ( count > WX_RX_QUEUE_MAX_PAYLOAD || frame == NULL ) {
+    BTRAP ();
+  }
+  CHKP_PD4_SB ();
+}
+
+int
+main (void)
+{
+  wx_init ();
+
+  // The XBee must be awake (and the SLEEP_RQ line under our control) while
+  // we configure it
+  WX_SLEEP_RQ_CONTROL_PIN_INIT ();
+
+  uint8_t sentinel = wx_enter_at_command_mode ();
+  if ( ! sentinel ) {
+    BTRAP ();
+  }
+  sentinel = wx_at_command_expect_ok ("SM1");
+  if ( ! sentinel ) {
+    BTRAP ();
+  }
+  sentinel = wx_exit_at_command_mode ();
+  if ( ! sentinel ) {
+    BTRAP ();
+  }
+
+  wxdc_init ();
+
+  uint16_t counter = 0;
+
+  for ( ; ; ) {
+
+    wxdc_stats_t stats;
+    wxdc_get_stats (&stats);
+
+    uint8_t frame[sizeof (counter) + sizeof (stats.radio_on_ms)];
+    memcpy (frame, &counter, sizeof (counter));
+    memcpy (
+        frame + sizeof (counter),
+        &(stats.radio_on_ms),
+        sizeof (stats.radio_on_ms) );
+    sentinel = wxdc_queue_frame (sizeof (frame), frame);
+    if ( ! sentinel ) {
+      BTRAP ();
+    }
+    counter++;
+
+    wxdc_wake_cycle (handle_frame);
+
+    if ( counter == CHECK_CYCLES ) {
+      wxdc_get_stats (&stats);
+      if ( stats.wake_cycles != CHECK_CYCLES        ||
+           stats.frames_sent != CHECK_CYCLES        ||
+           wxdc_queued_frame_count () != 0          ||
+           stats.sleep_s != (CHECK_CYCLES - 1) * SLEEP_TIME_S ) {
+        BTRAP ();
+      }
+      // The radio must have been on for at least the listen windows, but
+      // it shouldn't have been on for much longer than that
+      uint32_t const min_on_ms = CHECK_CYCLES * WXDC_LISTEN_WINDOW_MS;
+      uint32_t const max_on_ms = 2 * min_on_ms + CHECK_CYCLES * 100;
+      if ( stats.radio_on_ms < min_on_ms || stats.radio_on_ms > max_on_ms ) {
+        BTRAP ();
+      }
+      CHKP_PD4_TB ();
+    }
+
+    wxdc_sleep (SLEEP_TIME_S);
+  }
+}
@@ -0,0 +1 @@
+../host_test_util.h
\ No newline at end of file
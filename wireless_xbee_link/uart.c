@@ -0,0 +1 @@
+../term_io/uart.c
\ No newline at end of file
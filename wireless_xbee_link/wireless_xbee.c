@@ -0,0 +1 @@
+../wireless_xbee/wireless_xbee.c
\ No newline at end of file
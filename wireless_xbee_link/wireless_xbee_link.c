@@ -0,0 +1,375 @@
+// Implementation of the interface described in wireless_xbee_link.h.
+
+#include <assert.h>
+#include <string.h>
+
+#include "timer0_stopwatch.h"
+#include "util.h"
+#include "wireless_xbee_link.h"
+
+// Frame types (first byte of the header).  These aren't printable ASCII,
+// so stray text frames (from wx_log_message() for example) are ignored.
+#define FRAME_TYPE_MESSAGE 0xD1
+#define FRAME_TYPE_ACK     0xA1
+
+// Positions of the header fields
+#define HEADER_TYPE_INDEX            0
+#define HEADER_SEQUENCE_NUMBER_INDEX 1
+#define HEADER_ACK_INDEX             2
+#define HEADER_SELECTIVE_ACK_INDEX   3
+
+// Window slot for sequence number sn.  This works across sequence number
+// wrap-around because WXL_WINDOW_SIZE is a power of two.
+#define SLOT(sn) ((sn) % WXL_WINDOW_SIZE)
+
+#define TIMER0_TICKS_PER_MS (F_CPU / TIMER0_STOPWATCH_PRESCALER_DIVIDER / 1000)
+
+typedef struct {
+  uint8_t length;
+  uint8_t acked;            // TRUE once acknowledged (maybe selectively)
+  uint8_t retransmitted;    // TRUE if sent more than once
+  uint16_t sent_ms;         // Time of the most recent transmission
+  uint8_t data[WXL_MAX_MESSAGE_LENGTH];
+} tx_slot_t;
+
+typedef struct {
+  uint8_t present;          // TRUE if received but not yet delivered
+  uint8_t length;
+  uint8_t data[WXL_MAX_MESSAGE_LENGTH];
+} rx_slot_t;
+
+static tx_slot_t tx_window[WXL_WINDOW_SIZE];
+static uint8_t tx_base;   // Oldest unacknowledged sequence number
+static uint8_t tx_next;   // Sequence number for the next new message
+
+static rx_slot_t rx_window[WXL_WINDOW_SIZE];
+static uint8_t rx_next;   // Next sequence number to deliver to the client
+
+static uint8_t ack_owed;  // TRUE if the peer needs to hear our rx state
+
+// Round trip time estimator state, in milliseconds scaled by 8 and 4
+// respectively (like in BSD TCP).  srtt8 is 0 until the first measurement.
+static uint16_t srtt8;
+static uint16_t rttvar4;
+static uint16_t rto_ms;
+
+static wxl_stats_t stats;
+
+static uint16_t
+now_ms (void)
+{
+  // Wraps every 65.536 s, which is fine since we only ever subtract times
+  // much closer together than that.  The underlying tick counter also
+  // wraps (after about 4.7 hours), which may cause one early retransmit.
+  return timer0_stopwatch_ticks () / TIMER0_TICKS_PER_MS;
+}
+
+void
+wxl_init (void)
+{
+  timer0_stopwatch_init ();
+
+  tx_base = 0;
+  tx_next = 0;
+  rx_next = 0;
+  for ( uint8_t ii = 0 ; ii < WXL_WINDOW_SIZE ; ii++ ) {
+    rx_window[ii].present = FALSE;
+  }
+  ack_owed = FALSE;
+
+  srtt8 = 0;
+  rttvar4 = 0;
+  rto_ms = WXL_INITIAL_RTO_MS;
+
+  memset (&stats, 0, sizeof (stats));
+}
+
+static uint8_t
+selective_ack_bitmap (void)
+{
+  // Return a bitmap with bit ii set iff message rx_next + ii has been
+  // received (but not yet delivered).
+
+  uint8_t sab = 0;   // Selective Ack Bitmap
+
+  for ( uint8_t ii = 0 ; ii < WXL_WINDOW_SIZE ; ii++ ) {
+    if ( rx_window[SLOT ((uint8_t) (rx_next + ii))].present ) {
+      sab |= _BV (ii);
+    }
+  }
+
+  return sab;
+}
+
+static void
+put_frame (uint8_t type, uint8_t sn, uint8_t count, void const *data)
+{
+  // Send a frame of the given type, with sequence number sn (ignored for
+  // ACK frames), our current rx state, and count bytes of data.
+
+  uint8_t header[WXL_HEADER_LENGTH];
+  header[HEADER_TYPE_INDEX] = type;
+  header[HEADER_SEQUENCE_NUMBER_INDEX] = sn;
+  header[HEADER_ACK_INDEX] = rx_next;
+  header[HEADER_SELECTIVE_ACK_INDEX] = selective_ack_bitmap ();
+
+  // This can't fail, since WXL_MAX_MESSAGE_LENGTH is a safe length
+  uint8_t sentinel
+    = wx_put_split_frame (WXL_HEADER_LENGTH, header, count, data);
+  assert (sentinel);
+
+  ack_owed = FALSE;
+}
+
+uint8_t
+wxl_send (uint8_t count, void const *data)
+{
+  assert (count <= WXL_MAX_MESSAGE_LENGTH);
+
+  if ( (uint8_t) (tx_next - tx_base) == WXL_WINDOW_SIZE ) {
+    return FALSE;
+  }
+
+  tx_slot_t *ts = &(tx_window[SLOT (tx_next)]);
+  ts->length = count;
+  ts->acked = FALSE;
+  ts->retransmitted = FALSE;
+  memcpy (ts->data, data, count);
+
+  put_frame (FRAME_TYPE_MESSAGE, tx_next, ts->length, ts->data);
+  ts->sent_ms = now_ms ();
+
+  tx_next++;
+  stats.messages_sent++;
+
+  return TRUE;
+}
+
+uint8_t
+wxl_receive (uint8_t *count, void *buf)
+{
+  rx_slot_t *rs = &(rx_window[SLOT (rx_next)]);
+
+  if ( ! rs->present ) {
+    return FALSE;
+  }
+
+  memcpy (buf, rs->data, rs->length);
+  *count = rs->length;
+  rs->present = FALSE;
+  rx_next++;
+
+  // The peer needs to know that the window has moved
+  ack_owed = TRUE;
+
+  return TRUE;
+}
+
+static void
+update_rto (uint16_t rtt_ms)
+{
+  // Update the round trip time estimate with measurement rtt_ms, and
+  // recompute the retransmission timeout (see RFC 6298).
+
+  // Zero is reserved to mean no measurement yet
+  if ( rtt_ms == 0 ) {
+    rtt_ms = 1;
+  }
+  if ( rtt_ms > WXL_MAX_RTO_MS ) {
+    rtt_ms = WXL_MAX_RTO_MS;
+  }
+
+  if ( srtt8 == 0 ) {
+    srtt8 = rtt_ms << 3;
+    rttvar4 = rtt_ms << 1;
+  }
+  else {
+    int16_t delta = rtt_ms - (srtt8 >> 3);
+    srtt8 += delta;
+    if ( delta < 0 ) {
+      delta = -delta;
+    }
+    delta -= (rttvar4 >> 2);
+    rttvar4 += delta;
+  }
+
+  uint16_t new_rto_ms = (srtt8 >> 3) + rttvar4;
+  if ( new_rto_ms < WXL_MIN_RTO_MS ) {
+    new_rto_ms = WXL_MIN_RTO_MS;
+  }
+  if ( new_rto_ms > WXL_MAX_RTO_MS ) {
+    new_rto_ms = WXL_MAX_RTO_MS;
+  }
+  rto_ms = new_rto_ms;
+}
+
+static void
+mark_acked (uint8_t sn, uint16_t now)
+{
+  tx_slot_t *ts = &(tx_window[SLOT (sn)]);
+
+  if ( ts->acked ) {
+    return;
+  }
+  ts->acked = TRUE;
+
+  // Karn's algorithm: we can't tell which transmission of a retransmitted
+  // message is being acknowledged, so only the others get measured.
+  if ( ! ts->retransmitted ) {
+    update_rto (now - ts->sent_ms);
+  }
+}
+
+static void
+handle_ack (uint8_t ack, uint8_t sab)
+{
+  // Handle cumulative ACK ack and Selective Ack Bitmap sab from the peer.
+
+  uint8_t in_flight = tx_next - tx_base;
+
+  // An ACK from before an earlier one (or garbage) is just ignored
+  if ( (uint8_t) (ack - tx_base) > in_flight ) {
+    return;
+  }
+
+  uint16_t now = now_ms ();
+
+  for ( uint8_t sn = tx_base ; sn != ack ; sn++ ) {
+    mark_acked (sn, now);
+  }
+  for ( uint8_t ii = 0 ; ii < WXL_WINDOW_SIZE ; ii++ ) {
+    uint8_t sn = ack + ii;
+    if ( (sab & _BV (ii)) && (uint8_t) (sn - tx_base) < in_flight ) {
+      mark_acked (sn, now);
+    }
+  }
+
+  // Slide the window up to the cumulative ACK, and no further.  Messages
+  // beyond it that were selectively acknowledged won't be retransmitted,
+  // but they keep their slots until the cumulative ACK passes them: the
+  // peer hasn't delivered them yet, so its window hasn't moved past them
+  // and it would discard any new messages sent in their place.
+  tx_base = ack;
+}
+
+static void
+handle_message (uint8_t sn, uint8_t count, uint8_t const *data)
+{
+  // Handle a message with sequence number sn and count bytes of data.
+
+  // Whatever happens, the peer needs to know it got here
+  ack_owed = TRUE;
+
+  if ( (uint8_t) (sn - rx_next) >= WXL_WINDOW_SIZE ) {
+    // Already delivered (the peer missed our ACK), or hopelessly confused
+    stats.duplicates_received++;
+    return;
+  }
+
+  rx_slot_t *rs = &(rx_window[SLOT (sn)]);
+  if ( rs->present ) {
+    stats.duplicates_received++;
+    return;
+  }
+
+  memcpy (rs->data, data, count);
+  rs->length = count;
+  rs->present = TRUE;
+  stats.messages_received++;
+}
+
+static void
+handle_frame (uint8_t count, uint8_t const *frame)
+{
+  if ( count < WXL_HEADER_LENGTH ) {
+    return;
+  }
+
+  uint8_t type = frame[HEADER_TYPE_INDEX];
+  if ( type != FRAME_TYPE_MESSAGE && type != FRAME_TYPE_ACK ) {
+    return;
+  }
+
+  handle_ack (frame[HEADER_ACK_INDEX], frame[HEADER_SELECTIVE_ACK_INDEX]);
+
+  if ( type == FRAME_TYPE_MESSAGE ) {
+    handle_message (
+        frame[HEADER_SEQUENCE_NUMBER_INDEX],
+        count - WXL_HEADER_LENGTH,
+        frame + WXL_HEADER_LENGTH );
+  }
+}
+
+static void
+retransmit_expired (void)
+{
+  // Retransmit every unacknowledged message that has been waiting for
+  // longer than the retransmission timeout.  If any had, back off the
+  // timeout.
+
+  uint8_t expired = FALSE;
+
+  for ( uint8_t sn = tx_base ; sn != tx_next ; sn++ ) {
+    tx_slot_t *ts = &(tx_window[SLOT (sn)]);
+    if ( ts->acked ) {
+      continue;
+    }
+    uint16_t now = now_ms ();
+    if ( (uint16_t) (now - ts->sent_ms) >= rto_ms ) {
+      put_frame (FRAME_TYPE_MESSAGE, sn, ts->length, ts->data);
+      ts->sent_ms = now_ms ();
+      ts->retransmitted = TRUE;
+      stats.retransmissions++;
+      expired = TRUE;
+    }
+  }
+
+  if ( expired ) {
+    rto_ms = (rto_ms > WXL_MAX_RTO_MS / 2 ? WXL_MAX_RTO_MS : rto_ms * 2);
+  }
+}
+
+void
+wxl_service (uint16_t timeout)
+{
+  uint8_t frame[WXL_HEADER_LENGTH + WXL_MAX_MESSAGE_LENGTH];
+  uint8_t count;
+
+  if ( wx_get_frame (sizeof (frame), &count, frame, timeout) ) {
+    handle_frame (count, frame);
+  }
+#ifndef WX_RX_INTERRUPT_DRIVEN
+  // See the notes about this near the wx_get_frame() declaration
+  else if ( WX_UART_RX_ERROR () ) {
+    WX_UART_FLUSH_RX_BUFFER ();
+  }
+#endif
+
+  retransmit_expired ();
+
+  if ( ack_owed ) {
+    put_frame (FRAME_TYPE_ACK, 0, 0, NULL);
+  }
+}
+
+uint8_t
+wxl_unacknowledged_count (void)
+{
+  uint8_t uc = 0;   // Unacknowledged Count
+
+  for ( uint8_t sn = tx_base ; sn != tx_next ; sn++ ) {
+    if ( ! tx_window[SLOT (sn)].acked ) {
+      uc++;
+    }
+  }
+
+  return uc;
+}
+
+void
+wxl_get_stats (wxl_stats_t *stats_ptr)
+{
+  *stats_ptr = stats;
+  stats_ptr->srtt_ms = srtt8 >> 3;
+  stats_ptr->rto_ms = rto_ms;
+}
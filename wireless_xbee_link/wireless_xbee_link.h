@@ -0,0 +1,141 @@
+// Reliable, In-Order Message Link Over wireless_xbee.h Frames
+//
+// Test driver: wireless_xbee_link_test.c    Implementation: wireless_xbee_link.c
+// Host test driver: wireless_xbee_link_host_test.c
+//
+// The frames sent by wx_put_frame() can be lost or corrupted, and
+// wireless_xbee.h leaves acknowledgement and retries to its clients.
+// This interface provides them: messages sent with wxl_send() on one node
+// are delivered by wxl_receive() on the other node exactly once and in
+// order, or not at all if the link is down for good.
+//
+// Unlike a simple stop-and-wait scheme (send a message, wait for the ACK,
+// repeat), up to WXL_WINDOW_SIZE messages can be in flight at once, so
+// the radio isn't left idle for a round trip after every message.  The
+// details:
+//
+//   * Every frame carries a four byte header with a frame type, a sequence
+//     number (for messages), and the receiver state of the sending node:
+//     the sequence number of the next message it will deliver to its client
+//     (a cumulative ACK), and a bitmap showing which of the following
+//     WXL_WINDOW_SIZE messages it has already received (a selective ACK).
+//     So ACKs ride along on messages going the other way when possible,
+//     and only messages that were actually lost get retransmitted.
+//
+//   * The cumulative ACK only advances as the receiving client actually
+//     collects messages with wxl_receive(), so a slow receiver throttles
+//     the sender rather than being overrun.
+//
+//   * The retransmission timeout is computed from measured round trip
+//     times in the usual way (smoothed RTT plus four times the smoothed
+//     RTT variation, see RFC 6298).  Retransmitted messages aren't used for
+//     RTT measurements (Karn's algorithm), and the timeout doubles each
+//     time it expires, up to WXL_MAX_RTO_MS.
+//
+//   * Duplicate messages (resulting from lost ACKs) are recognized from
+//     their sequence numbers, acknowledged again, and otherwise discarded.
+//
+// This interface does nothing in the background: wxl_service() must be
+// called frequently to receive frames and handle retransmission.
+// wx_init() (and any XBee configuration) should be done before
+// wxl_init() is called.  Defining WX_RX_INTERRUPT_DRIVEN (see
+// wireless_xbee.h) is recommended, since otherwise frames that arrive
+// while wxl_service() isn't running are lost (they'll be retransmitted,
+// but that wastes time).  Both nodes must use the same WXL_WINDOW_SIZE.
+//
+// The RAM required is about 2 * WXL_WINDOW_SIZE * WXL_MAX_MESSAGE_LENGTH
+// bytes (about 360 bytes with the defaults), plus a frame buffer on the
+// stack in wxl_service().
+//
+// There is no connection setup, so both nodes must be (re)started together.
+// If only one node restarts the sequence numbers no longer agree, and the
+// link stays stuck until the other node is restarted as well.
+//
+// WARNING: this interface uses timer0 via the timer0_stopwatch.h interface
+// (see the warning there about the effect of that interface on timer1).
+
+#ifndef WIRELESS_XBEE_LINK_H
+#define WIRELESS_XBEE_LINK_H
+
+#include <inttypes.h>
+
+#include "wireless_xbee.h"
+
+// Number of messages that can be in flight (sent but not yet acknowledged)
+// at once, and also the number of out-of-order messages the receiver will
+// hold on to.  Must be a power of two no greater than eight.
+#ifndef WXL_WINDOW_SIZE
+#  define WXL_WINDOW_SIZE 4
+#endif
+#if WXL_WINDOW_SIZE != 1 && WXL_WINDOW_SIZE != 2 && \
+    WXL_WINDOW_SIZE != 4 && WXL_WINDOW_SIZE != 8
+#  error WXL_WINDOW_SIZE must be 1, 2, 4, or 8
+#endif
+
+// Size of the header added to every message.
+#define WXL_HEADER_LENGTH 4
+
+// Maximum message length.  This is small enough that the frame always fits
+// in a single radio packet, whatever the message contains.
+#define WXL_MAX_MESSAGE_LENGTH \
+  (WX_FRAME_SAFE_UNESCAPED_PAYLOAD_LENGTH - WXL_HEADER_LENGTH)
+
+// Retransmission timeout used until a round trip time has been measured.
+#ifndef WXL_INITIAL_RTO_MS
+#  define WXL_INITIAL_RTO_MS 1000
+#endif
+
+// Limits for the retransmission timeout.
+#ifndef WXL_MIN_RTO_MS
+#  define WXL_MIN_RTO_MS 100
+#endif
+#ifndef WXL_MAX_RTO_MS
+#  define WXL_MAX_RTO_MS 8000
+#endif
+
+// Link statistics.  These wrap around at UINT16_MAX.
+typedef struct {
+  uint16_t messages_sent;          // Not counting retransmissions
+  uint16_t retransmissions;
+  uint16_t messages_received;      // Distinct messages, in or out of order
+  uint16_t duplicates_received;    // Including out-of-window messages
+  uint16_t srtt_ms;                // Smoothed round trip time (0 if unknown)
+  uint16_t rto_ms;                 // Current retransmission timeout
+} wxl_stats_t;
+
+// Initialize the link state (and timer0_stopwatch.h).  Interrupts are
+// enabled globally by this function.
+void
+wxl_init (void);
+
+// Send count bytes from data as a message.  The data is copied, so the
+// caller can reuse it as soon as this function returns.  The count must
+// be at most WXL_MAX_MESSAGE_LENGTH.  Returns TRUE if the message was sent
+// (or at least queued for retransmission), or FALSE if WXL_WINDOW_SIZE
+// messages are already in flight (in which case the caller should call
+// wxl_service() for a while and try again).
+uint8_t
+wxl_send (uint8_t count, void const *data);
+
+// If the next message from the peer has arrived, copy it into buf (which
+// must have room for WXL_MAX_MESSAGE_LENGTH bytes), set *count to its
+// length, and return TRUE.  Otherwise return FALSE.
+uint8_t
+wxl_receive (uint8_t *count, void *buf);
+
+// Spend up to about timeout milliseconds waiting for a frame from the peer
+// (see wx_get_frame()), process it if one arrives, retransmit any messages
+// whose retransmission timeout has expired, and send an ACK if one is
+// owed to the peer and hasn't been sent along with a message.
+void
+wxl_service (uint16_t timeout);
+
+// Return the number of sent messages that haven't been acknowledged yet.
+uint8_t
+wxl_unacknowledged_count (void);
+
+// Get the current link statistics.
+void
+wxl_get_stats (wxl_stats_t *stats_ptr);
+
+#endif // WIRELESS_XBEE_LINK_H
@@ -0,0 +1,461 @@
+// Host test driver for wireless_xbee_link.c (see the host_test target in
+// generic.mk).
+//
+// Two nodes are linked by a simulated radio channel that drops, delays,
+// and reorders frames.  Each node is the real wireless_xbee_link.c compiled
+// for the host (see wireless_xbee_link_host_test.h for how the two copies
+// are kept apart), with wx_put_split_frame() and wx_get_frame() implemented
+// here on top of the channel and the timer0_stopwatch.h functions on top
+// of a simulated clock.  Time advances one millisecond per simulation
+// step, and nothing else happens in between, so runs are deterministic and
+// many simulated minutes take only a moment.
+//
+// Every message carries a sequence number and filler bytes derived from it,
+// and the receiving side checks that the messages it's given arrive
+// exactly once, in order, intact, and before a generous deadline.  The
+// channel also checks that no node ever sends a message that falls beyond
+// the end of the peer's receive window (which would mean the sender had
+// lost track of what the receiver can accept).
+//
+// This program exits with a non-zero status after printing a description
+// of the first failure, or prints a summary line per test and exits with
+// status zero if everything passes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wireless_xbee_link_host_test.h"
+#include "host_test_util.h"
+#include "wireless_xbee_link.h"
+
+// Wire format details from wireless_xbee_link.c that the channel needs to
+// recognize message frames and check their sequence numbers.
+#define FRAME_TYPE_MESSAGE           0xD1
+#define HEADER_TYPE_INDEX            0
+#define HEADER_SEQUENCE_NUMBER_INDEX 1
+
+// Length of the sequence number at the start of every test message.
+#define TEST_SEQUENCE_NUMBER_LENGTH sizeof (uint32_t)
+
+// Maximum number of frames the channel can have in flight in one direction
+// before it starts dropping them.  The XBee has a limited buffer as well.
+#define CHANNEL_CAPACITY 64
+
+// Maximum frame length the channel carries.
+#define CHANNEL_MAX_FRAME_LENGTH UINT8_MAX
+
+typedef struct {
+  uint32_t deliver_ms;
+  uint32_t order;            // Sent order, to deliver equal times in order
+  uint8_t length;
+  uint8_t data[CHANNEL_MAX_FRAME_LENGTH];
+} channel_frame_t;
+
+typedef struct {
+  channel_frame_t frames[CHANNEL_CAPACITY];
+  uint8_t count;
+  uint32_t next_order;
+} channel_t;
+
+// Channel characteristics.
+typedef struct {
+  uint8_t drop_percent;      // Probability that a frame is lost
+  uint16_t min_latency_ms;   // Latency is uniform in this range, so frames
+  uint16_t max_latency_ms;   // that are close together can be reordered
+} channel_config_t;
+
+typedef struct node_struct node_t;
+
+struct node_struct {
+  char const *name;
+
+  // The renamed copies of the wireless_xbee_link.h functions for this node
+  void (*init) (void);
+  uint8_t (*send) (uint8_t count, void const *data);
+  uint8_t (*receive) (uint8_t *count, void *buf);
+  void (*service) (uint16_t timeout);
+  uint8_t (*unacknowledged_count) (void);
+  void (*get_stats) (wxl_stats_t *stats_ptr);
+
+  channel_t to_peer;         // Frames sent by this node
+  node_t *peer;
+
+  uint32_t messages_sent;
+  uint32_t messages_delivered;
+};
+
+// Declare the functions from the wireless_xbee_link.c copy for node.
+#define DECLARE_NODE_LINK_FUNCTIONS(node)                             \
+  void node ## _wxl_init (void);                                       \
+  uint8_t node ## _wxl_send (uint8_t count, void const *data);        \
+  uint8_t node ## _wxl_receive (uint8_t *count, void *buf);           \
+  void node ## _wxl_service (uint16_t timeout);                        \
+  uint8_t node ## _wxl_unacknowledged_count (void);                    \
+  void node ## _wxl_get_stats (wxl_stats_t *stats_ptr);
+
+DECLARE_NODE_LINK_FUNCTIONS (node_a)
+DECLARE_NODE_LINK_FUNCTIONS (node_b)
+
+#define NODE_INITIALIZER(node)                                        \
+  {                                                                   \
+    .name = #node,                                                    \
+    .init = node ## _wxl_init,                                        \
+    .send = node ## _wxl_send,                                        \
+    .receive = node ## _wxl_receive,                                  \
+    .service = node ## _wxl_service,                                  \
+    .unacknowledged_count = node ## _wxl_unacknowledged_count,        \
+    .get_stats = node ## _wxl_get_stats                               \
+  }
+
+static node_t node_a = NODE_INITIALIZER (node_a);
+static node_t node_b = NODE_INITIALIZER (node_b);
+
+static channel_config_t channel_config;
+
+// Simulated time in milliseconds.
+static uint32_t now_ms;
+
+static uint8_t
+filler_byte (uint32_t sequence_number, uint8_t index)
+{
+  return (uint8_t) (sequence_number * 31 + index * 7);
+}
+
+static void
+check_message_window (node_t const *sender, uint8_t length, uint8_t *data)
+{
+  // Check that the message frame of length bytes at data from sender is in
+  // (or just behind) the receive window of the peer.  It has to be: the
+  // peer only acknowledges messages it has delivered, so the sender can
+  // never have sent (and be retransmitting) messages more than
+  // WXL_WINDOW_SIZE past the first one the peer hasn't delivered.
+
+  if ( length < WXL_HEADER_LENGTH ||
+       data[HEADER_TYPE_INDEX] != FRAME_TYPE_MESSAGE ) {
+    return;
+  }
+
+  node_t const *receiver = sender->peer;
+  uint8_t sn = data[HEADER_SEQUENCE_NUMBER_INDEX];
+  uint8_t rx_next = receiver->messages_delivered;
+  uint8_t ahead = sn - rx_next;
+
+  if ( ahead >= WXL_WINDOW_SIZE && ahead < UINT8_MAX + 1 - WXL_WINDOW_SIZE ) {
+    fail (
+        "%s sent message %u, but %s hasn't delivered message %u yet so "
+        "that's outside its receive window",
+        sender->name,
+        sn,
+        receiver->name,
+        rx_next );
+  }
+}
+
+static uint8_t
+put_split_frame (
+    node_t *sender,
+    uint8_t header_count,
+    void const *header,
+    uint8_t body_count,
+    void const *body )
+{
+  // Stand-in for wx_put_split_frame() for sender.
+
+  if ( header_count + body_count > WX_FRAME_SAFE_UNESCAPED_PAYLOAD_LENGTH ) {
+    fail ("%s tried to send an overlong frame", sender->name);
+  }
+
+  uint8_t length = header_count + body_count;
+  uint8_t data[CHANNEL_MAX_FRAME_LENGTH];
+  memcpy (data, header, header_count);
+  memcpy (data + header_count, body, body_count);
+
+  check_message_window (sender, length, data);
+
+  channel_t *channel = &(sender->to_peer);
+
+  if ( random_uint32 () % 100 < channel_config.drop_percent ||
+       channel->count == CHANNEL_CAPACITY ) {
+    return TRUE;   // The radio has no idea the frame got lost
+  }
+
+  uint16_t latency_range
+    = channel_config.max_latency_ms - channel_config.min_latency_ms + 1;
+
+  channel_frame_t *cf = &(channel->frames[channel->count++]);
+  cf->deliver_ms
+    = now_ms + channel_config.min_latency_ms + random_uint32 () % latency_range;
+  cf->order = channel->next_order++;
+  cf->length = length;
+  memcpy (cf->data, data, length);
+
+  return TRUE;
+}
+
+static uint8_t
+get_frame (node_t *receiver, uint8_t mfps, uint8_t *rfps, void *buf)
+{
+  // Stand-in for wx_get_frame() for receiver.  The timeout is ignored,
+  // since time only passes between simulation steps: only frames that have
+  // already arrived can be returned.
+
+  channel_t *channel = &(receiver->peer->to_peer);
+
+  int first = -1;
+  for ( int ii = 0 ; ii < channel->count ; ii++ ) {
+    channel_frame_t *cf = &(channel->frames[ii]);
+    if ( cf->deliver_ms > now_ms ) {
+      continue;
+    }
+    if ( first == -1 ||
+         cf->deliver_ms < channel->frames[first].deliver_ms ||
+         ( cf->deliver_ms == channel->frames[first].deliver_ms &&
+           cf->order < channel->frames[first].order ) ) {
+      first = ii;
+    }
+  }
+
+  if ( first == -1 ) {
+    return FALSE;
+  }
+
+  channel_frame_t cf = channel->frames[first];
+  channel->frames[first] = channel->frames[--(channel->count)];
+
+  if ( cf.length > mfps ) {
+    return FALSE;
+  }
+
+  memcpy (buf, cf.data, cf.length);
+  *rfps = cf.length;
+
+  return TRUE;
+}
+
+// Define the external functions the wireless_xbee_link.c copy for node
+// expects (see wireless_xbee_link_host_test.h).
+#define DEFINE_NODE_SHIMS(node)                                         \
+  uint8_t                                                               \
+  node ## _wx_put_split_frame (                                         \
+      uint8_t header_count,                                             \
+      void const *header,                                               \
+      uint8_t body_count,                                               \
+      void const *body )                                                \
+  {                                                                     \
+    return put_split_frame (                                            \
+        &node, header_count, header, body_count, body );                \
+  }                                                                     \
+                                                                        \
+  uint8_t                                                               \
+  node ## _wx_get_frame (                                               \
+      uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout )        \
+  {                                                                     \
+    (void) timeout;                                                     \
+    return get_frame (&node, mfps, rfps, buf);                          \
+  }                                                                     \
+                                                                        \
+  void                                                                  \
+  node ## _timer0_stopwatch_init (void)                                 \
+  {                                                                     \
+  }                                                                     \
+                                                                        \
+  uint32_t                                                              \
+  node ## _timer0_stopwatch_ticks (void)                                \
+  {                                                                     \
+    return now_ms * WXL_HOST_TEST_TIMER0_TICKS_PER_MS;                  \
+  }
+
+// These are only called from the wireless_xbee_link.c copies.
+#define DECLARE_NODE_SHIMS(node)                                        \
+  uint8_t node ## _wx_put_split_frame (                                 \
+      uint8_t header_count,                                             \
+      void const *header,                                               \
+      uint8_t body_count,                                               \
+      void const *body );                                               \
+  uint8_t node ## _wx_get_frame (                                       \
+      uint8_t mfps, uint8_t *rfps, void *buf, uint16_t timeout );       \
+  void node ## _timer0_stopwatch_init (void);                           \
+  uint32_t node ## _timer0_stopwatch_ticks (void);
+
+DECLARE_NODE_SHIMS (node_a)
+DECLARE_NODE_SHIMS (node_b)
+
+DEFINE_NODE_SHIMS (node_a)
+DEFINE_NODE_SHIMS (node_b)
+
+static void
+reset (channel_config_t const *config, uint32_t seed)
+{
+  // Reset the simulation and both nodes for a new test.
+
+  channel_config = *config;
+  random_state = seed;
+  now_ms = 0;
+
+  node_t *nodes[] = { &node_a, &node_b };
+  for ( uint8_t ii = 0 ; ii < 2 ; ii++ ) {
+    node_t *node = nodes[ii];
+    node->peer = (ii == 0 ? &node_b : &node_a);
+    node->to_peer.count = 0;
+    node->to_peer.next_order = 0;
+    node->messages_sent = 0;
+    node->messages_delivered = 0;
+    node->init ();
+  }
+}
+
+static void
+send_messages (node_t *node, uint32_t total)
+{
+  // Have node send as many of its total test messages as the link accepts.
+
+  while ( node->messages_sent < total ) {
+    uint8_t message[WXL_MAX_MESSAGE_LENGTH];
+    uint32_t sn = node->messages_sent;
+    uint8_t length
+      = TEST_SEQUENCE_NUMBER_LENGTH
+        + sn % (WXL_MAX_MESSAGE_LENGTH - TEST_SEQUENCE_NUMBER_LENGTH + 1);
+    memcpy (message, &sn, TEST_SEQUENCE_NUMBER_LENGTH);
+    for ( uint8_t ii = TEST_SEQUENCE_NUMBER_LENGTH ; ii < length ; ii++ ) {
+      message[ii] = filler_byte (sn, ii);
+    }
+    if ( ! node->send (length, message) ) {
+      break;
+    }
+    node->messages_sent++;
+  }
+}
+
+static void
+receive_message (node_t *node)
+{
+  // If node has a message to deliver, check that it's the expected one.
+
+  uint8_t message[WXL_MAX_MESSAGE_LENGTH];
+  uint8_t length;
+
+  if ( ! node->receive (&length, message) ) {
+    return;
+  }
+
+  uint32_t sn;
+  if ( length < TEST_SEQUENCE_NUMBER_LENGTH ) {
+    fail ("%s got a %u byte message", node->name, length);
+  }
+  memcpy (&sn, message, TEST_SEQUENCE_NUMBER_LENGTH);
+  if ( sn != node->messages_delivered ) {
+    fail (
+        "%s got message %lu when expecting message %lu",
+        node->name,
+        (unsigned long) sn,
+        (unsigned long) node->messages_delivered );
+  }
+  for ( uint8_t ii = TEST_SEQUENCE_NUMBER_LENGTH ; ii < length ; ii++ ) {
+    if ( message[ii] != filler_byte (sn, ii) ) {
+      fail ("%s got corrupted message %lu", node->name, (unsigned long) sn);
+    }
+  }
+
+  node->messages_delivered++;
+}
+
+static void
+run (
+    char const *name,
+    channel_config_t const *config,
+    uint32_t a_to_b_total,
+    uint32_t b_to_a_total,
+    uint16_t b_receive_interval_ms,
+    uint32_t deadline_ms )
+{
+  // Have node_a send a_to_b_total messages to node_b while node_b sends
+  // b_to_a_total to node_a over a channel with the given characteristics.
+  // node_a collects messages as soon as they're available but node_b only
+  // collects one every b_receive_interval_ms.  All messages must be
+  // delivered, and both nodes must see all their messages acknowledged,
+  // before deadline_ms.
+
+  test_name = name;
+  reset (config, 42);
+
+  while (
+      node_a.messages_delivered < b_to_a_total ||
+      node_b.messages_delivered < a_to_b_total ||
+      node_a.unacknowledged_count () != 0 ||
+      node_b.unacknowledged_count () != 0 ) {
+
+    if ( now_ms >= deadline_ms ) {
+      fail (
+          "link stalled: %s delivered %lu of %lu, "
+          "%s delivered %lu of %lu",
+          node_a.name,
+          (unsigned long) node_a.messages_delivered,
+          (unsigned long) b_to_a_total,
+          node_b.name,
+          (unsigned long) node_b.messages_delivered,
+          (unsigned long) a_to_b_total );
+    }
+
+    send_messages (&node_a, a_to_b_total);
+    send_messages (&node_b, b_to_a_total);
+
+    receive_message (&node_a);
+    if ( now_ms % b_receive_interval_ms == 0 ) {
+      receive_message (&node_b);
+    }
+
+    node_a.service (0);
+    node_b.service (0);
+
+    now_ms++;
+  }
+
+  // Anything still in transit can only be a duplicate or ACK, but make
+  // sure none of it confuses the nodes.
+  for ( uint16_t ii = 0 ; ii < config->max_latency_ms + 1 ; ii++ ) {
+    node_a.service (0);
+    node_b.service (0);
+    receive_message (&node_a);
+    receive_message (&node_b);
+    now_ms++;
+  }
+
+  wxl_stats_t a_stats, b_stats;
+  node_a.get_stats (&a_stats);
+  node_b.get_stats (&b_stats);
+
+  printf (
+      "%s: ok: %lu + %lu messages in %lu ms, %u + %u retransmissions, "
+      "srtt %u/%u ms\n",
+      test_name,
+      (unsigned long) a_to_b_total,
+      (unsigned long) b_to_a_total,
+      (unsigned long) now_ms,
+      a_stats.retransmissions,
+      b_stats.retransmissions,
+      a_stats.srtt_ms,
+      b_stats.srtt_ms );
+}
+
+int
+main (void)
+{
+  channel_config_t const perfect = { 0, 20, 20 };
+  channel_config_t const lossy = { 25, 30, 70 };
+  channel_config_t const bad = { 50, 10, 200 };
+
+  // Lots of messages both ways, with the receivers keeping up.
+  run ("perfect bidirectional", &perfect, 2000, 2000, 1, 60000);
+  run ("lossy bidirectional", &lossy, 2000, 2000, 1, 600000);
+  run ("bad bidirectional", &bad, 100, 100, 1, 1200000);
+
+  // A receiver that collects messages much more slowly than the sender can
+  // send them, so the window is usually full of messages it has received
+  // but not delivered.
+  run ("slow receiver", &perfect, 500, 0, 50, 60000);
+  run ("lossy slow receiver", &lossy, 500, 0, 50, 600000);
+  run ("lossy slow bidirectional", &lossy, 500, 500, 50, 600000);
+
+  return EXIT_SUCCESS;
+}
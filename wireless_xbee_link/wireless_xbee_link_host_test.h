@@ -0,0 +1,76 @@
+// Stand-Ins Letting wireless_xbee_link.c Compile on the Development Machine
+//
+// Host test driver: wireless_xbee_link_host_test.c
+//
+// This header is force-included (with the compiler's -include option) when
+// wireless_xbee_link.c is compiled for the host (see the Makefile).  It
+// claims the include guards of the AVR-only headers wireless_xbee_link.c
+// uses and supplies the few things it needs from them instead, so the
+// real wireless_xbee_link.c (and the real wireless_xbee.h) are what gets
+// tested.  The wx_put_split_frame(), wx_get_frame(), timer0_stopwatch_init()
+// and timer0_stopwatch_ticks() functions are left for the test driver to
+// implement on top of a simulated radio channel and clock.
+//
+// The test driver needs two linked nodes, so wireless_xbee_link.c gets
+// compiled twice, each time with WXL_HOST_TEST_NODE defined to a different
+// prefix.  That prefix is pasted onto the names of all the public functions
+// of wireless_xbee_link.h and all the external functions it calls, so for
+// example with WXL_HOST_TEST_NODE defined to node_a, wxl_send() becomes
+// node_a_wxl_send() and calls node_a_wx_put_split_frame().  The static
+// link state naturally ends up separate for each node.
+
+#ifndef WIRELESS_XBEE_LINK_HOST_TEST_H
+#define WIRELESS_XBEE_LINK_HOST_TEST_H
+
+#include <stdint.h>
+
+// Stand in for the parts of util.h, dio.h, uart.h, and timer0_stopwatch.h
+// that wireless_xbee_link.c and wireless_xbee.h actually use.
+#define UTIL_H
+#define DIO_H
+#define UART_H
+#define TIMER0_STOPWATCH_H
+
+#define TRUE  0x01
+#define FALSE 0x00
+
+#define _BV(bit) (1 << (bit))
+
+#ifndef F_CPU
+#  define F_CPU 16000000UL
+#endif
+#define TIMER0_STOPWATCH_PRESCALER_DIVIDER 64
+
+#define WXL_HOST_TEST_TIMER0_TICKS_PER_MS \
+  (F_CPU / TIMER0_STOPWATCH_PRESCALER_DIVIDER / 1000)
+
+#ifdef WXL_HOST_TEST_NODE
+
+#  define WXL_HOST_TEST_PASTE_AGAIN(prefix, name) prefix ## _ ## name
+#  define WXL_HOST_TEST_PASTE(prefix, name) \
+     WXL_HOST_TEST_PASTE_AGAIN (prefix, name)
+#  define WXL_HOST_TEST_RENAME(name) \
+     WXL_HOST_TEST_PASTE (WXL_HOST_TEST_NODE, name)
+
+#  define wxl_init                 WXL_HOST_TEST_RENAME (wxl_init)
+#  define wxl_send                 WXL_HOST_TEST_RENAME (wxl_send)
+#  define wxl_receive              WXL_HOST_TEST_RENAME (wxl_receive)
+#  define wxl_service              WXL_HOST_TEST_RENAME (wxl_service)
+#  define wxl_unacknowledged_count \
+     WXL_HOST_TEST_RENAME (wxl_unacknowledged_count)
+#  define wxl_get_stats            WXL_HOST_TEST_RENAME (wxl_get_stats)
+
+#  define wx_put_split_frame       WXL_HOST_TEST_RENAME (wx_put_split_frame)
+#  define wx_get_frame             WXL_HOST_TEST_RENAME (wx_get_frame)
+#  define timer0_stopwatch_init    WXL_HOST_TEST_RENAME (timer0_stopwatch_init)
+#  define timer0_stopwatch_ticks   WXL_HOST_TEST_RENAME (timer0_stopwatch_ticks)
+
+#endif
+
+void
+timer0_stopwatch_init (void);
+
+uint32_t
+timer0_stopwatch_ticks (void);
+
+#endif // WIRELESS_XBEE_LINK_HOST_TEST_H
@@ -0,0 +1,68 @@
+// Test/demo for the wireless_xbee_link.h interface.
+//
+// This program needs two Arduinos with XBee shields, both running it (see
+// wireless_xbee_test.c for notes about the shields, and the CHKP_PD4()
+// macro definition there for why a LED must be connected from Digital 4
+// (PD4) to ground).  Each node streams messages containing an incrementing
+// counter to the other node as fast as the link allows, and checks that
+// the counter values it receives arrive exactly once and in order.  The LED
+// blinks once per 100 messages received, or blinks frantically forever if
+// a message arrives out of order (or a duplicate is delivered).
+//
+// Since loss is what the link is supposed to cope with, it's worth making
+// things hard for it: try moving the nodes far apart, putting one in a
+// metal box, or resetting the XBee of one node (but not the Arduino) while
+// the test is running.  Both nodes should recover and continue.  Note that
+// the Arduinos themselves must be started at about the same time (see the
+// notes about connection setup in wireless_xbee_link.h).
+
+#include <assert.h>
+#include <string.h>
+
+#include "util.h"
+#include "wireless_xbee_link.h"
+
+// See the comments in wireless_xbee_test.c for the story behind these.
+#define CHKP_PD4_SB() CHKP_USING (DDRD, DDD4, PORTD, PORTD4, 300.0, 1)
+#undef BTRAP
+#define BTRAP() BTRAP_USING (DDRD, DDD4, PORTD, PORTD4, 100.0)
+
+#define MESSAGES_PER_BLINK 100
+
+int
+main (void)
+{
+  wx_init ();
+  wxl_init ();
+
+  uint16_t next_to_send = 0;
+  uint16_t next_expected = 0;
+
+  for ( ; ; ) {
+
+    if ( wxl_send (sizeof (next_to_send), &next_to_send) ) {
+      next_to_send++;
+    }
+
+    // A short timeout keeps the send window full
+    uint16_t const service_timeout_ms = 2;
+    wxl_service (service_timeout_ms);
+
+    uint8_t count;
+    uint8_t buf[WXL_MAX_MESSAGE_LENGTH];
+    while ( wxl_receive (&count, buf) ) {
+      uint16_t value;
+      if ( count != sizeof (value) ) {
+        BTRAP ();
+      }
+      memcpy (&value, buf, sizeof (value));
+      if ( value != next_expected ) {
+        BTRAP ();
+      }
+      next_expected++;
+      if ( next_expected % MESSAGES_PER_BLINK == 0 ) {
+        CHKP_PD4_SB ();
+      }
+    }
+  }
+}